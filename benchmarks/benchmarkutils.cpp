@@ -0,0 +1,166 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#ifdef __GLIBC__
+#  include <malloc.h>
+#endif
+
+#include <QtGlobal>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+
+#include "core/application.h"
+#include "core/database.h"
+#include "core/song.h"
+#include "collection/collection.h"
+#include "collection/collectionbackend.h"
+#include "benchmarkutils.h"
+
+namespace BenchmarkUtils {
+
+const int kSmallCollection = 10000;
+const int kMediumCollection = 100000;
+const int kLargeCollection = 1000000;
+
+namespace {
+
+Application *sApplication = nullptr;
+
+const char *kWords[] = {
+  "love", "night", "blue", "heart", "river", "fire", "dream", "light", "road", "home",
+  "café", "über", "niño", "søster", "sœur", "Ærø", "Ångström", "東京", "Москва", "naïve",
+  "song", "time", "world", "rain", "summer", "winter", "gold", "shadow", "city", "ocean"
+};
+const int kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+const char *kGenres[] = {
+  "Rock", "Pop", "Jazz", "Classical", "Electronic", "Hip-Hop", "Folk", "Metal", "Blues", "Ambient"
+};
+const int kGenreCount = sizeof(kGenres) / sizeof(kGenres[0]);
+
+QString Words(int seed, int count) {
+
+  QStringList words;
+  for (int i = 0; i < count; ++i) {
+    // A cheap integer hash, so neighbouring songs don't share all their words.
+    seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+    words << QString::fromUtf8(kWords[seed % kWordCount]);
+  }
+  return words.join(" ");
+
+}
+
+}  // namespace
+
+void SetApplication(Application *app) { sApplication = app; }
+
+Application *app() { return sApplication; }
+
+Song GenerateSong(int i, int directory_id, const QString &path) {
+
+  const int track = i % 12;
+  const int album = i / 12;
+  const int artist = album / 8;
+  const bool compilation = album % 50 == 0;
+
+  Song song;
+  song.Init(Words(i, 1 + i % 4), QString("%1 %2").arg(Words(artist * 7, 2)).arg(compilation ? track : artist), QString("%1 %2").arg(Words(album * 13, 1 + album % 3)).arg(album), 180000000000LL + (i % 240) * 1000000000LL);
+  if (!compilation) song.set_albumartist(QString("%1 %2").arg(Words(artist * 7, 2)).arg(artist));
+  song.set_compilation(compilation);
+  song.set_track(track + 1);
+  song.set_disc(1 + (album % 10 == 0 ? track / 6 : 0));
+  song.set_year(1960 + album % 60);
+  song.set_originalyear(album % 5 == 0 ? 1950 + album % 40 : -1);
+  song.set_genre(kGenres[artist % kGenreCount]);
+  song.set_composer(album % 3 == 0 ? Words(artist * 11, 2) : QString());
+  song.set_comment(i % 10 == 0 ? Words(i * 17, 6) : QString());
+  song.set_filetype(album % 2 == 0 ? Song::FileType_FLAC : Song::FileType_MPEG);
+  song.set_samplerate(album % 4 == 0 ? 96000 : 44100);
+  song.set_bitdepth(album % 2 == 0 ? (album % 4 == 0 ? 24 : 16) : 0);
+  song.set_bitrate(album % 2 == 0 ? 1000 : 320);
+  song.set_directory_id(directory_id);
+  const QString basefilename = QString("%1.%2").arg(track + 1, 2, 10, QChar('0')).arg(album % 2 == 0 ? "flac" : "mp3");
+  song.set_url(QUrl::fromLocalFile(QString("%1/%2/%3/%4").arg(path).arg(artist).arg(album).arg(basefilename)));
+  song.set_basefilename(basefilename);
+  song.set_filesize(5000000 + i % 1000);
+  song.set_mtime(1500000000 + i);
+  song.set_ctime(1500000000 + i);
+  song.set_source(Song::Source_Collection);
+  song.set_valid(true);
+  return song;
+
+}
+
+SongList GenerateSongs(int count, int directory_id, const QString &path) {
+
+  SongList songs;
+  songs.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    songs << GenerateSong(i, directory_id, path);
+  }
+  return songs;
+
+}
+
+qint64 HeapInUse() {
+
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+  return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+  return mallinfo().uordblks;
+#else
+  return -1;
+#endif
+
+}
+
+CollectionBackend *CreateCollectionBackend(Database **db) {
+
+  *db = new MemoryDatabase(sApplication);
+  CollectionBackend *backend = new CollectionBackend;
+  backend->Init(*db, SCollection::kSongsTable, SCollection::kDirsTable, SCollection::kSubdirsTable, SCollection::kFtsTable, SCollection::kJournalTable);
+  return backend;
+
+}
+
+CollectionBackend *Collection(int song_count) {
+
+  static QMap<int, CollectionBackend*> collections;
+  if (collections.contains(song_count)) return collections[song_count];
+
+  Database *db = nullptr;
+  CollectionBackend *backend = CreateCollectionBackend(&db);
+  backend->AddDirectory("/music");
+
+  // Add the songs in batches the size the collection watcher uses.
+  const SongList songs = GenerateSongs(song_count);
+  for (int i = 0; i < songs.count(); i += 1000) {
+    backend->AddOrUpdateSongs(songs.mid(i, 1000));
+  }
+
+  collections[song_count] = backend;
+  return backend;
+
+}
+
+}  // namespace BenchmarkUtils
@@ -0,0 +1,61 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BENCHMARKUTILS_H
+#define BENCHMARKUTILS_H
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QString>
+
+#include "core/song.h"
+
+class Application;
+class CollectionBackend;
+class Database;
+
+namespace BenchmarkUtils {
+
+// Library sizes most benchmarks are run with.
+extern const int kSmallCollection;
+extern const int kMediumCollection;
+extern const int kLargeCollection;
+
+// The application shared by all benchmarks, its database and settings are in Qt's test locations.
+void SetApplication(Application *app);
+Application *app();
+
+// A deterministic synthetic library: 12 tracks per album, 8 albums per artist, a compilation every 50 albums,
+// and some non-ASCII text so the tokenizer and the collation don't only see ASCII.
+Song GenerateSong(int i, int directory_id = 1, const QString &path = "/music");
+SongList GenerateSongs(int count, int directory_id = 1, const QString &path = "/music");
+
+// Bytes of heap memory currently allocated, or -1 where that can't be measured.
+qint64 HeapInUse();
+
+// An empty in-memory collection.  The caller owns both.
+CollectionBackend *CreateCollectionBackend(Database **db);
+
+// An in-memory collection with the given number of synthetic songs, created once per size and kept until exit.
+CollectionBackend *Collection(int song_count);
+
+}  // namespace BenchmarkUtils
+
+#endif  // BENCHMARKUTILS_H
@@ -0,0 +1,140 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <benchmark/benchmark.h>
+
+#include <QCoreApplication>
+#include <QThreadPool>
+#include <QVector>
+
+#include "core/database.h"
+#include "core/song.h"
+#include "collection/collectionbackend.h"
+#include "collection/collectionindex.h"
+#include "collection/collectionmodel.h"
+#include "collection/collectionquery.h"
+#include "benchmarkutils.h"
+
+using namespace BenchmarkUtils;
+
+namespace {
+
+void CollectionSizes(benchmark::internal::Benchmark *b) {
+  b->Arg(kSmallCollection)->Arg(kMediumCollection)->Arg(kLargeCollection);
+}
+
+void CollectionSizesAndGroupings(benchmark::internal::Benchmark *b) {
+  for (int size : { kSmallCollection, kMediumCollection, kLargeCollection }) {
+    for (int group_by = CollectionModel::GroupBy_Artist; group_by <= CollectionModel::GroupBy_Format; ++group_by) {
+      b->Args({ size, group_by });
+    }
+  }
+}
+
+}  // namespace
+
+static void BM_CollectionBackend_AddOrUpdateSongs(benchmark::State &state) {
+
+  const SongList songs = GenerateSongs(state.range(0));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    Database *db = nullptr;
+    CollectionBackend *backend = CreateCollectionBackend(&db);
+    backend->AddDirectory("/music");
+    state.ResumeTiming();
+
+    for (int i = 0; i < songs.count(); i += 1000) {
+      backend->AddOrUpdateSongs(songs.mid(i, 1000));
+    }
+
+    state.PauseTiming();
+    delete backend;
+    delete db;
+    state.ResumeTiming();
+  }
+
+  state.counters["songs_per_second"] = benchmark::Counter(songs.count(), benchmark::Counter::kIsIterationInvariantRate);
+
+}
+BENCHMARK(BM_CollectionBackend_AddOrUpdateSongs)->Apply(CollectionSizes)->Unit(benchmark::kMillisecond)->Iterations(1);
+
+// Reads every song of the collection, like the watcher does when it rescans a directory.
+static void BM_CollectionBackend_FindSongsInDirectory(benchmark::State &state) {
+
+  CollectionBackend *backend = Collection(state.range(0));
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(backend->FindSongsInDirectory(1));
+  }
+
+  state.counters["songs_per_second"] = benchmark::Counter(state.range(0), benchmark::Counter::kIsIterationInvariantRate);
+
+}
+BENCHMARK(BM_CollectionBackend_FindSongsInDirectory)->Apply(CollectionSizes)->Unit(benchmark::kMillisecond);
+
+static void BM_CollectionModel_Reset(benchmark::State &state) {
+
+  CollectionBackend *backend = Collection(state.range(0));
+  CollectionModel model(backend, app());
+
+  // Setting the grouping starts a background reset, let it finish so it doesn't run alongside the measured ones.
+  model.SetGroupBy(CollectionModel::Grouping(CollectionModel::GroupBy(state.range(1)), CollectionModel::GroupBy_Album));
+  QThreadPool::globalInstance()->waitForDone();
+  QCoreApplication::processEvents();
+
+  for (auto _ : state) {
+    model.Reset();
+  }
+
+  state.counters["top_level_items"] = model.rowCount();
+
+}
+BENCHMARK(BM_CollectionModel_Reset)->Apply(CollectionSizesAndGroupings)->Unit(benchmark::kMillisecond);
+
+static void BM_CollectionIndex_Load(benchmark::State &state) {
+
+  CollectionBackend *backend = Collection(state.range(0));
+
+  for (auto _ : state) {
+    delete CollectionIndex::Load(backend);
+  }
+
+}
+BENCHMARK(BM_CollectionIndex_Load)->Apply(CollectionSizes)->Unit(benchmark::kMillisecond);
+
+static void BM_CollectionIndex_Filter(benchmark::State &state) {
+
+  CollectionIndex *index = CollectionIndex::Load(Collection(state.range(0)));
+
+  QueryOptions options;
+  options.set_filter("love ni");
+
+  int matches = 0;
+  for (auto _ : state) {
+    matches = index->Filter(options).count();
+  }
+  state.counters["matches"] = matches;
+
+  delete index;
+
+}
+BENCHMARK(BM_CollectionIndex_Filter)->Apply(CollectionSizes)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,186 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <benchmark/benchmark.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QUrl>
+
+#include "core/database.h"
+#include "core/song.h"
+#include "core/taskmanager.h"
+#include "collection/collectionbackend.h"
+#include "collection/collectionwatcher.h"
+#include "collection/directory.h"
+#include "benchmarkutils.h"
+
+using namespace BenchmarkUtils;
+
+namespace {
+
+void SubdirectorySizes(benchmark::internal::Benchmark *b) {
+  b->Arg(1000)->Arg(10000)->Arg(100000);
+}
+
+// A subdirectory listing and the songs the collection has for it, every file has a song.
+void GenerateListing(int file_count, QStringList *files_on_disk, SongList *songs_in_db) {
+
+  const QString path = "/music/album";
+  for (int i = 0; i < file_count; ++i) {
+    const QString filename = QString("%1/%2.mp3").arg(path).arg(i, 5, 10, QChar('0'));
+    *files_on_disk << filename;
+
+    Song song = GenerateSong(i, 1, path);
+    song.set_url(QUrl::fromLocalFile(filename));
+    *songs_in_db << song;
+  }
+
+}
+
+}  // namespace
+
+// Baseline for the hashed lookups: how ScanSubdirectoryOnly used to compare the listing against the collection,
+// searching the songs for every file and the files for every song.  Quadratic, so it's only run once per size.
+static void BM_CollectionWatcher_MatchListingLinear(benchmark::State &state) {
+
+  QStringList files_on_disk;
+  SongList songs_in_db;
+  GenerateListing(state.range(0), &files_on_disk, &songs_in_db);
+
+  for (auto _ : state) {
+    int matched = 0;
+    for (const QString &file : files_on_disk) {
+      for (const Song &song : songs_in_db) {
+        if (song.url().toLocalFile() == file) {
+          ++matched;
+          break;
+        }
+      }
+    }
+    int deleted = 0;
+    for (const Song &song : songs_in_db) {
+      if (!files_on_disk.contains(song.url().toLocalFile())) ++deleted;
+    }
+    benchmark::DoNotOptimize(matched);
+    benchmark::DoNotOptimize(deleted);
+  }
+
+  state.counters["files_per_second"] = benchmark::Counter(state.range(0), benchmark::Counter::kIsIterationInvariantRate);
+
+}
+BENCHMARK(BM_CollectionWatcher_MatchListingLinear)->Apply(SubdirectorySizes)->Unit(benchmark::kMillisecond)->Iterations(1);
+
+// The same comparison with the songs indexed by path and the files in a set, as ScanSubdirectoryOnly does now.
+static void BM_CollectionWatcher_MatchListingHashed(benchmark::State &state) {
+
+  QStringList files_on_disk;
+  SongList songs_in_db;
+  GenerateListing(state.range(0), &files_on_disk, &songs_in_db);
+
+  for (auto _ : state) {
+    QSet<QString> files_on_disk_set;
+    files_on_disk_set.reserve(files_on_disk.count());
+    for (const QString &file : files_on_disk) files_on_disk_set.insert(file);
+
+    QHash<QString, Song> songs_in_db_by_path;
+    songs_in_db_by_path.reserve(songs_in_db.count());
+    for (const Song &song : songs_in_db) {
+      const QString song_path = song.url().toLocalFile();
+      if (!songs_in_db_by_path.contains(song_path)) songs_in_db_by_path.insert(song_path, song);
+    }
+
+    int matched = 0;
+    for (const QString &file : files_on_disk) {
+      if (songs_in_db_by_path.contains(file)) ++matched;
+    }
+    int deleted = 0;
+    for (const Song &song : songs_in_db) {
+      if (!files_on_disk_set.contains(song.url().toLocalFile())) ++deleted;
+    }
+    benchmark::DoNotOptimize(matched);
+    benchmark::DoNotOptimize(deleted);
+  }
+
+  state.counters["files_per_second"] = benchmark::Counter(state.range(0), benchmark::Counter::kIsIterationInvariantRate);
+
+}
+BENCHMARK(BM_CollectionWatcher_MatchListingHashed)->Apply(SubdirectorySizes)->Unit(benchmark::kMillisecond);
+
+// Rescans one subdirectory where every file is already in the collection with the right mtime.
+// No tags are read, so this measures comparing the directory listing against the collection.
+static void BM_CollectionWatcher_RescanUnchangedSubdirectory(benchmark::State &state) {
+
+  const int file_count = state.range(0);
+
+  QTemporaryDir temp_dir;
+  const QString path = temp_dir.path() + "/album";
+  QDir().mkpath(path);
+
+  Database *db = nullptr;
+  CollectionBackend *backend = CreateCollectionBackend(&db);
+  backend->AddDirectory(temp_dir.path());
+  Directory dir = backend->GetAllDirectories().first();
+
+  SongList songs;
+  for (int i = 0; i < file_count; ++i) {
+    const QString filename = QString("%1/%2.mp3").arg(path).arg(i, 5, 10, QChar('0'));
+    QFile file(filename);
+    file.open(QIODevice::WriteOnly);
+    file.close();
+
+    Song song = GenerateSong(i, dir.id, path);
+    song.set_url(QUrl::fromLocalFile(filename));
+    song.set_basefilename(QFileInfo(filename).fileName());
+    song.set_mtime(QFileInfo(filename).lastModified().toTime_t());
+    songs << song;
+  }
+  backend->AddOrUpdateSongs(songs);
+
+  TaskManager task_manager;
+  CollectionWatcher watcher(Song::Source_Collection);
+  watcher.set_backend(backend);
+  watcher.set_task_manager(&task_manager);
+
+  Subdirectory subdir;
+  subdir.directory_id = dir.id;
+  subdir.path = path;
+  // A zero mtime makes the incremental scan look at the subdirectory every time.
+  subdir.mtime = 0;
+
+  for (auto _ : state) {
+    watcher.AddDirectory(dir, SubdirectoryList() << subdir);
+  }
+
+  state.counters["files_per_second"] = benchmark::Counter(file_count, benchmark::Counter::kIsIterationInvariantRate);
+
+  watcher.Stop();
+  delete backend;
+  delete db;
+
+}
+BENCHMARK(BM_CollectionWatcher_RescanUnchangedSubdirectory)->Apply(SubdirectorySizes)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,204 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "analyzer/fht.h"
+#include "analyzer/fhtkernels.h"
+
+// One analyzer frame: mix the scope down to mono, take the spectrum and scale it, like BlockAnalyzer does.
+// The first argument is the FHT size exponent, the analyzers use 9.
+
+namespace {
+
+// The recursive scalar FHT the analyzers used before, kept as the baseline.
+class RecursiveFHT {
+ public:
+  explicit RecursiveFHT(int n) : num_(1 << n), buf_(num_), tab_(num_ * 2) {
+
+    float *costab = tab_.data();
+    float *sintab = tab_.data() + num_ / 2 + 1;
+    for (int ul = 0; ul < num_; ul++) {
+      float d = M_PI * ul / (num_ / 2);
+      *costab = *sintab = cos(d);
+      costab += 2;
+      sintab += 2;
+      if (sintab > tab_.data() + num_ * 2) sintab = tab_.data() + 1;
+    }
+
+  }
+
+  void spectrum(float *p) {
+
+    transform(p, num_, 0);
+    p[0] = static_cast<float>(2 * pow(p[0], 2));
+    float *q = p + num_ - 1;
+    for (int i = 1; i < num_ / 2; i++) p[i] = static_cast<float>(pow(p[i], 2) + pow(*q--, 2));
+    for (int i = 0; i < num_ / 2; i++) p[i] = static_cast<float>(sqrt(p[i] / 2));
+
+  }
+
+  void scale(float *p, float d) {
+    for (int i = 0; i < num_ / 2; i++) p[i] *= d;
+  }
+
+ private:
+  void transform8(float *p) {
+
+    const float a = p[0], b = p[1], c = p[2], d = p[3], e = p[4], f = p[5], g = p[6], h = p[7];
+    const float b_f2 = (b - f) * M_SQRT2;
+    const float d_h2 = (d - h) * M_SQRT2;
+    const float a_c_eg = a - c - e + g;
+    const float a_ce_g = a - c + e - g;
+    const float ac_e_g = a + c - e - g;
+    const float aceg = a + c + e + g;
+    const float b_df_h = b - d + f - h;
+    const float bdfh = b + d + f + h;
+
+    p[0] = aceg + bdfh;
+    p[1] = ac_e_g + b_f2;
+    p[2] = a_ce_g + b_df_h;
+    p[3] = a_c_eg + d_h2;
+    p[4] = aceg - bdfh;
+    p[5] = ac_e_g - b_f2;
+    p[6] = a_ce_g - b_df_h;
+    p[7] = a_c_eg - d_h2;
+
+  }
+
+  void transform(float *p, int n, int k) {
+
+    if (n == 8) {
+      transform8(p + k);
+      return;
+    }
+
+    const int ndiv2 = n / 2;
+    float *t1 = buf_.data();
+    float *t2 = buf_.data() + ndiv2;
+    float *pp = p + k;
+    for (int i = 0; i < ndiv2; i++) {
+      *t1++ = *pp++;
+      *t2++ = *pp++;
+    }
+    std::copy(buf_.data(), buf_.data() + n, p + k);
+
+    transform(p, ndiv2, k);
+    transform(p, ndiv2, k + ndiv2);
+
+    const int j = num_ / ndiv2 - 1;
+    t1 = buf_.data();
+    t2 = t1 + ndiv2;
+    float *t3 = p + k + ndiv2;
+    float *t4 = p + k + n;
+    const float *ptab = tab_.data();
+    pp = p + k;
+
+    float a = *ptab++ * *t3++;
+    a += *ptab * *pp;
+    ptab += j;
+    *t1++ = *pp + a;
+    *t2++ = *pp++ - a;
+
+    for (int i = 1; i < ndiv2; i++, ptab += j) {
+      a = *ptab++ * *t3++;
+      a += *ptab * *--t4;
+      *t1++ = *pp + a;
+      *t2++ = *pp++ - a;
+    }
+
+    std::copy(buf_.data(), buf_.data() + n, p + k);
+
+  }
+
+  int num_;
+  std::vector<float> buf_;
+  std::vector<float> tab_;
+};
+
+// The second argument is the index of the kernels in FHTKernels::Available(), plain C++ is 0.
+void KernelSizes(benchmark::internal::Benchmark *b) {
+  for (int exp = 6; exp <= 9; ++exp) {
+    for (int kernels = 0; kernels < 3; ++kernels) b->Args({ exp, kernels });
+  }
+}
+
+std::vector<int16_t> GenerateScope(int frames) {
+
+  std::vector<int16_t> scope(frames * 2);
+  for (int16_t &sample : scope) sample = static_cast<int16_t>(rand() % 65536 - 32768);
+  return scope;
+
+}
+
+}  // namespace
+
+static void BM_FHT_Recursive(benchmark::State &state) {
+
+  RecursiveFHT fht(state.range(0));
+  const int size = 1 << state.range(0);
+  const std::vector<int16_t> scope = GenerateScope(size);
+  std::vector<float> buffer(size);
+
+  for (auto _ : state) {
+    for (int x = 0, i = 0; x < size; ++x, i += 2) {
+      buffer[x] = double(scope[i] + scope[i + 1]) / (2 * (1 << 15));
+    }
+    fht.spectrum(buffer.data());
+    fht.scale(buffer.data(), 1.0 / 20);
+    benchmark::DoNotOptimize(buffer.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * size);
+
+}
+BENCHMARK(BM_FHT_Recursive)->DenseRange(6, 9);
+
+static void BM_FHT_Kernels(benchmark::State &state) {
+
+  const std::vector<const FHTKernels*> kernels = FHTKernels::Available();
+  if (state.range(1) >= static_cast<int>(kernels.size())) {
+    state.SkipWithError("The CPU doesn't support these kernels");
+    return;
+  }
+  state.SetLabel(kernels[state.range(1)]->name);
+
+  FHT fht(state.range(0), kernels[state.range(1)]);
+  const std::vector<int16_t> scope = GenerateScope(fht.size());
+  std::vector<float> buffer(fht.size());
+
+  for (auto _ : state) {
+    fht.mono(buffer.data(), scope.data());
+    fht.spectrum(buffer.data());
+    fht.scale(buffer.data(), 1.0 / 20);
+    benchmark::DoNotOptimize(buffer.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * fht.size());
+
+}
+BENCHMARK(BM_FHT_Kernels)->Apply(KernelSizes);
@@ -0,0 +1,74 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <cstring>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <QtGlobal>
+#include <QApplication>
+#include <QCoreApplication>
+#include <QStandardPaths>
+
+#include "core/application.h"
+#include "core/logging.h"
+#include "core/metatypes.h"
+#include "benchmarkutils.h"
+
+int main(int argc, char **argv) {
+
+  // The collection model loads icons and pixmaps, which need a GUI application, but not a display.
+  if (qgetenv("QT_QPA_PLATFORM").isEmpty()) qputenv("QT_QPA_PLATFORM", "offscreen");
+
+  QCoreApplication::setApplicationName("strawberry-benchmarks");
+  QCoreApplication::setOrganizationName("Strawberry");
+
+  // Keep the database and settings of the benchmarks away from the user's.
+  QStandardPaths::setTestModeEnabled(true);
+
+  QApplication a(argc, argv);
+
+  RegisterMetaTypes();
+  logging::Init();
+  logging::SetLevels("*:1");
+
+  Application app;
+  BenchmarkUtils::SetApplication(&app);
+
+  // Results are written as JSON unless another format is asked for, so runs can be compared by tools.
+  std::vector<char*> args(argv, argv + argc);
+  bool has_format = false;
+  for (char *arg : args) {
+    if (strncmp(arg, "--benchmark_format", 18) == 0) has_format = true;
+  }
+  static char json_format[] = "--benchmark_format=json";
+  if (!has_format) args.push_back(json_format);
+
+  int args_count = args.size();
+  benchmark::Initialize(&args_count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(args_count, args.data())) return 1;
+
+  benchmark::RunSpecifiedBenchmarks();
+
+  return 0;
+
+}
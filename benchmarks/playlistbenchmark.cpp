@@ -0,0 +1,157 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <benchmark/benchmark.h>
+
+#include <QtGlobal>
+#include <QSortFilterProxyModel>
+#include <QString>
+#include <QStringList>
+
+#include "core/application.h"
+#include "core/song.h"
+#include "playlist/playlist.h"
+#include "playlist/playlistbackend.h"
+#include "playlist/playlistitem.h"
+#include "playlist/songplaylistitem.h"
+#include "benchmarkutils.h"
+
+using namespace BenchmarkUtils;
+
+namespace {
+
+void PlaylistSizes(benchmark::internal::Benchmark *b) {
+  b->Arg(kSmallCollection)->Arg(kMediumCollection);
+}
+
+PlaylistItemList GeneratePlaylistItems(int count) {
+
+  PlaylistItemList items;
+  items.reserve(count);
+  for (const Song &song : GenerateSongs(count)) {
+    items << PlaylistItemPtr(new SongPlaylistItem(song));
+  }
+  return items;
+
+}
+
+}  // namespace
+
+static void BM_PlaylistBackend_SavePlaylist(benchmark::State &state) {
+
+  PlaylistBackend *backend = app()->playlist_backend();
+  const int id = backend->CreatePlaylist("Benchmark", QString());
+  const PlaylistItemList items = GeneratePlaylistItems(state.range(0));
+
+  for (auto _ : state) {
+    backend->SavePlaylist(id, items, -1);
+  }
+
+  state.counters["items_per_second"] = benchmark::Counter(items.count(), benchmark::Counter::kIsIterationInvariantRate);
+
+  backend->RemovePlaylist(id);
+
+}
+BENCHMARK(BM_PlaylistBackend_SavePlaylist)->Apply(PlaylistSizes)->Unit(benchmark::kMillisecond);
+
+// Inserts and removes one item in a saved playlist, only the edit is written.
+static void BM_PlaylistBackend_InsertRemoveItem(benchmark::State &state) {
+
+  PlaylistBackend *backend = app()->playlist_backend();
+  const int id = backend->CreatePlaylist("Benchmark", QString());
+  backend->SavePlaylist(id, GeneratePlaylistItems(state.range(0)), -1);
+  const PlaylistItemList item = GeneratePlaylistItems(1);
+
+  for (auto _ : state) {
+    backend->InsertPlaylistItems(id, state.range(0) / 2, item, -1);
+    backend->RemovePlaylistItems(id, state.range(0) / 2, 1, -1);
+  }
+
+  backend->RemovePlaylist(id);
+
+}
+BENCHMARK(BM_PlaylistBackend_InsertRemoveItem)->Apply(PlaylistSizes)->Unit(benchmark::kMillisecond);
+
+static void BM_PlaylistBackend_GetPlaylistItems(benchmark::State &state) {
+
+  PlaylistBackend *backend = app()->playlist_backend();
+  const int id = backend->CreatePlaylist("Benchmark", QString());
+  backend->SavePlaylist(id, GeneratePlaylistItems(state.range(0)), -1);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(backend->GetPlaylistItems(id));
+  }
+
+  state.counters["items_per_second"] = benchmark::Counter(state.range(0), benchmark::Counter::kIsIterationInvariantRate);
+
+  backend->RemovePlaylist(id);
+
+}
+BENCHMARK(BM_PlaylistBackend_GetPlaylistItems)->Apply(PlaylistSizes)->Unit(benchmark::kMillisecond);
+
+static void BM_Playlist_Sort(benchmark::State &state) {
+
+  PlaylistBackend *backend = app()->playlist_backend();
+  const int id = backend->CreatePlaylist("Benchmark", QString());
+  Playlist playlist(backend, app()->task_manager(), app()->collection_backend(), id);
+  playlist.InsertSongs(GenerateSongs(state.range(0)));
+
+  // Alternate the order so every iteration has to move the items.
+  Qt::SortOrder order = Qt::AscendingOrder;
+  for (auto _ : state) {
+    playlist.sort(state.range(1), order);
+    order = order == Qt::AscendingOrder ? Qt::DescendingOrder : Qt::AscendingOrder;
+  }
+
+  backend->RemovePlaylist(id);
+
+}
+BENCHMARK(BM_Playlist_Sort)
+    ->Args({ kSmallCollection, Playlist::Column_Title })
+    ->Args({ kSmallCollection, Playlist::Column_Artist })
+    ->Args({ kSmallCollection, Playlist::Column_Album })
+    ->Args({ kMediumCollection, Playlist::Column_Title })
+    ->Args({ kMediumCollection, Playlist::Column_Artist })
+    ->Args({ kMediumCollection, Playlist::Column_Album })
+    ->Unit(benchmark::kMillisecond);
+
+// Types a filter one letter at a time, then clears it.
+static void BM_Playlist_Filter(benchmark::State &state) {
+
+  PlaylistBackend *backend = app()->playlist_backend();
+  const int id = backend->CreatePlaylist("Benchmark", QString());
+  Playlist playlist(backend, app()->task_manager(), app()->collection_backend(), id);
+  playlist.InsertSongs(GenerateSongs(state.range(0)));
+
+  const QStringList filters = QStringList() << "l" << "lo" << "lov" << "love" << "love n" << "love ni" << QString();
+  int matches = 0;
+  for (auto _ : state) {
+    for (const QString &filter : filters) {
+      playlist.proxy()->setFilterFixedString(filter);
+      if (filter == "love ni") matches = playlist.proxy()->rowCount();
+    }
+  }
+  state.counters["matches"] = matches;
+
+  backend->RemovePlaylist(id);
+
+}
+BENCHMARK(BM_Playlist_Filter)->Apply(PlaylistSizes)->Unit(benchmark::kMillisecond);
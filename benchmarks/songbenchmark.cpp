@@ -0,0 +1,117 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <benchmark/benchmark.h>
+
+#include <QtGlobal>
+
+#include "core/song.h"
+#include "collection/collectionbackend.h"
+#include "collection/collectionquery.h"
+#include "playlist/playlistitem.h"
+#include "playlist/songplaylistitem.h"
+#include "benchmarkutils.h"
+
+using namespace BenchmarkUtils;
+
+// These measure the heap used by the songs that are kept, the time is only how long creating them takes.
+// The second argument turns compact storage on.
+
+namespace {
+
+void SongMemory(benchmark::State &state, qint64 used, int song_count) {
+
+  state.counters["bytes_per_song"] = double(used) / song_count;
+  state.counters["megabytes"] = double(used) / (1024 * 1024);
+
+}
+
+}  // namespace
+
+static void BM_Song_Memory_Generated(benchmark::State &state) {
+
+  if (HeapInUse() == -1) {
+    state.SkipWithError("Heap usage can't be measured on this platform");
+    return;
+  }
+
+  Song::SetCompactStorage(state.range(1));
+
+  qint64 used = 0;
+  for (auto _ : state) {
+    const qint64 before = HeapInUse();
+    SongList songs = GenerateSongs(state.range(0));
+    used = HeapInUse() - before;
+
+    state.PauseTiming();
+    songs.clear();
+    state.ResumeTiming();
+  }
+  SongMemory(state, used, state.range(0));
+
+  Song::SetCompactStorage(false);
+
+}
+BENCHMARK(BM_Song_Memory_Generated)
+    ->Args({ kMediumCollection, 0 })
+    ->Args({ kMediumCollection, 1 })
+    ->Args({ 500000, 0 })
+    ->Args({ 500000, 1 })
+    ->Unit(benchmark::kMillisecond)->Iterations(1);
+
+// The songs of the whole collection as loaded from the database, plus a playlist holding all of them.
+static void BM_Song_Memory_CollectionAndPlaylist(benchmark::State &state) {
+
+  if (HeapInUse() == -1) {
+    state.SkipWithError("Heap usage can't be measured on this platform");
+    return;
+  }
+
+  CollectionBackend *backend = Collection(state.range(0));
+  Song::SetCompactStorage(state.range(1));
+
+  qint64 used = 0;
+  for (auto _ : state) {
+    const qint64 before = HeapInUse();
+    CollectionQuery query;
+    SongList songs = backend->ExecCollectionQuery(&query);
+    PlaylistItemList items;
+    items.reserve(songs.count());
+    for (const Song &song : songs) {
+      items << PlaylistItemPtr(new SongPlaylistItem(song));
+    }
+    // Drop the collection's copies, like the playlist outliving a collection query
+    songs.clear();
+    used = HeapInUse() - before;
+
+    state.PauseTiming();
+    items.clear();
+    state.ResumeTiming();
+  }
+  SongMemory(state, used, state.range(0));
+
+  Song::SetCompactStorage(false);
+
+}
+BENCHMARK(BM_Song_Memory_CollectionAndPlaylist)
+    ->Args({ kMediumCollection, 0 })
+    ->Args({ kMediumCollection, 1 })
+    ->Unit(benchmark::kMillisecond)->Iterations(1);
@@ -0,0 +1,126 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <benchmark/benchmark.h>
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include "core/song.h"
+#include "tagreader.h"
+#include "tagreadermessages.pb.h"
+#include "benchmarkutils.h"
+
+using namespace BenchmarkUtils;
+
+namespace {
+
+const int kFixtureCount = 100;
+
+// A few silent MPEG-1 layer III frames, 128 kbit/s at 44.1 kHz, 417 bytes each.
+QByteArray GenerateMP3() {
+
+  QByteArray frame(417, '\0');
+  frame[0] = char(0xff);
+  frame[1] = char(0xfb);
+  frame[2] = char(0x90);
+  frame[3] = char(0x64);
+  return frame.repeated(40);
+
+}
+
+// The FLAC signature and a STREAMINFO block for 44.1 kHz, 2 channel, 16 bit audio, without audio frames.
+QByteArray GenerateFLAC() {
+
+  QByteArray data("fLaC");
+  data.append(char(0x80));  // Last metadata block, STREAMINFO
+  data.append(char(0x00));
+  data.append(char(0x00));
+  data.append(char(34));
+
+  QByteArray streaminfo(34, '\0');
+  streaminfo[0] = char(0x10);  // Minimum block size 4096
+  streaminfo[2] = char(0x10);  // Maximum block size 4096
+  // Sample rate (20 bits), channels - 1 (3 bits), bits per sample - 1 (5 bits) and total samples (36 bits).
+  const quint64 packed = (quint64(44100) << 44) | (quint64(1) << 41) | (quint64(15) << 36);
+  for (int i = 0; i < 8; ++i) {
+    streaminfo[10 + i] = char((packed >> (56 - i * 8)) & 0xff);
+  }
+  data.append(streaminfo);
+  return data;
+
+}
+
+QStringList GenerateFixtures(const QString &path, const QString &extension, const QByteArray &data) {
+
+  TagReader tag_reader;
+  QStringList filenames;
+  for (int i = 0; i < kFixtureCount; ++i) {
+    const QString filename = QString("%1/%2.%3").arg(path).arg(i).arg(extension);
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) continue;
+    file.write(data);
+    file.close();
+
+    pb::tagreader::SongMetadata metadata;
+    GenerateSong(i).ToProtobuf(&metadata);
+    tag_reader.SaveFile(filename, metadata);
+    filenames << filename;
+  }
+  return filenames;
+
+}
+
+void ReadFiles(benchmark::State &state, const QStringList &filenames) {
+
+  TagReader tag_reader;
+  for (auto _ : state) {
+    for (const QString &filename : filenames) {
+      pb::tagreader::SongMetadata metadata;
+      tag_reader.ReadFile(filename, &metadata);
+      benchmark::DoNotOptimize(metadata);
+    }
+  }
+  state.counters["files_per_second"] = benchmark::Counter(filenames.count(), benchmark::Counter::kIsIterationInvariantRate);
+
+}
+
+}  // namespace
+
+static void BM_TagReader_ReadFile_MP3(benchmark::State &state) {
+
+  QTemporaryDir temp_dir;
+  ReadFiles(state, GenerateFixtures(temp_dir.path(), "mp3", GenerateMP3()));
+
+}
+BENCHMARK(BM_TagReader_ReadFile_MP3)->Unit(benchmark::kMillisecond);
+
+static void BM_TagReader_ReadFile_FLAC(benchmark::State &state) {
+
+  QTemporaryDir temp_dir;
+  ReadFiles(state, GenerateFixtures(temp_dir.path(), "flac", GenerateFLAC()));
+
+}
+BENCHMARK(BM_TagReader_ReadFile_FLAC)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,61 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <benchmark/benchmark.h>
+
+#include <QByteArray>
+#include <QList>
+
+#include "core/song.h"
+#include "core/utf8tokenizer.h"
+#include "benchmarkutils.h"
+
+using namespace BenchmarkUtils;
+
+// Tokenizes the text of the full text search columns, like the FTS tokenizer does when songs are added.
+static void BM_Utf8Tokenizer(benchmark::State &state) {
+
+  QList<QByteArray> texts;
+  qint64 bytes = 0;
+  for (const Song &song : GenerateSongs(state.range(0))) {
+    const QByteArray text = QString("%1 %2 %3 %4 %5 %6").arg(song.title(), song.album(), song.artist(), song.albumartist(), song.genre(), song.comment()).toUtf8();
+    texts << text;
+    bytes += text.size();
+  }
+
+  int tokens = 0;
+  for (auto _ : state) {
+    tokens = 0;
+    for (const QByteArray &text : texts) {
+      Utf8Tokenizer tokenizer(text.constData(), text.size());
+      const char *token = nullptr;
+      int token_bytes = 0;
+      int start_offset = 0;
+      int end_offset = 0;
+      while (tokenizer.Next(&token, &token_bytes, &start_offset, &end_offset)) ++tokens;
+    }
+  }
+
+  state.SetBytesProcessed(state.iterations() * bytes);
+  state.counters["tokens"] = tokens;
+
+}
+BENCHMARK(BM_Utf8Tokenizer)->Arg(kSmallCollection)->Arg(kMediumCollection)->Unit(benchmark::kMillisecond);
@@ -68,7 +68,7 @@ CREATE INDEX idx_device_%deviceid_songs_comp_artist ON device_%deviceid_songs (c
 
 CREATE VIRTUAL TABLE device_%deviceid_fts USING fts3(
   ftstitle, ftsalbum, ftsartist, ftsalbumartist, ftscomposer, ftsperformer, ftsgrouping, ftsgenre, ftscomment,
-  tokenize=unicode
+  tokenize=utf8fold
 );
 
 UPDATE devices SET schema_version=0 WHERE ROWID=%deviceid;
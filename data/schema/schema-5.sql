@@ -0,0 +1,7 @@
+CREATE TABLE IF NOT EXISTS subdirectories_journal (
+  directory_id INTEGER NOT NULL,
+  path TEXT NOT NULL,
+  PRIMARY KEY (directory_id, path)
+);
+
+UPDATE schema_version SET version=5;
@@ -0,0 +1,14 @@
+ALTER TABLE playlists ADD COLUMN item_order BLOB;
+
+CREATE TABLE IF NOT EXISTS playlist_items_journal (
+  playlist INTEGER NOT NULL,
+  operation INTEGER NOT NULL,
+  position INTEGER NOT NULL DEFAULT -1,
+  rows BLOB
+);
+
+CREATE INDEX IF NOT EXISTS idx_playlist_items_playlist ON playlist_items (playlist);
+
+CREATE INDEX IF NOT EXISTS idx_playlist_items_journal_playlist ON playlist_items_journal (playlist);
+
+UPDATE schema_version SET version=7;
@@ -4,7 +4,7 @@ CREATE TABLE IF NOT EXISTS schema_version (
 
 DELETE FROM schema_version;
 
-INSERT INTO schema_version (version) VALUES (4);
+INSERT INTO schema_version (version) VALUES (7);
 
 CREATE TABLE IF NOT EXISTS directories (
   path TEXT NOT NULL,
@@ -17,6 +17,12 @@ CREATE TABLE IF NOT EXISTS subdirectories (
   mtime INTEGER NOT NULL
 );
 
+CREATE TABLE IF NOT EXISTS subdirectories_journal (
+  directory_id INTEGER NOT NULL,
+  path TEXT NOT NULL,
+  PRIMARY KEY (directory_id, path)
+);
+
 CREATE TABLE IF NOT EXISTS songs (
 
   title TEXT NOT NULL,
@@ -236,7 +242,8 @@ CREATE TABLE IF NOT EXISTS playlists (
   ui_order INTEGER NOT NULL DEFAULT 0,
   special_type TEXT,
   ui_path TEXT,
-  is_favorite INTEGER NOT NULL DEFAULT 0
+  is_favorite INTEGER NOT NULL DEFAULT 0,
+  item_order BLOB
 
 );
 
@@ -298,6 +305,13 @@ CREATE TABLE IF NOT EXISTS playlist_items (
 
 );
 
+CREATE TABLE IF NOT EXISTS playlist_items_journal (
+  playlist INTEGER NOT NULL,
+  operation INTEGER NOT NULL,
+  position INTEGER NOT NULL DEFAULT -1,
+  rows BLOB
+);
+
 CREATE TABLE IF NOT EXISTS devices (
   unique_id TEXT NOT NULL,
   friendly_name TEXT,
@@ -316,6 +330,10 @@ CREATE INDEX IF NOT EXISTS idx_album ON songs (album);
 
 CREATE INDEX IF NOT EXISTS idx_title ON songs (title);
 
+CREATE INDEX IF NOT EXISTS idx_playlist_items_playlist ON playlist_items (playlist);
+
+CREATE INDEX IF NOT EXISTS idx_playlist_items_journal_playlist ON playlist_items_journal (playlist);
+
 CREATE VIEW IF NOT EXISTS duplicated_songs as select artist dup_artist, album dup_album, title dup_title from songs as inner_songs where artist != '' and album != '' and title != '' and unavailable = 0 group by artist, album , title having count(*) > 1;
 
 CREATE VIRTUAL TABLE IF NOT EXISTS songs_fts USING fts3(
@@ -329,7 +347,7 @@ CREATE VIRTUAL TABLE IF NOT EXISTS songs_fts USING fts3(
   ftsgrouping,
   ftsgenre,
   ftscomment,
-  tokenize=unicode
+  tokenize=utf8fold
 
 );
 
@@ -344,7 +362,7 @@ CREATE VIRTUAL TABLE IF NOT EXISTS tidal_artists_songs_fts USING fts3(
   ftsgrouping,
   ftsgenre,
   ftscomment,
-  tokenize=unicode
+  tokenize=utf8fold
 
 );
 
@@ -359,7 +377,7 @@ CREATE VIRTUAL TABLE IF NOT EXISTS tidal_albums_songs_fts USING fts3(
   ftsgrouping,
   ftsgenre,
   ftscomment,
-  tokenize=unicode
+  tokenize=utf8fold
 
 );
 
@@ -374,7 +392,7 @@ CREATE VIRTUAL TABLE IF NOT EXISTS tidal_songs_fts USING fts3(
   ftsgrouping,
   ftsgenre,
   ftscomment,
-  tokenize=unicode
+  tokenize=utf8fold
 
 );
 
@@ -389,7 +407,7 @@ CREATE VIRTUAL TABLE IF NOT EXISTS playlist_items_fts_ USING fts3(
   ftsgrouping,
   ftsgenre,
   ftscomment,
-  tokenize=unicode
+  tokenize=utf8fold
 
 );
 
@@ -404,7 +422,7 @@ CREATE VIRTUAL TABLE IF NOT EXISTS %allsongstables_fts USING fts3(
   ftsgrouping,
   ftsgenre,
   ftscomment,
-  tokenize=unicode
+  tokenize=utf8fold
 
 );
 
@@ -46,6 +46,12 @@ void TagReaderWorker::MessageArrived(const pb::tagreader::Message& message) {
   if (message.has_read_file_request()) {
     tag_reader_.ReadFile(QStringFromStdString(message.read_file_request().filename()), reply.mutable_read_file_response()->mutable_metadata());
   }
+  else if (message.has_read_files_request()) {
+    pb::tagreader::ReadFilesResponse *response = reply.mutable_read_files_response();
+    for (const std::string &filename : message.read_files_request().filenames()) {
+      tag_reader_.ReadFile(QStringFromStdString(filename), response->add_metadata());
+    }
+  }
   else if (message.has_save_file_request()) {
     reply.mutable_save_file_response()->set_success(tag_reader_.SaveFile(QStringFromStdString(message.save_file_request().filename()), message.save_file_request().metadata()));
   }
@@ -29,9 +29,15 @@
 #include <cstdint>
 
 #include <QWidget>
-#include <QVector>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QElapsedTimer>
 #include <QPainter>
 #include <QPalette>
+#include <QPoint>
+#include <QRect>
+#include <QStringList>
+#include <QThread>
 #include <QTimerEvent>
 #include <QtEvents>
 
@@ -63,7 +69,87 @@ Analyzer::Base::Base(QWidget *parent, uint scopeSize)
       engine_(nullptr),
       lastscope_(512),
       new_frame_(false),
-      is_playing_(false) {}
+      is_playing_(false),
+      state_(Engine::Empty),
+      threaded_(false),
+      render_thread_(nullptr),
+      renderer_(nullptr),
+      render_size_(size()),
+      background_(palette().color(QPalette::Window)),
+      frame_pending_(false),
+      pending_state_(Engine::Empty) {}
+
+Analyzer::Base::~Base() {
+
+  set_threaded(false);
+  delete fht_;
+
+}
+
+void Analyzer::Base::changeTimeout(uint newTimeout) {
+
+  QMutexLocker l(&render_mutex_);
+
+  timeout_ = newTimeout;
+  if (timer_.isActive()) {
+    timer_.stop();
+    timer_.start(timeout_, this);
+  }
+
+  framerateChanged();
+
+}
+
+void Analyzer::Base::set_threaded(bool threaded) {
+
+  if (threaded == threaded_) return;
+
+  if (threaded) {
+    renderer_ = new Renderer(this);
+    render_thread_ = new QThread;
+    render_thread_->setObjectName("Analyzer");
+    renderer_->moveToThread(render_thread_);
+    render_thread_->start();
+    threaded_ = true;
+  }
+  else {
+    // Waits for the frame being rendered, frames still queued are dropped with the renderer.
+    render_thread_->quit();
+    render_thread_->wait();
+    delete renderer_;
+    delete render_thread_;
+    renderer_ = nullptr;
+    render_thread_ = nullptr;
+    threaded_ = false;
+
+    QMutexLocker l(&frame_mutex_);
+    frame_pending_ = false;
+    front_frame_ = QImage();
+    back_frame_ = QImage();
+
+    qLog(Debug) << "Analyzer frame times:" << frame_times_.ToString();
+  }
+
+  frame_times_.Clear();
+
+}
+
+bool Analyzer::Base::event(QEvent *e) {
+
+  switch (e->type()) {
+    case QEvent::Resize:
+    case QEvent::PaletteChange: {
+      // The analyzers rebuild their buffers here, so this can't happen in the middle of a frame.
+      QMutexLocker l(&render_mutex_);
+      render_size_ = size();
+      background_ = palette().color(QPalette::Window);
+      return QWidget::event(e);
+    }
+    default:
+      return QWidget::event(e);
+  }
+
+}
 
 void Analyzer::Base::hideEvent(QHideEvent*) { timer_.stop(); }
 
@@ -71,15 +157,16 @@ void Analyzer::Base::showEvent(QShowEvent*) { timer_.start(timeout(), this); }
 
 void Analyzer::Base::transform(Scope& scope) {
 
-  QVector<float> aux(fht_->size());
-  if (aux.size() >= scope.size()) {
-    std::copy(scope.begin(), scope.end(), aux.begin());
+  // Reuse the buffer between frames
+  aux_.resize(fht_->size());
+  if (aux_.size() >= scope.size()) {
+    std::copy(scope.begin(), scope.end(), aux_.begin());
   }
   else {
-    std::copy(scope.begin(), scope.begin() + aux.size(), aux.begin());
+    std::copy(scope.begin(), scope.begin() + aux_.size(), aux_.begin());
   }
 
-  fht_->logSpectrum(scope.data(), aux.data());
+  fht_->logSpectrum(scope.data(), aux_.data());
   fht_->scale(scope.data(), 1.0 / 20);
 
   scope.resize(fht_->size() / 2);  // second half of values are rubbish
@@ -89,18 +176,33 @@ void Analyzer::Base::transform(Scope& scope) {
 void Analyzer::Base::paintEvent(QPaintEvent *e) {
 
   QPainter p(this);
-  p.fillRect(e->rect(), palette().color(QPalette::Window));
 
-  switch (engine_->state()) {
-    case Engine::Playing: {
-      const Engine::Scope& thescope = engine_->scope(timeout_);
-      int i = 0;
+  if (threaded_) {
+    p.fillRect(e->rect(), palette().color(QPalette::Window));
+    QMutexLocker l(&frame_mutex_);
+    p.drawImage(0, 0, front_frame_);
+    return;
+  }
+
+  QMutexLocker l(&render_mutex_);
+  if (engine_->state() == Engine::Playing) {
+    Paint(p, Engine::Playing, engine_->scope(timeout_));
+  }
+  else {
+    Paint(p, engine_->state(), Engine::Scope());
+  }
 
+}
+
+void Analyzer::Base::Paint(QPainter &p, Engine::State state, const Engine::Scope &scope) {
+
+  p.fillRect(QRect(QPoint(0, 0), render_size_), background_);
+
+  state_ = state;
+  switch (state) {
+    case Engine::Playing: {
       // convert to mono here - our built in analyzers need mono, but the engines provide interleaved pcm
-      for (uint x = 0; (int)x < fht_->size(); ++x) {
-        lastscope_[x] = double(thescope[i] + thescope[i + 1]) / (2 * (1 << 15));
-        i += 2;
-      }
+      fht_->mono(lastscope_.data(), scope.data());
 
       is_playing_ = true;
       transform(lastscope_);
@@ -124,6 +226,68 @@ void Analyzer::Base::paintEvent(QPaintEvent *e) {
 
 }
 
+void Analyzer::Base::QueueFrame() {
+
+  const Engine::State state = engine_->state();
+
+  QMutexLocker l(&frame_mutex_);
+
+  // The renderer hasn't started on the last frame yet, so that one is replaced by this one.
+  const bool skipped = frame_pending_;
+
+  pending_state_ = state;
+  if (state == Engine::Playing) {
+    pending_scope_ = engine_->scope(timeout_);
+  }
+  frame_pending_ = true;
+
+  if (skipped) {
+    frame_times_.AddSkipped();
+  }
+  else {
+    QMetaObject::invokeMethod(renderer_, "Render", Qt::QueuedConnection);
+  }
+
+}
+
+void Analyzer::Base::RenderFrame() {
+
+  QElapsedTimer timer;
+  timer.start();
+
+  Engine::State state;
+  {
+    QMutexLocker l(&frame_mutex_);
+    if (!frame_pending_) return;
+    frame_pending_ = false;
+    state = pending_state_;
+    render_scope_.swap(pending_scope_);
+  }
+
+  {
+    QMutexLocker l(&render_mutex_);
+
+    if (back_frame_.size() != render_size_) {
+      back_frame_ = QImage(render_size_, QImage::Format_ARGB32_Premultiplied);
+    }
+    if (back_frame_.isNull()) return;
+
+    QPainter p(&back_frame_);
+    new_frame_ = true;
+    Paint(p, state, render_scope_);
+  }
+
+  {
+    QMutexLocker l(&frame_mutex_);
+    front_frame_.swap(back_frame_);
+  }
+
+  frame_times_.Add(timer.nsecsElapsed());
+
+  QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
+
+}
+
 int Analyzer::Base::resizeExponent(int exp) {
 
   if (exp < 3)
@@ -224,7 +388,54 @@ void Analyzer::Base::timerEvent(QTimerEvent *e) {
   QWidget::timerEvent(e);
   if (e->timerId() != timer_.timerId()) return;
 
+  if (threaded_) {
+    QueueFrame();
+    return;
+  }
+
   new_frame_ = true;
   update();
 
 }
+
+void Analyzer::Renderer::Render() { analyzer_->RenderFrame(); }
+
+Analyzer::FrameTimeHistogram::FrameTimeHistogram() { Clear(); }
+
+void Analyzer::FrameTimeHistogram::Add(qint64 nanosec) {
+
+  int bucket = 0;
+  while (bucket < kBucketCount - 1 && nanosec >= qint64(BucketLimit(bucket)) * 1000000) ++bucket;
+  buckets_[bucket].ref();
+
+}
+
+void Analyzer::FrameTimeHistogram::Clear() {
+
+  for (int i = 0; i < kBucketCount; ++i) buckets_[i].store(0);
+  skipped_.store(0);
+
+}
+
+int Analyzer::FrameTimeHistogram::BucketLimit(int bucket) {
+
+  if (bucket >= kBucketCount - 1) return -1;
+  return 1 << bucket;
+
+}
+
+QString Analyzer::FrameTimeHistogram::ToString() const {
+
+  QStringList ret;
+  for (int i = 0; i < kBucketCount; ++i) {
+    if (BucketLimit(i) == -1) {
+      ret << QString(">=%1ms: %2").arg(BucketLimit(i - 1)).arg(count(i));
+    }
+    else {
+      ret << QString("<%1ms: %2").arg(BucketLimit(i)).arg(count(i));
+    }
+  }
+  ret << QString("skipped: %1").arg(skipped());
+  return ret.join(", ");
+
+}
@@ -35,7 +35,12 @@
 #include <QtGlobal>
 #include <QObject>
 #include <QWidget>
+#include <QAtomicInt>
 #include <QBasicTimer>
+#include <QColor>
+#include <QImage>
+#include <QMutex>
+#include <QSize>
 #include <QString>
 #include <QPainter>
 #include <QtEvents>
@@ -44,38 +49,87 @@
 #include "engine/engine_fwd.h"
 #include "engine/enginebase.h"
 
+class QEvent;
 class QHideEvent;
 class QShowEvent;
 class QTimerEvent;
 class QPaintEvent;
+class QThread;
 
 namespace Analyzer {
 
 typedef std::vector<float> Scope;
 
+class Base;
+
+// How long frames took to render, counted in buckets that double from 1ms.
+// Frames that were dropped because the one before wasn't done yet are counted as skipped.
+class FrameTimeHistogram {
+ public:
+  static const int kBucketCount = 8;
+
+  FrameTimeHistogram();
+
+  void Add(qint64 nanosec);
+  void AddSkipped() { skipped_.ref(); }
+  void Clear();
+
+  int count(int bucket) const { return buckets_[bucket].load(); }
+  int skipped() const { return skipped_.load(); }
+
+  // The upper end of the bucket in milliseconds, -1 for the last one
+  static int BucketLimit(int bucket);
+
+  QString ToString() const;
+
+ private:
+  QAtomicInt buckets_[kBucketCount];
+  QAtomicInt skipped_;
+};
+
+// Renders the frames of an analyzer on its own thread.
+class Renderer : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit Renderer(Base *analyzer) : analyzer_(analyzer) {}
+
+ public slots:
+  void Render();
+
+ private:
+  Base *analyzer_;
+};
+
 class Base : public QWidget {
   Q_OBJECT
 
+  friend class Renderer;
+
  public:
-  ~Base() { delete fht_; }
+  ~Base();
 
   uint timeout() const { return timeout_; }
 
   void set_engine(EngineBase *engine) { engine_ = engine; }
 
-  void changeTimeout(uint newTimeout) {
-    timeout_ = newTimeout;
-    if (timer_.isActive()) {
-      timer_.stop();
-      timer_.start(timeout_, this);
-    }
-  }
+  // Also calls framerateChanged()
+  void changeTimeout(uint newTimeout);
 
   virtual void framerateChanged() {}
 
+  // When threaded, the spectrum is computed and the frame is painted into an image on a separate thread, the widget only draws the last finished frame.
+  // transform(), analyze() and demo() then run on that thread, so analyzers must paint with QImages instead of QPixmaps.
+  // This has to be turned off again before the analyzer is deleted.
+  void set_threaded(bool threaded);
+  bool threaded() const { return threaded_; }
+
+  const FrameTimeHistogram &frame_times() const { return frame_times_; }
+
  protected:
   explicit Base(QWidget*, uint scopeSize = 7);
 
+  bool event(QEvent*);
   void hideEvent(QHideEvent*);
   void showEvent(QShowEvent*);
   void paintEvent(QPaintEvent*);
@@ -90,15 +144,48 @@ class Base : public QWidget {
   virtual void analyze(QPainter& p, const Scope&, bool new_frame) = 0;
   virtual void demo(QPainter& p);
 
+  // The size to paint at, use this instead of width() and height() in analyze() and demo()
+  QSize render_size() const { return render_size_; }
+
+ private:
+  void Paint(QPainter &p, Engine::State state, const Engine::Scope &scope);
+  void QueueFrame();
+  void RenderFrame();
+
  protected:
   QBasicTimer timer_;
   uint timeout_;
   FHT *fht_;
   EngineBase *engine_;
   Scope lastscope_;
+  Scope aux_;
 
   bool new_frame_;
   bool is_playing_;
+
+  // The engine state of the frame being painted
+  Engine::State state_;
+
+ private:
+  bool threaded_;
+  QThread *render_thread_;
+  Renderer *renderer_;
+
+  // Held while a frame is rendered, and while the GUI thread changes anything a frame uses
+  QMutex render_mutex_;
+  QSize render_size_;
+  QColor background_;
+  Engine::Scope render_scope_;
+  QImage back_frame_;
+
+  // Guards the input for the next frame and the last finished frame
+  QMutex frame_mutex_;
+  bool frame_pending_;
+  Engine::State pending_state_;
+  Engine::Scope pending_scope_;
+  QImage front_frame_;
+
+  FrameTimeHistogram frame_times_;
 };
 
 void interpolate(const Scope&, Scope&);
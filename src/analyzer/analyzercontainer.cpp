@@ -46,6 +46,7 @@
 
 const char *AnalyzerContainer::kSettingsGroup = "Analyzer";
 const char *AnalyzerContainer::kSettingsFramerate = "framerate";
+const char *AnalyzerContainer::kSettingsThreaded = "threaded";
 
 // Framerates
 const int AnalyzerContainer::kLowFramerate = 20;
@@ -62,6 +63,7 @@ AnalyzerContainer::AnalyzerContainer(QWidget *parent)
       group_framerate_(new QActionGroup(this)),
       mapper_(new QSignalMapper(this)),
       mapper_framerate_(new QSignalMapper(this)),
+      threaded_action_(nullptr),
       visualisation_action_(nullptr),
       double_click_timer_(new QTimer(this)),
       ignore_next_click_(false),
@@ -80,6 +82,9 @@ AnalyzerContainer::AnalyzerContainer(QWidget *parent)
   connect(mapper_framerate_, SIGNAL(mapped(int)), SLOT(ChangeFramerate(int)));
 
   context_menu_->addMenu(context_menu_framerate_);
+  threaded_action_ = context_menu_->addAction(tr("Render in a separate thread"));
+  threaded_action_->setCheckable(true);
+  connect(threaded_action_, SIGNAL(toggled(bool)), SLOT(ChangeThreaded(bool)));
   context_menu_->addSeparator();
 
   AddAnalyzerType<BlockAnalyzer>();
@@ -103,6 +108,11 @@ AnalyzerContainer::AnalyzerContainer(QWidget *parent)
 
 }
 
+AnalyzerContainer::~AnalyzerContainer() {
+  // The render thread has to be stopped before the analyzer is destroyed by QWidget
+  DeleteAnalyzer();
+}
+
 void AnalyzerContainer::SetActions(QAction *visualisation) {
   visualisation_action_ = visualisation;
   context_menu_->addAction(visualisation_action_);
@@ -151,10 +161,20 @@ void AnalyzerContainer::SetEngine(EngineBase *engine) {
   engine_ = engine;
 }
 
-void AnalyzerContainer::DisableAnalyzer() {
+void AnalyzerContainer::DeleteAnalyzer() {
+
+  if (!current_analyzer_) return;
+
+  // Stop rendering before the subclass is destroyed, ~Base would be too late
+  current_analyzer_->set_threaded(false);
   delete current_analyzer_;
   current_analyzer_ = nullptr;
 
+}
+
+void AnalyzerContainer::DisableAnalyzer() {
+  DeleteAnalyzer();
+
   Save();
 }
 
@@ -167,12 +187,13 @@ void AnalyzerContainer::ChangeAnalyzer(int id) {
     return;
   }
 
-  delete current_analyzer_;
+  DeleteAnalyzer();
   current_analyzer_ = qobject_cast<Analyzer::Base*>(instance);
   current_analyzer_->set_engine(engine_);
   // Even if it is not supposed to happen, I don't want to get a dbz error
   current_framerate_ = current_framerate_ == 0 ? kMediumFramerate : current_framerate_;
   current_analyzer_->changeTimeout(1000 / current_framerate_);
+  current_analyzer_->set_threaded(threaded_action_->isChecked());
 
   layout()->addWidget(current_analyzer_);
 
@@ -185,10 +206,8 @@ void AnalyzerContainer::ChangeFramerate(int new_framerate) {
   if (current_analyzer_) {
     // Even if it is not supposed to happen, I don't want to get a dbz error
     new_framerate = new_framerate == 0 ? kMediumFramerate : new_framerate;
+    // this also notifies the current analyzer that the framerate has changed
     current_analyzer_->changeTimeout(1000 / new_framerate);
-
-    // notify the current analyzer that the framerate has changed
-    current_analyzer_->framerateChanged();
   }
   SaveFramerate(new_framerate);
 
@@ -200,8 +219,12 @@ void AnalyzerContainer::Load() {
   s.beginGroup(kSettingsGroup);
   QString type = s.value("type", "BlockAnalyzer").toString();
   current_framerate_ = s.value(kSettingsFramerate, kMediumFramerate).toInt();
+  const bool threaded = s.value(kSettingsThreaded, false).toBool();
   s.endGroup();
 
+  // Before the analyzer is created, so it starts out threaded
+  threaded_action_->setChecked(threaded);
+
   // Analyzer
   if (type.isEmpty()) {
     DisableAnalyzer();
@@ -239,6 +262,17 @@ void AnalyzerContainer::SaveFramerate(int framerate) {
 
 }
 
+void AnalyzerContainer::ChangeThreaded(bool threaded) {
+
+  if (current_analyzer_) current_analyzer_->set_threaded(threaded);
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.setValue(kSettingsThreaded, threaded);
+  s.endGroup();
+
+}
+
 void AnalyzerContainer::Save() {
 
   QSettings s;
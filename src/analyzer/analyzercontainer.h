@@ -50,12 +50,14 @@ class AnalyzerContainer : public QWidget {
 
  public:
   AnalyzerContainer(QWidget* parent);
+  ~AnalyzerContainer();
 
   void SetEngine(EngineBase *engine);
   void SetActions(QAction *visualisation);
 
   static const char *kSettingsGroup;
   static const char *kSettingsFramerate;
+  static const char *kSettingsThreaded;
 
 signals:
   void WheelEvent(int delta);
@@ -69,6 +71,7 @@ signals:
   void ChangeAnalyzer(int id);
   void ChangeFramerate(int new_framerate);
   void DisableAnalyzer();
+  void ChangeThreaded(bool threaded);
   void ShowPopupMenu();
 
  private:
@@ -80,6 +83,7 @@ signals:
   void Load();
   void Save();
   void SaveFramerate(int framerate);
+  void DeleteAnalyzer();
   template <typename T>
   void AddAnalyzerType();
   void AddFramerate(const QString& name, int framerate);
@@ -97,6 +101,7 @@ signals:
   QList<int> framerate_list_;
   QList<QAction*> actions_;
   QAction *disable_action_;
+  QAction *threaded_action_;
 
   QAction *visualisation_action_;
   QTimer *double_click_timer_;
@@ -27,7 +27,7 @@
 #include <cmath>
 
 #include <QWidget>
-#include <QPixmap>
+#include <QImage>
 #include <QPainter>
 #include <QPalette>
 #include <QColor>
@@ -50,8 +50,8 @@ BlockAnalyzer::BlockAnalyzer(QWidget *parent)
       columns_(0),
       rows_(0),
       y_(0),
-      barpixmap_(1, 1),
-      topbarpixmap_(kWidth, kHeight),
+      barpixmap_(1, 1, QImage::Format_ARGB32_Premultiplied),
+      topbarpixmap_(kWidth, kHeight, QImage::Format_ARGB32_Premultiplied),
       scope_(kMinColumns),
       store_(1 << 8, 0),
       fade_bars_(kFadeSize),
@@ -64,7 +64,7 @@ BlockAnalyzer::BlockAnalyzer(QWidget *parent)
   setMaximumWidth(kMaxColumns * (kWidth + 1) - 1);
 
   // mxcl says null pixmaps cause crashes, so let's play it safe
-  for (uint i = 0; i < kFadeSize; ++i) fade_bars_[i] = QPixmap(1, 1);
+  for (uint i = 0; i < kFadeSize; ++i) fade_bars_[i] = QImage(1, 1, QImage::Format_ARGB32_Premultiplied);
 
 }
 
@@ -74,8 +74,9 @@ void BlockAnalyzer::resizeEvent(QResizeEvent *e) {
 
   QWidget::resizeEvent(e);
 
-  background_ = QPixmap(size());
-  canvas_ = QPixmap(size());
+  // Images rather than pixmaps, these are painted on the render thread when the analyzer is threaded
+  background_ = QImage(size(), QImage::Format_ARGB32_Premultiplied);
+  canvas_ = QImage(size(), QImage::Format_ARGB32_Premultiplied);
 
   const uint oldRows = rows_;
 
@@ -90,10 +91,10 @@ void BlockAnalyzer::resizeEvent(QResizeEvent *e) {
   scope_.resize(columns_);
 
   if (rows_ != oldRows) {
-    barpixmap_ = QPixmap(kWidth, rows_ * (kHeight + 1));
+    barpixmap_ = QImage(kWidth, rows_ * (kHeight + 1), QImage::Format_ARGB32_Premultiplied);
 
     for (uint i = 0; i < kFadeSize; ++i)
-      fade_bars_[i] = QPixmap(kWidth, rows_ * (kHeight + 1));
+      fade_bars_[i] = QImage(kWidth, rows_ * (kHeight + 1), QImage::Format_ARGB32_Premultiplied);
 
     yscale_.resize(rows_ + 1);
 
@@ -156,7 +157,7 @@ void BlockAnalyzer::analyze(QPainter &p, const Analyzer::Scope &s, bool new_fram
   // if it contains 6 elements there are 5 rows in the analyzer
 
   if (!new_frame) {
-    p.drawPixmap(0, 0, canvas_);
+    p.drawImage(0, 0, canvas_);
     return;
   }
 
@@ -165,7 +166,7 @@ void BlockAnalyzer::analyze(QPainter &p, const Analyzer::Scope &s, bool new_fram
   Analyzer::interpolate(s, scope_);
 
   // Paint the background
-  canvas_painter.drawPixmap(0, 0, background_);
+  canvas_painter.drawImage(0, 0, background_);
 
   for (uint y, x = 0; x < scope_.size(); ++x) {
     // determine y
@@ -187,19 +188,19 @@ void BlockAnalyzer::analyze(QPainter &p, const Analyzer::Scope &s, bool new_fram
     if (fade_intensity_[x] > 0) {
       const uint offset = --fade_intensity_[x];
       const uint y = y_ + (fade_pos_[x] * (kHeight + 1));
-      canvas_painter.drawPixmap(x * (kWidth + 1), y, fade_bars_[offset], 0, 0, kWidth, height() - y);
+      canvas_painter.drawImage(x * (kWidth + 1), y, fade_bars_[offset], 0, 0, kWidth, render_size().height() - y);
     }
 
     if (fade_intensity_[x] == 0) fade_pos_[x] = rows_;
 
     // REMEMBER: y is a number from 0 to rows_, 0 means all blocks are glowing, rows_ means none are
-    canvas_painter.drawPixmap(x * (kWidth + 1), y * (kHeight + 1) + y_, *bar(), 0, y * (kHeight + 1), bar()->width(), bar()->height());
+    canvas_painter.drawImage(x * (kWidth + 1), y * (kHeight + 1) + y_, *bar(), 0, y * (kHeight + 1), bar()->width(), bar()->height());
   }
 
   for (uint x = 0; x < store_.size(); ++x)
-    canvas_painter.drawPixmap(x * (kWidth + 1), static_cast<int>(store_[x]) * (kHeight + 1) + y_, topbarpixmap_);
+    canvas_painter.drawImage(x * (kWidth + 1), static_cast<int>(store_[x]) * (kHeight + 1) + y_, topbarpixmap_);
 
-  p.drawPixmap(0, 0, canvas_);
+  p.drawImage(0, 0, canvas_);
 
 }
 
@@ -32,7 +32,7 @@
 #include <QWidget>
 #include <QVector>
 #include <QString>
-#include <QPixmap>
+#include <QImage>
 #include <QPainter>
 #include <QPalette>
 #include <QtEvents>
@@ -67,19 +67,19 @@ class BlockAnalyzer : public Analyzer::Base {
   void determineStep();
 
  private:
-  QPixmap *bar() { return &barpixmap_; }
+  QImage *bar() { return &barpixmap_; }
 
   uint columns_, rows_;      // number of rows and columns of blocks
   uint y_;                   // y-offset from top of widget
-  QPixmap barpixmap_;
-  QPixmap topbarpixmap_;
-  QPixmap background_;
-  QPixmap canvas_;
+  QImage barpixmap_;
+  QImage topbarpixmap_;
+  QImage background_;
+  QImage canvas_;
   Analyzer::Scope scope_;    // so we don't create a vector every frame
   QVector<float> store_;     // current bar heights
   QVector<float> yscale_;
 
-  QVector<QPixmap> fade_bars_;
+  QVector<QImage> fade_bars_;
   QVector<uint> fade_pos_;
   QVector<int> fade_intensity_;
 
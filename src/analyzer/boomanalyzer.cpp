@@ -28,9 +28,11 @@
 
 #include <QObject>
 #include <QWidget>
-#include <QPixmap>
+#include <QImage>
 #include <QPainter>
 #include <QColor>
+#include <QPalette>
+#include <QtEvents>
 
 using Analyzer::Scope;
 
@@ -45,6 +47,8 @@ BoomAnalyzer::BoomAnalyzer(QWidget* parent)
       bands_(0),
       scope_(kMinBandCount),
       fg_(palette().color(QPalette::Highlight)),
+      bg_(palette().color(QPalette::Background)),
+      midlight_(palette().color(QPalette::Midlight)),
       K_barHeight_(1.271)  // 1.471
       ,
       F_peakSpeed_(1.103)  // 1.122
@@ -53,7 +57,7 @@ BoomAnalyzer::BoomAnalyzer(QWidget* parent)
       bar_height_(kMaxBandCount, 0),
       peak_height_(kMaxBandCount, 0),
       peak_speed_(kMaxBandCount, 0.01),
-      barPixmap_(kColumnWidth, 50) {
+      barPixmap_(kColumnWidth, 50, QImage::Format_ARGB32_Premultiplied) {
 
   setMinimumWidth(kMinBandCount * (kColumnWidth + 1) - 1);
   setMaximumWidth(kMaxBandCount * (kColumnWidth + 1) - 1);
@@ -80,9 +84,9 @@ void BoomAnalyzer::resizeEvent(QResizeEvent* e) {
 
   F_ = static_cast<double>(HEIGHT) / (log10(256) * 1.1 /*<- max. amplitude*/);
 
-  barPixmap_ = QPixmap(kColumnWidth - 2, HEIGHT);
-  canvas_ = QPixmap(size());
-  canvas_.fill(palette().color(QPalette::Background));
+  barPixmap_ = QImage(kColumnWidth - 2, HEIGHT, QImage::Format_ARGB32_Premultiplied);
+  canvas_ = QImage(size(), QImage::Format_ARGB32_Premultiplied);
+  canvas_.fill(bg_);
 
   QPainter p(&barPixmap_);
   for (uint y = 0; y < HEIGHT; ++y) {
@@ -96,6 +100,17 @@ void BoomAnalyzer::resizeEvent(QResizeEvent* e) {
 
 }
 
+void BoomAnalyzer::changeEvent(QEvent* e) {
+
+  QWidget::changeEvent(e);
+
+  if (e->type() == QEvent::PaletteChange) {
+    bg_ = palette().color(QPalette::Background);
+    midlight_ = palette().color(QPalette::Midlight);
+  }
+
+}
+
 void BoomAnalyzer::transform(Scope& s) {
 
   fht_->spectrum(s.data());
@@ -107,15 +122,16 @@ void BoomAnalyzer::transform(Scope& s) {
 
 void BoomAnalyzer::analyze(QPainter& p, const Scope& scope, bool new_frame) {
 
-  if (!new_frame || engine_->state() == Engine::Paused) {
-    p.drawPixmap(0, 0, canvas_);
+  if (!new_frame || state_ == Engine::Paused) {
+    p.drawImage(0, 0, canvas_);
     return;
   }
   float h;
-  const uint MAX_HEIGHT = height() - 1;
+  const uint HEIGHT = render_size().height();
+  const uint MAX_HEIGHT = HEIGHT - 1;
 
   QPainter canvas_painter(&canvas_);
-  canvas_.fill(palette().color(QPalette::Background));
+  canvas_.fill(bg_);
 
   Analyzer::interpolate(scope, scope_);
 
@@ -152,18 +168,18 @@ void BoomAnalyzer::analyze(QPainter& p, const Scope& scope, bool new_frame) {
       }
     }
 
-    y = height() - uint(bar_height_[i]);
-    canvas_painter.drawPixmap(x + 1, y, barPixmap_, 0, y, -1, -1);
+    y = HEIGHT - uint(bar_height_[i]);
+    canvas_painter.drawImage(x + 1, y, barPixmap_, 0, y, -1, -1);
     canvas_painter.setPen(fg_);
     if (bar_height_[i] > 0)
-      canvas_painter.drawRect(x, y, kColumnWidth - 1, height() - y - 1);
+      canvas_painter.drawRect(x, y, kColumnWidth - 1, HEIGHT - y - 1);
 
-    y = height() - uint(peak_height_[i]);
-    canvas_painter.setPen(palette().color(QPalette::Midlight));
+    y = HEIGHT - uint(peak_height_[i]);
+    canvas_painter.setPen(midlight_);
     canvas_painter.drawLine(x, y, x + kColumnWidth - 1, y);
   }
 
-  p.drawPixmap(0, 0, canvas_);
+  p.drawImage(0, 0, canvas_);
 
 }
 
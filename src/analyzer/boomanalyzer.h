@@ -29,10 +29,11 @@
 
 #include <QObject>
 #include <QWidget>
-#include <QPixmap>
+#include <QImage>
 #include <QPainter>
 #include <QColor>
 
+class QEvent;
 class QResizeEvent;
 
 class BoomAnalyzer : public Analyzer::Base {
@@ -52,6 +53,7 @@ class BoomAnalyzer : public Analyzer::Base {
 
  protected:
   void resizeEvent(QResizeEvent* e);
+  void changeEvent(QEvent* e);
 
   static const uint kColumnWidth;
   static const uint kMaxBandCount;
@@ -60,6 +62,9 @@ class BoomAnalyzer : public Analyzer::Base {
   uint bands_;
   Analyzer::Scope scope_;
   QColor fg_;
+  // Copied from the palette, it can't be used from the render thread
+  QColor bg_;
+  QColor midlight_;
 
   double K_barHeight_, F_peakSpeed_, F_;
 
@@ -67,8 +72,8 @@ class BoomAnalyzer : public Analyzer::Base {
   std::vector<float> peak_height_;
   std::vector<float> peak_speed_;
 
-  QPixmap barPixmap_;
-  QPixmap canvas_;
+  QImage barPixmap_;
+  QImage canvas_;
 
 };
 
@@ -24,15 +24,14 @@
 
 #include <algorithm>
 #include <cmath>
+#include <stdint.h>
 
 #include <QVector>
 
-FHT::FHT(int n) : num_((n < 3) ? 0 : 1 << n), exp2_((n < 3) ? -1 : n) {
-  if (n > 3) {
-    buf_vector_.resize(num_);
-    tab_vector_.resize(num_ * 2);
-    makeCasTable();
-  }
+#include "fhtkernels.h"
+
+FHT::FHT(int n, const FHTKernels *kernels) : num_((n < 3) ? 0 : 1 << n), exp2_((n < 3) ? -1 : n), kernels_(kernels ? kernels : FHTKernels::Best()) {
+  if (num_ > 0) makeCasTable();
 }
 
 FHT::~FHT() {}
@@ -40,26 +39,32 @@ FHT::~FHT() {}
 int FHT::sizeExp() const { return exp2_; }
 int FHT::size() const { return num_; }
 
-float* FHT::buf_() { return buf_vector_.data(); }
 float* FHT::tab_() { return tab_vector_.data(); }
 int* FHT::log_() { return log_vector_.data(); }
 
 void FHT::makeCasTable(void) {
-  float* costab = tab_();
-  float* sintab = tab_() + num_ / 2 + 1;
 
-  for (int ul = 0; ul < num_; ul++) {
-    float d = M_PI * ul / (num_ / 2);
-    *costab = *sintab = cos(d);
+  // The passes combining transforms of length m / 2 into transforms of length m need cos and sin of pi * j / (m / 2) for j < m / 4.
+  for (int m = 8; m <= num_; m *= 2) {
+    for (int j = 0; j < m / 4; j++) tab_vector_ << cos(M_PI * j / (m / 2));
+    for (int j = 0; j < m / 4; j++) tab_vector_ << sin(M_PI * j / (m / 2));
+  }
 
-    costab += 2;
-    sintab += 2;
-    if (sintab > tab_() + num_ * 2) sintab = tab_() + 1;
+  bitrev_vector_.resize(num_);
+  for (int i = 0; i < num_; i++) {
+    int r = 0;
+    for (int bit = 0; bit < exp2_; bit++) r |= ((i >> bit) & 1) << (exp2_ - 1 - bit);
+    bitrev_vector_[i] = r;
   }
+
 }
 
 void FHT::scale(float* p, float d) {
-  for (int i = 0; i < (num_ / 2); i++) *p++ *= d;
+  kernels_->scale(p, num_ / 2, d);
+}
+
+void FHT::mono(float* out, const int16_t* in) {
+  kernels_->mono(in, out, num_);
 }
 
 void FHT::ewma(float* d, float* s, float w) {
@@ -94,43 +99,27 @@ void FHT::logSpectrum(float* out, float* p) {
 }
 
 void FHT::semiLogSpectrum(float* p) {
-  power2(p);
-  for (int i = 0; i < (num_ / 2); i++, p++) {
-    float e = 10.0 * log10(sqrt(*p / 2));
-    *p = e < 0 ? 0 : e;
-  }
+  transform(p);
+  if (num_ > 0) kernels_->decibel(p, num_);
 }
 
 void FHT::spectrum(float* p) {
-  power2(p);
-  for (int i = 0; i < (num_ / 2); i++, p++)
-    *p = static_cast<float>(sqrt(*p / 2));
+  transform(p);
+  if (num_ > 0) kernels_->magnitude(p, num_);
 }
 
 void FHT::power(float* p) {
   power2(p);
-  for (int i = 0; i < (num_ / 2); i++) *p++ /= 2;
+  scale(p, 0.5);
 }
 
 void FHT::power2(float* p) {
-  _transform(p, num_, 0);
-
-  *p = static_cast<float>(2 * pow(*p, 2));
-  p++;
-
-  float* q = p + num_ - 2;
-  for (int i = 1; i < (num_ / 2); i++) {
-    *p = static_cast<float>(pow(*p, 2) + pow(*q, 2));
-    p++;
-    q--;
-  }
+  transform(p);
+  if (num_ > 0) kernels_->power2(p, num_);
 }
 
 void FHT::transform(float* p) {
-  if (num_ == 8)
-    transform8(p);
-  else
-    _transform(p, num_, 0);
+  if (num_ > 0) kernels_->transform(p, num_, bitrev_vector_.constData(), tab_vector_.constData());
 }
 
 void FHT::transform8(float* p) {
@@ -161,47 +150,3 @@ void FHT::transform8(float* p) {
   *--p = aceg + bdfh;
 
 }
-
-void FHT::_transform(float* p, int n, int k) {
-
-  if (n == 8) {
-    transform8(p + k);
-    return;
-  }
-
-  int i, j, ndiv2 = n / 2;
-  float a, *t1, *t2, *t3, *t4, *ptab, *pp;
-
-  for (i = 0, t1 = buf_(), t2 = buf_() + ndiv2, pp = &p[k]; i < ndiv2; i++)
-    *t1++ = *pp++, *t2++ = *pp++;
-
-  std::copy(buf_(), buf_() + n, p + k);
-
-  _transform(p, ndiv2, k);
-  _transform(p, ndiv2, k + ndiv2);
-
-  j = num_ / ndiv2 - 1;
-  t1 = buf_();
-  t2 = t1 + ndiv2;
-  t3 = p + k + ndiv2;
-  ptab = tab_();
-  pp = p + k;
-
-  a = *ptab++ * *t3++;
-  a += *ptab * *pp;
-  ptab += j;
-
-  *t1++ = *pp + a;
-  *t2++ = *pp++ - a;
-
-  for (i = 1, t4 = p + k + n; i < ndiv2; i++, ptab += j) {
-    a = *ptab++ * *t3++;
-    a += *ptab * *--t4;
-
-    *t1++ = *pp + a;
-    *t2++ = *pp++ - a;
-  }
-
-  std::copy(buf_(), buf_() + n, p + k);
-
-}
@@ -23,53 +23,64 @@
 #ifndef FHT_H
 #define FHT_H
 
+#include <stdint.h>
+
 #include <QVector>
 
+struct FHTKernels;
+
 /**
  * Implementation of the Hartley Transform after Bracewell's discrete
  * algorithm. The algorithm is subject to US patent No. 4,646,256 (1987)
  * but was put into public domain by the Board of Trustees of Stanford
  * University in 1994 and is now freely available[1].
  *
+ * The transform is done iteratively in place, and the inner loops run
+ * on the widest vector instructions the CPU has (see FHTKernels).
+ *
  * [1] Computer in Physics, Vol. 9, No. 4, Jul/Aug 1995 pp 373-379
  */
 class FHT {
   const int num_;
   const int exp2_;
+  const FHTKernels *kernels_;
 
-  QVector<float> buf_vector_;
   QVector<float> tab_vector_;
+  QVector<int> bitrev_vector_;
   QVector<int> log_vector_;
 
-  float* buf_();
   float* tab_();
   int* log_();
 
   /**
-   * Create a table of "cas" (cosine and sine) values.
+   * Create a table of "cas" (cosine and sine) values for every pass of
+   * the transform, and the bit reversed index of every value.
    * Has only to be done in the constructor and saves from
    * calculating the same values over and over while transforming.
    */
   void makeCasTable();
 
-  /**
-   * Recursive in-place Hartley transform. For internal use only!
-   */
-  void _transform(float*, int, int);
-
  public:
   /**
   * Prepare transform for data sets with @f$2^n@f$ numbers, whereby @f$n@f$
-  * should be at least 3. Values of more than 3 need a trigonometry table.
+  * should be at least 3.
+  * @param kernels are the FHTKernels to use, the best ones the CPU supports by default.
   * @see makeCasTable()
   */
-  FHT(int);
+  FHT(int, const FHTKernels *kernels = nullptr);
 
   ~FHT();
   int sizeExp() const;
   int size() const;
   void scale(float*, float);
 
+  /**
+   * Mixes interleaved 16-bit stereo down to @f$2^n@f$ mono values in [-1, 1].
+   * @param out is the mono data.
+   * @param in has twice as many samples.
+   */
+  void mono(float* out, const int16_t* in);
+
   /**
    * Exponentially Weighted Moving Average (EWMA) filter.
    * @param d is the filtered data.
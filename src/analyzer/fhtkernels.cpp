@@ -0,0 +1,61 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <vector>
+
+#include "fhtkernels.h"
+#include "fhtkernelsimpl.h"
+
+const FHTKernels *FHTScalarKernels() {
+
+  static const FHTKernels kernels = MakeKernels<ScalarOps>("C++");
+  return &kernels;
+
+}
+
+std::vector<const FHTKernels*> FHTKernels::Available() {
+
+  std::vector<const FHTKernels*> kernels;
+  kernels.push_back(FHTScalarKernels());
+
+#if defined(__GNUC__) && (defined(HAVE_SSE2) || defined(HAVE_AVX2))
+  __builtin_cpu_init();
+#endif
+#ifdef HAVE_SSE2
+  if (__builtin_cpu_supports("sse2")) kernels.push_back(FHTSse2Kernels());
+#endif
+#ifdef HAVE_AVX2
+  if (__builtin_cpu_supports("avx2")) kernels.push_back(FHTAvx2Kernels());
+#endif
+#ifdef HAVE_NEON
+  kernels.push_back(FHTNeonKernels());
+#endif
+
+  return kernels;
+
+}
+
+const FHTKernels *FHTKernels::Best() {
+
+  static const FHTKernels *kernels = Available().back();
+  return kernels;
+
+}
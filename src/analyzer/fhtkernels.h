@@ -0,0 +1,67 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FHTKERNELS_H
+#define FHTKERNELS_H
+
+#include "config.h"
+
+#include <stdint.h>
+#include <vector>
+
+// The inner loops of the FHT and the spectrum passes after it.
+// There is one set for every instruction set the build has code for, each compiled in its own file with the flags for that instruction set.
+// The best one the CPU supports is picked at runtime, with plain C++ as the fallback.
+struct FHTKernels {
+  const char *name;
+
+  // Mixes interleaved 16-bit stereo down to frames mono samples in [-1, 1].
+  void (*mono)(const int16_t *interleaved, float *out, int frames);
+
+  // In-place Hartley transform of n values, n is a power of two of at least 8.
+  // bitrev holds the bit reversed index of every value, twiddles the cosines and sines for each pass (see FHT::makeCasTable()).
+  void (*transform)(float *p, int n, const int *bitrev, const float *twiddles);
+
+  // Turn the n Hartley coefficients in p into n/2 values of the spectrum, the second half of p is left alone.
+  // power2 is the doubled power, magnitude the amplitude and decibel 10 * log10 of the amplitude, cut off at 0.
+  void (*power2)(float *p, int n);
+  void (*magnitude)(float *p, int n);
+  void (*decibel)(float *p, int n);
+
+  void (*scale)(float *p, int count, float factor);
+
+  // The kernels the CPU picks, these don't change while running.
+  static const FHTKernels *Best();
+
+  // All kernels this CPU can run, plain C++ first.
+  static std::vector<const FHTKernels*> Available();
+};
+
+const FHTKernels *FHTScalarKernels();
+#ifdef HAVE_SSE2
+const FHTKernels *FHTSse2Kernels();
+#endif
+#ifdef HAVE_AVX2
+const FHTKernels *FHTAvx2Kernels();
+#endif
+#ifdef HAVE_NEON
+const FHTKernels *FHTNeonKernels();
+#endif
+
+#endif  // FHTKERNELS_H
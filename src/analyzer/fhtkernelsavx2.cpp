@@ -0,0 +1,71 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "fhtkernels.h"
+#include "fhtkernelsimpl.h"
+
+namespace {
+
+struct Avx2Ops {
+  typedef __m256 V;
+  static const int kWidth = 8;
+
+  static V Load(const float *p) { return _mm256_loadu_ps(p); }
+  static void Store(float *p, V v) { _mm256_storeu_ps(p, v); }
+  static V Set(float x) { return _mm256_set1_ps(x); }
+  static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+  static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+  static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+  static V Div(V a, V b) { return _mm256_div_ps(a, b); }
+  static V Max(V a, V b) { return _mm256_max_ps(a, b); }
+  static V Sqrt(V a) { return _mm256_sqrt_ps(a); }
+  static V Reverse(V v) { return _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)); }
+
+  static V Log10(V x) {
+
+    const __m256i bits = _mm256_castps_si256(x);
+    const __m256i exponent = _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xff)), _mm256_set1_epi32(127));
+    V m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+    V e = _mm256_cvtepi32_ps(exponent);
+    const V big = _mm256_cmp_ps(m, _mm256_set1_ps(kSqrt2), _CMP_GT_OQ);
+    m = _mm256_sub_ps(m, _mm256_and_ps(big, _mm256_mul_ps(m, _mm256_set1_ps(0.5f))));
+    e = _mm256_add_ps(e, _mm256_and_ps(big, _mm256_set1_ps(1.0f)));
+    return Log10Reduced<Avx2Ops>(m, e);
+
+  }
+
+  // vpmaddwd adds each left and right sample pair to 32 bits, it doesn't cross the 128-bit lanes so the frames stay in order.
+  static V Mono(const int16_t *p) {
+    return _mm256_cvtepi32_ps(_mm256_madd_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), _mm256_set1_epi16(1)));
+  }
+};
+
+}  // namespace
+
+const FHTKernels *FHTAvx2Kernels() {
+
+  static const FHTKernels kernels = MakeKernels<Avx2Ops>("AVX2");
+  return &kernels;
+
+}
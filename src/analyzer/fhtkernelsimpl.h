@@ -0,0 +1,278 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FHTKERNELSIMPL_H
+#define FHTKERNELSIMPL_H
+
+// The FHT kernels written once for any vector type, only include this from the fhtkernels*.cpp files.
+// Each of those files wraps its instruction set in an Ops class:
+//   V                       the vector type, kWidth floats wide
+//   Load, Store             unaligned
+//   Set                     all lanes to one value
+//   Add, Sub, Mul, Div, Max, Sqrt
+//   Reverse                 the lanes in reverse order
+//   Log10
+//   Mono                    kWidth frames of interleaved 16-bit stereo, mixed as the sum of both channels
+// Everything here is in an anonymous namespace, so code built with different instruction sets is never mixed up by the linker.
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "fhtkernels.h"
+
+namespace {
+
+const float kSqrt2 = 1.41421356f;
+const float kLn2 = 0.69314718f;
+const float kLog10E = 0.43429448f;
+
+// log10(m * 2^e) for m in [sqrt(0.5), sqrt(2)].
+// ln(m) = 2 atanh(z) with z = (m - 1) / (m + 1), |z| < 0.172 so four terms of the series are plenty.
+template <typename Ops>
+typename Ops::V Log10Reduced(typename Ops::V m, typename Ops::V e) {
+
+  typedef typename Ops::V V;
+
+  const V one = Ops::Set(1.0f);
+  const V z = Ops::Div(Ops::Sub(m, one), Ops::Add(m, one));
+  const V z2 = Ops::Mul(z, z);
+  V series = Ops::Add(Ops::Set(1.0f / 5.0f), Ops::Mul(z2, Ops::Set(1.0f / 7.0f)));
+  series = Ops::Add(Ops::Set(1.0f / 3.0f), Ops::Mul(z2, series));
+  series = Ops::Add(one, Ops::Mul(z2, series));
+  const V ln = Ops::Add(Ops::Mul(e, Ops::Set(kLn2)), Ops::Mul(Ops::Mul(Ops::Set(2.0f), z), series));
+
+  return Ops::Mul(ln, Ops::Set(kLog10E));
+
+}
+
+// Used for the values left over after the last full vector, and as the plain C++ kernels.
+struct ScalarOps {
+  typedef float V;
+  static const int kWidth = 1;
+
+  static V Load(const float *p) { return *p; }
+  static void Store(float *p, V v) { *p = v; }
+  static V Set(float x) { return x; }
+  static V Add(V a, V b) { return a + b; }
+  static V Sub(V a, V b) { return a - b; }
+  static V Mul(V a, V b) { return a * b; }
+  static V Div(V a, V b) { return a / b; }
+  static V Max(V a, V b) { return a > b ? a : b; }
+  static V Sqrt(V a) { return sqrtf(a); }
+  static V Reverse(V v) { return v; }
+
+  static V Log10(V x) {
+
+    int32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    float e = static_cast<float>(((bits >> 23) & 0xff) - 127);
+    bits = (bits & 0x007fffff) | 0x3f800000;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    if (m > kSqrt2) {
+      m *= 0.5f;
+      e += 1.0f;
+    }
+    return Log10Reduced<ScalarOps>(m, e);
+
+  }
+
+  static V Mono(const int16_t *p) { return static_cast<float>(p[0] + p[1]); }
+};
+
+template <typename Ops>
+void Mono(const int16_t *interleaved, float *out, int frames) {
+
+  const float factor = 1.0f / (2 * (1 << 15));
+
+  int i = 0;
+  for (; i + Ops::kWidth <= frames; i += Ops::kWidth) {
+    Ops::Store(out + i, Ops::Mul(Ops::Mono(interleaved + 2 * i), Ops::Set(factor)));
+  }
+  for (; i < frames; ++i) {
+    out[i] = ScalarOps::Mono(interleaved + 2 * i) * factor;
+  }
+
+}
+
+// One butterfly of a pass, e and o are the values from the first and the second half.
+inline void Butterfly(float *e, float *o, float t) {
+
+  const float a = *e;
+  *e = a + t;
+  *o = a - t;
+
+}
+
+// Iterative decimation in time: reorder the values by bit reversed index, then combine transforms of length m / 2 into transforms of length m.
+// The first two passes need no twiddles, so they are done at once as a 4 point transform of every group of four.
+// In the later passes value j is combined with its mirror mh - j, so the vector code reverses the lanes of the mirrored half.
+template <typename Ops>
+void Transform(float *p, int n, const int *bitrev, const float *twiddles) {
+
+  typedef typename Ops::V V;
+  const int w = Ops::kWidth;
+
+  for (int i = 0; i < n; ++i) {
+    const int j = bitrev[i];
+    if (i < j) {
+      const float t = p[i];
+      p[i] = p[j];
+      p[j] = t;
+    }
+  }
+
+  for (int r = 0; r < n; r += 4) {
+    const float ab = p[r] + p[r + 1];
+    const float a_b = p[r] - p[r + 1];
+    const float cd = p[r + 2] + p[r + 3];
+    const float c_d = p[r + 2] - p[r + 3];
+    p[r] = ab + cd;
+    p[r + 1] = a_b + c_d;
+    p[r + 2] = ab - cd;
+    p[r + 3] = a_b - c_d;
+  }
+
+  for (int m = 8; m <= n; m *= 2) {
+    const int mh = m / 2;
+    const int m4 = m / 4;
+    const float *cosines = twiddles;
+    const float *sines = twiddles + m4;
+
+    for (int r = 0; r < n; r += m) {
+      float *e = p + r;
+      float *o = p + r + mh;
+
+      Butterfly(e, o, o[0]);
+      Butterfly(e + m4, o + m4, o[m4]);
+
+      int j = 1;
+      for (; j + w <= m4; j += w) {
+        // k is the lowest index of the mirrored block, it runs backwards from mh - j.
+        const int k = mh - j - w + 1;
+        const V oj = Ops::Load(o + j);
+        const V ok = Ops::Reverse(Ops::Load(o + k));
+        const V c = Ops::Load(cosines + j);
+        const V s = Ops::Load(sines + j);
+        const V tj = Ops::Add(Ops::Mul(oj, c), Ops::Mul(ok, s));
+        const V tk = Ops::Sub(Ops::Mul(oj, s), Ops::Mul(ok, c));
+        const V ej = Ops::Load(e + j);
+        const V ek = Ops::Reverse(Ops::Load(e + k));
+        Ops::Store(e + j, Ops::Add(ej, tj));
+        Ops::Store(o + j, Ops::Sub(ej, tj));
+        Ops::Store(e + k, Ops::Reverse(Ops::Add(ek, tk)));
+        Ops::Store(o + k, Ops::Reverse(Ops::Sub(ek, tk)));
+      }
+      for (; j < m4; ++j) {
+        const int k = mh - j;
+        const float oj = o[j];
+        const float ok = o[k];
+        Butterfly(e + j, o + j, oj * cosines[j] + ok * sines[j]);
+        Butterfly(e + k, o + k, oj * sines[j] - ok * cosines[j]);
+      }
+    }
+
+    twiddles += 2 * m4;
+  }
+
+}
+
+// Value i of the spectrum comes from coefficients i and n - i, the vector code reverses the lanes of the second.
+// Output is the halved power, so Output can be the square root or the logarithm of it directly.
+template <typename Ops, typename Output>
+void Spectrum(float *p, int n, Output output) {
+
+  typedef typename Ops::V V;
+  const int w = Ops::kWidth;
+  const int half = n / 2;
+
+  p[0] = output.Scalar(p[0] * p[0]);
+
+  int i = 1;
+  for (; i + w <= half; i += w) {
+    const V a = Ops::Load(p + i);
+    const V b = Ops::Reverse(Ops::Load(p + n - i - w + 1));
+    Ops::Store(p + i, output.Vector(Ops::Mul(Ops::Add(Ops::Mul(a, a), Ops::Mul(b, b)), Ops::Set(0.5f))));
+  }
+  for (; i < half; ++i) {
+    p[i] = output.Scalar((p[i] * p[i] + p[n - i] * p[n - i]) * 0.5f);
+  }
+
+}
+
+template <typename Ops>
+struct Power2Output {
+  typename Ops::V Vector(typename Ops::V x) const { return Ops::Mul(x, Ops::Set(2.0f)); }
+  float Scalar(float x) const { return x * 2.0f; }
+};
+
+template <typename Ops>
+struct MagnitudeOutput {
+  typename Ops::V Vector(typename Ops::V x) const { return Ops::Sqrt(x); }
+  float Scalar(float x) const { return ScalarOps::Sqrt(x); }
+};
+
+// 10 * log10(sqrt(x)) is 5 * log10(x)
+template <typename Ops>
+struct DecibelOutput {
+  typename Ops::V Vector(typename Ops::V x) const { return Ops::Max(Ops::Mul(Ops::Log10(x), Ops::Set(5.0f)), Ops::Set(0.0f)); }
+  float Scalar(float x) const { return ScalarOps::Max(ScalarOps::Log10(x) * 5.0f, 0.0f); }
+};
+
+template <typename Ops>
+void Power2(float *p, int n) { Spectrum<Ops>(p, n, Power2Output<Ops>()); }
+
+template <typename Ops>
+void Magnitude(float *p, int n) { Spectrum<Ops>(p, n, MagnitudeOutput<Ops>()); }
+
+template <typename Ops>
+void Decibel(float *p, int n) { Spectrum<Ops>(p, n, DecibelOutput<Ops>()); }
+
+template <typename Ops>
+void Scale(float *p, int count, float factor) {
+
+  int i = 0;
+  for (; i + Ops::kWidth <= count; i += Ops::kWidth) {
+    Ops::Store(p + i, Ops::Mul(Ops::Load(p + i), Ops::Set(factor)));
+  }
+  for (; i < count; ++i) {
+    p[i] *= factor;
+  }
+
+}
+
+template <typename Ops>
+FHTKernels MakeKernels(const char *name) {
+
+  FHTKernels kernels;
+  kernels.name = name;
+  kernels.mono = &Mono<Ops>;
+  kernels.transform = &Transform<Ops>;
+  kernels.power2 = &Power2<Ops>;
+  kernels.magnitude = &Magnitude<Ops>;
+  kernels.decibel = &Decibel<Ops>;
+  kernels.scale = &Scale<Ops>;
+  return kernels;
+
+}
+
+}  // namespace
+
+#endif  // FHTKERNELSIMPL_H
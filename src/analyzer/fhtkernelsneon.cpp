@@ -0,0 +1,75 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <arm_neon.h>
+
+#include "fhtkernels.h"
+#include "fhtkernelsimpl.h"
+
+namespace {
+
+// NEON is always there on 64-bit ARM, which also has the vector division and square root.
+struct NeonOps {
+  typedef float32x4_t V;
+  static const int kWidth = 4;
+
+  static V Load(const float *p) { return vld1q_f32(p); }
+  static void Store(float *p, V v) { vst1q_f32(p, v); }
+  static V Set(float x) { return vdupq_n_f32(x); }
+  static V Add(V a, V b) { return vaddq_f32(a, b); }
+  static V Sub(V a, V b) { return vsubq_f32(a, b); }
+  static V Mul(V a, V b) { return vmulq_f32(a, b); }
+  static V Div(V a, V b) { return vdivq_f32(a, b); }
+  static V Max(V a, V b) { return vmaxq_f32(a, b); }
+  static V Sqrt(V a) { return vsqrtq_f32(a); }
+  static V Reverse(V v) {
+    const V r = vrev64q_f32(v);
+    return vcombine_f32(vget_high_f32(r), vget_low_f32(r));
+  }
+
+  static V Log10(V x) {
+
+    const int32x4_t bits = vreinterpretq_s32_f32(x);
+    const int32x4_t exponent = vsubq_s32(vandq_s32(vshrq_n_s32(bits, 23), vdupq_n_s32(0xff)), vdupq_n_s32(127));
+    V m = vreinterpretq_f32_s32(vorrq_s32(vandq_s32(bits, vdupq_n_s32(0x007fffff)), vdupq_n_s32(0x3f800000)));
+    V e = vcvtq_f32_s32(exponent);
+    const uint32x4_t big = vcgtq_f32(m, vdupq_n_f32(kSqrt2));
+    m = vbslq_f32(big, vmulq_f32(m, vdupq_n_f32(0.5f)), m);
+    e = vbslq_f32(big, vaddq_f32(e, vdupq_n_f32(1.0f)), e);
+    return Log10Reduced<NeonOps>(m, e);
+
+  }
+
+  static V Mono(const int16_t *p) {
+    const int16x4x2_t frames = vld2_s16(p);
+    return vcvtq_f32_s32(vaddl_s16(frames.val[0], frames.val[1]));
+  }
+};
+
+}  // namespace
+
+const FHTKernels *FHTNeonKernels() {
+
+  static const FHTKernels kernels = MakeKernels<NeonOps>("NEON");
+  return &kernels;
+
+}
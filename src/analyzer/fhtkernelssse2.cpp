@@ -0,0 +1,71 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <emmintrin.h>
+
+#include "fhtkernels.h"
+#include "fhtkernelsimpl.h"
+
+namespace {
+
+struct Sse2Ops {
+  typedef __m128 V;
+  static const int kWidth = 4;
+
+  static V Load(const float *p) { return _mm_loadu_ps(p); }
+  static void Store(float *p, V v) { _mm_storeu_ps(p, v); }
+  static V Set(float x) { return _mm_set1_ps(x); }
+  static V Add(V a, V b) { return _mm_add_ps(a, b); }
+  static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+  static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+  static V Div(V a, V b) { return _mm_div_ps(a, b); }
+  static V Max(V a, V b) { return _mm_max_ps(a, b); }
+  static V Sqrt(V a) { return _mm_sqrt_ps(a); }
+  static V Reverse(V v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3)); }
+
+  static V Log10(V x) {
+
+    const __m128i bits = _mm_castps_si128(x);
+    const __m128i exponent = _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xff)), _mm_set1_epi32(127));
+    V m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+    V e = _mm_cvtepi32_ps(exponent);
+    const V big = _mm_cmpgt_ps(m, _mm_set1_ps(kSqrt2));
+    m = _mm_sub_ps(m, _mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f))));
+    e = _mm_add_ps(e, _mm_and_ps(big, _mm_set1_ps(1.0f)));
+    return Log10Reduced<Sse2Ops>(m, e);
+
+  }
+
+  // pmaddwd adds each left and right sample pair to 32 bits.
+  static V Mono(const int16_t *p) {
+    return _mm_cvtepi32_ps(_mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_set1_epi16(1)));
+  }
+};
+
+}  // namespace
+
+const FHTKernels *FHTSse2Kernels() {
+
+  static const FHTKernels kernels = MakeKernels<Sse2Ops>("SSE2");
+  return &kernels;
+
+}
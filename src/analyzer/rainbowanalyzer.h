@@ -30,7 +30,9 @@
 
 #include <QObject>
 #include <QWidget>
+#include <QAtomicInt>
 #include <QDateTime>
+#include <QImage>
 #include <QPainter>
 #include <QPen>
 
@@ -70,7 +72,7 @@ class RainbowAnalyzer : public Analyzer::Base {
   static RainbowType rainbowtype;
 
   inline QRect SourceRect(RainbowType rainbowtype) const {
-    return QRect(0, kHeight[rainbowtype] * frame_, kWidth[rainbowtype], kHeight[rainbowtype]);
+    return QRect(0, kHeight[rainbowtype] * frame_.load(), kWidth[rainbowtype], kHeight[rainbowtype]);
   }
 
   inline QRect SleepingSourceRect(RainbowType rainbowtype) const {
@@ -78,11 +80,11 @@ class RainbowAnalyzer : public Analyzer::Base {
   }
 
   inline QRect DestRect(RainbowType rainbowtype) const {
-    return QRect(width() - kWidth[rainbowtype], (height() - kHeight[rainbowtype]) / 2, kWidth[rainbowtype], kHeight[rainbowtype]);
+    return QRect(render_size().width() - kWidth[rainbowtype], (render_size().height() - kHeight[rainbowtype]) / 2, kWidth[rainbowtype], kHeight[rainbowtype]);
   }
 
   inline QRect SleepingDestRect(RainbowType rainbowtype) const {
-    return QRect(width() - kWidth[rainbowtype], (height() - kSleepingHeight[rainbowtype]) / 2, kWidth[rainbowtype], kSleepingHeight[rainbowtype]);
+    return QRect(render_size().width() - kWidth[rainbowtype], (render_size().height() - kSleepingHeight[rainbowtype]) / 2, kWidth[rainbowtype], kSleepingHeight[rainbowtype]);
   }
 
  private:
@@ -91,18 +93,19 @@ class RainbowAnalyzer : public Analyzer::Base {
   QPen colors_[kRainbowBands];
 
   // Rainbow Nyancat & Dash
-  QPixmap cat_dash_[2];
+  QImage cat_dash_[2];
 
   // For the cat or dash animation
   int timer_id_;
-  int frame_;
+  // Advanced on the GUI thread, read by the render thread
+  QAtomicInt frame_;
 
   // The y positions of each point on the rainbow.
   float history_[kHistorySize * kRainbowBands];
 
   // A cache of the last frame's rainbow, 
   // so it can be used in the next frame.
-  QPixmap buffer_[2];
+  QImage buffer_[2];
   int current_buffer_;
 
   // Geometry information that's updated on resize:
@@ -43,6 +43,7 @@ const char *SCollection::kSongsTable = "songs";
 const char *SCollection::kDirsTable = "directories";
 const char *SCollection::kSubdirsTable = "subdirectories";
 const char *SCollection::kFtsTable = "songs_fts";
+const char *SCollection::kJournalTable = "subdirectories_journal";
 
 SCollection::SCollection(Application *app, QObject *parent)
     : QObject(parent),
@@ -55,7 +56,7 @@ SCollection::SCollection(Application *app, QObject *parent)
   backend_ = new CollectionBackend();
   backend()->moveToThread(app->database()->thread());
 
-  backend_->Init(app->database(), kSongsTable, kDirsTable, kSubdirsTable, kFtsTable);
+  backend_->Init(app->database(), kSongsTable, kDirsTable, kSubdirsTable, kFtsTable, kJournalTable);
 
   model_ = new CollectionModel(backend_, app_, this);
 
@@ -90,6 +91,8 @@ void SCollection::Init() {
   connect(watcher_, SIGNAL(SongsReadded(SongList, bool)), backend_, SLOT(MarkSongsUnavailable(SongList, bool)));
   connect(watcher_, SIGNAL(SubdirsDiscovered(SubdirectoryList)), backend_, SLOT(AddOrUpdateSubdirs(SubdirectoryList)));
   connect(watcher_, SIGNAL(SubdirsMTimeUpdated(SubdirectoryList)), backend_, SLOT(AddOrUpdateSubdirs(SubdirectoryList)));
+  connect(watcher_, SIGNAL(SubdirsChanged(SubdirectoryList)), backend_, SLOT(AddSubdirsToJournal(SubdirectoryList)));
+  connect(watcher_, SIGNAL(SubdirsRescanned(SubdirectoryList)), backend_, SLOT(RemoveSubdirsFromJournal(SubdirectoryList)));
   connect(watcher_, SIGNAL(CompilationsNeedUpdating()), backend_, SLOT(UpdateCompilations()));
   connect(backend_, SIGNAL(SongsStatisticsChanged(SongList)), SLOT(SongsStatisticsChanged(SongList)));
   connect(app_->playlist_manager(), SIGNAL(CurrentSongChanged(Song)), SLOT(CurrentSongChanged(Song)));
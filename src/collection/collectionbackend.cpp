@@ -25,9 +25,11 @@
 #include <QMutex>
 #include <QSet>
 #include <QMap>
+#include <QHash>
 #include <QByteArray>
 #include <QFileInfo>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QVariant>
 #include <QString>
 #include <QStringList>
@@ -40,6 +42,7 @@
 #include "core/database.h"
 #include "core/logging.h"
 #include "core/scopedtransaction.h"
+#include "core/sqlstatement.h"
 #include "core/utilities.h"
 
 #include "directory.h"
@@ -48,17 +51,19 @@
 #include "sqlrow.h"
 
 const char *CollectionBackend::kSettingsGroup = "Collection";
+const int CollectionBackend::kMaxBindValues = 999;
 
 CollectionBackend::CollectionBackend(QObject *parent) :
     CollectionBackendInterface(parent),
     db_(nullptr) {}
 
-void CollectionBackend::Init(Database *db, const QString &songs_table, const QString &dirs_table, const QString &subdirs_table, const QString &fts_table) {
+void CollectionBackend::Init(Database *db, const QString &songs_table, const QString &dirs_table, const QString &subdirs_table, const QString &fts_table, const QString &journal_table) {
   db_ = db;
   songs_table_ = songs_table;
   dirs_table_ = dirs_table;
   subdirs_table_ = subdirs_table;
   fts_table_ = fts_table;
+  journal_table_ = journal_table;
 }
 
 void CollectionBackend::LoadDirectoriesAsync() {
@@ -93,8 +98,7 @@ void CollectionBackend::LoadDirectories() {
 
   DirectoryList dirs = GetAllDirectories();
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   for (const Directory &dir : dirs) {
     emit DirectoryDiscovered(dir, SubdirsInDirectory(dir.id, db));
@@ -149,8 +153,7 @@ void CollectionBackend::ChangeDirPath(int id, const QString &old_path, const QSt
 
 DirectoryList CollectionBackend::GetAllDirectories() {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   DirectoryList ret;
 
@@ -172,8 +175,7 @@ DirectoryList CollectionBackend::GetAllDirectories() {
 
 SubdirectoryList CollectionBackend::SubdirsInDirectory(int id) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db = db_->Connect();
+  QSqlDatabase db(db_->ConnectReadOnly());
   return SubdirsInDirectory(id, db);
 
 }
@@ -199,10 +201,34 @@ SubdirectoryList CollectionBackend::SubdirsInDirectory(int id, QSqlDatabase &db)
 
 }
 
+SubdirectoryList CollectionBackend::JournaledSubdirsInDirectory(int id) {
+
+  if (journal_table_.isEmpty()) return SubdirectoryList();
+
+  QSqlDatabase db(db_->ConnectReadOnly());
+
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT path FROM %1 WHERE directory_id = :dir").arg(journal_table_));
+  q.bindValue(":dir", id);
+  q.exec();
+  if (db_->CheckErrors(q)) return SubdirectoryList();
+
+  SubdirectoryList subdirs;
+  while (q.next()) {
+    Subdirectory subdir;
+    subdir.directory_id = id;
+    subdir.path = q.value(0).toString();
+    subdir.mtime = 0;
+    subdirs << subdir;
+  }
+
+  return subdirs;
+
+}
+
 void CollectionBackend::UpdateTotalSongCount() {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QSqlQuery q(db);
   q.prepare(QString("SELECT COUNT(*) FROM %1 WHERE unavailable = 0").arg(songs_table_));
@@ -216,8 +242,7 @@ void CollectionBackend::UpdateTotalSongCount() {
 
 void CollectionBackend::UpdateTotalArtistCount() {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QSqlQuery q(db);
   q.prepare(QString("select COUNT(distinct artist) from %1 WHERE unavailable = 0").arg(songs_table_));
@@ -231,8 +256,7 @@ void CollectionBackend::UpdateTotalArtistCount() {
 
 void CollectionBackend::UpdateTotalAlbumCount() {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QSqlQuery q(db);
   q.prepare(QString("select COUNT(distinct album) from %1 WHERE unavailable = 0").arg(songs_table_));
@@ -289,6 +313,15 @@ void CollectionBackend::RemoveDirectory(const Directory &dir) {
   q.exec();
   if (db_->CheckErrors(q)) return;
 
+  // And any pending change events for them
+  if (!journal_table_.isEmpty()) {
+    q = QSqlQuery(db);
+    q.prepare(QString("DELETE FROM %1 WHERE directory_id = :id").arg(journal_table_));
+    q.bindValue(":id", dir.id);
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+  }
+
   // Now remove the directory itself
   q = QSqlQuery(db);
   q.prepare(QString("DELETE FROM %1 WHERE ROWID = :id").arg(dirs_table_));
@@ -304,14 +337,10 @@ void CollectionBackend::RemoveDirectory(const Directory &dir) {
 
 SongList CollectionBackend::FindSongsInDirectory(int id) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
-  QSqlQuery q(db);
-  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE directory_id = :directory_id").arg(songs_table_));
+  SqlStatement q(db_, db, QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE directory_id = :directory_id").arg(songs_table_));
   q.bindValue(":directory_id", id);
-  q.exec();
-  if (db_->CheckErrors(q)) return SongList();
 
   SongList ret;
   while (q.next()) {
@@ -319,6 +348,7 @@ SongList CollectionBackend::FindSongsInDirectory(int id) {
     song.InitFromQuery(q, true);
     ret << song;
   }
+  if (q.CheckErrors()) return SongList();
   return ret;
 
 }
@@ -383,82 +413,202 @@ void CollectionBackend::AddOrUpdateSubdirs(const SubdirectoryList &subdirs) {
 
 }
 
-void CollectionBackend::AddOrUpdateSongs(const SongList &songs) {
+void CollectionBackend::AddSubdirsToJournal(const SubdirectoryList &subdirs) {
+
+  if (journal_table_.isEmpty() || subdirs.isEmpty()) return;
 
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
+  QSqlQuery q(db);
+  q.prepare(QString("INSERT OR IGNORE INTO %1 (directory_id, path) VALUES (:id, :path)").arg(journal_table_));
+
+  ScopedTransaction transaction(&db);
+  for (const Subdirectory &subdir : subdirs) {
+    q.bindValue(":id", subdir.directory_id);
+    q.bindValue(":path", subdir.path);
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+  }
+  transaction.Commit();
+
+}
+
+void CollectionBackend::RemoveSubdirsFromJournal(const SubdirectoryList &subdirs) {
 
-  QSqlQuery check_dir(db);
-  check_dir.prepare(QString("SELECT ROWID FROM %1 WHERE ROWID = :id").arg(dirs_table_));
-  QSqlQuery add_song(db);
-  add_song.prepare(QString("INSERT INTO %1 (" + Song::kColumnSpec + ") VALUES (" + Song::kBindSpec + ")").arg(songs_table_));
-  QSqlQuery update_song(db);
-  update_song.prepare(QString("UPDATE %1 SET " + Song::kUpdateSpec + " WHERE ROWID = :id").arg(songs_table_));
-  QSqlQuery add_song_fts(db);
-  add_song_fts.prepare(QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec + ") VALUES (:id, " + Song::kFtsBindSpec + ")").arg(fts_table_));
-  QSqlQuery update_song_fts(db);
-  update_song_fts.prepare(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec + " WHERE ROWID = :id").arg(fts_table_));
+  if (journal_table_.isEmpty() || subdirs.isEmpty()) return;
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+  QSqlQuery q(db);
+  q.prepare(QString("DELETE FROM %1 WHERE directory_id = :id AND path = :path").arg(journal_table_));
 
   ScopedTransaction transaction(&db);
+  for (const Subdirectory &subdir : subdirs) {
+    q.bindValue(":id", subdir.directory_id);
+    q.bindValue(":path", subdir.path);
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+  }
+  transaction.Commit();
 
-  SongList added_songs;
-  SongList deleted_songs;
+}
 
-  for (const Song &song : songs) {
-    // Do a sanity check first - make sure the song's directory still exists
-    // This is to fix a possible race condition when a directory is removed while CollectionWatcher is scanning it.
-    if (!dirs_table_.isEmpty()) {
-      check_dir.bindValue(":id", song.directory_id());
-      check_dir.exec();
-      if (db_->CheckErrors(check_dir)) continue;
-
-      if (!check_dir.next()) continue;  // Directory didn't exist
-    }
+void CollectionBackend::AddOrUpdateSongs(const SongList &songs) {
 
-    if (song.id() == -1) {
-      // Create
+  if (songs.isEmpty()) return;
 
-      // Insert the row and create a new ID
-      song.BindToQuery(&add_song);
-      add_song.exec();
-      if (db_->CheckErrors(add_song)) continue;
+  QElapsedTimer timer;
+  timer.start();
 
-      // Get the new ID
-      const int id = add_song.lastInsertId().toInt();
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
 
-      // Add to the FTS index
-      add_song_fts.bindValue(":id", id);
-      song.BindToFtsQuery(&add_song_fts);
-      add_song_fts.exec();
-      if (db_->CheckErrors(add_song_fts)) continue;
+  ScopedTransaction transaction(&db);
 
-      Song copy(song);
-      copy.set_id(id);
-      added_songs << copy;
+  // Do a sanity check first - make sure the songs' directories still exist
+  // This is to fix a possible race condition when a directory is removed while CollectionWatcher is scanning it.
+  QSet<int> existing_dirs;
+  if (!dirs_table_.isEmpty()) {
+    QSet<int> dir_ids;
+    for (const Song &song : songs) {
+      dir_ids << song.directory_id();
+    }
+    QStringList str_dir_ids;
+    for (int id : dir_ids) {
+      str_dir_ids << QString::number(id);
+    }
+
+    QSqlQuery check_dirs(db);
+    check_dirs.prepare(QString("SELECT ROWID FROM %1 WHERE ROWID IN (%2)").arg(dirs_table_, str_dir_ids.join(",")));
+    check_dirs.exec();
+    if (db_->CheckErrors(check_dirs)) return;
+    while (check_dirs.next()) {
+      existing_dirs << check_dirs.value(0).toInt();
+    }
+  }
+
+  SongList new_songs;
+  SongList changed_songs;
+  QStringList changed_ids;
+  for (const Song &song : songs) {
+    if (!dirs_table_.isEmpty() && !existing_dirs.contains(song.directory_id())) continue;  // Directory didn't exist
+
+    if (song.id() == -1) {
+      new_songs << song;
     }
     else {
-      // Get the previous song data first
-      Song old_song(GetSongById(song.id()));
-      if (!old_song.is_valid()) continue;
+      changed_songs << song;
+      changed_ids << QString::number(song.id());
+    }
+  }
+
+  SongList added_songs;
+  SongList deleted_songs;
+
+  // The FTS index is filled from the songs table once all songs are written.
+  QStringList fts_source_columns;
+  for (const QString &column : Song::kFtsColumns) {
+    fts_source_columns << column.mid(3);  // Strip the "fts" prefix
+  }
+  const QString fts_insert = QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec + ") SELECT ROWID, %2 FROM %3 WHERE ").arg(fts_table_, fts_source_columns.join(", "), songs_table_);
+
+  if (!changed_songs.isEmpty()) {
+    // Get the previous song data first, in one query, from the writer connection so we see this transaction's changes
+    QHash<int, Song> old_songs;
+    for (const Song &old_song : GetSongsById(changed_ids, db)) {
+      old_songs.insert(old_song.id(), old_song);
+    }
+
+    QSqlQuery update_song(db);
+    update_song.prepare(QString("UPDATE %1 SET " + Song::kUpdateSpec + " WHERE ROWID = :id").arg(songs_table_));
+
+    QStringList updated_ids;
+    for (const Song &song : changed_songs) {
+      QHash<int, Song>::const_iterator it = old_songs.constFind(song.id());
+      if (it == old_songs.constEnd()) continue;
 
-      // Update
       song.BindToQuery(&update_song);
       update_song.bindValue(":id", song.id());
       update_song.exec();
       if (db_->CheckErrors(update_song)) continue;
 
-      song.BindToFtsQuery(&update_song_fts);
-      update_song_fts.bindValue(":id", song.id());
-      update_song_fts.exec();
-      if (db_->CheckErrors(update_song_fts)) continue;
-
-      deleted_songs << old_song;
+      updated_ids << QString::number(song.id());
+      deleted_songs << *it;
       added_songs << song;
     }
+
+    if (!updated_ids.isEmpty()) {
+      QSqlQuery delete_fts(db);
+      delete_fts.prepare(QString("DELETE FROM %1 WHERE ROWID IN (%2)").arg(fts_table_, updated_ids.join(",")));
+      delete_fts.exec();
+      if (db_->CheckErrors(delete_fts)) return;
+
+      QSqlQuery update_fts(db);
+      update_fts.prepare(fts_insert + QString("ROWID IN (%1)").arg(updated_ids.join(",")));
+      update_fts.exec();
+      if (db_->CheckErrors(update_fts)) return;
+    }
+  }
+
+  if (!new_songs.isEmpty()) {
+    // Insert as many rows per statement as SQLite allows bound values.
+    const int columns = Song::kColumns.count();
+    const int max_rows = qMax(1, kMaxBindValues / columns);
+
+    QStringList row_placeholders;
+    for (int i = 0 ; i < columns ; ++i) {
+      row_placeholders << "?";
+    }
+    const QString row_spec = "(" + row_placeholders.join(", ") + ")";
+
+    QSqlQuery add_songs(db);
+    int prepared_rows = 0;
+    int first_id = -1;
+
+    for (int i = 0 ; i < new_songs.count() ; i += max_rows) {
+      const int rows = qMin(max_rows, new_songs.count() - i);
+      if (rows != prepared_rows) {
+        QStringList values_spec;
+        for (int j = 0 ; j < rows ; ++j) {
+          values_spec << row_spec;
+        }
+        add_songs.prepare(QString("INSERT INTO %1 (" + Song::kColumnSpec + ") VALUES " + values_spec.join(", ")).arg(songs_table_));
+        prepared_rows = rows;
+      }
+
+      for (int j = 0 ; j < rows ; ++j) {
+        for (const QVariant &value : new_songs[i + j].ColumnValues()) {
+          add_songs.addBindValue(value);
+        }
+      }
+      add_songs.exec();
+      if (db_->CheckErrors(add_songs)) continue;
+
+      // The rows of one statement get consecutive IDs, ending with the last inserted one.
+      const int last_id = add_songs.lastInsertId().toInt();
+      for (int j = 0 ; j < rows ; ++j) {
+        Song copy(new_songs[i + j]);
+        copy.set_id(last_id - rows + 1 + j);
+        added_songs << copy;
+      }
+      if (first_id == -1) first_id = last_id - rows + 1;
+    }
+
+    if (first_id != -1) {
+      // New rows always get a higher ID than the existing ones.
+      QSqlQuery add_fts(db);
+      add_fts.prepare(fts_insert + "ROWID >= :id");
+      add_fts.bindValue(":id", first_id);
+      add_fts.exec();
+      if (db_->CheckErrors(add_fts)) return;
+    }
   }
 
   transaction.Commit();
 
+  const qint64 elapsed = timer.elapsed();
+  qLog(Debug) << "Added or updated" << added_songs.count() << "songs in" << elapsed << "ms," << (elapsed > 0 ? added_songs.count() * 1000 / elapsed : added_songs.count()) << "songs/s";
+
   if (!deleted_songs.isEmpty()) emit SongsDeleted(deleted_songs);
 
   if (!added_songs.isEmpty()) emit SongsDiscovered(added_songs);
@@ -547,7 +697,6 @@ QStringList CollectionBackend::GetAll(const QString &column, const QueryOptions
   query.SetColumnSpec("DISTINCT " + column);
   query.AddCompilationRequirement(false);
 
-  QMutexLocker l(db_->Mutex());
   if (!ExecQuery(&query)) return QStringList();
 
   QStringList ret;
@@ -578,11 +727,8 @@ QStringList CollectionBackend::GetAllArtistsWithAlbums(const QueryOptions &opt)
   query2.AddWhere("album", "", "!=");
   query2.AddWhere("albumartist", "", "=");
 
-  {
-    QMutexLocker l(db_->Mutex());
-    if (!ExecQuery(&query) || !ExecQuery(&query2)) {
-      return QStringList();
-    }
+  if (!ExecQuery(&query) || !ExecQuery(&query2)) {
+    return QStringList();
   }
 
   QSet<QString> artists;
@@ -624,7 +770,6 @@ SongList CollectionBackend::GetSongs(const QString &artist, const QString &album
 SongList CollectionBackend::ExecCollectionQuery(CollectionQuery *query) {
 
   query->SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
-  QMutexLocker l(db_->Mutex());
   if (!ExecQuery(query)) return SongList();
 
   SongList ret;
@@ -638,14 +783,12 @@ SongList CollectionBackend::ExecCollectionQuery(CollectionQuery *query) {
 }
 
 Song CollectionBackend::GetSongById(int id) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
   return GetSongById(id, db);
 }
 
 SongList CollectionBackend::GetSongsById(const QList<int> &ids) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QStringList str_ids;
   for (int id : ids) {
@@ -656,16 +799,14 @@ SongList CollectionBackend::GetSongsById(const QList<int> &ids) {
 }
 
 SongList CollectionBackend::GetSongsById(const QStringList &ids) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   return GetSongsById(ids, db);
 }
 
 SongList CollectionBackend::GetSongsByForeignId(const QStringList &ids, const QString &table, const QString &column) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QString in = ids.join(",");
 
@@ -687,9 +828,15 @@ SongList CollectionBackend::GetSongsByForeignId(const QStringList &ids, const QS
 }
 
 Song CollectionBackend::GetSongById(int id, QSqlDatabase &db) {
-  SongList list = GetSongsById(QStringList() << QString::number(id), db);
-  if (list.isEmpty()) return Song();
-  return list.first();
+
+  SqlStatement q(db_, db, QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE ROWID = :id").arg(songs_table_));
+  q.bindValue(":id", id);
+
+  Song song;
+  if (q.next()) song.InitFromQuery(q, true);
+  q.CheckErrors();
+  return song;
+
 }
 
 SongList CollectionBackend::GetSongsById(const QStringList &ids, QSqlDatabase &db) {
@@ -755,7 +902,6 @@ SongList CollectionBackend::GetCompilationSongs(const QString &album, const Quer
   query.AddCompilationRequirement(true);
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
   if (!ExecQuery(&query)) return SongList();
 
   SongList ret;
@@ -875,10 +1021,7 @@ CollectionBackend::AlbumList CollectionBackend::GetAlbums(const QString &artist,
     query.AddWhereArtist(artist);
   }
 
-  {
-    QMutexLocker l(db_->Mutex());
-    if (!ExecQuery(&query)) return ret;
-  }
+  if (!ExecQuery(&query)) return ret;
 
   QString last_album;
   QString last_artist;
@@ -925,7 +1068,6 @@ CollectionBackend::Album CollectionBackend::GetAlbumArt(const QString &artist, c
   }
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
   if (!ExecQuery(&query)) return ret;
 
   if (query.Next()) {
@@ -961,7 +1103,7 @@ void CollectionBackend::UpdateManualAlbumArt(const QString &artist, const QStrin
     query.AddWhere("artist", artist);
   }
 
-  if (!ExecQuery(&query)) return;
+  if (!ExecQuery(&query, db)) return;
 
   SongList deleted_songs;
   while (query.Next()) {
@@ -995,7 +1137,7 @@ void CollectionBackend::UpdateManualAlbumArt(const QString &artist, const QStrin
   db_->CheckErrors(q);
 
   // Now get the updated songs
-  if (!ExecQuery(&query)) return;
+  if (!ExecQuery(&query, db)) return;
 
   SongList added_songs;
   while (query.Next()) {
@@ -1024,7 +1166,7 @@ void CollectionBackend::ForceCompilation(const QString &album, const QList<QStri
     query.AddWhere("album", album);
     if (!artist.isNull() && !artist.isEmpty()) query.AddWhere("artist", artist);
 
-    if (!ExecQuery(&query)) return;
+    if (!ExecQuery(&query, db)) return;
 
     while (query.Next()) {
       Song song;
@@ -1047,7 +1189,7 @@ void CollectionBackend::ForceCompilation(const QString &album, const QList<QStri
     db_->CheckErrors(q);
 
     // Now get the updated songs
-    if (!ExecQuery(&query)) return;
+    if (!ExecQuery(&query, db)) return;
 
     while (query.Next()) {
       Song song;
@@ -1064,7 +1206,11 @@ void CollectionBackend::ForceCompilation(const QString &album, const QList<QStri
 }
 
 bool CollectionBackend::ExecQuery(CollectionQuery *q) {
-  return !db_->CheckErrors(q->Exec(db_->Connect(), songs_table_, fts_table_));
+  return !db_->CheckErrors(q->Exec(db_->ConnectReadOnly(), songs_table_, fts_table_));
+}
+
+bool CollectionBackend::ExecQuery(CollectionQuery *q, QSqlDatabase &db) {
+  return !db_->CheckErrors(q->Exec(db, songs_table_, fts_table_));
 }
 
 void CollectionBackend::IncrementPlayCount(int id) {
@@ -121,15 +121,18 @@ class CollectionBackend : public CollectionBackendInterface {
 
  public:
   static const char *kSettingsGroup;
+  // SQLITE_MAX_VARIABLE_NUMBER of older SQLite versions, limits the number of rows per multi-row insert.
+  static const int kMaxBindValues;
 
   Q_INVOKABLE CollectionBackend(QObject *parent = nullptr);
-  void Init(Database *db, const QString &songs_table, const QString &dirs_table, const QString &subdirs_table, const QString &fts_table);
+  void Init(Database *db, const QString &songs_table, const QString &dirs_table, const QString &subdirs_table, const QString &fts_table, const QString &journal_table = QString());
 
   Database *db() const { return db_; }
 
   QString songs_table() const { return songs_table_; }
   QString dirs_table() const { return dirs_table_; }
   QString subdirs_table() const { return subdirs_table_; }
+  QString journal_table() const { return journal_table_; }
 
   // Get a list of directories in the collection.  Emits DirectoriesDiscovered.
   void LoadDirectoriesAsync();
@@ -140,6 +143,8 @@ class CollectionBackend : public CollectionBackendInterface {
 
   SongList FindSongsInDirectory(int id);
   SubdirectoryList SubdirsInDirectory(int id);
+  // Subdirectories that had change events which were not rescanned yet, for example because Strawberry was closed before the rescan.
+  SubdirectoryList JournaledSubdirsInDirectory(int id);
   DirectoryList GetAllDirectories();
   void ChangeDirPath(int id, const QString &old_path, const QString &new_path);
 
@@ -169,6 +174,7 @@ class CollectionBackend : public CollectionBackendInterface {
   void AddDirectory(const QString &path);
   void RemoveDirectory(const Directory &dir);
 
+  // Runs on the read-only connection, callers don't need to hold the database mutex.
   bool ExecQuery(CollectionQuery *q);
   SongList ExecCollectionQuery(CollectionQuery *query);
 
@@ -188,6 +194,8 @@ class CollectionBackend : public CollectionBackendInterface {
   void DeleteSongs(const SongList &songs);
   void MarkSongsUnavailable(const SongList &songs, bool unavailable = true);
   void AddOrUpdateSubdirs(const SubdirectoryList &subdirs);
+  void AddSubdirsToJournal(const SubdirectoryList &subdirs);
+  void RemoveSubdirsFromJournal(const SubdirectoryList &subdirs);
   void UpdateCompilations();
   void UpdateManualAlbumArt(const QString &artist,  const QString &albumartist, const QString &album, const QString &art);
   void ForceCompilation(const QString &album, const QList<QString> &artists, bool on);
@@ -225,6 +233,7 @@ signals:
   AlbumList GetAlbums(const QString &artist, const QString &album_artist, bool compilation = false, const QueryOptions &opt = QueryOptions());
   AlbumList GetAlbums(const QString &artist, bool compilation, const QueryOptions &opt = QueryOptions());
   SubdirectoryList SubdirsInDirectory(int id, QSqlDatabase &db);
+  bool ExecQuery(CollectionQuery *q, QSqlDatabase &db);
 
   Song GetSongById(int id, QSqlDatabase &db);
   SongList GetSongsById(const QStringList &ids, QSqlDatabase &db);
@@ -235,6 +244,7 @@ signals:
   QString dirs_table_;
   QString subdirs_table_;
   QString fts_table_;
+  QString journal_table_;
 
 };
 
@@ -0,0 +1,418 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <algorithm>
+
+#include <QtGlobal>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QElapsedTimer>
+
+#include "core/logging.h"
+#include "core/song.h"
+#include "core/utf8tokenizer.h"
+#include "collectionbackend.h"
+#include "collectionquery.h"
+#include "collectionindex.h"
+
+namespace {
+
+// Terms beyond this are ignored, the match generation is stored in a byte per row.
+const int kMaxTerms = 254;
+
+struct WordLessThan {
+  explicit WordLessThan(const QList<QByteArray> &words) : words_(words) {}
+  bool operator()(const int a, const int b) const { return words_[a] < words_[b]; }
+  bool operator()(const int a, const QByteArray &b) const { return words_[a] < b; }
+  const QList<QByteArray> &words_;
+};
+
+}  // namespace
+
+CollectionIndex::CollectionIndex() : song_count_(0), dead_count_(0), unsorted_words_(0) {
+
+  // Id 0 is the empty string so "is this tag empty" is a plain int compare.
+  Intern(QString());
+
+}
+
+CollectionIndex *CollectionIndex::Load(CollectionBackend *backend) {
+
+  QElapsedTimer timer;
+  timer.start();
+
+  CollectionQuery q;
+  q.SetColumnSpec("%songs_table.ROWID, title, album, artist, albumartist, composer, performer, grouping, genre, comment, year, originalyear, disc, filetype, samplerate, bitdepth, bitrate, ctime, compilation_effective");
+
+  CollectionIndex *index = new CollectionIndex;
+  if (!backend->ExecQuery(&q)) return index;
+
+  SongList songs;
+  while (q.Next()) {
+    Song song;
+    song.set_id(q.Value(0).toInt());
+    song.set_title(q.Value(1).toString());
+    song.set_album(q.Value(2).toString());
+    song.set_artist(q.Value(3).toString());
+    song.set_albumartist(q.Value(4).toString());
+    song.set_composer(q.Value(5).toString());
+    song.set_performer(q.Value(6).toString());
+    song.set_grouping(q.Value(7).toString());
+    song.set_genre(q.Value(8).toString());
+    song.set_comment(q.Value(9).toString());
+    song.set_year(q.Value(10).toInt());
+    song.set_originalyear(q.Value(11).toInt());
+    song.set_disc(q.Value(12).toInt());
+    song.set_filetype(Song::FileType(q.Value(13).toInt()));
+    song.set_samplerate(q.Value(14).toInt());
+    song.set_bitdepth(q.Value(15).toInt());
+    song.set_bitrate(q.Value(16).toInt());
+    song.set_ctime(q.Value(17).toUInt());
+    song.set_compilation_on(q.Value(18).toBool());
+    songs << song;
+
+    if (songs.count() >= 10000) {
+      index->AddOrUpdateSongs(songs);
+      songs.clear();
+    }
+  }
+  index->AddOrUpdateSongs(songs);
+
+  qLog(Debug) << "Loaded" << index->song_count() << "songs and" << index->words_.count() << "words into the collection index in" << timer.elapsed() << "ms";
+
+  return index;
+
+}
+
+int CollectionIndex::Intern(const QString &str) {
+
+  QHash<QString, int>::const_iterator it = string_ids_.constFind(str);
+  if (it != string_ids_.constEnd()) return it.value();
+
+  const int id = strings_.count();
+  strings_ << str;
+  string_ids_.insert(str, id);
+  return id;
+
+}
+
+void CollectionIndex::AddOrUpdateSongs(const SongList &songs) {
+
+  for (const Song &song : songs) {
+    const int old_row = rows_.value(song.id(), -1);
+    if (old_row != -1) RemoveRow(old_row);
+    rows_.insert(song.id(), AddRow(song));
+  }
+  SortNewWords();
+
+}
+
+void CollectionIndex::RemoveSongs(const SongList &songs) {
+
+  for (const Song &song : songs) {
+    const int row = rows_.value(song.id(), -1);
+    if (row == -1) continue;
+    RemoveRow(row);
+    rows_.remove(song.id());
+  }
+
+  if (dead_count_ > 1000 && dead_count_ > song_count_) Compact();
+
+}
+
+int CollectionIndex::AddRow(const Song &song) {
+
+  const int row = song_id_.count();
+
+  song_id_ << song.id();
+  title_ << Intern(song.title());
+  album_ << Intern(song.album());
+  artist_ << Intern(song.artist());
+  albumartist_ << Intern(song.albumartist());
+  composer_ << Intern(song.composer());
+  performer_ << Intern(song.performer());
+  grouping_ << Intern(song.grouping());
+  genre_ << Intern(song.genre());
+  year_ << song.year();
+  originalyear_ << song.originalyear();
+  disc_ << song.disc();
+  filetype_ << song.filetype();
+  samplerate_ << song.samplerate();
+  bitdepth_ << song.bitdepth();
+  bitrate_ << song.bitrate();
+  ctime_ << song.ctime();
+  compilation_ << song.is_compilation();
+
+  IndexWords(row, Column_Title, song.title());
+  IndexWords(row, Column_Album, song.album());
+  IndexWords(row, Column_Artist, song.artist());
+  IndexWords(row, Column_AlbumArtist, song.albumartist());
+  IndexWords(row, Column_Composer, song.composer());
+  IndexWords(row, Column_Performer, song.performer());
+  IndexWords(row, Column_Grouping, song.grouping());
+  IndexWords(row, Column_Genre, song.genre());
+  IndexWords(row, Column_Comment, song.comment());
+
+  ++song_count_;
+
+  return row;
+
+}
+
+void CollectionIndex::RemoveRow(const int row) {
+
+  // The postings still point to the row, they are skipped because the row is dead and dropped by Compact().
+  song_id_[row] = -1;
+  --song_count_;
+  ++dead_count_;
+
+}
+
+void CollectionIndex::IndexWords(const int row, const int column, const QString &text) {
+
+  if (text.isEmpty()) return;
+
+  const QByteArray utf8 = text.toUtf8();
+  Utf8Tokenizer tokenizer(utf8.constData(), utf8.size());
+  const char *token = nullptr;
+  int token_bytes = 0;
+  int start_offset = 0;
+  int end_offset = 0;
+  while (tokenizer.Next(&token, &token_bytes, &start_offset, &end_offset)) {
+    const QByteArray word = QByteArray::fromRawData(token, token_bytes);
+    QHash<QByteArray, int>::const_iterator it = word_ids_.constFind(word);
+    int word_id = 0;
+    if (it == word_ids_.constEnd()) {
+      word_id = words_.count();
+      // Deep copy, the token points into the tokenizer's buffer or the input.
+      words_ << QByteArray(token, token_bytes);
+      word_ids_.insert(words_.last(), word_id);
+      postings_.append(QVector<quint32>());
+      ++unsorted_words_;
+    }
+    else {
+      word_id = it.value();
+    }
+    const quint32 posting = (quint32(row) << 4) | quint32(column);
+    QVector<quint32> &postings = postings_[word_id];
+    // The same word twice in a column only needs one posting.
+    if (postings.isEmpty() || postings.last() != posting) postings << posting;
+  }
+
+}
+
+void CollectionIndex::SortNewWords() {
+
+  if (unsorted_words_ == 0) return;
+
+  WordLessThan less_than(words_);
+  const int first_new = words_.count() - unsorted_words_;
+
+  if (unsorted_words_ > sorted_words_.count() / 16) {
+    // Bulk load, sorting everything at once is cheaper than inserting one by one.
+    for (int i = first_new; i < words_.count(); ++i) sorted_words_ << i;
+    std::sort(sorted_words_.begin(), sorted_words_.end(), less_than);
+  }
+  else {
+    for (int i = first_new; i < words_.count(); ++i) {
+      sorted_words_.insert(std::lower_bound(sorted_words_.begin(), sorted_words_.end(), i, less_than), i);
+    }
+  }
+  unsorted_words_ = 0;
+
+}
+
+void CollectionIndex::Compact() {
+
+  QVector<int> new_rows(song_id_.count(), -1);
+  int new_row = 0;
+  for (int row = 0; row < song_id_.count(); ++row) {
+    if (!is_alive(row)) continue;
+    new_rows[row] = new_row;
+    if (row != new_row) {
+      song_id_[new_row] = song_id_[row];
+      title_[new_row] = title_[row];
+      album_[new_row] = album_[row];
+      artist_[new_row] = artist_[row];
+      albumartist_[new_row] = albumartist_[row];
+      composer_[new_row] = composer_[row];
+      performer_[new_row] = performer_[row];
+      grouping_[new_row] = grouping_[row];
+      genre_[new_row] = genre_[row];
+      year_[new_row] = year_[row];
+      originalyear_[new_row] = originalyear_[row];
+      disc_[new_row] = disc_[row];
+      filetype_[new_row] = filetype_[row];
+      samplerate_[new_row] = samplerate_[row];
+      bitdepth_[new_row] = bitdepth_[row];
+      bitrate_[new_row] = bitrate_[row];
+      ctime_[new_row] = ctime_[row];
+      compilation_[new_row] = compilation_[row];
+      rows_[song_id_[new_row]] = new_row;
+    }
+    ++new_row;
+  }
+
+  song_id_.resize(new_row);
+  title_.resize(new_row);
+  album_.resize(new_row);
+  artist_.resize(new_row);
+  albumartist_.resize(new_row);
+  composer_.resize(new_row);
+  performer_.resize(new_row);
+  grouping_.resize(new_row);
+  genre_.resize(new_row);
+  year_.resize(new_row);
+  originalyear_.resize(new_row);
+  disc_.resize(new_row);
+  filetype_.resize(new_row);
+  samplerate_.resize(new_row);
+  bitdepth_.resize(new_row);
+  bitrate_.resize(new_row);
+  ctime_.resize(new_row);
+  compilation_.resize(new_row);
+
+  for (QVector<quint32> &postings : postings_) {
+    int out = 0;
+    for (int i = 0; i < postings.count(); ++i) {
+      const int row = new_rows[postings[i] >> 4];
+      if (row == -1) continue;
+      postings[out++] = (quint32(row) << 4) | (postings[i] & 0xf);
+    }
+    postings.resize(out);
+  }
+
+  // Words only used by removed songs are left in place, they have no postings and cost next to nothing.
+  dead_count_ = 0;
+
+}
+
+void CollectionIndex::MatchTerm(const QueryOptions::FilterTerm &term, QVector<quint8> *matches, const quint8 generation) const {
+
+  // Rows matching all previous terms have the previous generation, move the ones that also match this term to the next.
+  const quint8 previous = generation - 1;
+  quint8 *data = matches->data();
+
+  QVector<int>::const_iterator it = std::lower_bound(sorted_words_.constBegin(), sorted_words_.constEnd(), term.prefix, WordLessThan(words_));
+  for (; it != sorted_words_.constEnd() && words_[*it].startsWith(term.prefix); ++it) {
+    for (const quint32 posting : postings_[*it]) {
+      if (term.column != -1 && int(posting & 0xf) != term.column) continue;
+      const int row = posting >> 4;
+      if (data[row] == previous) data[row] = generation;
+    }
+  }
+
+}
+
+QVector<int> CollectionIndex::Filter(const QueryOptions &options) const {
+
+  QVector<int> rows;
+  rows.reserve(song_count_);
+  for (int row = 0; row < song_id_.count(); ++row) {
+    if (is_alive(row)) rows << row;
+  }
+  return Filter(options, rows);
+
+}
+
+QVector<int> CollectionIndex::Filter(const QueryOptions &options, const QVector<int> &rows) const {
+
+  QVector<int> ret;
+  ret.reserve(rows.count());
+
+  QList<QueryOptions::FilterTerm> terms = options.FilterTerms();
+  if (terms.count() > kMaxTerms) terms = terms.mid(0, kMaxTerms);
+
+  QVector<quint8> matches;
+  if (!terms.isEmpty()) {
+    matches.fill(0, song_id_.count());
+    quint8 generation = 0;
+    for (const QueryOptions::FilterTerm &term : terms) {
+      MatchTerm(term, &matches, ++generation);
+    }
+  }
+  const quint8 all_terms = quint8(terms.count());
+
+  uint cutoff = 0;
+  if (options.max_age() != -1) {
+    cutoff = QDateTime::currentDateTime().toTime_t() - options.max_age();
+  }
+
+  QHash<QPair<quint64, int>, int> duplicates;
+  if (options.query_mode() == QueryOptions::QueryMode_Duplicates) {
+    for (int row = 0; row < song_id_.count(); ++row) {
+      if (!is_alive(row) || artist_[row] == 0 || album_[row] == 0 || title_[row] == 0) continue;
+      ++duplicates[qMakePair((quint64(artist_[row]) << 32) | quint64(album_[row]), title_[row])];
+    }
+  }
+
+  for (const int row : rows) {
+    if (!is_alive(row)) continue;
+    if (!terms.isEmpty() && matches[row] != all_terms) continue;
+    if (options.max_age() != -1 && ctime_[row] <= cutoff) continue;
+
+    switch (options.query_mode()) {
+      case QueryOptions::QueryMode_All:
+        break;
+      case QueryOptions::QueryMode_Duplicates:
+        if (duplicates.value(qMakePair((quint64(artist_[row]) << 32) | quint64(album_[row]), title_[row])) < 2) continue;
+        break;
+      case QueryOptions::QueryMode_Untagged:
+        if (artist_[row] != 0 && album_[row] != 0 && title_[row] != 0) continue;
+        break;
+    }
+
+    ret << row;
+  }
+
+  return ret;
+
+}
+
+Song CollectionIndex::GroupingSong(const int row) const {
+
+  Song song;
+  song.set_id(song_id_[row]);
+  song.set_title(strings_[title_[row]]);
+  song.set_album(strings_[album_[row]]);
+  song.set_artist(strings_[artist_[row]]);
+  song.set_albumartist(strings_[albumartist_[row]]);
+  song.set_composer(strings_[composer_[row]]);
+  song.set_performer(strings_[performer_[row]]);
+  song.set_grouping(strings_[grouping_[row]]);
+  song.set_genre(strings_[genre_[row]]);
+  song.set_year(year_[row]);
+  song.set_originalyear(originalyear_[row]);
+  song.set_disc(disc_[row]);
+  song.set_filetype(Song::FileType(filetype_[row]));
+  song.set_samplerate(samplerate_[row]);
+  song.set_bitdepth(bitdepth_[row]);
+  song.set_bitrate(bitrate_[row]);
+  song.set_ctime(ctime_[row]);
+  song.set_compilation_on(compilation_[row]);
+  return song;
+
+}
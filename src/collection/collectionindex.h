@@ -0,0 +1,149 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef COLLECTIONINDEX_H
+#define COLLECTIONINDEX_H
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QVector>
+#include <QHash>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include "core/song.h"
+#include "collectionquery.h"
+
+class CollectionBackend;
+
+// A columnar copy of the grouping and search columns of every song in the collection, used by CollectionModel to group and filter without going to the database.
+// Strings are interned so each column is a plain array of ints, and the words of the full text search columns are kept in a sorted list for prefix lookups.
+// Rows are never moved while songs are added or removed, removed rows are only marked dead and reused by Compact().
+// The index is not thread safe, it is built in a background thread by Load() and only used from the thread that owns the model after that.
+class CollectionIndex {
+ public:
+  CollectionIndex();
+
+  // Same order as Song::kFtsColumns, so a "column:" prefix in the filter maps directly to a column.
+  enum Column {
+    Column_Title = 0,
+    Column_Album,
+    Column_Artist,
+    Column_AlbumArtist,
+    Column_Composer,
+    Column_Performer,
+    Column_Grouping,
+    Column_Genre,
+    Column_Comment,
+    ColumnCount
+  };
+
+  // Reads all available songs from the collection in one query.
+  static CollectionIndex *Load(CollectionBackend *backend);
+
+  void AddOrUpdateSongs(const SongList &songs);
+  void RemoveSongs(const SongList &songs);
+
+  int song_count() const { return song_count_; }
+  int row_count() const { return song_id_.count(); }
+  bool is_alive(const int row) const { return song_id_[row] != -1; }
+  int RowForSongId(const int id) const { return rows_.value(id, -1); }
+
+  // Returns the alive rows matching the filter text, age and query mode, in row order.
+  QVector<int> Filter(const QueryOptions &options) const;
+  // Same as above, but only considers the given rows.
+  QVector<int> Filter(const QueryOptions &options, const QVector<int> &rows) const;
+
+  // Interned strings, the same id is the same string.  Id 0 is always the empty string.
+  int StringId(const QString &str) const { return string_ids_.value(str, -1); }
+  const QString &String(const int id) const { return strings_[id]; }
+
+  int song_id(const int row) const { return song_id_[row]; }
+  int title(const int row) const { return title_[row]; }
+  int album(const int row) const { return album_[row]; }
+  int artist(const int row) const { return artist_[row]; }
+  int albumartist(const int row) const { return albumartist_[row]; }
+  int effective_albumartist(const int row) const { return albumartist_[row] == 0 ? artist_[row] : albumartist_[row]; }
+  int composer(const int row) const { return composer_[row]; }
+  int performer(const int row) const { return performer_[row]; }
+  int grouping(const int row) const { return grouping_[row]; }
+  int genre(const int row) const { return genre_[row]; }
+  int year(const int row) const { return year_[row]; }
+  int originalyear(const int row) const { return originalyear_[row]; }
+  int effective_originalyear(const int row) const { return originalyear_[row] < 0 ? year_[row] : originalyear_[row]; }
+  int disc(const int row) const { return disc_[row]; }
+  int filetype(const int row) const { return filetype_[row]; }
+  int samplerate(const int row) const { return samplerate_[row]; }
+  int bitdepth(const int row) const { return bitdepth_[row]; }
+  int bitrate(const int row) const { return bitrate_[row]; }
+  uint ctime(const int row) const { return ctime_[row]; }
+  bool is_compilation(const int row) const { return compilation_[row]; }
+
+  // A song with only the columns used for grouping set, enough for CollectionModel to create container items from.
+  Song GroupingSong(const int row) const;
+
+ private:
+  int Intern(const QString &str);
+  int AddRow(const Song &song);
+  void RemoveRow(const int row);
+  void IndexWords(const int row, const int column, const QString &text);
+  void SortNewWords();
+  void Compact();
+
+  void MatchTerm(const QueryOptions::FilterTerm &term, QVector<quint8> *matches, const quint8 generation) const;
+
+ private:
+  int song_count_;
+  int dead_count_;
+
+  QHash<int, int> rows_;
+
+  QStringList strings_;
+  QHash<QString, int> string_ids_;
+
+  QVector<int> song_id_;
+  QVector<int> title_;
+  QVector<int> album_;
+  QVector<int> artist_;
+  QVector<int> albumartist_;
+  QVector<int> composer_;
+  QVector<int> performer_;
+  QVector<int> grouping_;
+  QVector<int> genre_;
+  QVector<int> year_;
+  QVector<int> originalyear_;
+  QVector<int> disc_;
+  QVector<int> filetype_;
+  QVector<int> samplerate_;
+  QVector<int> bitdepth_;
+  QVector<int> bitrate_;
+  QVector<uint> ctime_;
+  QVector<bool> compilation_;
+
+  // Every distinct word, its postings as (row << 4 | column), and the word ids sorted by word for prefix lookups.
+  QList<QByteArray> words_;
+  QHash<QByteArray, int> word_ids_;
+  QVector<QVector<quint32>> postings_;
+  QVector<int> sorted_words_;
+  int unsorted_words_;
+};
+
+#endif  // COLLECTIONINDEX_H
@@ -27,7 +27,6 @@
 #include <QtGlobal>
 #include <QtConcurrentRun>
 #include <QtAlgorithms>
-#include <QMutex>
 #include <QFuture>
 #include <QDataStream>
 #include <QMimeData>
@@ -36,6 +35,9 @@
 #include <QVariant>
 #include <QList>
 #include <QSet>
+#include <QHash>
+#include <QPair>
+#include <QVector>
 #include <QChar>
 #include <QRegExp>
 #include <QString>
@@ -55,6 +57,7 @@
 #include "collectionquery.h"
 #include "collectionbackend.h"
 #include "collectiondirectorymodel.h"
+#include "collectionindex.h"
 #include "collectionitem.h"
 #include "collectionmodel.h"
 #include "sqlrow.h"
@@ -79,6 +82,165 @@ static bool IsCompilationArtistNode(const CollectionItem *node) {
   return node == node->parent->compilation_artist_node_;
 }
 
+namespace {
+
+// Songs for the song nodes are read from the database in batches of this many ids.
+const int kIndexSongBatchSize = 10000;
+
+// The in-memory index equivalent of the WHERE clauses FilterQuery adds for a parent item, with the keys resolved to interned string ids up front.
+struct IndexRowFilter {
+  IndexRowFilter() : type(CollectionModel::GroupBy_None), compilation(false), string_id(-1), album_id(-1), grouping_id(-1), value1(0), value2(0), value3(0) {}
+
+  CollectionModel::GroupBy type;
+  bool compilation;
+  int string_id;
+  int album_id;
+  int grouping_id;
+  int value1;
+  int value2;
+  int value3;
+};
+
+IndexRowFilter CreateIndexRowFilter(const CollectionIndex *index, const CollectionModel::GroupBy type, const CollectionItem *item) {
+
+  IndexRowFilter filter;
+  filter.type = type;
+
+  switch (type) {
+    case CollectionModel::GroupBy_AlbumArtist:
+    case CollectionModel::GroupBy_Artist:
+      filter.compilation = IsCompilationArtistNode(item);
+      filter.string_id = index->StringId(item->key);
+      break;
+    case CollectionModel::GroupBy_Album:
+    case CollectionModel::GroupBy_Composer:
+    case CollectionModel::GroupBy_Performer:
+    case CollectionModel::GroupBy_Grouping:
+    case CollectionModel::GroupBy_Genre:
+      filter.string_id = index->StringId(item->key);
+      break;
+    case CollectionModel::GroupBy_YearAlbum:
+    case CollectionModel::GroupBy_OriginalYearAlbum:
+      filter.value1 = qMax(0, item->metadata.year());
+      filter.value2 = qMax(0, item->metadata.originalyear());
+      filter.album_id = index->StringId(item->metadata.album());
+      filter.grouping_id = index->StringId(item->metadata.grouping());
+      break;
+    case CollectionModel::GroupBy_Year:
+    case CollectionModel::GroupBy_OriginalYear:
+    case CollectionModel::GroupBy_Disc:
+    case CollectionModel::GroupBy_Samplerate:
+    case CollectionModel::GroupBy_Bitdepth:
+    case CollectionModel::GroupBy_Bitrate:
+      filter.value1 = item->key.toInt();
+      break;
+    case CollectionModel::GroupBy_FileType:
+    case CollectionModel::GroupBy_Format:
+      filter.value1 = item->metadata.filetype();
+      filter.value2 = item->metadata.samplerate();
+      filter.value3 = item->metadata.bitdepth();
+      break;
+    case CollectionModel::GroupBy_None:
+      break;
+  }
+
+  return filter;
+
+}
+
+bool IndexRowMatches(const CollectionIndex *index, const IndexRowFilter &filter, const int row) {
+
+  switch (filter.type) {
+    case CollectionModel::GroupBy_AlbumArtist:
+      if (filter.compilation) return index->is_compilation(row);
+      return !index->is_compilation(row) && index->effective_albumartist(row) == filter.string_id;
+    case CollectionModel::GroupBy_Artist:
+      if (filter.compilation) return index->is_compilation(row);
+      return !index->is_compilation(row) && index->artist(row) == filter.string_id;
+    case CollectionModel::GroupBy_Album:
+      return index->album(row) == filter.string_id;
+    case CollectionModel::GroupBy_Composer:
+      return index->composer(row) == filter.string_id;
+    case CollectionModel::GroupBy_Performer:
+      return index->performer(row) == filter.string_id;
+    case CollectionModel::GroupBy_Grouping:
+      return index->grouping(row) == filter.string_id;
+    case CollectionModel::GroupBy_Genre:
+      return index->genre(row) == filter.string_id;
+    case CollectionModel::GroupBy_YearAlbum:
+      return qMax(0, index->year(row)) == filter.value1 && index->album(row) == filter.album_id && index->grouping(row) == filter.grouping_id;
+    case CollectionModel::GroupBy_OriginalYearAlbum:
+      return qMax(0, index->year(row)) == filter.value1 && qMax(0, index->originalyear(row)) == filter.value2 && index->album(row) == filter.album_id && index->grouping(row) == filter.grouping_id;
+    case CollectionModel::GroupBy_Year:
+      return qMax(0, index->year(row)) == filter.value1;
+    case CollectionModel::GroupBy_OriginalYear:
+      return qMax(0, index->effective_originalyear(row)) == filter.value1;
+    case CollectionModel::GroupBy_Disc:
+      return index->disc(row) == filter.value1;
+    case CollectionModel::GroupBy_Samplerate:
+      return qMax(0, index->samplerate(row)) == filter.value1;
+    case CollectionModel::GroupBy_Bitdepth:
+      return qMax(0, index->bitdepth(row)) == filter.value1;
+    case CollectionModel::GroupBy_Bitrate:
+      return qMax(0, index->bitrate(row)) == filter.value1;
+    case CollectionModel::GroupBy_FileType:
+      return index->filetype(row) == filter.value1;
+    case CollectionModel::GroupBy_Format:
+      return index->filetype(row) == filter.value1 && index->samplerate(row) == filter.value2 && index->bitdepth(row) == filter.value3;
+    case CollectionModel::GroupBy_None:
+      break;
+  }
+  return true;
+
+}
+
+// Rows with the same key end up in the same container item, like the DISTINCT columns InitQuery selects.
+QPair<quint64, quint64> IndexGroupKey(const CollectionIndex *index, const CollectionModel::GroupBy type, const int row) {
+
+  switch (type) {
+    case CollectionModel::GroupBy_AlbumArtist:
+      return qMakePair(quint64(index->effective_albumartist(row)), quint64(0));
+    case CollectionModel::GroupBy_Artist:
+      return qMakePair(quint64(index->artist(row)), quint64(0));
+    case CollectionModel::GroupBy_Album:
+      return qMakePair(quint64(index->album(row)), quint64(0));
+    case CollectionModel::GroupBy_Composer:
+      return qMakePair(quint64(index->composer(row)), quint64(0));
+    case CollectionModel::GroupBy_Performer:
+      return qMakePair(quint64(index->performer(row)), quint64(0));
+    case CollectionModel::GroupBy_Grouping:
+      return qMakePair(quint64(index->grouping(row)), quint64(0));
+    case CollectionModel::GroupBy_Genre:
+      return qMakePair(quint64(index->genre(row)), quint64(0));
+    case CollectionModel::GroupBy_YearAlbum:
+      return qMakePair(quint64(quint32(qMax(0, index->year(row)))), (quint64(index->album(row)) << 32) | quint64(index->grouping(row)));
+    case CollectionModel::GroupBy_OriginalYearAlbum:
+      return qMakePair((quint64(quint32(qMax(0, index->year(row)))) << 32) | quint64(quint32(qMax(0, index->originalyear(row)))), (quint64(index->album(row)) << 32) | quint64(index->grouping(row)));
+    case CollectionModel::GroupBy_Year:
+      return qMakePair(quint64(quint32(qMax(0, index->year(row)))), quint64(0));
+    case CollectionModel::GroupBy_OriginalYear:
+      return qMakePair(quint64(quint32(qMax(0, index->effective_originalyear(row)))), quint64(0));
+    case CollectionModel::GroupBy_Disc:
+      return qMakePair(quint64(quint32(index->disc(row))), quint64(0));
+    case CollectionModel::GroupBy_Samplerate:
+      return qMakePair(quint64(quint32(qMax(0, index->samplerate(row)))), quint64(0));
+    case CollectionModel::GroupBy_Bitdepth:
+      return qMakePair(quint64(quint32(qMax(0, index->bitdepth(row)))), quint64(0));
+    case CollectionModel::GroupBy_Bitrate:
+      return qMakePair(quint64(quint32(qMax(0, index->bitrate(row)))), quint64(0));
+    case CollectionModel::GroupBy_FileType:
+      return qMakePair(quint64(quint32(index->filetype(row))), quint64(0));
+    case CollectionModel::GroupBy_Format:
+      return qMakePair((quint64(quint32(index->filetype(row))) << 32) | quint64(quint32(index->samplerate(row))), quint64(quint32(index->bitdepth(row))));
+    case CollectionModel::GroupBy_None:
+      break;
+  }
+  return qMakePair(quint64(index->song_id(row)), quint64(0));
+
+}
+
+}  // namespace
+
 CollectionModel::CollectionModel(CollectionBackend *backend, Application *app, QObject *parent) :
       SimpleTreeModel<CollectionItem>(new CollectionItem(this), parent),
       backend_(backend),
@@ -88,19 +250,27 @@ CollectionModel::CollectionModel(CollectionBackend *backend, Application *app, Q
       total_song_count_(0),
       total_artist_count_(0),
       total_album_count_(0),
+      update_serial_(0),
+      update_pending_(false),
       artist_icon_(IconLoader::Load("folder-sound")),
       album_icon_(IconLoader::Load("cdcase")),
       playlists_dir_icon_(IconLoader::Load("folder-sound")),
       playlist_icon_(IconLoader::Load("albums")),
       init_task_id_(-1),
       use_pretty_covers_(false),
-      show_dividers_(true) {
+      show_dividers_(true),
+      use_index_(false),
+      index_loading_(false),
+      index_(nullptr),
+      index_rows_valid_(false),
+      index_song_load_id_(0) {
 
   root_->lazy_loaded = true;
 
   group_by_[0] = GroupBy_AlbumArtist;
   group_by_[1] = GroupBy_Album;
   group_by_[2] = GroupBy_None;
+  tree_group_by_ = group_by_;
 
   cover_loader_options_.desired_height_ = kPrettyCoverSize;
   cover_loader_options_.pad_output_image_ = true;
@@ -118,6 +288,7 @@ CollectionModel::CollectionModel(CollectionBackend *backend, Application *app, Q
   connect(backend_, SIGNAL(SongsDiscovered(SongList)), SLOT(SongsDiscovered(SongList)));
   connect(backend_, SIGNAL(SongsDeleted(SongList)), SLOT(SongsDeleted(SongList)));
   connect(backend_, SIGNAL(DatabaseReset()), SLOT(Reset()));
+  connect(backend_, SIGNAL(DatabaseReset()), SLOT(LoadIndex()));
   connect(backend_, SIGNAL(TotalSongCountUpdated(int)), SLOT(TotalSongCountUpdatedSlot(int)));
   connect(backend_, SIGNAL(TotalArtistCountUpdated(int)), SLOT(TotalArtistCountUpdatedSlot(int)));
   connect(backend_, SIGNAL(TotalAlbumCountUpdated(int)), SLOT(TotalAlbumCountUpdatedSlot(int)));
@@ -129,7 +300,12 @@ CollectionModel::CollectionModel(CollectionBackend *backend, Application *app, Q
 
 }
 
-CollectionModel::~CollectionModel() { delete root_; }
+CollectionModel::~CollectionModel() {
+
+  delete root_;
+  delete index_;
+
+}
 
 void CollectionModel::set_pretty_covers(bool use_pretty_covers) {
 
@@ -147,6 +323,63 @@ void CollectionModel::set_show_dividers(bool show_dividers) {
   }
 }
 
+void CollectionModel::set_use_index(bool use_index) {
+
+  if (use_index == use_index_) return;
+
+  use_index_ = use_index;
+  if (use_index_) {
+    LoadIndex();
+  }
+  else {
+    delete index_;
+    index_ = nullptr;
+    index_rows_valid_ = false;
+  }
+
+}
+
+void CollectionModel::LoadIndex() {
+
+  if (!use_index_ || index_loading_) return;
+
+  index_loading_ = true;
+  index_pending_.clear();
+
+  QFuture<CollectionIndex*> future = QtConcurrent::run(&CollectionIndex::Load, backend_);
+  NewClosure(future, this, SLOT(IndexLoaded(QFuture<CollectionIndex*>)), future);
+
+}
+
+void CollectionModel::IndexLoaded(QFuture<CollectionIndex*> future) {
+
+  index_loading_ = false;
+
+  CollectionIndex *index = future.result();
+  QList<QPair<bool, SongList>> pending = index_pending_;
+  index_pending_.clear();
+
+  if (!use_index_) {
+    delete index;
+    return;
+  }
+
+  // Catch up with the changes since the songs were read.
+  for (const QPair<bool, SongList> &changes : pending) {
+    if (changes.first) index->AddOrUpdateSongs(changes.second);
+    else index->RemoveSongs(changes.second);
+  }
+
+  delete index_;
+  index_ = index;
+  index_rows_valid_ = false;
+
+}
+
+bool CollectionModel::IndexReady() const {
+  return index_ && !index_loading_;
+}
+
 void CollectionModel::SaveGrouping(QString name) {
 
   qLog(Debug) << "Model, save to: " << name;
@@ -184,6 +417,10 @@ void CollectionModel::Init(bool async) {
 
 void CollectionModel::SongsDiscovered(const SongList &songs) {
 
+  if (index_loading_) index_pending_ << qMakePair(true, songs);
+  else if (index_) index_->AddOrUpdateSongs(songs);
+  index_rows_valid_ = false;
+
   for (const Song &song : songs) {
 
     // Sanity check to make sure we don't add songs that are outside the user's filter
@@ -412,6 +649,10 @@ QString CollectionModel::DividerDisplayText(GroupBy type, const QString &key) co
 
 void CollectionModel::SongsDeleted(const SongList &songs) {
 
+  if (index_loading_) index_pending_ << qMakePair(false, songs);
+  else if (index_) index_->RemoveSongs(songs);
+  index_rows_valid_ = false;
+
   // Delete the actual song nodes first, keeping track of each parent so we might check to see if they're empty later.
   QSet<CollectionItem*> parents;
   for (const Song &song : songs) {
@@ -456,6 +697,7 @@ void CollectionModel::SongsDeleted(const SongList &songs) {
         node->parent->compilation_artist_node_ = nullptr;
       else
         container_nodes_[node->container_level].remove(node->key);
+      index_song_loads_.remove(node);
 
       // It was empty - delete it
       beginRemoveRows(ItemToIndex(node->parent), node->row, node->row);
@@ -694,7 +936,6 @@ bool CollectionModel::HasCompilations(const CollectionQuery &query) {
   q.AddCompilationRequirement(true);
   q.SetLimit(1);
 
-  QMutexLocker l(backend_->db()->Mutex());
   if (!backend_->ExecQuery(&q)) return false;
 
   return q.Next();
@@ -702,38 +943,55 @@ bool CollectionModel::HasCompilations(const CollectionQuery &query) {
 }
 
 CollectionModel::QueryResult CollectionModel::RunQuery(CollectionItem *parent) {
+  return RunChildrenQuery(PrepareChildrenQuery(parent));
+}
 
-  QueryResult result;
+CollectionModel::ChildrenQuery CollectionModel::PrepareChildrenQuery(CollectionItem *parent) {
+
+  ChildrenQuery ret;
 
   // Information about what we want the children to be
   int child_level = parent == root_ ? 0 : parent->container_level + 1;
   GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by_[child_level];
 
   // Initialise the query.  child_type says what type of thing we want (artists, songs, etc.)
-  CollectionQuery q(query_options_);
-  InitQuery(child_type, &q);
+  ret.query = CollectionQuery(query_options_);
+  InitQuery(child_type, &ret.query);
 
   // Walk up through the item's parents adding filters as necessary
   CollectionItem *p = parent;
   while (p && p->type == CollectionItem::Type_Container) {
-    FilterQuery(group_by_[p->container_level], p, &q);
+    FilterQuery(group_by_[p->container_level], p, &ret.query);
+    ret.path.prepend(p);
+    ret.keys.prepend(p->key);
     p = p->parent;
   }
 
   // Artists GroupBy is special - we don't want compilation albums appearing
   if (IsArtistGroupBy(child_type)) {
     // Add the special Various artists node
-    if (show_various_artists_ && HasCompilations(q)) {
-      result.create_va = true;
-    }
-
+    ret.check_compilations = show_various_artists_;
     // Don't show compilations again outside the Various artists node
+    ret.exclude_compilations = true;
+  }
+
+  return ret;
+
+}
+
+CollectionModel::QueryResult CollectionModel::RunChildrenQuery(const ChildrenQuery &query) {
+
+  QueryResult result;
+
+  CollectionQuery q = query.query;
+  if (query.check_compilations && HasCompilations(q)) {
+    result.create_va = true;
+  }
+  if (query.exclude_compilations) {
     q.AddCompilationRequirement(false);
   }
 
   // Execute the query
-  QMutexLocker l(backend_->db()->Mutex());
-
   if (!backend_->ExecQuery(&q)) return result;
 
   while (q.Next()) {
@@ -743,6 +1001,125 @@ CollectionModel::QueryResult CollectionModel::RunQuery(CollectionItem *parent) {
 
 }
 
+CollectionModel::ChildrenQueryList CollectionModel::RunChildrenQueries(ChildrenQueryList queries) {
+
+  for (ChildrenQuery &query : queries) {
+    query.result = RunChildrenQuery(query);
+  }
+  return queries;
+
+}
+
+CollectionModel::QueryResult CollectionModel::RunIndexQuery(CollectionItem *parent) {
+
+  QueryResult result;
+
+  // Information about what we want the children to be
+  int child_level = parent == root_ ? 0 : parent->container_level + 1;
+  GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by_[child_level];
+
+  // Walk up through the item's parents collecting filters as necessary
+  QList<IndexRowFilter> filters;
+  CollectionItem *p = parent;
+  while (p && p->type == CollectionItem::Type_Container) {
+    filters << CreateIndexRowFilter(index_, group_by_[p->container_level], p);
+    p = p->parent;
+  }
+
+  QSet<QPair<quint64, quint64>> groups;
+  for (const int row : IndexRows()) {
+    bool matches = true;
+    for (const IndexRowFilter &filter : filters) {
+      if (!IndexRowMatches(index_, filter, row)) {
+        matches = false;
+        break;
+      }
+    }
+    if (!matches) continue;
+
+    // Artists GroupBy is special - compilations go in the Various artists node only
+    if (IsArtistGroupBy(child_type) && index_->is_compilation(row)) {
+      if (show_various_artists_) result.create_va = true;
+      continue;
+    }
+
+    if (child_type == GroupBy_None) {
+      result.song_ids << index_->song_id(row);
+      continue;
+    }
+
+    const QPair<quint64, quint64> key = IndexGroupKey(index_, child_type, row);
+    if (groups.contains(key)) continue;
+    groups.insert(key);
+    result.songs << index_->GroupingSong(row);
+  }
+
+  return result;
+
+}
+
+const QVector<int> &CollectionModel::IndexRows() {
+
+  if (!index_rows_valid_) {
+    index_rows_ = index_->Filter(query_options_);
+    index_rows_valid_ = true;
+  }
+  return index_rows_;
+
+}
+
+SongList CollectionModel::GetIndexSongs(const QList<int> &ids) {
+
+  // The index only has the columns used for grouping, so songs still come from the database.
+  SongList songs;
+  for (int i = 0; i < ids.count(); i += kIndexSongBatchSize) {
+    songs << backend_->GetSongsById(ids.mid(i, kIndexSongBatchSize));
+  }
+  return songs;
+
+}
+
+CollectionModel::QueryResult CollectionModel::LoadIndexSongs(QueryResult result) {
+
+  result.songs << GetIndexSongs(result.song_ids);
+  result.song_ids.clear();
+  return result;
+
+}
+
+void CollectionModel::LoadIndexSongsAsync(CollectionItem *parent, const QList<int> &ids) {
+
+  const int load_id = ++index_song_load_id_;
+  index_song_loads_[parent] = load_id;
+
+  QFuture<SongList> future = QtConcurrent::run(this, &CollectionModel::GetIndexSongs, ids);
+  NewClosure(future, this, SLOT(IndexSongsLoaded(QFuture<SongList>, CollectionItem*, int, int)), future, parent, load_id, update_serial_);
+
+}
+
+void CollectionModel::IndexSongsLoaded(QFuture<SongList> future, CollectionItem *parent, int load_id, int serial) {
+
+  // The item was deleted or populated in the meantime, or a newer load was started for it.
+  // Only the address is compared until it's known the item is still there.
+  if (index_song_loads_.value(parent, -1) != load_id) return;
+  index_song_loads_.remove(parent);
+
+  if (serial != update_serial_) {
+    // The filter changed while the songs were read.  Loaded items got their own load from the update, the others start again.
+    if (!parent->lazy_loaded) LazyPopulate(parent);
+    return;
+  }
+
+  QueryResult result;
+  for (const Song &song : future.result()) {
+    if (!song_nodes_.contains(song.id())) result.songs << song;
+  }
+
+  parent->lazy_loaded = true;
+  PostQuery(parent, result, true);
+
+}
+
 void CollectionModel::PostQuery(CollectionItem *parent, const CollectionModel::QueryResult &result, bool signal) {
 
   // Information about what we want the children to be
@@ -765,19 +1142,67 @@ void CollectionModel::PostQuery(CollectionItem *parent, const CollectionModel::Q
       container_nodes_[child_level][item->key] = item;
   }
 
+  SongList songs = result.songs;
+  if (!result.song_ids.isEmpty()) songs << GetIndexSongs(result.song_ids);
+
+  for (const Song &song : songs) {
+    CollectionItem *item = ItemFromSong(child_type, signal, child_level == 0, parent, song, child_level);
+
+    if (child_type == GroupBy_None)
+      song_nodes_[item->metadata.id()] = item;
+    else
+      container_nodes_[child_level][item->key] = item;
+  }
+
+}
+
+void CollectionModel::LazyPopulate(CollectionItem *parent) {
+
+  if (parent->lazy_loaded || index_song_loads_.contains(parent)) return;
+
+  if (!IndexReady()) {
+    LazyPopulate(parent, true);
+    return;
+  }
+
+  // Song ids are only returned for the lowest level, so there is nothing else in the result then.
+  const QueryResult result = RunIndexQuery(parent);
+  if (result.song_ids.isEmpty()) {
+    parent->lazy_loaded = true;
+    PostQuery(parent, result, true);
+    return;
+  }
+
+  LoadIndexSongsAsync(parent, result.song_ids);
+
 }
 
 void CollectionModel::LazyPopulate(CollectionItem *parent, bool signal) {
 
   if (parent->lazy_loaded) return;
   parent->lazy_loaded = true;
+  // The songs are needed right now, a background load that's still running is ignored.
+  index_song_loads_.remove(parent);
 
-  QueryResult result = RunQuery(parent);
+  QueryResult result = IndexReady() ? RunIndexQuery(parent) : RunQuery(parent);
   PostQuery(parent, result, signal);
 
 }
 
 void CollectionModel::ResetAsync() {
+
+  if (IndexReady()) {
+    // Grouping the index is fast and it's only safe to use from this thread, but songs at the top level still come from the database.
+    const QueryResult result = RunIndexQuery(root_);
+    if (result.song_ids.isEmpty()) {
+      ResetFinished(result);
+      return;
+    }
+    QFuture<CollectionModel::QueryResult> future = QtConcurrent::run(this, &CollectionModel::LoadIndexSongs, result);
+    NewClosure(future, this, SLOT(ResetAsyncQueryFinished(QFuture<CollectionModel::QueryResult>)), future);
+    return;
+  }
+
   QFuture<CollectionModel::QueryResult> future = QtConcurrent::run(this, &CollectionModel::RunQuery, root_);
   NewClosure(future, this, SLOT(ResetAsyncQueryFinished(QFuture<CollectionModel::QueryResult>)), future);
 
@@ -785,7 +1210,11 @@ void CollectionModel::ResetAsync() {
 
 void CollectionModel::ResetAsyncQueryFinished(QFuture<CollectionModel::QueryResult> future) {
 
-  const struct QueryResult result = future.result();
+  ResetFinished(future.result());
+
+}
+
+void CollectionModel::ResetFinished(const QueryResult &result) {
 
   BeginReset();
   root_->lazy_loaded = true;
@@ -801,6 +1230,266 @@ void CollectionModel::ResetAsyncQueryFinished(QFuture<CollectionModel::QueryResu
 
 }
 
+void CollectionModel::UpdateAsync(bool narrowing) {
+
+  // A different top level means every row changes, so there is nothing to gain from updating.
+  if (!root_->lazy_loaded || init_task_id_ != -1 || tree_group_by_[0] != group_by_[0]) {
+    ResetAsync();
+    return;
+  }
+
+  ++update_serial_;
+
+  QList<ItemPath> paths;
+  GetLoadedPaths(root_, ItemPath(), &paths);
+
+  if (IndexReady()) {
+    for (const ItemPath &path : paths) {
+      CollectionItem *item = FindLoadedContainer(path);
+      if (item) UpdateChildren(item, RunIndexQuery(item));
+    }
+    DeleteEmptyDividers();
+    tree_group_by_ = group_by_;
+    return;
+  }
+
+  // The tree is only known to match the old filter if no update is still running.
+  if (narrowing && !update_pending_ && tree_group_by_ == group_by_) {
+    // Songs are tested in memory.  Containers that aren't loaded can't be, only the parents of those are queried again.
+    paths.clear();
+    PruneChildren(root_, ItemPath(), &paths);
+    DeleteEmptyDividers();
+    if (paths.isEmpty()) return;
+  }
+
+  // Only the loaded containers are queried, the others get their children with the new filter when they are expanded.
+  ChildrenQueryList queries;
+  for (const ItemPath &path : paths) {
+    queries << PrepareChildrenQuery(path.isEmpty() ? root_ : path.last());
+  }
+
+  update_pending_ = true;
+  QFuture<CollectionModel::ChildrenQueryList> future = QtConcurrent::run(this, &CollectionModel::RunChildrenQueries, queries);
+  NewClosure(future, this, SLOT(UpdateAsyncQueryFinished(QFuture<CollectionModel::ChildrenQueryList>, int)), future, update_serial_);
+
+}
+
+void CollectionModel::GetLoadedPaths(CollectionItem *parent, const ItemPath &path, QList<ItemPath> *paths) const {
+
+  *paths << path;
+  for (CollectionItem *child : parent->children) {
+    if (child->type == CollectionItem::Type_Container && child->lazy_loaded) GetLoadedPaths(child, ItemPath(path) << child, paths);
+  }
+
+}
+
+CollectionItem *CollectionModel::FindLoadedContainer(const ItemPath &path, const QStringList &keys) const {
+
+  CollectionItem *item = root_;
+  for (int i = 0; i < path.count(); ++i) {
+    if (!item->children.contains(path[i])) return nullptr;
+    item = path[i];
+    // Another item could have been created at the address of one that was deleted
+    if (i < keys.count() && item->key != keys[i]) return nullptr;
+  }
+  return item->lazy_loaded ? item : nullptr;
+
+}
+
+void CollectionModel::UpdateAsyncQueryFinished(QFuture<CollectionModel::ChildrenQueryList> future, int serial) {
+
+  // Another update or a reset was started while the queries were running.
+  if (serial != update_serial_) return;
+  update_pending_ = false;
+
+  // Parents come before their children, so containers that were removed by the update of their parent are skipped.
+  for (const ChildrenQuery &query : future.result()) {
+    CollectionItem *item = FindLoadedContainer(query.path, query.keys);
+    if (item) UpdateChildren(item, query.result);
+  }
+  DeleteEmptyDividers();
+  tree_group_by_ = group_by_;
+
+}
+
+void CollectionModel::PruneChildren(CollectionItem *parent, const ItemPath &path, QList<ItemPath> *unloaded_paths) {
+
+  for (CollectionItem *child : parent->children) {
+    if (child->type == CollectionItem::Type_Container && !child->lazy_loaded) {
+      *unloaded_paths << path;
+      break;
+    }
+  }
+
+  for (int row = parent->children.count() - 1; row >= 0; --row) {
+    CollectionItem *child = parent->children[row];
+    bool keep = true;
+    if (child->type == CollectionItem::Type_Song) {
+      keep = query_options_.Matches(child->metadata);
+    }
+    else if (child->type == CollectionItem::Type_Container && child->lazy_loaded) {
+      PruneChildren(child, ItemPath(path) << child, unloaded_paths);
+      keep = !child->children.isEmpty();
+    }
+    if (keep) continue;
+
+    ForgetItem(child);
+    if (IsCompilationArtistNode(child)) parent->compilation_artist_node_ = nullptr;
+    beginRemoveRows(ItemToIndex(parent), row, row);
+    parent->Delete(row);
+    endRemoveRows();
+  }
+
+}
+
+void CollectionModel::UpdateChildren(CollectionItem *parent, const QueryResult &result) {
+
+  // Information about what we want the children to be
+  int child_level = parent == root_ ? 0 : parent->container_level + 1;
+  GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by_[child_level];
+  const bool same_type = child_level >= 3 || tree_group_by_[child_level] == child_type;
+
+  // Existing children are matched on their key, or their song ID for songs.
+  QSet<QString> old_keys;
+  QSet<int> old_ids;
+  if (same_type) {
+    for (CollectionItem *child : parent->children) {
+      if (child->type == CollectionItem::Type_Song) old_ids << child->metadata.id();
+      else if (child->type == CollectionItem::Type_Container && !IsCompilationArtistNode(child)) old_keys << child->key;
+    }
+  }
+
+  // Songs from the index are read from the database only if they're not already in the tree.
+  // When the filter is only refined this means no query at all.
+  QueryResult new_result = result;
+  new_result.song_ids.clear();
+  for (const int id : result.song_ids) {
+    if (!old_ids.contains(id)) new_result.song_ids << id;
+  }
+
+  // Build the new children in a detached item first so they can be compared with the ones in the tree.
+  CollectionItem staging(CollectionItem::Type_Container);
+  staging.container_level = parent->container_level;
+  if (new_result.create_va) CreateCompilationArtistNode(false, &staging);
+  for (const SqlRow &row : new_result.rows) {
+    ItemFromQuery(child_type, false, false, &staging, row, child_level);
+  }
+  for (const Song &song : new_result.songs) {
+    ItemFromSong(child_type, false, false, &staging, song, child_level);
+  }
+
+  QSet<QString> new_keys;
+  QSet<int> new_ids = result.song_ids.toSet();
+  for (CollectionItem *child : staging.children) {
+    if (child->type == CollectionItem::Type_Song) new_ids << child->metadata.id();
+    else if (!IsCompilationArtistNode(child)) new_keys << child->key;
+  }
+
+  // Remove the children that are gone, starting from the end so the rows of the others don't move.
+  for (int row = parent->children.count() - 1; row >= 0; --row) {
+    CollectionItem *child = parent->children[row];
+    bool keep = false;
+    if (!same_type) keep = child->type == CollectionItem::Type_Divider;
+    else if (child->type == CollectionItem::Type_Song) keep = new_ids.contains(child->metadata.id());
+    else if (IsCompilationArtistNode(child)) keep = staging.compilation_artist_node_ != nullptr;
+    else if (child->type == CollectionItem::Type_Container) keep = new_keys.contains(child->key);
+    else keep = true;
+    if (keep) continue;
+
+    ForgetItem(child);
+    if (IsCompilationArtistNode(child)) parent->compilation_artist_node_ = nullptr;
+    beginRemoveRows(ItemToIndex(parent), row, row);
+    parent->Delete(row);
+    endRemoveRows();
+  }
+
+  // The new songs from the index are added when they have been read.
+  if (!new_result.song_ids.isEmpty()) LoadIndexSongsAsync(parent, new_result.song_ids);
+
+  // Move the new children into the tree.
+  QList<CollectionItem*> new_items;
+  for (CollectionItem *child : staging.children) {
+    if (child->type == CollectionItem::Type_Song) {
+      if (!old_ids.contains(child->metadata.id())) new_items << child;
+    }
+    else if (IsCompilationArtistNode(child)) {
+      if (!parent->compilation_artist_node_) new_items << child;
+    }
+    else if (!old_keys.contains(child->key)) {
+      new_items << child;
+    }
+  }
+  if (new_items.isEmpty()) return;
+
+  // Dividers first, they change the sort text of the items.
+  if (child_level == 0 && show_dividers_) {
+    for (CollectionItem *item : new_items) {
+      if (!IsCompilationArtistNode(item)) CreateDivider(child_type, true, item);
+    }
+  }
+
+  beginInsertRows(ItemToIndex(parent), parent->children.count(), parent->children.count() + new_items.count() - 1);
+  for (CollectionItem *item : new_items) {
+    staging.children.removeOne(item);
+    if (item == staging.compilation_artist_node_) {
+      staging.compilation_artist_node_ = nullptr;
+      parent->compilation_artist_node_ = item;
+    }
+    item->parent = parent;
+    item->model = parent->model;
+    item->row = parent->children.count();
+    parent->children << item;
+
+    if (child_type == GroupBy_None)
+      song_nodes_[item->metadata.id()] = item;
+    else if (!IsCompilationArtistNode(item))
+      container_nodes_[child_level][item->key] = item;
+  }
+  endInsertRows();
+
+}
+
+void CollectionModel::ForgetItem(CollectionItem *item) {
+
+  for (CollectionItem *child : item->children) {
+    ForgetItem(child);
+  }
+
+  if (item->type == CollectionItem::Type_Song) {
+    if (song_nodes_.value(item->metadata.id()) == item) song_nodes_.remove(item->metadata.id());
+  }
+  else if (item->type == CollectionItem::Type_Container && item->container_level >= 0 && item->container_level < 3 && !IsCompilationArtistNode(item)) {
+    if (container_nodes_[item->container_level].value(item->key) == item) container_nodes_[item->container_level].remove(item->key);
+  }
+
+  for (QMap<quint64, ItemAndCacheKey>::iterator it = pending_art_.begin(); it != pending_art_.end();) {
+    if (it.value().first == item) it = pending_art_.erase(it);
+    else ++it;
+  }
+
+  index_song_loads_.remove(item);
+
+}
+
+void CollectionModel::DeleteEmptyDividers() {
+
+  QSet<QString> divider_keys;
+  for (CollectionItem *node : root_->children) {
+    if (node->type != CollectionItem::Type_Divider) divider_keys << DividerKey(tree_group_by_[0], node);
+  }
+
+  for (const QString &divider_key : divider_nodes_.keys()) {
+    if (divider_keys.contains(divider_key)) continue;
+
+    int row = divider_nodes_[divider_key]->row;
+    beginRemoveRows(ItemToIndex(root_), row, row);
+    root_->Delete(row);
+    endRemoveRows();
+    divider_nodes_.remove(divider_key);
+  }
+
+}
+
 void CollectionModel::BeginReset() {
 
   beginResetModel();
@@ -811,6 +1500,10 @@ void CollectionModel::BeginReset() {
   container_nodes_[2].clear();
   divider_nodes_.clear();
   pending_art_.clear();
+  index_song_loads_.clear();
+  tree_group_by_ = group_by_;
+  ++update_serial_;
+  update_pending_ = false;
 
   root_ = new CollectionItem(this);
   root_->compilation_artist_node_ = nullptr;
@@ -1113,6 +1806,7 @@ CollectionItem *CollectionModel::ItemFromSong(GroupBy type, bool signal, bool cr
       int year = qMax(0, s.year());
       item->metadata.set_year(year);
       item->metadata.set_album(s.album());
+      item->metadata.set_grouping(s.grouping());
       item->key = PrettyYearAlbum(year, s.album());
       item->sort_text = SortTextForNumber(year) + s.grouping() + s.album();
       break;
@@ -1124,6 +1818,7 @@ CollectionItem *CollectionModel::ItemFromSong(GroupBy type, bool signal, bool cr
       item->metadata.set_year(year);
       item->metadata.set_originalyear(originalyear);
       item->metadata.set_album(s.album());
+      item->metadata.set_grouping(s.grouping());
       item->key = PrettyYearAlbum(effective_originalyear, s.album());
       item->sort_text = SortTextForNumber(effective_originalyear) + s.grouping() + s.album();
       break;
@@ -1140,12 +1835,18 @@ CollectionItem *CollectionModel::ItemFromSong(GroupBy type, bool signal, bool cr
       item->sort_text = SortTextForNumber(year) + " ";
       break;
     }
-  case GroupBy_Composer:                            item->key = s.composer();
-  case GroupBy_Performer:                           item->key = s.performer();
-  case GroupBy_Grouping:                            item->key = s.grouping();
-  case GroupBy_Genre: if (item->key.isNull())       item->key = s.genre();
-  case GroupBy_Album: if (item->key.isNull())       item->key = s.album();
-  case GroupBy_AlbumArtist: if (item->key.isNull()) item->key = s.effective_albumartist();
+    case GroupBy_Composer:
+    case GroupBy_Performer:
+    case GroupBy_Grouping:
+    case GroupBy_Genre:
+    case GroupBy_Album:
+    case GroupBy_AlbumArtist:
+      if (type == GroupBy_Composer) item->key = s.composer();
+      else if (type == GroupBy_Performer) item->key = s.performer();
+      else if (type == GroupBy_Grouping) item->key = s.grouping();
+      else if (type == GroupBy_Genre) item->key = s.genre();
+      else if (type == GroupBy_Album) item->key = s.album();
+      else item->key = s.effective_albumartist();
       item->display_text = TextOrUnknown(item->key);
       item->sort_text = SortTextForArtist(item->key);
       break;
@@ -1212,28 +1913,34 @@ CollectionItem *CollectionModel::ItemFromSong(GroupBy type, bool signal, bool cr
 
 void CollectionModel::FinishItem(GroupBy type, bool signal, bool create_divider, CollectionItem *parent, CollectionItem *item) {
 
+  Q_UNUSED(parent);
+
   if (type == GroupBy_None) item->lazy_loaded = true;
 
   if (signal) endInsertRows();
 
-  // Create the divider entry if we're supposed to
-  if (create_divider && show_dividers_) {
-    QString divider_key = DividerKey(type, item);
-    item->sort_text.prepend(divider_key);
+  // Create the divider entry if we're supposed to, dividers are always top-level.
+  if (create_divider && show_dividers_) CreateDivider(type, signal, item);
 
-    if (!divider_key.isEmpty() && !divider_nodes_.contains(divider_key)) {
-      if (signal)
-        beginInsertRows(ItemToIndex(parent), parent->children.count(), parent->children.count());
+}
 
-      CollectionItem *divider = new CollectionItem(CollectionItem::Type_Divider, root_);
-      divider->key = divider_key;
-      divider->display_text = DividerDisplayText(type, divider_key);
-      divider->lazy_loaded = true;
+void CollectionModel::CreateDivider(GroupBy type, bool signal, CollectionItem *item) {
 
-      divider_nodes_[divider_key] = divider;
+  QString divider_key = DividerKey(type, item);
+  item->sort_text.prepend(divider_key);
 
-      if (signal) endInsertRows();
-    }
+  if (!divider_key.isEmpty() && !divider_nodes_.contains(divider_key)) {
+    if (signal)
+      beginInsertRows(ItemToIndex(root_), root_->children.count(), root_->children.count());
+
+    CollectionItem *divider = new CollectionItem(CollectionItem::Type_Divider, root_);
+    divider->key = divider_key;
+    divider->display_text = DividerDisplayText(type, divider_key);
+    divider->lazy_loaded = true;
+
+    divider_nodes_[divider_key] = divider;
+
+    if (signal) endInsertRows();
   }
 
 }
@@ -1366,7 +2073,7 @@ void CollectionModel::GetChildSongs(CollectionItem *item, QList<QUrl> *urls, Son
 
   switch (item->type) {
     case CollectionItem::Type_Container: {
-      const_cast<CollectionModel*>(this)->LazyPopulate(item);
+      const_cast<CollectionModel*>(this)->LazyPopulate(item, true);
 
       QList<CollectionItem*> children = item->children;
       std::sort(children.begin(), children.end(), std::bind(&CollectionModel::CompareItems, this, _1, _2));
@@ -1408,19 +2115,41 @@ SongList CollectionModel::GetChildSongs(const QModelIndex &index) const {
 }
 
 void CollectionModel::SetFilterAge(int age) {
+
+  // A shorter age can only match fewer songs
+  const int old_age = query_options_.max_age();
+  const bool narrowing = age != -1 && (old_age == -1 || age <= old_age);
+
   query_options_.set_max_age(age);
-  ResetAsync();
+  index_rows_valid_ = false;
+  UpdateAsync(narrowing);
+
 }
 
 void CollectionModel::SetFilterText(const QString &text) {
+
+  // Typing more of a word or another word can only match fewer songs, so only the songs that matched before need to be looked at again.
+  // A new colon could turn a word into a column name, which is not a refinement.
+  const QString old_filter = query_options_.filter();
+  const bool refine = text.startsWith(old_filter) && !text.mid(old_filter.length()).contains(':') && query_options_.query_mode() == QueryOptions::QueryMode_All;
+
   query_options_.set_filter(text);
-  ResetAsync();
+
+  if (IndexReady() && index_rows_valid_ && refine) {
+    index_rows_ = index_->Filter(query_options_, index_rows_);
+  }
+  else {
+    index_rows_valid_ = false;
+  }
+
+  UpdateAsync(refine);
 
 }
 
 void CollectionModel::SetFilterQueryMode(QueryOptions::QueryMode query_mode) {
   query_options_.set_query_mode(query_mode);
-  ResetAsync();
+  index_rows_valid_ = false;
+  UpdateAsync();
 
 }
 
@@ -1437,7 +2166,7 @@ void CollectionModel::SetGroupBy(const Grouping &g) {
 
   group_by_ = g;
 
-  ResetAsync();
+  UpdateAsync();
   emit GroupingChanged(g);
 
 }
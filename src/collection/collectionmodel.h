@@ -32,10 +32,12 @@
 #include <QDataStream>
 #include <QList>
 #include <QMap>
+#include <QHash>
 #include <QMetaType>
 #include <QMimeData>
 #include <QPair>
 #include <QSet>
+#include <QVector>
 #include <QVariant>
 #include <QString>
 #include <QStringList>
@@ -56,6 +58,7 @@
 class Application;
 class CollectionBackend;
 class CollectionDirectoryModel;
+class CollectionIndex;
 class CollectionItem;
 
 class CollectionModel : public SimpleTreeModel<CollectionItem> {
@@ -124,9 +127,30 @@ class CollectionModel : public SimpleTreeModel<CollectionItem> {
     QueryResult() : create_va(false) {}
 
     SqlRowList rows;
+    // Used instead of rows when the query was answered by the in-memory index.
+    // Song nodes are only given by id, the songs are read from the database when the nodes are created.
+    SongList songs;
+    QList<int> song_ids;
     bool create_va;
   };
 
+  // The containers from the top level down to an item.
+  // Items in a path may have been deleted since it was made, so they are only compared with the children that are still in the tree.
+  typedef QList<CollectionItem*> ItemPath;
+
+  // A query for the children of a container, built on this thread so it can be run in a background thread without touching the tree.
+  struct ChildrenQuery {
+    ChildrenQuery() : check_compilations(false), exclude_compilations(false) {}
+
+    ItemPath path;
+    QStringList keys;
+    CollectionQuery query;
+    bool check_compilations;
+    bool exclude_compilations;
+    QueryResult result;
+  };
+  typedef QList<ChildrenQuery> ChildrenQueryList;
+
   CollectionBackend *backend() const { return backend_; }
   CollectionDirectoryModel *directory_model() const { return dir_model_; }
 
@@ -157,6 +181,10 @@ class CollectionModel : public SimpleTreeModel<CollectionItem> {
   // Whether or not to show letters heading in the collection view
   void set_show_dividers(bool show_dividers);
 
+  // Whether or not to keep a copy of the collection in memory for grouping and filtering without querying the database
+  void set_use_index(bool use_index);
+  bool use_index() const { return use_index_; }
+
   // Save the current grouping
   void SaveGrouping(QString name);
 
@@ -188,7 +216,8 @@ signals:
   void ResetAsync();
 
  protected:
-  void LazyPopulate(CollectionItem *item) { LazyPopulate(item, true); }
+  // Called when a view expands an item.  Songs from the index are read from the database in a background thread, the item is loaded when they're in.
+  void LazyPopulate(CollectionItem *item);
   void LazyPopulate(CollectionItem *item, bool signal);
 
  private slots:
@@ -202,6 +231,12 @@ signals:
 
   // Called after ResetAsync
   void ResetAsyncQueryFinished(QFuture<CollectionModel::QueryResult> future);
+  // Called after UpdateAsync
+  void UpdateAsyncQueryFinished(QFuture<CollectionModel::ChildrenQueryList> future, int serial);
+
+  void LoadIndex();
+  void IndexLoaded(QFuture<CollectionIndex*> future);
+  void IndexSongsLoaded(QFuture<SongList> future, CollectionItem *parent, int load_id, int serial);
 
   void AlbumArtLoaded(quint64 id, const QImage &image);
 
@@ -209,12 +244,43 @@ signals:
   // Provides some optimisations for loading the list of items in the root.
   // This gets called a lot when filtering the playlist, so it's nice to be able to do it in a background thread.
   QueryResult RunQuery(CollectionItem *parent);
+  ChildrenQuery PrepareChildrenQuery(CollectionItem *parent);
+  QueryResult RunChildrenQuery(const ChildrenQuery &query);
+  ChildrenQueryList RunChildrenQueries(ChildrenQueryList queries);
   void PostQuery(CollectionItem *parent, const QueryResult &result, bool signal);
+  void ResetFinished(const QueryResult &result);
+
+  // Same as RunQuery, but groups and filters the in-memory index instead of querying the database.
+  bool IndexReady() const;
+  QueryResult RunIndexQuery(CollectionItem *parent);
+  const QVector<int> &IndexRows();
+  SongList GetIndexSongs(const QList<int> &ids);
+  // Loads the songs of an index query result from the database, so it can be done in a background thread.
+  QueryResult LoadIndexSongs(QueryResult result);
+  // Reads the songs in a background thread and adds them to parent when they're in.
+  void LoadIndexSongsAsync(CollectionItem *parent, const QList<int> &ids);
 
   bool HasCompilations(const CollectionQuery &query);
 
   void BeginReset();
 
+  // Brings the populated part of the tree in line with the current filter and grouping, only inserting and removing the rows that changed.
+  // Expanded items that still match are kept, so views don't lose their state.
+  // When narrowing is set the new filter can only match songs the old one matched, so songs already in the tree are tested without a query.
+  void UpdateAsync(bool narrowing = false);
+  // Adds the paths of parent and the loaded containers below it, parents before their children.
+  void GetLoadedPaths(CollectionItem *parent, const ItemPath &path, QList<ItemPath> *paths) const;
+  // Returns the container at the end of path if it's still in the tree and loaded.
+  // The keys are checked too when they're given.
+  CollectionItem *FindLoadedContainer(const ItemPath &path, const QStringList &keys = QStringList()) const;
+  void UpdateChildren(CollectionItem *parent, const QueryResult &result);
+  // Removes the songs that don't match the filter any more, and the loaded containers that are left empty.
+  // The paths of the containers with children that aren't loaded are added to unloaded_paths, parents before their children.
+  void PruneChildren(CollectionItem *parent, const ItemPath &path, QList<ItemPath> *unloaded_paths);
+  // Removes an item that's about to be deleted and everything below it from the lookup maps.
+  void ForgetItem(CollectionItem *item);
+  void DeleteEmptyDividers();
+
   // Functions for working with queries and creating items.
   // When the model is reset or when a node is lazy-loaded the Collection constructs a database query to populate the items.
   // Filters are added for each parent item, restricting the songs returned to a particular album or artist for example.
@@ -231,6 +297,7 @@ signals:
   // Helpers for ItemFromQuery and ItemFromSong
   CollectionItem *InitItem(GroupBy type, bool signal, CollectionItem *parent, int container_level);
   void FinishItem(GroupBy type, bool signal, bool create_divider, CollectionItem *parent, CollectionItem *item);
+  void CreateDivider(GroupBy type, bool signal, CollectionItem *item);
 
   QString DividerKey(GroupBy type, CollectionItem *item) const;
   QString DividerDisplayText(GroupBy type, const QString &key) const;
@@ -253,6 +320,12 @@ signals:
 
   QueryOptions query_options_;
   Grouping group_by_;
+  // The grouping the items in the tree were created with, group_by_ is ahead of it until an update finishes.
+  Grouping tree_group_by_;
+  // Counts the updates, so the results of an update that was overtaken by another one or by a reset are dropped.
+  int update_serial_;
+  // Set while the queries of an update are running
+  bool update_pending_;
 
   // Keyed on database ID
   QMap<int, CollectionItem*> song_nodes_;
@@ -277,6 +350,18 @@ signals:
   bool use_pretty_covers_;
   bool show_dividers_;
 
+  bool use_index_;
+  bool index_loading_;
+  CollectionIndex *index_;
+  // Changes from the backend while the index is loading, applied when it's done.  True for discovered songs, false for deleted songs.
+  QList<QPair<bool, SongList>> index_pending_;
+  // The index rows matching query_options_, kept while the filter text is only being refined so narrowing the search never goes back to all songs.
+  QVector<int> index_rows_;
+  bool index_rows_valid_;
+  // The items whose songs are being read by LoadIndexSongsAsync, with the ID of the load.
+  QHash<CollectionItem*, int> index_song_loads_;
+  int index_song_load_id_;
+
   AlbumCoverLoaderOptions cover_loader_options_;
 
   typedef QPair<CollectionItem*, QString> ItemAndCacheKey;
@@ -22,6 +22,8 @@
 
 #include <QtGlobal>
 #include <QDateTime>
+#include <QList>
+#include <QByteArray>
 #include <QVariant>
 #include <QString>
 #include <QStringList>
@@ -33,9 +35,86 @@
 #include "collectionquery.h"
 #include "core/logging.h"
 #include "core/song.h"
+#include "core/utf8tokenizer.h"
+
+namespace {
+
+// Whether any of the words in text start with prefix.
+bool HasWordWithPrefix(const QString &text, const QByteArray &prefix) {
+
+  const QByteArray utf8 = text.toUtf8();
+  Utf8Tokenizer tokenizer(utf8.constData(), utf8.size());
+  const char *word = nullptr;
+  int word_bytes = 0;
+  int start_offset = 0;
+  int end_offset = 0;
+  while (tokenizer.Next(&word, &word_bytes, &start_offset, &end_offset)) {
+    if (word_bytes >= prefix.size() && qstrncmp(word, prefix.constData(), prefix.size()) == 0) return true;
+  }
+  return false;
+
+}
+
+// The text of a song in a column of Song::kFtsColumns.
+QString FtsColumnText(const Song &song, const int column) {
+
+  switch (column) {
+    case 0: return song.title();
+    case 1: return song.album();
+    case 2: return song.artist();
+    case 3: return song.albumartist();
+    case 4: return song.composer();
+    case 5: return song.performer();
+    case 6: return song.grouping();
+    case 7: return song.genre();
+    case 8: return song.comment();
+  }
+  return QString();
+
+}
+
+}  // namespace
 
 QueryOptions::QueryOptions() : max_age_(-1), query_mode_(QueryMode_All) {}
 
+QList<QueryOptions::FilterTerm> QueryOptions::FilterTerms() const {
+
+  QList<FilterTerm> terms;
+  QStringList tokens(filter_.split(QRegExp("\\s+"), QString::SkipEmptyParts));
+  for (QString token : tokens) {
+    token.remove('(');
+    token.remove(')');
+    token.remove('"');
+    token.replace('-', ' ');
+
+    int column = -1;
+    if (token.contains(':')) {
+      const int column_index = Song::kFtsColumns.indexOf(QRegExp("fts" + QRegExp::escape(token.section(':', 0, 0)), Qt::CaseInsensitive));
+      if (column_index != -1) {
+        column = column_index;
+        token = token.section(':', 1, -1);
+      }
+      token.replace(':', ' ');
+    }
+
+    const QByteArray utf8 = token.toUtf8();
+    Utf8Tokenizer tokenizer(utf8.constData(), utf8.size());
+    const char *word = nullptr;
+    int word_bytes = 0;
+    int start_offset = 0;
+    int end_offset = 0;
+    while (tokenizer.Next(&word, &word_bytes, &start_offset, &end_offset)) {
+      FilterTerm term;
+      term.prefix = QByteArray(word, word_bytes);
+      term.column = column;
+      terms << term;
+    }
+  }
+
+  return terms;
+
+}
+
 CollectionQuery::CollectionQuery(const QueryOptions &options)
     : include_unavailable_(false), join_with_fts_(false), limit_(-1) {
 
@@ -201,8 +280,15 @@ bool QueryOptions::Matches(const Song &song) const {
     if (song.ctime() <= cutoff) return false;
   }
 
-  if (!filter_.isNull()) {
-    return song.artist().contains(filter_, Qt::CaseInsensitive) || song.album().contains(filter_, Qt::CaseInsensitive) || song.title().contains(filter_, Qt::CaseInsensitive);
+  if (query_mode_ == QueryMode_Untagged && !song.artist().isEmpty() && !song.album().isEmpty() && !song.title().isEmpty()) return false;
+
+  // Every term has to be the start of a word in one of the columns, like the FTS MATCH.
+  for (const FilterTerm &term : FilterTerms()) {
+    bool matched = false;
+    for (int column = 0; column < Song::kFtsColumns.count() && !matched; ++column) {
+      if (term.column == -1 || term.column == column) matched = HasWordWithPrefix(FtsColumnText(song, column), term.prefix);
+    }
+    if (!matched) return false;
   }
 
   return true;
@@ -26,6 +26,8 @@
 #include <stdbool.h>
 
 #include <QMetaType>
+#include <QList>
+#include <QByteArray>
 #include <QVariant>
 #include <QString>
 #include <QStringList>
@@ -48,10 +50,23 @@ struct QueryOptions {
     QueryMode_Untagged
   };
 
+  // A word of the filter text, folded the same way as the words in the full text search index.
+  struct FilterTerm {
+    FilterTerm() : column(-1) {}
+    // Matches words starting with it
+    QByteArray prefix;
+    // The index in Song::kFtsColumns when the term has a "column:" prefix, otherwise -1 for all columns.
+    int column;
+  };
+
   QueryOptions();
 
+  // Tests a song the same way the database query does, used to filter songs that are already in memory.
   bool Matches(const Song &song) const;
 
+  // Mirrors the munging CollectionQuery does for FTS: every token is a prefix, "column:token" restricts the token to one column and other colons separate words.
+  QList<FilterTerm> FilterTerms() const;
+
   QString filter() const { return filter_; }
   void set_filter(const QString &filter) {
     this->filter_ = filter;
@@ -59,6 +59,7 @@
 #include "core/application.h"
 #include "core/iconloader.h"
 #include "core/mimedata.h"
+#include "core/song.h"
 #include "core/utilities.h"
 #include "collectionbackend.h"
 #include "collectiondirectorymodel.h"
@@ -218,10 +219,12 @@ void CollectionView::ReloadSettings() {
 
   settings.beginGroup(CollectionSettingsPage::kSettingsGroup);
   SetAutoOpen(settings.value("auto_open", false).toBool());
+  Song::SetCompactStorage(settings.value("compact_songs", false).toBool());
 
   if (app_) {
     app_->collection_model()->set_pretty_covers(settings.value("pretty_covers", true).toBool());
     app_->collection_model()->set_show_dividers(settings.value("show_dividers", true).toBool());
+    app_->collection_model()->set_use_index(settings.value("in_memory_index", false).toBool());
   }
 
   settings.endGroup();
@@ -31,7 +31,12 @@
 #include <QHash>
 #include <QMap>
 #include <QList>
+#include <QQueue>
 #include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QtConcurrentRun>
 #include <QTimer>
 #include <QVariant>
 #include <QString>
@@ -60,6 +65,8 @@
 namespace {
 static const char *kNoMediaFile = ".nomedia";
 static const char *kNoMusicFile = ".nomusic";
+// Files read from the tagreader at a time, so a scan can be stopped between them
+static const int kReadFilesChunkSize = 256;
 }
 
 QStringList CollectionWatcher::sValidImages;
@@ -73,6 +80,7 @@ CollectionWatcher::CollectionWatcher(Song::Source source, QObject *parent)
       stop_requested_(false),
       scan_on_startup_(true),
       monitor_(true),
+      scan_threads_(1),
       rescan_timer_(new QTimer(this)),
       rescan_paused_(false),
       total_watches_(0),
@@ -88,6 +96,7 @@ CollectionWatcher::CollectionWatcher(Song::Source source, QObject *parent)
   ReloadSettings();
 
   connect(rescan_timer_, SIGNAL(timeout()), SLOT(RescanPathsNow()));
+  connect(fs_watcher_, SIGNAL(EventsLost()), SLOT(FileSystemEventsLost()));
 }
 
 CollectionWatcher::ScanTransaction::ScanTransaction(CollectionWatcher *watcher, int dir, bool incremental, bool ignores_mtime)
@@ -155,19 +164,31 @@ void CollectionWatcher::ScanTransaction::AddToProgressMax(int n) {
 
 }
 
-SongList CollectionWatcher::ScanTransaction::FindSongsInSubdirectory(const QString &path) {
+void CollectionWatcher::ScanTransaction::PreloadCaches() {
 
-  if (cached_songs_dirty_) {
-    cached_songs_ = watcher_->backend_->FindSongsInDirectory(dir_);
-    cached_songs_dirty_ = false;
-  }
+  if (cached_songs_dirty_) LoadCachedSongs();
+
+  if (known_subdirs_dirty_)
+    SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
 
-  // TODO: Make this faster
-  SongList ret;
-  for (const Song &song : cached_songs_) {
-    if (song.url().toLocalFile().section('/', 0, -2) == path) ret << song;
+}
+
+void CollectionWatcher::ScanTransaction::LoadCachedSongs() {
+
+  // Index the songs by the subdirectory they're in, so each lookup doesn't have to go through every song in the directory.
+  cached_songs_.clear();
+  for (const Song &song : watcher_->backend_->FindSongsInDirectory(dir_)) {
+    cached_songs_[song.url().toLocalFile().section('/', 0, -2)] << song;
   }
-  return ret;
+  cached_songs_dirty_ = false;
+
+}
+
+SongList CollectionWatcher::ScanTransaction::FindSongsInSubdirectory(const QString &path) {
+
+  if (cached_songs_dirty_) LoadCachedSongs();
+
+  return cached_songs_.value(path);
 
 }
 
@@ -176,6 +197,14 @@ void CollectionWatcher::ScanTransaction::SetKnownSubdirs(const SubdirectoryList
   known_subdirs_ = subdirs;
   known_subdirs_dirty_ = false;
 
+  seen_subdirs_.clear();
+  immediate_subdirs_.clear();
+  for (const Subdirectory &subdir : known_subdirs_) {
+    if (subdir.mtime == 0) continue;
+    seen_subdirs_.insert(subdir.path);
+    immediate_subdirs_[subdir.path.left(subdir.path.lastIndexOf(QDir::separator()))] << subdir;
+  }
+
 }
 
 bool CollectionWatcher::ScanTransaction::HasSeenSubdir(const QString &path) {
@@ -183,10 +212,7 @@ bool CollectionWatcher::ScanTransaction::HasSeenSubdir(const QString &path) {
   if (known_subdirs_dirty_)
     SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
 
-  for (const Subdirectory &subdir : known_subdirs_) {
-    if (subdir.path == path && subdir.mtime != 0) return true;
-  }
-  return false;
+  return seen_subdirs_.contains(path);
 
 }
 
@@ -195,14 +221,7 @@ SubdirectoryList CollectionWatcher::ScanTransaction::GetImmediateSubdirs(const Q
   if (known_subdirs_dirty_)
     SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
 
-  SubdirectoryList ret;
-  for (const Subdirectory &subdir : known_subdirs_) {
-    if (subdir.path.left(subdir.path.lastIndexOf(QDir::separator())) == path && subdir.mtime != 0) {
-      ret << subdir;
-    }
-  }
-
-  return ret;
+  return immediate_subdirs_.value(path);
 
 }
 
@@ -225,17 +244,33 @@ void CollectionWatcher::AddDirectory(const Directory &dir, const SubdirectoryLis
     ScanSubdirectory(dir.path, Subdirectory(), &transaction);
   }
   else {
-    // We can do an incremental scan - looking at the mtimes of each subdirectory and only rescan if the directory has changed.
-    ScanTransaction transaction(this, dir.id, true);
-    transaction.SetKnownSubdirs(subdirs);
-    transaction.AddToProgressMax(subdirs.count());
-    for (const Subdirectory &subdir : subdirs) {
-      if (stop_requested_) return;
+    // Subdirectories that changed while we were running, but weren't rescanned before we were closed.
+    // Files rewritten in place don't change the mtime of their directory, so these are always rescanned, even if the startup scan is disabled.
+    const SubdirectoryList journaled_subdirs = backend_->JournaledSubdirsInDirectory(dir.id);
+    QSet<QString> journaled_paths;
+    for (const Subdirectory &subdir : journaled_subdirs) {
+      journaled_paths << subdir.path;
+    }
+
+    {
+      // We can do an incremental scan - looking at the mtimes of each subdirectory and only rescan if the directory has changed.
+      ScanTransaction transaction(this, dir.id, true);
+      transaction.SetKnownSubdirs(subdirs);
+      ScanRequestList requests;
+      for (const Subdirectory &subdir : subdirs) {
+        if (stop_requested_) return;
 
-      if (scan_on_startup_) ScanSubdirectory(subdir.path, subdir, &transaction);
+        const bool journaled = journaled_paths.contains(subdir.path);
+        if (scan_on_startup_ || journaled) requests << ScanRequest(subdir.path, subdir, journaled);
 
-      if (monitor_) AddWatch(dir, subdir.path);
+        if (monitor_) AddWatch(dir, subdir.path);
+      }
+      transaction.AddToProgressMax(requests.count());
+      ScanSubdirectories(requests, &transaction);
+      if (stop_requested_) return;
     }
+
+    emit SubdirsRescanned(journaled_subdirs);
   }
 
   emit CompilationsNeedUpdating();
@@ -244,50 +279,124 @@ void CollectionWatcher::AddDirectory(const Directory &dir, const SubdirectoryLis
 
 void CollectionWatcher::ScanSubdirectory(const QString &path, const Subdirectory &subdir, ScanTransaction *t, bool force_noincremental) {
 
+  ScanSubdirectories(ScanRequestList() << ScanRequest(path, subdir, force_noincremental), t);
+
+}
+
+void CollectionWatcher::ScanSubdirectories(const ScanRequestList &requests, ScanTransaction *t) {
+
+  if (scan_threads_ > 1) {
+    ScanSubdirectoriesParallel(requests, t);
+    return;
+  }
+
+  for (const ScanRequest &request : requests) {
+    if (stop_requested_) return;
+
+    ScanResult result = ScanSubdirectoryOnly(request.path, request.subdir, t, request.force_noincremental);
+    if (stop_requested_) return;
+    MergeScanResult(result, t);
+
+    // Recurse into the subdirs that we found
+    ScanSubdirectories(result.children, t);
+  }
+
+}
+
+void CollectionWatcher::ScanSubdirectoriesParallel(const ScanRequestList &requests, ScanTransaction *t) {
+
+  if (requests.isEmpty()) return;
+
+  // Fill the caches here, so the scanner threads never modify the transaction.
+  t->PreloadCaches();
+
+  QMutex results_mutex;
+  QWaitCondition results_ready;
+  QQueue<ScanResult> results;
+  int pending = 0;
+
+  // The pool hands queued subdirectories to whichever scanner thread becomes idle first, so one deep subtree doesn't hold up the others.
+  auto scan = [this, t, &results_mutex, &results_ready, &results, &pending](const ScanRequest &request) {
+    ++pending;
+    QtConcurrent::run(&scan_thread_pool_, [this, t, request, &results_mutex, &results_ready, &results]() {
+      ScanResult result = ScanSubdirectoryOnly(request.path, request.subdir, t, request.force_noincremental);
+      QMutexLocker l(&results_mutex);
+      results.enqueue(result);
+      results_ready.wakeOne();
+    });
+  };
+
+  for (const ScanRequest &request : requests) {
+    scan(request);
+  }
+
+  // Merge the results on this thread as they come in.
+  // Even if we're stopping we have to wait for the running scans, since they reference the transaction and the queue.
+  QMutexLocker l(&results_mutex);
+  while (pending > 0) {
+    while (results.isEmpty()) results_ready.wait(&results_mutex);
+    ScanResult result = results.dequeue();
+    --pending;
+    l.unlock();
+
+    if (!stop_requested_) {
+      MergeScanResult(result, t);
+      for (const ScanRequest &child : result.children) {
+        scan(child);
+      }
+    }
+
+    l.relock();
+  }
+
+}
+
+CollectionWatcher::ScanResult CollectionWatcher::ScanSubdirectoryOnly(const QString &path, const Subdirectory &subdir, ScanTransaction *t, bool force_noincremental) {
+
+  ScanResult r;
+  r.dir = t->dir();
+
   QFileInfo path_info(path);
   QDir path_dir(path);
 
+  // Check the mtime first, for an incremental scan of an unchanged collection that's the only syscall we need per subdirectory.
+  if (!t->ignores_mtime() && !force_noincremental && t->is_incremental() && subdir.mtime == path_info.lastModified().toTime_t()) {
+    // The directory hasn't changed since last time
+    return r;
+  }
+
   // Do not scan symlinked dirs that are already in collection
   if (path_info.isSymLink()) {
     QString real_path = path_info.symLinkTarget();
     for (const Directory &dir : watched_dirs_) {
       if (real_path.startsWith(dir.path)) {
-        t->AddToProgress(1);
-        return;
+        return r;
       }
     }
   }
 
   // Do not scan directories containing a .nomedia or .nomusic file
   if (path_dir.exists(kNoMediaFile) || path_dir.exists(kNoMusicFile)) {
-    t->AddToProgress(1);
-    return;
-  }
-
-  if (!t->ignores_mtime() && !force_noincremental && t->is_incremental() && subdir.mtime == path_info.lastModified().toTime_t()) {
-    // The directory hasn't changed since last time
-    t->AddToProgress(1);
-    return;
+    return r;
   }
 
   QMap<QString, QStringList> album_art;
   QStringList files_on_disk;
-  SubdirectoryList my_new_subdirs;
+  QSet<QString> files_on_disk_set;
 
   // If a directory is moved then only its parent gets a changed notification, so we need to look and see if any of our children don't exist any more.
   // If one has been removed, "rescan" it to get the deleted songs
   SubdirectoryList previous_subdirs = t->GetImmediateSubdirs(path);
-  for (const Subdirectory &subdir : previous_subdirs) {
-    if (!QFile::exists(subdir.path) && subdir.path != path) {
-      t->AddToProgressMax(1);
-      ScanSubdirectory(subdir.path, subdir, t, true);
+  for (const Subdirectory &prev_subdir : previous_subdirs) {
+    if (!QFile::exists(prev_subdir.path) && prev_subdir.path != path) {
+      r.children << ScanRequest(prev_subdir.path, prev_subdir, true);
     }
   }
 
   // First we "quickly" get a list of the files in the directory that we think might be music.  While we're here, we also look for new subdirectories and possible album artwork.
   QDirIterator it(path, QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot);
   while (it.hasNext()) {
-    if (stop_requested_) return;
+    if (stop_requested_) return r;
 
     QString child(it.next());
     QFileInfo child_info(child);
@@ -299,7 +408,7 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const Subdirectory
         new_subdir.directory_id = -1;
         new_subdir.path = child;
         new_subdir.mtime = child_info.lastModified().toTime_t();
-        my_new_subdirs << new_subdir;
+        r.children << ScanRequest(child, new_subdir, true);
       }
     }
     else {
@@ -308,27 +417,48 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const Subdirectory
 
       if (sValidImages.contains(ext_part))
         album_art[dir_part] << child;
-      else if (!child_info.isHidden())
+      else if (!child_info.isHidden()) {
         files_on_disk << child;
+        files_on_disk_set.insert(child);
+      }
     }
   }
 
-  if (stop_requested_) return;
+  if (stop_requested_) return r;
 
-  // Ask the database for a list of files in this directory
+  // Ask the database for a list of files in this directory, and index them by path.
+  // Songs from a cue sheet share the same file, the first section is the one that's matched against the file.
   SongList songs_in_db = t->FindSongsInSubdirectory(path);
+  QHash<QString, Song> songs_in_db_by_path;
+  songs_in_db_by_path.reserve(songs_in_db.count());
+  for (const Song &song : songs_in_db) {
+    const QString song_path = song.url().toLocalFile();
+    if (!songs_in_db_by_path.contains(song_path)) songs_in_db_by_path.insert(song_path, song);
+  }
 
   QSet<QString> cues_processed;
 
+  // The tags of new and changed files without a cue sheet are read in one batch after we've looked at all the files.
+  // This sends a few big requests instead of one per file, and keeps all the tagreader workers busy.
+  struct ChangedFile {
+    QString file;
+    Song matching_song;
+    QString image;
+    bool cue_deleted;
+  };
+  QList<ChangedFile> changed_files;
+  QStringList new_files;
+
   // Now compare the list from the database with the list of files on disk
   for (const QString &file : files_on_disk) {
-    if (stop_requested_) return;
+    if (stop_requested_) return r;
 
     // associated cue
     QString matching_cue = NoExtensionPart(file) + ".cue";
 
-    Song matching_song;
-    if (FindSongByPath(songs_in_db, file, &matching_song)) {
+    QHash<QString, Song>::const_iterator matching_it = songs_in_db_by_path.constFind(file);
+    if (matching_it != songs_in_db_by_path.constEnd()) {
+      const Song &matching_song = *matching_it;
       uint matching_cue_mtime = GetMtimeForCue(matching_cue);
 
       // The song is in the database and still on disk.
@@ -337,7 +467,7 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const Subdirectory
 
       if (!file_info.exists()) {
         // Partially fixes race condition - if file was removed between being added to the list and now.
-        files_on_disk.removeAll(file);
+        files_on_disk_set.remove(file);
         continue;
       }
 
@@ -363,20 +493,25 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const Subdirectory
 
         // if cue associated...
         if (!cue_deleted && (matching_song.has_cue() || cue_added)) {
-          UpdateCueAssociatedSongs(file, path, matching_cue, image, t);
+          UpdateCueAssociatedSongs(file, path, matching_cue, image, &r);
           // if no cue or it's about to lose it...
         }
         else {
-          UpdateNonCueAssociatedSong(file, matching_song, image, cue_deleted, t);
+          changed_files << ChangedFile{file, matching_song, image, cue_deleted};
         }
       }
 
       // nothing has changed - mark the song available without re-scanning
-      if (matching_song.is_unavailable()) t->readded_songs << matching_song;
+      if (matching_song.is_unavailable()) r.readded_songs << matching_song;
 
     }
     else {
       // The song is on disk but not in the DB
+      if (GetMtimeForCue(matching_cue) == 0) {
+        new_files << file;
+        continue;
+      }
+
       SongList song_list = ScanNewFile(file, path, matching_cue, &cues_processed);
 
       if (song_list.isEmpty()) {
@@ -389,47 +524,81 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const Subdirectory
 
       for (Song song : song_list) {
         song.set_source(source_);
-        song.set_directory_id(t->dir());
+        song.set_directory_id(r.dir);
         if (song.art_automatic().isEmpty()) song.set_art_automatic(image);
-        t->new_songs << song;
+        r.new_songs << song;
       }
     }
   }
 
+  QStringList files_to_read(new_files);
+  for (const ChangedFile &changed_file : changed_files) {
+    files_to_read << changed_file.file;
+  }
+  SongList songs_on_disk;
+  for (int i = 0 ; i < files_to_read.count() ; i += kReadFilesChunkSize) {
+    if (stop_requested_) return r;
+    songs_on_disk << TagReaderClient::Instance()->ReadFilesBlocking(files_to_read.mid(i, kReadFilesChunkSize));
+  }
+
+  for (int i = 0 ; i < new_files.count() ; ++i) {
+    Song song = songs_on_disk[i];
+    if (!song.is_valid()) continue;
+
+    qLog(Debug) << new_files[i] << "created";
+    // choose an image for the song
+    QString image = ImageForSong(new_files[i], album_art);
+
+    song.set_source(source_);
+    song.set_directory_id(r.dir);
+    if (song.art_automatic().isEmpty()) song.set_art_automatic(image);
+    r.new_songs << song;
+  }
+
+  for (int i = 0 ; i < changed_files.count() ; ++i) {
+    const ChangedFile &changed_file = changed_files[i];
+    UpdateNonCueAssociatedSong(changed_file.file, changed_file.matching_song, songs_on_disk[new_files.count() + i], changed_file.image, changed_file.cue_deleted, &r);
+  }
+
   // Look for deleted songs
   for (const Song &song : songs_in_db) {
-    if (!song.is_unavailable() && !files_on_disk.contains(song.url().toLocalFile())) {
+    if (!song.is_unavailable() && !files_on_disk_set.contains(song.url().toLocalFile())) {
       qLog(Debug) << "Song deleted from disk:" << song.url().toLocalFile();
-      t->deleted_songs << song;
+      r.deleted_songs << song;
     }
   }
 
   // Add this subdir to the new or touched list
-  Subdirectory updated_subdir;
-  updated_subdir.directory_id = t->dir();
-  updated_subdir.mtime = path_info.exists() ? path_info.lastModified().toTime_t() : 0;
-  updated_subdir.path = path;
+  r.updated_subdir.directory_id = r.dir;
+  r.updated_subdir.mtime = path_info.exists() ? path_info.lastModified().toTime_t() : 0;
+  r.updated_subdir.path = path;
+  r.is_new_subdir = subdir.directory_id == -1;
+  r.scanned = true;
 
-  if (subdir.directory_id == -1)
-    t->new_subdirs << updated_subdir;
-  else
-    t->touched_subdirs << updated_subdir;
+  return r;
 
-  t->AddToProgress(1);
+}
 
-  // Recurse into the new subdirs that we found
-  t->AddToProgressMax(my_new_subdirs.count());
-  for (const Subdirectory &my_new_subdir : my_new_subdirs) {
-    if (stop_requested_) return;
-    ScanSubdirectory(my_new_subdir.path, my_new_subdir, t, true);
+void CollectionWatcher::MergeScanResult(const ScanResult &result, ScanTransaction *t) {
+
+  if (result.scanned) {
+    t->deleted_songs << result.deleted_songs;
+    t->readded_songs << result.readded_songs;
+    t->new_songs << result.new_songs;
+    t->touched_songs << result.touched_songs;
+
+    if (result.is_new_subdir)
+      t->new_subdirs << result.updated_subdir;
+    else
+      t->touched_subdirs << result.updated_subdir;
   }
 
-}
+  t->AddToProgress(1);
+  t->AddToProgressMax(result.children.count());
 
-void CollectionWatcher::UpdateCueAssociatedSongs(const QString &file, const QString &path, const QString &matching_cue, const QString &image, ScanTransaction *t) {
+}
 
-  QFile cue(matching_cue);
-  cue.open(QIODevice::ReadOnly);
+void CollectionWatcher::UpdateCueAssociatedSongs(const QString &file, const QString &path, const QString &matching_cue, const QString &image, ScanResult *r) {
 
   SongList old_sections = backend_->GetSongsByUrl(QUrl::fromLocalFile(file));
 
@@ -441,18 +610,18 @@ void CollectionWatcher::UpdateCueAssociatedSongs(const QString &file, const QStr
   QSet<int> used_ids;
 
   // Update every song that's in the cue and collection
-  for (Song cue_song : cue_parser_->Load(&cue, matching_cue, path)) {
+  for (Song cue_song : LoadCue(matching_cue, path)) {
     cue_song.set_source(source_);
-    cue_song.set_directory_id(t->dir());
+    cue_song.set_directory_id(r->dir);
 
     Song matching = sections_map[cue_song.beginning_nanosec()];
     // a new section
     if (!matching.is_valid()) {
-      t->new_songs << cue_song;
+      r->new_songs << cue_song;
       // changed section
     }
     else {
-      PreserveUserSetData(file, image, matching, &cue_song, t);
+      PreserveUserSetData(file, image, matching, &cue_song, r);
       used_ids.insert(matching.id());
     }
   }
@@ -460,30 +629,29 @@ void CollectionWatcher::UpdateCueAssociatedSongs(const QString &file, const QStr
   // sections that are now missing
   for (const Song &matching : old_sections) {
     if (!used_ids.contains(matching.id())) {
-      t->deleted_songs << matching;
+      r->deleted_songs << matching;
     }
   }
 
 }
 
-void CollectionWatcher::UpdateNonCueAssociatedSong(const QString &file, const Song &matching_song, const QString &image, bool cue_deleted, ScanTransaction *t) {
+void CollectionWatcher::UpdateNonCueAssociatedSong(const QString &file, const Song &matching_song, const Song &song_read, const QString &image, bool cue_deleted, ScanResult *r) {
 
   // If a cue got deleted, we turn it's first section into the new 'raw' (cueless) song and we just remove the rest of the sections from the collection
   if (cue_deleted) {
     for (const Song &song : backend_->GetSongsByUrl(QUrl::fromLocalFile(file))) {
       if (!song.IsMetadataEqual(matching_song)) {
-        t->deleted_songs << song;
+        r->deleted_songs << song;
       }
     }
   }
 
-  Song song_on_disk;
+  Song song_on_disk(song_read);
   song_on_disk.set_source(source_);
-  song_on_disk.set_directory_id(t->dir());
-  TagReaderClient::Instance()->ReadFileBlocking(file, &song_on_disk);
+  song_on_disk.set_directory_id(r->dir);
 
   if (song_on_disk.is_valid()) {
-    PreserveUserSetData(file, image, matching_song, &song_on_disk, t);
+    PreserveUserSetData(file, image, matching_song, &song_on_disk, r);
   }
 
 }
@@ -492,47 +660,40 @@ SongList CollectionWatcher::ScanNewFile(const QString &file, const QString &path
 
   SongList song_list;
 
-  uint matching_cue_mtime = GetMtimeForCue(matching_cue);
-  // If it's a cue - create virtual tracks
-  if (matching_cue_mtime) {
-    // don't process the same cue many times
-    if (cues_processed->contains(matching_cue)) return song_list;
-
-    QFile cue(matching_cue);
-    cue.open(QIODevice::ReadOnly);
-
-    // Ignore FILEs pointing to other media files.
-    // Also, watch out for incorrect media files.
-    // Playlist parser for CUEs considers every entry in sheet valid and we don't want invalid media getting into collection!
-    QString file_nfd = file.normalized(QString::NormalizationForm_D);
-    for (const Song &cue_song : cue_parser_->Load(&cue, matching_cue, path)) {
-      if (cue_song.url().toLocalFile().normalized(QString::NormalizationForm_D) == file_nfd) {
-        if (TagReaderClient::Instance()->IsMediaFileBlocking(file)) {
-          song_list << cue_song;
-        }
+  // don't process the same cue many times
+  if (cues_processed->contains(matching_cue)) return song_list;
+
+  // Ignore FILEs pointing to other media files.
+  // Also, watch out for incorrect media files.
+  // Playlist parser for CUEs considers every entry in sheet valid and we don't want invalid media getting into collection!
+  QString file_nfd = file.normalized(QString::NormalizationForm_D);
+  for (const Song &cue_song : LoadCue(matching_cue, path)) {
+    if (cue_song.url().toLocalFile().normalized(QString::NormalizationForm_D) == file_nfd) {
+      if (TagReaderClient::Instance()->IsMediaFileBlocking(file)) {
+        song_list << cue_song;
       }
     }
-
-    if (!song_list.isEmpty()) {
-      *cues_processed << matching_cue;
-    }
-
-    // it's a normal media file
   }
-  else {
-    Song song;
-    TagReaderClient::Instance()->ReadFileBlocking(file, &song);
 
-    if (song.is_valid()) {
-      song_list << song;
-    }
+  if (!song_list.isEmpty()) {
+    *cues_processed << matching_cue;
   }
 
   return song_list;
 
 }
 
-void CollectionWatcher::PreserveUserSetData(const QString &file, const QString &image, const Song &matching_song, Song *out, ScanTransaction *t) {
+SongList CollectionWatcher::LoadCue(const QString &matching_cue, const QString &path) {
+
+  QFile cue(matching_cue);
+  cue.open(QIODevice::ReadOnly);
+
+  QMutexLocker l(&cue_parser_mutex_);
+  return cue_parser_->Load(&cue, matching_cue, path);
+
+}
+
+void CollectionWatcher::PreserveUserSetData(const QString &file, const QString &image, const Song &matching_song, Song *out, ScanResult *r) {
 
   out->set_id(matching_song.id());
 
@@ -546,17 +707,17 @@ void CollectionWatcher::PreserveUserSetData(const QString &file, const QString &
   if (matching_song.is_unavailable()) {
     qLog(Debug) << file << " unavailable song restored";
 
-    t->new_songs << *out;
+    r->new_songs << *out;
   }
   else if (!matching_song.IsMetadataEqual(*out)) {
     qLog(Debug) << file << "metadata changed";
 
     // Update the song in the DB
-    t->new_songs << *out;
+    r->new_songs << *out;
   }
   else {
     // Only the mtime's changed
-    t->touched_songs << *out;
+    r->touched_songs << *out;
   }
 
 }
@@ -601,19 +762,6 @@ void CollectionWatcher::RemoveDirectory(const Directory &dir) {
 
 }
 
-bool CollectionWatcher::FindSongByPath(const SongList &list, const QString &path, Song *out) {
-
-  // TODO: Make this faster
-  for (const Song &song : list) {
-    if (song.url().toLocalFile() == path) {
-      *out = song;
-      return true;
-    }
-  }
-  return false;
-
-}
-
 void CollectionWatcher::DirectoryChanged(const QString &subdir) {
 
   // Find what dir it was in
@@ -626,27 +774,53 @@ void CollectionWatcher::DirectoryChanged(const QString &subdir) {
   qLog(Debug) << "Subdir" << subdir << "changed under directory" << dir.path << "id" << dir.id;
 
   // Queue the subdir for rescanning
-  if (!rescan_queue_[dir.id].contains(subdir)) rescan_queue_[dir.id] << subdir;
+  if (!rescan_queue_[dir.id].contains(subdir)) {
+    rescan_queue_[dir.id] << subdir;
+
+    Subdirectory changed_subdir;
+    changed_subdir.directory_id = dir.id;
+    changed_subdir.path = subdir;
+    changed_subdir.mtime = 0;
+    emit SubdirsChanged(SubdirectoryList() << changed_subdir);
+  }
 
   if (!rescan_paused_) rescan_timer_->start();
 
 }
 
+void CollectionWatcher::FileSystemEventsLost() {
+
+  // We don't know which directories changed, fall back to checking the mtimes of all of them.
+  qLog(Warning) << "File system change events were lost, rescanning the collection";
+  IncrementalScanAsync();
+
+}
+
 void CollectionWatcher::RescanPathsNow() {
 
   for (int dir : rescan_queue_.keys()) {
     if (stop_requested_) return;
-    ScanTransaction transaction(this, dir, false);
-    transaction.AddToProgressMax(rescan_queue_[dir].count());
 
-    for (const QString &path : rescan_queue_[dir]) {
+    SubdirectoryList rescanned_subdirs;
+    {
+      ScanTransaction transaction(this, dir, false);
+      transaction.AddToProgressMax(rescan_queue_[dir].count());
+
+      ScanRequestList requests;
+      for (const QString &path : rescan_queue_[dir]) {
+        Subdirectory subdir;
+        subdir.directory_id = dir;
+        subdir.mtime = 0;
+        subdir.path = path;
+        requests << ScanRequest(path, subdir);
+        rescanned_subdirs << subdir;
+      }
+      ScanSubdirectories(requests, &transaction);
       if (stop_requested_) return;
-      Subdirectory subdir;
-      subdir.directory_id = dir;
-      subdir.mtime = 0;
-      subdir.path = path;
-      ScanSubdirectory(path, subdir, &transaction);
     }
+
+    // Only now that the transaction committed the changes they can be removed from the journal.
+    emit SubdirsRescanned(rescanned_subdirs);
   }
 
   rescan_queue_.clear();
@@ -732,6 +906,8 @@ void CollectionWatcher::ReloadSettings() {
   s.beginGroup(CollectionSettingsPage::kSettingsGroup);
   scan_on_startup_ = s.value("startup_scan", true).toBool();
   monitor_ = s.value("monitor", true).toBool();
+  scan_threads_ = qBound(1, s.value("scan_threads", 1).toInt(), 32);
+  scan_thread_pool_.setMaxThreadCount(scan_threads_);
 
   best_image_filters_.clear();
   QStringList filters = s.value("cover_art_patterns", QStringList() << "front" << "cover").toStringList();
@@ -791,11 +967,12 @@ void CollectionWatcher::PerformScan(bool incremental, bool ignore_mtimes) {
     SubdirectoryList subdirs(transaction.GetAllSubdirs());
     transaction.AddToProgressMax(subdirs.count());
 
+    ScanRequestList requests;
     for (const Subdirectory &subdir : subdirs) {
-      if (stop_requested_) return;
-
-      ScanSubdirectory(subdir.path, subdir, &transaction);
+      requests << ScanRequest(subdir.path, subdir);
     }
+    ScanSubdirectories(requests, &transaction);
+    if (stop_requested_) return;
   }
 
   emit CompilationsNeedUpdating();
@@ -24,14 +24,18 @@
 #include "config.h"
 
 #include <stdbool.h>
+#include <atomic>
 
 #include <QtGlobal>
 #include <QObject>
 #include <QHash>
 #include <QMap>
+#include <QList>
+#include <QMutex>
 #include <QSet>
 #include <QString>
 #include <QStringList>
+#include <QThreadPool>
 #include <QTimer>
 
 #include "directory.h"
@@ -66,6 +70,9 @@ signals:
   void SongsReadded(const SongList &songs, bool unavailable = false);
   void SubdirsDiscovered(const SubdirectoryList &subdirs);
   void SubdirsMTimeUpdated(const SubdirectoryList &subdirs);
+  // Change events are journaled until the subdirectory is rescanned, so they survive a restart before the rescan happened.
+  void SubdirsChanged(const SubdirectoryList &subdirs);
+  void SubdirsRescanned(const SubdirectoryList &subdirs);
   void CompilationsNeedUpdating();
 
   void ScanStarted(int task_id);
@@ -88,6 +95,10 @@ signals:
     ScanTransaction(CollectionWatcher *watcher, int dir, bool incremental, bool ignores_mtime = false);
     ~ScanTransaction();
 
+    // Loads the songs and subdirectories caches.
+    // After this the lookup functions below don't modify the transaction, so they are safe to call from the scanner threads.
+    void PreloadCaches();
+
     SongList FindSongsInSubdirectory(const QString &path);
     bool HasSeenSubdir(const QString &path);
     void SetKnownSubdirs(const SubdirectoryList &subdirs);
@@ -126,22 +137,60 @@ signals:
 
     CollectionWatcher *watcher_;
 
-    SongList cached_songs_;
+    void LoadCachedSongs();
+
+    // Subdirectory path -> songs in that subdirectory
+    QHash<QString, SongList> cached_songs_;
     bool cached_songs_dirty_;
 
     SubdirectoryList known_subdirs_;
     bool known_subdirs_dirty_;
+    // Indexes of known_subdirs_, only containing the subdirectories that still exist (mtime != 0).
+    QSet<QString> seen_subdirs_;
+    QHash<QString, SubdirectoryList> immediate_subdirs_;  // parent path -> children
+  };
+
+  // A subdirectory waiting to be scanned.
+  struct ScanRequest {
+    ScanRequest() : force_noincremental(false) {}
+    ScanRequest(const QString &_path, const Subdirectory &_subdir, bool _force_noincremental = false)
+        : path(_path), subdir(_subdir), force_noincremental(_force_noincremental) {}
+
+    QString path;
+    Subdirectory subdir;
+    bool force_noincremental;
+  };
+  typedef QList<ScanRequest> ScanRequestList;
+
+  // The result of scanning a single subdirectory, without recursing into it's children.
+  // This is produced by ScanSubdirectoryOnly(), which might run on a scanner thread, and merged into the ScanTransaction on the watcher thread.
+  struct ScanResult {
+    ScanResult() : dir(-1), scanned(false), is_new_subdir(false) {}
+
+    int dir;
+    // False if the subdirectory was skipped, then only the progress is updated.
+    bool scanned;
+    bool is_new_subdir;
+    Subdirectory updated_subdir;
+
+    SongList deleted_songs;
+    SongList readded_songs;
+    SongList new_songs;
+    SongList touched_songs;
+
+    // Deleted and newly discovered children that need to be scanned next.
+    ScanRequestList children;
   };
 
  private slots:
   void DirectoryChanged(const QString &path);
+  void FileSystemEventsLost();
   void IncrementalScanNow();
   void FullScanNow();
   void RescanPathsNow();
   void ScanSubdirectory(const QString &path, const Subdirectory &subdir, ScanTransaction *t, bool force_noincremental = false);
 
  private:
-  static bool FindSongByPath(const SongList &list, const QString &path, Song *out);
   inline static QString NoExtensionPart(const QString &fileName);
   inline static QString ExtensionPart(const QString &fileName);
   inline static QString DirectoryPart(const QString &fileName);
@@ -151,15 +200,26 @@ signals:
   uint GetMtimeForCue(const QString &cue_path);
   void PerformScan(bool incremental, bool ignore_mtimes);
 
+  void ScanSubdirectories(const ScanRequestList &requests, ScanTransaction *t);
+  // Scans the files of one subdirectory.  Only reads from the transaction, so this can run on a scanner thread.
+  ScanResult ScanSubdirectoryOnly(const QString &path, const Subdirectory &subdir, ScanTransaction *t, bool force_noincremental);
+  // Adds the result of ScanSubdirectoryOnly() to the transaction.  Must be called on the watcher thread.
+  void MergeScanResult(const ScanResult &result, ScanTransaction *t);
+  // Fans the subdirectories out to the scanner thread pool, and merges the results on this thread as they come in.
+  void ScanSubdirectoriesParallel(const ScanRequestList &requests, ScanTransaction *t);
+
   // Updates the sections of a cue associated and altered (according to mtime) media file during a scan.
-  void UpdateCueAssociatedSongs(const QString &file, const QString &path, const QString &matching_cue, const QString &image, ScanTransaction *t);
+  void UpdateCueAssociatedSongs(const QString &file, const QString &path, const QString &matching_cue, const QString &image, ScanResult *r);
   // Updates a single non-cue associated and altered (according to mtime) song during a scan.
-  void UpdateNonCueAssociatedSong(const QString &file, const Song &matching_song, const QString &image, bool cue_deleted, ScanTransaction *t);
+  // song_read holds the tags read from the file.
+  void UpdateNonCueAssociatedSong(const QString &file, const Song &matching_song, const Song &song_read, const QString &image, bool cue_deleted, ScanResult *r);
   // Updates a new song with some metadata taken from it's equivalent old song (for example rating and score).
-  void PreserveUserSetData(const QString &file, const QString &image, const Song &matching_song, Song *out, ScanTransaction *t);
-  // Scans a single media file that's present on the disk but not yet in the collection.
-  // It may result in a multiple files added to the collection when the media file has many sections (like a CUE related media file).
+  void PreserveUserSetData(const QString &file, const QString &image, const Song &matching_song, Song *out, ScanResult *r);
+  // Scans a single cue associated media file that's present on the disk but not yet in the collection.
+  // It results in a song for every section of the media file.  Other new files have their tags read in a batch.
   SongList ScanNewFile(const QString &file, const QString &path, const QString &matching_cue, QSet<QString> *cues_processed);
+  // Parses a cue sheet.  The parser is shared by the scanner threads, so calls are serialized.
+  SongList LoadCue(const QString &matching_cue, const QString &path);
 
  private:
   Song::Source source_;
@@ -174,10 +234,16 @@ signals:
   // e.g. using ["front", "cover"] would identify front.jpg and exclude back.jpg.
   QStringList best_image_filters_;
 
-  bool stop_requested_;
+  // Read by the scanner threads while a scan is running.
+  std::atomic_bool stop_requested_;
   bool scan_on_startup_;
   bool monitor_;
 
+  // Number of subdirectories scanned in parallel, 1 scans everything on the watcher thread.
+  // Keep this low for spinning disks and network shares.
+  int scan_threads_;
+  QThreadPool scan_thread_pool_;
+
   QMap<int, Directory> watched_dirs_;
   QTimer *rescan_timer_;
   QMap<int, QStringList> rescan_queue_; // dir id -> list of subdirs to be scanned
@@ -186,6 +252,7 @@ signals:
   int total_watches_;
 
   CueParser *cue_parser_;
+  QMutex cue_parser_mutex_;
 
   static QStringList sValidImages;
 };
@@ -26,11 +26,14 @@
 
 #include "sqlrow.h"
 
+#include "core/sqlstatement.h"
 #include "collectionquery.h"
 
-SqlRow::SqlRow(const QSqlQuery &query) { Init(query); }
+SqlRow::SqlRow(const QSqlQuery &query) : statement_(nullptr) { Init(query); }
 
-SqlRow::SqlRow(const CollectionQuery &query) { Init(query); }
+SqlRow::SqlRow(const CollectionQuery &query) : statement_(nullptr) { Init(query); }
+
+SqlRow::SqlRow(const SqlStatement &statement) : statement_(&statement) {}
 
 void SqlRow::Init(const QSqlQuery &query) {
 
@@ -40,3 +43,11 @@ void SqlRow::Init(const QSqlQuery &query) {
   }
 
 }
+
+int SqlRow::count() const {
+  return statement_ ? statement_->count() : columns_.count();
+}
+
+QVariant SqlRow::value(int i) const {
+  return statement_ ? statement_->value(i) : columns_.value(i);
+}
@@ -28,6 +28,7 @@
 #include <QSqlQuery>
 
 class CollectionQuery;
+class SqlStatement;
 
 class SqlRow {
 
@@ -35,8 +36,14 @@ class SqlRow {
   // WARNING: Implicit construction from QSqlQuery and CollectionQuery.
   SqlRow(const QSqlQuery &query);
   SqlRow(const CollectionQuery &query);
+  // Refers to the current row of the statement instead of copying it, so it's only valid until the statement steps to the next row.
+  SqlRow(const SqlStatement &statement);
 
-  const QVariant &value(int i) const { return columns_[i]; }
+  int count() const;
+  QVariant value(int i) const;
+
+  // The statement the columns are read from, or nullptr if they were copied.
+  const SqlStatement *statement() const { return statement_; }
 
   QList<QVariant> columns_;
 
@@ -45,6 +52,8 @@ class SqlRow {
 
   void Init(const QSqlQuery &query);
 
+  const SqlStatement *statement_;
+
 };
 
 typedef QList<SqlRow> SqlRowList;
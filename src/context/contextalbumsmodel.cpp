@@ -27,7 +27,6 @@
 #include <QObject>
 #include <QtGlobal>
 #include <QtAlgorithms>
-#include <QMutex>
 #include <QMimeData>
 #include <QVariant>
 #include <QList>
@@ -296,8 +295,6 @@ ContextAlbumsModel::QueryResult ContextAlbumsModel::RunQuery(CollectionItem *par
   }
 
   // Execute the query
-  QMutexLocker l(backend_->db()->Mutex());
-
   if (!backend_->ExecQuery(&q)) return result;
 
   while (q.Next()) {
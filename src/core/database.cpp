@@ -20,6 +20,7 @@
 
 #include "config.h"
 
+#include <mutex>
 #include <sqlite3.h>
 #include <boost/scope_exit.hpp>
 
@@ -52,7 +53,8 @@
 #include "scopedtransaction.h"
 
 const char *Database::kDatabaseFilename = "strawberry.db";
-const int Database::kSchemaVersion = 4;
+const int Database::kSchemaVersion = 7;
+const int Database::kMaxCachedStatements = 64;
 const char *Database::kMagicAllSongsTables = "%allsongstables";
 
 int Database::sNextConnectionId = 1;
@@ -96,7 +98,10 @@ struct sqlite3_tokenizer_cursor {
   /* Tokenizer implementations will typically add additional fields */
 };
 
+const char *Database::kFTSTokenizerName = "utf8fold";
+const char *Database::kLegacyFTSTokenizerName = "unicode";
 sqlite3_tokenizer_module *Database::sFTSTokenizer = nullptr;
+sqlite3_tokenizer_module *Database::sLegacyFTSTokenizer = nullptr;
 
 int Database::FTSCreate(int argc, const char *const *argv, sqlite3_tokenizer **tokenizer) {
 
@@ -114,6 +119,37 @@ int Database::FTSDestroy(sqlite3_tokenizer *tokenizer) {
 
 int Database::FTSOpen(sqlite3_tokenizer *pTokenizer, const char *input, int bytes, sqlite3_tokenizer_cursor **cursor) {
 
+  // The cursor is the only allocation, the tokens are read from the input in place.
+  *cursor = reinterpret_cast<sqlite3_tokenizer_cursor*>(new Utf8TokenizerCursor(pTokenizer, input, bytes));
+
+  return SQLITE_OK;
+
+}
+
+int Database::FTSClose(sqlite3_tokenizer_cursor *cursor) {
+
+  Utf8TokenizerCursor *real_cursor = reinterpret_cast<Utf8TokenizerCursor*>(cursor);
+  delete real_cursor;
+
+  return SQLITE_OK;
+
+}
+
+int Database::FTSNext(sqlite3_tokenizer_cursor *cursor, const char* *token, int *bytes, int *start_offset, int *end_offset, int *position) {
+
+  Utf8TokenizerCursor *real_cursor = reinterpret_cast<Utf8TokenizerCursor*>(cursor);
+
+  if (!real_cursor->tokenizer.Next(token, bytes, start_offset, end_offset)) {
+    return SQLITE_DONE;
+  }
+  *position = real_cursor->position++;
+
+  return SQLITE_OK;
+
+}
+
+int Database::LegacyFTSOpen(sqlite3_tokenizer *pTokenizer, const char *input, int bytes, sqlite3_tokenizer_cursor **cursor) {
+
   UnicodeTokenizerCursor *new_cursor = new UnicodeTokenizerCursor;
   new_cursor->pTokenizer = pTokenizer;
   new_cursor->position = 0;
@@ -176,7 +212,7 @@ int Database::FTSOpen(sqlite3_tokenizer *pTokenizer, const char *input, int byte
 
 }
 
-int Database::FTSClose(sqlite3_tokenizer_cursor *cursor) {
+int Database::LegacyFTSClose(sqlite3_tokenizer_cursor *cursor) {
 
   UnicodeTokenizerCursor *real_cursor = reinterpret_cast<UnicodeTokenizerCursor*>(cursor);
   delete real_cursor;
@@ -185,7 +221,7 @@ int Database::FTSClose(sqlite3_tokenizer_cursor *cursor) {
 
 }
 
-int Database::FTSNext(sqlite3_tokenizer_cursor *cursor, const char* *token, int *bytes, int *start_offset, int *end_offset, int *position) {
+int Database::LegacyFTSNext(sqlite3_tokenizer_cursor *cursor, const char* *token, int *bytes, int *start_offset, int *end_offset, int *position) {
 
   UnicodeTokenizerCursor *real_cursor = reinterpret_cast<UnicodeTokenizerCursor*>(cursor);
 
@@ -210,14 +246,25 @@ int Database::FTSNext(sqlite3_tokenizer_cursor *cursor, const char* *token, int
 
 void Database::StaticInit() {
 
-  sFTSTokenizer = new sqlite3_tokenizer_module;
-  sFTSTokenizer->iVersion = 0;
-  sFTSTokenizer->xCreate = &Database::FTSCreate;
-  sFTSTokenizer->xDestroy = &Database::FTSDestroy;
-  sFTSTokenizer->xOpen = &Database::FTSOpen;
-  sFTSTokenizer->xNext = &Database::FTSNext;
-  sFTSTokenizer->xClose = &Database::FTSClose;
-  return;
+  // Connections are opened from several threads, but they all share the same modules, so they're only built once.
+  static std::once_flag once;
+  std::call_once(once, []() {
+    sFTSTokenizer = new sqlite3_tokenizer_module;
+    sFTSTokenizer->iVersion = 0;
+    sFTSTokenizer->xCreate = &Database::FTSCreate;
+    sFTSTokenizer->xDestroy = &Database::FTSDestroy;
+    sFTSTokenizer->xOpen = &Database::FTSOpen;
+    sFTSTokenizer->xNext = &Database::FTSNext;
+    sFTSTokenizer->xClose = &Database::FTSClose;
+
+    sLegacyFTSTokenizer = new sqlite3_tokenizer_module;
+    sLegacyFTSTokenizer->iVersion = 0;
+    sLegacyFTSTokenizer->xCreate = &Database::FTSCreate;
+    sLegacyFTSTokenizer->xDestroy = &Database::FTSDestroy;
+    sLegacyFTSTokenizer->xOpen = &Database::LegacyFTSOpen;
+    sLegacyFTSTokenizer->xNext = &Database::LegacyFTSNext;
+    sLegacyFTSTokenizer->xClose = &Database::LegacyFTSClose;
+  });
 
 }
 
@@ -241,6 +288,10 @@ Database::Database(Application *app, QObject *parent, const QString &database_na
 
 }
 
+Database::~Database() {
+  FinalizeStatements();
+}
+
 QSqlDatabase Database::Connect() {
 
   QMutexLocker l(&connect_mutex_);
@@ -261,44 +312,15 @@ QSqlDatabase Database::Connect() {
   }
 
   db = QSqlDatabase::addDatabase("QSQLITE", connection_id);
-
-  if (!injected_database_name_.isNull())
-    db.setDatabaseName(injected_database_name_);
-  else
-    db.setDatabaseName(directory_ + "/" + kDatabaseFilename);
+  db.setDatabaseName(DatabaseFilename());
 
   if (!db.open()) {
     app_->AddError("Database: " + db.lastError().text());
     return db;
   }
 
-  // Find Sqlite3 functions in the Qt plugin.
-  StaticInit();
-
-  {
-
-#ifdef SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER
-    // In case sqlite>=3.12 is compiled without -DSQLITE_ENABLE_FTS3_TOKENIZER
-    // (generally a good idea  due to security reasons) the fts3 support should be enabled explicitly.
-    QVariant v = db.driver()->handle();
-    if (v.isValid() && qstrcmp(v.typeName(), "sqlite3*") == 0) {
-      sqlite3 *handle = *static_cast<sqlite3**>(v.data());
-      if (handle) {
-        int result = sqlite3_db_config(handle, SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER, 1, NULL);
-        if (result != SQLITE_OK) qLog(Fatal) << "Unable to enable FTS3 tokenizer";
-      }
-      else qLog(Fatal) << "Unable to enable FTS3 tokenizer";
-    }
-#endif
-    QSqlQuery set_fts_tokenizer(db);
-    set_fts_tokenizer.prepare("SELECT fts3_tokenizer(:name, :pointer)");
-    set_fts_tokenizer.bindValue(":name", "unicode");
-    set_fts_tokenizer.bindValue(":pointer", QByteArray(reinterpret_cast<const char*>(&sFTSTokenizer), sizeof(&sFTSTokenizer)));
-    if (!set_fts_tokenizer.exec()) {
-      qLog(Warning) << "Couldn't register FTS3 tokenizer : " << set_fts_tokenizer.lastError();
-    }
-    // Implicit invocation of ~QSqlQuery() when leaving the scope to release any remaining database locks!
-  }
+  EnableWriteAheadLog(db);
+  RegisterFTSTokenizer(db);
 
   if (db.tables().count() == 0) {
     // Set up initial schema
@@ -306,21 +328,7 @@ QSqlDatabase Database::Connect() {
     UpdateDatabaseSchema(0, db);
   }
 
-  // Attach external databases
-  for (const QString &key : attached_databases_.keys()) {
-    QString filename = attached_databases_[key].filename_;
-
-    if (!injected_database_name_.isNull()) filename = injected_database_name_;
-
-    // Attach the db
-    QSqlQuery q(db);
-    q.prepare("ATTACH DATABASE :filename AS :alias");
-    q.bindValue(":filename", filename);
-    q.bindValue(":alias", key);
-    if (!q.exec()) {
-      qFatal("Couldn't attach external database '%s'", key.toLatin1().constData());
-    }
-  }
+  AttachDatabasesOnConnection(db);
 
   if (startup_schema_version_ == -1) {
     UpdateMainSchema(&db);
@@ -343,6 +351,155 @@ QSqlDatabase Database::Connect() {
 
 }
 
+QSqlDatabase Database::ConnectReadOnly() {
+
+  // Every connection to an in-memory database gets its own private database, so readers have to share the writer connection.
+  if (IsMemoryDatabase()) return Connect();
+
+  QMutexLocker l(&connect_mutex_);
+
+  const QString connection_id = QString("%1_thread_%2_ro").arg(connection_id_).arg(reinterpret_cast<quint64>(QThread::currentThread()));
+
+  // Try to find an existing connection for this thread
+  QSqlDatabase db = QSqlDatabase::database(connection_id);
+  if (db.isOpen()) {
+    UpdateReadOnlyAttachedDatabases(db);
+    return db;
+  }
+
+  // The schema is created and upgraded by the writer connection, which is always opened first in the constructor.
+  db = QSqlDatabase::addDatabase("QSQLITE", connection_id);
+  db.setDatabaseName(DatabaseFilename());
+  db.setConnectOptions("QSQLITE_OPEN_READONLY");
+
+  if (!db.open()) {
+    app_->AddError("Database: " + db.lastError().text());
+    return db;
+  }
+
+  RegisterFTSTokenizer(db);
+  AttachDatabasesOnConnection(db);
+  read_only_attached_databases_[connection_id] = attached_databases_.keys();
+
+  return db;
+
+}
+
+void Database::UpdateReadOnlyAttachedDatabases(QSqlDatabase &db) {
+
+  // A reader connection can only be used from its own thread, so databases attached or detached after it was opened are caught up with the next time that thread connects.
+  QStringList &attached = read_only_attached_databases_[db.connectionName()];
+  const QStringList keys = attached_databases_.keys();
+  if (attached == keys) return;
+
+  for (const QString &key : attached) {
+    if (attached_databases_.contains(key)) continue;
+    QSqlQuery q(db);
+    q.prepare("DETACH DATABASE :alias");
+    q.bindValue(":alias", key);
+    if (!q.exec()) {
+      qLog(Warning) << "Failed to detach database" << key;
+    }
+  }
+
+  for (const QString &key : keys) {
+    if (attached.contains(key)) continue;
+    QString filename = attached_databases_[key].filename_;
+    if (!injected_database_name_.isNull()) filename = injected_database_name_;
+    QSqlQuery q(db);
+    q.prepare("ATTACH DATABASE :filename AS :alias");
+    q.bindValue(":filename", filename);
+    q.bindValue(":alias", key);
+    if (!q.exec()) {
+      qFatal("Couldn't attach external database '%s'", key.toLatin1().constData());
+    }
+  }
+
+  attached = keys;
+
+}
+
+QString Database::DatabaseFilename() const {
+
+  if (!injected_database_name_.isNull()) return injected_database_name_;
+  return directory_ + "/" + kDatabaseFilename;
+
+}
+
+void Database::EnableWriteAheadLog(QSqlDatabase &db) {
+
+  if (IsMemoryDatabase()) return;
+
+  // WAL lets the read-only connections run concurrently with a writer transaction.
+  // The journal mode is persistent, so this only really changes anything the first time the file is opened.
+  QSqlQuery q(db);
+  if (!q.exec("PRAGMA journal_mode = WAL") || !q.next() || q.value(0).toString().toLower() != "wal") {
+    qLog(Warning) << "Unable to enable write-ahead logging for" << db.databaseName();
+    return;
+  }
+  q.finish();
+
+  // In WAL mode NORMAL is still safe against corruption, it only skips the fsync on every commit.
+  if (!q.exec("PRAGMA synchronous = NORMAL")) {
+    qLog(Warning) << "Unable to set synchronous mode:" << q.lastError();
+  }
+
+}
+
+void Database::RegisterFTSTokenizer(QSqlDatabase &db) {
+
+  // Find Sqlite3 functions in the Qt plugin.
+  StaticInit();
+
+#ifdef SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER
+  // In case sqlite>=3.12 is compiled without -DSQLITE_ENABLE_FTS3_TOKENIZER
+  // (generally a good idea  due to security reasons) the fts3 support should be enabled explicitly.
+  QVariant v = db.driver()->handle();
+  if (v.isValid() && qstrcmp(v.typeName(), "sqlite3*") == 0) {
+    sqlite3 *handle = *static_cast<sqlite3**>(v.data());
+    if (handle) {
+      int result = sqlite3_db_config(handle, SQLITE_DBCONFIG_ENABLE_FTS3_TOKENIZER, 1, NULL);
+      if (result != SQLITE_OK) qLog(Fatal) << "Unable to enable FTS3 tokenizer";
+    }
+    else qLog(Fatal) << "Unable to enable FTS3 tokenizer";
+  }
+#endif
+  QSqlQuery set_fts_tokenizer(db);
+  set_fts_tokenizer.prepare("SELECT fts3_tokenizer(:name, :pointer)");
+  set_fts_tokenizer.bindValue(":name", kFTSTokenizerName);
+  set_fts_tokenizer.bindValue(":pointer", QByteArray(reinterpret_cast<const char*>(&sFTSTokenizer), sizeof(&sFTSTokenizer)));
+  if (!set_fts_tokenizer.exec()) {
+    qLog(Warning) << "Couldn't register FTS3 tokenizer : " << set_fts_tokenizer.lastError();
+  }
+  set_fts_tokenizer.bindValue(":name", kLegacyFTSTokenizerName);
+  set_fts_tokenizer.bindValue(":pointer", QByteArray(reinterpret_cast<const char*>(&sLegacyFTSTokenizer), sizeof(&sLegacyFTSTokenizer)));
+  if (!set_fts_tokenizer.exec()) {
+    qLog(Warning) << "Couldn't register legacy FTS3 tokenizer : " << set_fts_tokenizer.lastError();
+  }
+  // Implicit invocation of ~QSqlQuery() when leaving the scope to release any remaining database locks!
+
+}
+
+void Database::AttachDatabasesOnConnection(QSqlDatabase &db) {
+
+  // Attach external databases
+  for (const QString &key : attached_databases_.keys()) {
+    QString filename = attached_databases_[key].filename_;
+
+    if (!injected_database_name_.isNull()) filename = injected_database_name_;
+
+    // Attach the db
+    QSqlQuery q(db);
+    q.prepare("ATTACH DATABASE :filename AS :alias");
+    q.bindValue(":filename", filename);
+    q.bindValue(":alias", key);
+    if (!q.exec()) {
+      qFatal("Couldn't attach external database '%s'", key.toLatin1().constData());
+    }
+  }
+
+}
+
 void Database::UpdateMainSchema(QSqlDatabase *db) {
 
   // Get the database's schema version
@@ -394,7 +551,8 @@ void Database::RecreateAttachedDb(const QString &database_name) {
   }
 
   // We can't just re-attach the database now because it needs to be done for each thread.
-  // Close all the database connections, so each thread will re-attach it when they next connect.
+  // Close all the database connections, the read-only ones too, so each thread will re-attach it when they next connect.
+  FinalizeStatements();
   for (const QString &name : QSqlDatabase::connectionNames()) {
     QSqlDatabase::removeDatabase(name);
   }
@@ -402,6 +560,7 @@ void Database::RecreateAttachedDb(const QString &database_name) {
 }
 
 void Database::AttachDatabase(const QString &database_name, const AttachedDatabase &database) {
+  QMutexLocker l(&connect_mutex_);
   attached_databases_[database_name] = database;
 }
 
@@ -435,6 +594,8 @@ void Database::DetachDatabase(const QString &database_name) {
     }
   }
 
+  // The read-only connections detach it the next time their thread connects.
+  QMutexLocker connect_locker(&connect_mutex_);
   attached_databases_.remove(database_name);
 
 }
@@ -579,6 +740,52 @@ bool Database::CheckErrors(const QSqlQuery &query) {
 
 }
 
+sqlite3 *Database::SqliteHandle(QSqlDatabase &db) {
+
+  QVariant v = db.driver()->handle();
+  if (v.isValid() && qstrcmp(v.typeName(), "sqlite3*") == 0) {
+    return *static_cast<sqlite3**>(v.data());
+  }
+  return nullptr;
+
+}
+
+sqlite3_stmt *Database::TakeStatement(sqlite3 *handle, const QString &sql) {
+
+  QMutexLocker l(&statements_mutex_);
+  if (!statements_.contains(handle)) return nullptr;
+  return statements_[handle].take(sql);
+
+}
+
+void Database::ReturnStatement(sqlite3 *handle, const QString &sql, sqlite3_stmt *stmt) {
+
+  {
+    QMutexLocker l(&statements_mutex_);
+    QHash<QString, sqlite3_stmt*> &statements = statements_[handle];
+    // Queries with their values in the SQL text are all different, so stop caching when there are too many.
+    if (!statements.contains(sql) && statements.count() < kMaxCachedStatements) {
+      statements.insert(sql, stmt);
+      return;
+    }
+  }
+
+  sqlite3_finalize(stmt);
+
+}
+
+void Database::FinalizeStatements() {
+
+  QMutexLocker l(&statements_mutex_);
+  for (const QHash<QString, sqlite3_stmt*> &statements : statements_) {
+    for (sqlite3_stmt *stmt : statements) {
+      sqlite3_finalize(stmt);
+    }
+  }
+  statements_.clear();
+
+}
+
 bool Database::IntegrityCheck(QSqlDatabase db) {
 
   qLog(Debug) << "Starting database integrity check";
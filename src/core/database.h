@@ -32,11 +32,14 @@
 #include <QByteArray>
 #include <QList>
 #include <QMap>
+#include <QHash>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QString>
 #include <QStringList>
 
+#include "utf8tokenizer.h"
+
 extern "C" {
 
 struct sqlite3_tokenizer;
@@ -51,6 +54,7 @@ class Database : public QObject {
 
  public:
   Database(Application *app, QObject *parent = nullptr, const QString &database_name = QString());
+  ~Database();
 
   struct AttachedDatabase {
     AttachedDatabase() {}
@@ -63,13 +67,27 @@ class Database : public QObject {
   };
 
   static const int kSchemaVersion;
+  static const int kMaxCachedStatements;
   static const char *kDatabaseFilename;
   static const char *kMagicAllSongsTables;
 
+  // The writer connection for this thread.  All writes are serialized, so callers must hold Mutex() while using it.
   QSqlDatabase Connect();
+  // A read-only connection for this thread.  The database runs in WAL mode, so readers see the last committed state and never wait for the writer.
+  QSqlDatabase ConnectReadOnly();
   bool CheckErrors(const QSqlQuery &query);
   QMutex *Mutex() { return &mutex_; }
 
+  // The SQLite connection of a QSqlDatabase, or nullptr if it's not using the QSQLITE driver.
+  static sqlite3 *SqliteHandle(QSqlDatabase &db);
+
+  // The prepared statements of SqlStatement, cached by connection and SQL text.
+  // A statement is taken out of the cache while it's used, so the same query can run nested on one connection.
+  sqlite3_stmt *TakeStatement(sqlite3 *handle, const QString &sql);
+  void ReturnStatement(sqlite3 *handle, const QString &sql, sqlite3_stmt *stmt);
+  // SQLite can't close a connection that still has prepared statements, so they are finalized before the connections are closed.
+  void FinalizeStatements();
+
   void RecreateAttachedDb(const QString &database_name);
   void ExecSchemaCommands(QSqlDatabase &db, const QString &schema, int schema_version, bool in_transaction = false);
 
@@ -98,11 +116,19 @@ signals:
   bool IntegrityCheck(QSqlDatabase db);
   void BackupFile(const QString &filename);
   bool OpenDatabase(const QString &filename, sqlite3 **connection) const;
+  bool IsMemoryDatabase() const { return injected_database_name_ == ":memory:"; }
+  QString DatabaseFilename() const;
+  void EnableWriteAheadLog(QSqlDatabase &db);
+  void RegisterFTSTokenizer(QSqlDatabase &db);
+  void AttachDatabasesOnConnection(QSqlDatabase &db);
+  void UpdateReadOnlyAttachedDatabases(QSqlDatabase &db);
 
   Application *app_;
 
   // Alias -> filename
   QMap<QString, AttachedDatabase> attached_databases_;
+  // Read-only connection name -> the aliases attached on it
+  QHash<QString, QStringList> read_only_attached_databases_;
 
   QString directory_;
   QMutex connect_mutex_;
@@ -120,6 +146,9 @@ signals:
   uint query_hash_;
   QStringList query_cache_;
 
+  QMutex statements_mutex_;
+  QHash<sqlite3*, QHash<QString, sqlite3_stmt*>> statements_;
+
   // This is the schema version of Strawberry's DB from the app's last run.
   int startup_schema_version_;
 
@@ -128,14 +157,25 @@ signals:
 
   typedef int (*Sqlite3CreateFunc)(sqlite3*, const char*, int, int, void*, void (*)(sqlite3_context*, int, sqlite3_value**), void (*)(sqlite3_context*, int, sqlite3_value**), void (*)(sqlite3_context*));
 
+  // The tokenizer used by the full text search tables, see Utf8Tokenizer.
+  static const char *kFTSTokenizerName;
   static sqlite3_tokenizer_module *sFTSTokenizer;
 
+  // The QString based tokenizer used before schema version 6.
+  // It's still registered for indexes that were not migrated, such as the ones of devices.
+  static const char *kLegacyFTSTokenizerName;
+  static sqlite3_tokenizer_module *sLegacyFTSTokenizer;
+
   static int FTSCreate(int argc, const char *const *argv, sqlite3_tokenizer **tokenizer);
   static int FTSDestroy(sqlite3_tokenizer *tokenizer);
   static int FTSOpen(sqlite3_tokenizer *tokenizer, const char *input, int bytes, sqlite3_tokenizer_cursor **cursor);
   static int FTSClose(sqlite3_tokenizer_cursor *cursor);
   static int FTSNext(sqlite3_tokenizer_cursor *cursor, const char **token, int *bytes, int *start_offset, int *end_offset, int *position);
 
+  static int LegacyFTSOpen(sqlite3_tokenizer *tokenizer, const char *input, int bytes, sqlite3_tokenizer_cursor **cursor);
+  static int LegacyFTSClose(sqlite3_tokenizer_cursor *cursor);
+  static int LegacyFTSNext(sqlite3_tokenizer_cursor *cursor, const char **token, int *bytes, int *start_offset, int *end_offset, int *position);
+
   struct Token {
     Token(const QString &token, int start, int end);
     QString token;
@@ -155,6 +195,15 @@ signals:
     int position;
     QByteArray current_utf8;
   };
+
+  struct Utf8TokenizerCursor {
+    Utf8TokenizerCursor(const sqlite3_tokenizer *tokenizer, const char *input, int bytes)
+        : pTokenizer(tokenizer), position(0), tokenizer(input, bytes) {}
+
+    const sqlite3_tokenizer *pTokenizer;
+    int position;
+    Utf8Tokenizer tokenizer;
+  };
 };
 
 class MemoryDatabase : public Database {
@@ -162,6 +211,7 @@ class MemoryDatabase : public Database {
   MemoryDatabase(Application *app, QObject *parent = nullptr)
       : Database(app, parent, ":memory:") {}
   ~MemoryDatabase() {
+    FinalizeStatements();
     // Make sure Qt doesn't reuse the same database
     QSqlDatabase::removeDatabase(Connect().connectionName());
   }
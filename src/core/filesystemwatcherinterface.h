@@ -39,6 +39,8 @@ class FileSystemWatcherInterface : public QObject {
 
 signals:
   void PathChanged(const QString &path);
+  // Emitted when the backend dropped change notifications, so the watched paths need to be checked by other means.
+  void EventsLost();
 };
 
 #endif
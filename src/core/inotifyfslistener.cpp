@@ -0,0 +1,147 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <QObject>
+#include <QFile>
+#include <QSet>
+#include <QString>
+#include <QSocketNotifier>
+
+#include "core/logging.h"
+#include "filesystemwatcherinterface.h"
+#include "inotifyfslistener.h"
+
+namespace {
+// Everything that can change the list of songs in a directory, or the contents of a song.
+const uint32_t kWatchMask = IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+}
+
+InotifyFSListener::InotifyFSListener(QObject *parent)
+    : FileSystemWatcherInterface(parent),
+      fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+      notifier_(nullptr) {
+
+  if (fd_ == -1) {
+    qLog(Error) << "Failed to initialize inotify:" << strerror(errno);
+    return;
+  }
+
+  notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
+  connect(notifier_, SIGNAL(activated(int)), SLOT(ReadEvents()));
+
+}
+
+InotifyFSListener::~InotifyFSListener() {
+
+  if (fd_ != -1) close(fd_);
+
+}
+
+void InotifyFSListener::AddPath(const QString &path) {
+
+  if (fd_ == -1 || watches_.contains(path)) return;
+
+  const int wd = inotify_add_watch(fd_, QFile::encodeName(path).constData(), kWatchMask);
+  if (wd == -1) {
+    qLog(Warning) << "Failed to watch" << path << strerror(errno);
+    return;
+  }
+
+  // Hard links to the same directory share the watch descriptor, the last path added wins.
+  paths_[wd] = path;
+  watches_[path] = wd;
+
+}
+
+void InotifyFSListener::RemovePath(const QString &path) {
+
+  if (!watches_.contains(path)) return;
+
+  const int wd = watches_.take(path);
+  if (paths_.value(wd) == path) paths_.remove(wd);
+  inotify_rm_watch(fd_, wd);
+
+}
+
+void InotifyFSListener::Clear() {
+
+  for (int wd : paths_.keys()) {
+    inotify_rm_watch(fd_, wd);
+  }
+  paths_.clear();
+  watches_.clear();
+
+}
+
+void InotifyFSListener::ReadEvents() {
+
+  // Aligned as required by struct inotify_event.
+  alignas(struct inotify_event) char buffer[16384];
+
+  // Only report each directory once per batch, one copy of a large album can generate hundreds of events for the same directory.
+  QSet<QString> changed;
+  bool events_lost = false;
+
+  forever {
+    const ssize_t len = read(fd_, buffer, sizeof(buffer));
+    if (len <= 0) {
+      if (len == -1 && errno == EINTR) continue;
+      break;
+    }
+
+    for (char *p = buffer; p < buffer + len;) {
+      const struct inotify_event *event = reinterpret_cast<const struct inotify_event*>(p);
+      p += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        events_lost = true;
+        continue;
+      }
+
+      QHash<int, QString>::const_iterator it = paths_.constFind(event->wd);
+      if (it == paths_.constEnd()) continue;
+      const QString path = *it;
+
+      if (event->mask & IN_IGNORED) {
+        // The watch was removed, either by us or because the directory is gone.
+        paths_.remove(event->wd);
+        if (watches_.value(path) == event->wd) watches_.remove(path);
+      }
+
+      changed << path;
+    }
+  }
+
+  if (events_lost) {
+    qLog(Warning) << "The inotify event queue overflowed, changes were lost.";
+    emit EventsLost();
+  }
+
+  for (const QString &path : changed) {
+    emit PathChanged(path);
+  }
+
+}
@@ -0,0 +1,59 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INOTIFYFSLISTENER_H
+#define INOTIFYFSLISTENER_H
+
+#include "config.h"
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+
+#include "filesystemwatcherinterface.h"
+
+class QSocketNotifier;
+
+// Watches directories with inotify directly instead of going through QFileSystemWatcher.
+// Unlike QFileSystemWatcher this also reports files that were rewritten in place (which doesn't change the directory mtime),
+// and tells us through EventsLost() when the kernel queue overflowed, so the collection watcher knows it has to fall back to a full scan.
+class InotifyFSListener : public FileSystemWatcherInterface {
+  Q_OBJECT
+
+ public:
+  explicit InotifyFSListener(QObject *parent = nullptr);
+  ~InotifyFSListener();
+
+  void AddPath(const QString &path);
+  void RemovePath(const QString &path);
+  void Clear();
+
+ private slots:
+  void ReadEvents();
+
+ private:
+  int fd_;
+  QSocketNotifier *notifier_;
+
+  QHash<int, QString> paths_;  // watch descriptor -> path
+  QHash<QString, int> watches_;  // path -> watch descriptor
+
+};
+
+#endif  // INOTIFYFSLISTENER_H
@@ -154,6 +154,7 @@
 
 #ifdef HAVE_MOODBAR
 #  include "moodbar/moodbarcontroller.h"
+#  include "moodbar/moodbarloader.h"
 #  include "moodbar/moodbarproxystyle.h"
 #endif
 
@@ -411,6 +412,11 @@ MainWindow::MainWindow(Application *app, SystemTrayIcon *tray_icon, OSD *osd, co
   connect(ui_->action_jump, SIGNAL(triggered()), ui_->playlist->view(), SLOT(JumpToCurrentlyPlayingTrack()));
   connect(ui_->action_update_collection, SIGNAL(triggered()), app_->collection(), SLOT(IncrementalScan()));
   connect(ui_->action_full_collection_scan, SIGNAL(triggered()), app_->collection(), SLOT(FullScan()));
+#ifdef HAVE_MOODBAR
+  connect(ui_->action_generate_moodbars, SIGNAL(triggered()), app_->moodbar_loader(), SLOT(GenerateAll()));
+#else
+  ui_->action_generate_moodbars->setDisabled(true);
+#endif
 #if defined(HAVE_GSTREAMER)
   connect(ui_->action_add_files_to_transcoder, SIGNAL(triggered()), SLOT(AddFilesToTranscoder()));
 #else
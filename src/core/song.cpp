@@ -31,6 +31,7 @@
 #include <QObject>
 #include <QFile>
 #include <QFileInfo>
+#include <QAtomicInt>
 #include <QSharedData>
 #include <QtAlgorithms>
 #include <QHash>
@@ -62,9 +63,11 @@
 #include "timeconstants.h"
 #include "utilities.h"
 #include "song.h"
+#include "stringpool.h"
 #include "application.h"
 #include "mpris_common.h"
 #include "collection/sqlrow.h"
+#include "sqlstatement.h"
 #include "covermanager/albumcoverloader.h"
 #include "tagreadermessages.pb.h"
 
@@ -125,7 +128,8 @@ const QStringList Song::kColumns = QStringList() << "title"
 						 ;
 
 const QString Song::kColumnSpec = Song::kColumns.join(", ");
-const QString Song::kBindSpec = Utilities::Prepend(":", Song::kColumns).join(", ");
+const QStringList Song::kBindColumns = Utilities::Prepend(":", Song::kColumns);
+const QString Song::kBindSpec = Song::kBindColumns.join(", ");
 const QString Song::kUpdateSpec = Utilities::Updateify(Song::kColumns).join(", ");
 
 const QStringList Song::kFtsColumns = QStringList() << "ftstitle"
@@ -149,6 +153,24 @@ const QRegExp Song::kAlbumRemoveDisc(" ?-? ((\\(|\\[)?)(Disc|CD) ?([0-9]{1,2})((
 const QRegExp Song::kAlbumRemoveMisc(" ?-? ((\\(|\\[)?)(Remastered) ?((\\)|\\])?)$");
 const QRegExp Song::kTitleRemoveMisc(" ?-? ((\\(|\\[)?)(Remastered|Live|Remastered Version) ?((\\)|\\])?)$");
 
+namespace {
+
+// Text shared between songs when compact storage is on
+StringPool sStringPool;
+QAtomicInt sCompactStorage(0);
+
+inline QString Intern(const QString &str) {
+  return sCompactStorage.load() ? sStringPool.Intern(str) : str;
+}
+
+}  // namespace
+
+// Fields most songs don't have, allocated only for the songs that do.
+struct SongExtras : public QSharedData {
+  QImage image_;
+  QString error_;
+};
+
 struct Song::Private : public QSharedData {
 
   Private(Source source = Source_Unknown);
@@ -204,11 +226,11 @@ struct Song::Private : public QSharedData {
 
   QString cue_path_;		// If the song has a CUE, this contains it's path.
 
-  QImage image_;
   bool init_from_file_;		// Whether this song was loaded from a file using taglib.
   bool suspicious_tags_;	// Whether our encoding guesser thinks these tags might be incorrectly encoded.
 
-  QString error_;
+  // The image and the error, null until one is set
+  QSharedDataPointer<SongExtras> extras_;
 
 };
 
@@ -249,6 +271,16 @@ Song::Private::Private(Song::Source source)
 
       {}
 
+void Song::SetCompactStorage(bool compact) {
+
+  sCompactStorage.store(compact ? 1 : 0);
+  // Nothing new gets shared, let go of the strings no song uses anymore
+  if (!compact) sStringPool.Purge();
+
+}
+
+bool Song::compact_storage() { return sCompactStorage.load(); }
+
 Song::Song(Song::Source source) : d(new Private(source)) {}
 Song::Song(const Song &other) : d(other.d) {}
 Song::~Song() {}
@@ -321,26 +353,32 @@ bool Song::has_manually_unset_cover() const { return d->art_manual_ == kManually
 void Song::manually_unset_cover() { d->art_manual_ = kManuallyUnsetCover; }
 bool Song::has_embedded_cover() const { return d->art_automatic_ == kEmbeddedCover; }
 void Song::set_embedded_cover() { d->art_automatic_ = kEmbeddedCover; }
-const QImage &Song::image() const { return d->image_; }
-const QString &Song::error() const { return d->error_; }
+const QImage &Song::image() const {
+  static const QImage kNoImage;
+  return d->extras_ ? d->extras_->image_ : kNoImage;
+}
+const QString &Song::error() const {
+  static const QString kNoError;
+  return d->extras_ ? d->extras_->error_ : kNoError;
+}
 
 void Song::set_id(int id) { d->id_ = id; }
 void Song::set_album_id(int v) { d->album_id_ = v; }
 void Song::set_valid(bool v) { d->valid_ = v; }
 
 void Song::set_title(const QString &v) { d->title_ = v; }
-void Song::set_album(const QString &v) { d->album_ = v; }
-void Song::set_artist(const QString &v) { d->artist_ = v; }
-void Song::set_albumartist(const QString &v) { d->albumartist_ = v; }
+void Song::set_album(const QString &v) { d->album_ = Intern(v); }
+void Song::set_artist(const QString &v) { d->artist_ = Intern(v); }
+void Song::set_albumartist(const QString &v) { d->albumartist_ = Intern(v); }
 void Song::set_track(int v) { d->track_ = v; }
 void Song::set_disc(int v) { d->disc_ = v; }
 void Song::set_year(int v) { d->year_ = v; }
 void Song::set_originalyear(int v) { d->originalyear_ = v; }
-void Song::set_genre(const QString &v) { d->genre_ = v; }
+void Song::set_genre(const QString &v) { d->genre_ = Intern(v); }
 void Song::set_compilation(bool v) { d->compilation_ = v; }
-void Song::set_composer(const QString &v) { d->composer_ = v; }
-void Song::set_performer(const QString &v) { d->performer_ = v; }
-void Song::set_grouping(const QString &v) { d->grouping_ = v; }
+void Song::set_composer(const QString &v) { d->composer_ = Intern(v); }
+void Song::set_performer(const QString &v) { d->performer_ = Intern(v); }
+void Song::set_grouping(const QString &v) { d->grouping_ = Intern(v); }
 void Song::set_comment(const QString &v) { d->comment_ = v; }
 void Song::set_lyrics(const QString &v) { d->lyrics_ = v; }
 
@@ -378,11 +416,14 @@ void Song::set_compilation_detected(bool v) { d->compilation_detected_ = v; }
 void Song::set_compilation_on(bool v) { d->compilation_on_ = v; }
 void Song::set_compilation_off(bool v) { d->compilation_off_ = v; }
 
-void Song::set_art_automatic(const QString &v) { d->art_automatic_ = v; }
-void Song::set_art_manual(const QString &v) { d->art_manual_ = v; }
-void Song::set_cue_path(const QString &v) { d->cue_path_ = v; }
+void Song::set_art_automatic(const QString &v) { d->art_automatic_ = Intern(v); }
+void Song::set_art_manual(const QString &v) { d->art_manual_ = Intern(v); }
+void Song::set_cue_path(const QString &v) { d->cue_path_ = Intern(v); }
 
-void Song::set_image(const QImage &i) { d->image_ = i; }
+void Song::set_image(const QImage &i) {
+  if (!d->extras_) d->extras_ = new SongExtras;
+  d->extras_->image_ = i;
+}
 
 QString Song::JoinSpec(const QString &table) {
   return Utilities::Prepend(table + ".", kColumns).join(", ");
@@ -599,18 +640,18 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata &pb) {
   d->init_from_file_ = true;
   d->valid_ = pb.valid();
   d->title_ = QStringFromStdString(pb.title());
-  d->album_ = QStringFromStdString(pb.album());
-  d->artist_ = QStringFromStdString(pb.artist());
-  d->albumartist_ = QStringFromStdString(pb.albumartist());
+  d->album_ = Intern(QStringFromStdString(pb.album()));
+  d->artist_ = Intern(QStringFromStdString(pb.artist()));
+  d->albumartist_ = Intern(QStringFromStdString(pb.albumartist()));
   d->track_ = pb.track();
   d->disc_ = pb.disc();
   d->year_ = pb.year();
   d->originalyear_ = pb.originalyear();
-  d->genre_ = QStringFromStdString(pb.genre());
+  d->genre_ = Intern(QStringFromStdString(pb.genre()));
   d->compilation_ = pb.compilation();
-  d->composer_ = QStringFromStdString(pb.composer());
-  d->performer_ = QStringFromStdString(pb.performer());
-  d->grouping_ = QStringFromStdString(pb.grouping());
+  d->composer_ = Intern(QStringFromStdString(pb.composer()));
+  d->performer_ = Intern(QStringFromStdString(pb.performer()));
+  d->grouping_ = Intern(QStringFromStdString(pb.grouping()));
   d->comment_ = QStringFromStdString(pb.comment());
   d->lyrics_ = QStringFromStdString(pb.lyrics());
   set_length_nanosec(pb.length_nanosec());
@@ -632,7 +673,7 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata &pb) {
   }
 
   if (pb.has_art_automatic()) {
-    d->art_automatic_ = QStringFromStdString(pb.art_automatic());
+    d->art_automatic_ = Intern(QStringFromStdString(pb.art_automatic()));
   }
 
   InitArtManual();
@@ -676,169 +717,114 @@ void Song::ToProtobuf(pb::tagreader::SongMetadata *pb) const {
   pb->set_filetype(static_cast<pb::tagreader::SongMetadata_FileType>(d->filetype_));
 }
 
-#define tostr(n) (q.value(n).isNull() ? QString::null : q.value(n).toString())
-#define toint(n) (q.value(n).isNull() ? -1 : q.value(n).toInt())
-#define tolonglong(n) (q.value(n).isNull() ? -1 : q.value(n).toLongLong())
-#define tofloat(n) (q.value(n).isNull() ? -1 : q.value(n).toDouble())
-
-void Song::InitFromQuery(const SqlRow &q, bool reliable_metadata, int col) {
-
-  //qLog(Debug) << "Song::kColumns.size():" << Song::kColumns.size() << "q.columns_.size():" << q.columns_.size() << "col:" << col;
-
-  int x = col;
-  d->id_ = toint(col);
+namespace {
 
-  for (int i = 0 ; i < Song::kColumns.size(); i++) {
-    x++;
+// Reads the columns of a SqlRow that holds QVariants, with the same interface as SqlStatement.
+class SqlRowColumns {
+ public:
+  explicit SqlRowColumns(const SqlRow &row) : row_(row) {}
 
-    if (x >= q.columns_.size()) {
-      qLog(Error) << "Skipping" << Song::kColumns.value(i);
-      break;
-    }
-
-    //qLog(Debug) << "Index:" << i << x << Song::kColumns.value(i) << q.value(x).toString();
-
-    if (Song::kColumns.value(i) == "title") {
-      d->title_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "album") {
-      d->album_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "artist") {
-      d->artist_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "albumartist") {
-      d->albumartist_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "track") {
-      d->track_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "disc") {
-      d->disc_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "year") {
-      d->year_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "originalyear") {
-      d->originalyear_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "genre") {
-      d->genre_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "compilation") {
-      d->compilation_ = q.value(x).toBool();
-    }
-    else if (Song::kColumns.value(i) == "composer") {
-      d->composer_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "performer") {
-      d->performer_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "grouping") {
-      d->grouping_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "comment") {
-      d->comment_ = tostr(x);
-    }
-    else if (Song::kColumns.value(i) == "lyrics") {
-      d->comment_ = tostr(x);
-    }
+  int count() const { return row_.count(); }
+  bool isNull(int column) const { return column >= row_.count() || row_.value(column).isNull(); }
+  int toInt(int column) const { return row_.value(column).toInt(); }
+  qint64 toLongLong(int column) const { return row_.value(column).toLongLong(); }
+  bool toBool(int column) const { return row_.value(column).toBool(); }
+  QString toString(int column) const { return row_.value(column).toString(); }
 
-    else if (Song::kColumns.value(i) == "beginning") {
-      d->beginning_ = q.value(x).isNull() ? 0 : q.value(x).toLongLong();
-    }
-    else if (Song::kColumns.value(i) == "length") {
-      set_length_nanosec(tolonglong(x));
-    }
-
-    else if (Song::kColumns.value(i) == "bitrate") {
-      d->bitrate_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "samplerate") {
-      d->samplerate_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "bitdepth") {
-      d->bitdepth_ = toint(x);
-    }
-
-    else if (Song::kColumns.value(i) == "source") {
-      d->source_ = Source(q.value(x).toInt());
-    }
-    else if (Song::kColumns.value(i) == "directory_id") {
-      d->directory_id_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "filename") {
-     set_url(QUrl::fromEncoded(tostr(x).toUtf8()));
-     d->basefilename_ = QFileInfo(d->url_.toLocalFile()).fileName();
-    }
-    else if (Song::kColumns.value(i) == "filetype") {
-      d->filetype_ = FileType(q.value(x).toInt());
-    }
-    else if (Song::kColumns.value(i) == "filesize") {
-      d->filesize_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "mtime") {
-      d->mtime_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "ctime") {
-      d->ctime_ = toint(x);
-    }
-    else if (Song::kColumns.value(i) == "unavailable") {
-      d->unavailable_ = q.value(x).toBool();
-    }
+ private:
+  const SqlRow &row_;
+};
 
-    else if (Song::kColumns.value(i) == "playcount") {
-      d->playcount_ = q.value(x).isNull() ? 0 : q.value(x).toInt();
-    }
-    else if (Song::kColumns.value(i) == "skipcount") {
-      d->skipcount_ = q.value(x).isNull() ? 0 : q.value(x).toInt();
-    }
-    else if (Song::kColumns.value(i) == "lastplayed") {
-      d->lastplayed_ = toint(x);
-    }
+// Null columns are read as -1 or a null string
+template <typename T>
+QString ColumnString(const T &q, int column) { return q.isNull(column) ? QString() : q.toString(column); }
+template <typename T>
+int ColumnInt(const T &q, int column) { return q.isNull(column) ? -1 : q.toInt(column); }
+template <typename T>
+qint64 ColumnLongLong(const T &q, int column) { return q.isNull(column) ? -1 : q.toLongLong(column); }
 
-    else if (Song::kColumns.value(i) == "compilation_detected") {
-      d->compilation_detected_ = q.value(x).toBool();
-    }
-    else if (Song::kColumns.value(i) == "compilation_on") {
-      d->compilation_on_ = q.value(x).toBool();
-    }
-    else if (Song::kColumns.value(i) == "compilation_off") {
-      d->compilation_off_ = q.value(x).toBool();
-    }
-    else if (Song::kColumns.value(i) == "compilation_effective") {
-    }
+}  // namespace
 
-    else if (Song::kColumns.value(i) == "art_automatic") {
-      d->art_automatic_ = q.value(x).toString();
-    }
-    else if (Song::kColumns.value(i) == "art_manual") {
-      d->art_manual_ = q.value(x).toString();
-    }
+template <typename T>
+void Song::InitFromColumns(const T &q, bool reliable_metadata, int col) {
 
-    else if (Song::kColumns.value(i) == "effective_albumartist") {
-    }
-    else if (Song::kColumns.value(i) == "effective_originalyear") {
-    }
-
-    else if (Song::kColumns.value(i) == "cue_path") {
-      d->cue_path_ = tostr(x);
-    }
-
-    else {
-      qLog(Error) << "Forgot to handle" << Song::kColumns.value(i);
-    }
+  if (q.count() < col + kColumns.count() + 1) {
+    qLog(Error) << "Expected" << kColumns.count() + 1 << "columns from" << col << "but got" << q.count() - col;
   }
 
+  d->id_ = ColumnInt(q, col);
+
+  // The columns are read in the same order as kColumns
+  int x = col + 1;
+  d->title_ = ColumnString(q, x++);
+  d->album_ = Intern(ColumnString(q, x++));
+  d->artist_ = Intern(ColumnString(q, x++));
+  d->albumartist_ = Intern(ColumnString(q, x++));
+  d->track_ = ColumnInt(q, x++);
+  d->disc_ = ColumnInt(q, x++);
+  d->year_ = ColumnInt(q, x++);
+  d->originalyear_ = ColumnInt(q, x++);
+  d->genre_ = Intern(ColumnString(q, x++));
+  d->compilation_ = q.toBool(x++);
+  d->composer_ = Intern(ColumnString(q, x++));
+  d->performer_ = Intern(ColumnString(q, x++));
+  d->grouping_ = Intern(ColumnString(q, x++));
+  d->comment_ = ColumnString(q, x++);
+  d->lyrics_ = ColumnString(q, x++);
+
+  d->beginning_ = q.isNull(x) ? 0 : q.toLongLong(x);
+  ++x;
+  set_length_nanosec(ColumnLongLong(q, x++));
+
+  d->bitrate_ = ColumnInt(q, x++);
+  d->samplerate_ = ColumnInt(q, x++);
+  d->bitdepth_ = ColumnInt(q, x++);
+
+  d->source_ = Source(q.toInt(x++));
+  d->directory_id_ = ColumnInt(q, x++);
+  set_url(QUrl::fromEncoded(ColumnString(q, x++).toUtf8()));
+  d->basefilename_ = QFileInfo(d->url_.toLocalFile()).fileName();
+  d->filetype_ = FileType(q.toInt(x++));
+  d->filesize_ = ColumnInt(q, x++);
+  d->mtime_ = ColumnInt(q, x++);
+  d->ctime_ = ColumnInt(q, x++);
+  d->unavailable_ = q.toBool(x++);
+
+  d->playcount_ = q.isNull(x) ? 0 : q.toInt(x);
+  ++x;
+  d->skipcount_ = q.isNull(x) ? 0 : q.toInt(x);
+  ++x;
+  d->lastplayed_ = ColumnInt(q, x++);
+
+  d->compilation_detected_ = q.toBool(x++);
+  d->compilation_on_ = q.toBool(x++);
+  d->compilation_off_ = q.toBool(x++);
+  // compilation_effective is calculated by the database
+  ++x;
+
+  d->art_automatic_ = Intern(ColumnString(q, x++));
+  d->art_manual_ = Intern(ColumnString(q, x++));
+
+  // effective_albumartist and effective_originalyear are calculated by the database
+  x += 2;
+
+  d->cue_path_ = Intern(ColumnString(q, x++));
+
   d->valid_ = true;
   d->init_from_file_ = reliable_metadata;
 
   InitArtManual();
 
-#undef tostr
-#undef toint
-#undef tolonglong
-#undef tofloat
+}
+
+void Song::InitFromQuery(const SqlRow &query, bool reliable_metadata, int col) {
+
+  if (query.statement()) {
+    InitFromColumns(*query.statement(), reliable_metadata, col);
+  }
+  else {
+    InitFromColumns(SqlRowColumns(query), reliable_metadata, col);
+  }
 
 }
 
@@ -856,7 +842,8 @@ void Song::InitFromFilePartial(const QString &filename) {
   }
   else {
     d->valid_ = false;
-    d->error_ = QObject::tr("File %1 is not recognized as a valid audio file.").arg(filename);
+    if (!d->extras_) d->extras_ = new SongExtras;
+    d->extras_->error_ = QObject::tr("File %1 is not recognized as a valid audio file.").arg(filename);
   }
 
 }
@@ -1069,39 +1056,42 @@ void Song::MergeFromSimpleMetaBundle(const Engine::SimpleMetaBundle &bundle) {
 
 }
 
-void Song::BindToQuery(QSqlQuery *query) const {
+QVariantList Song::ColumnValues() const {
 
 #define strval(x) (x.isNull() ? "" : x)
 #define intval(x) (x <= 0 ? -1 : x)
 #define notnullintval(x) (x == -1 ? QVariant() : x)
 
-  // Remember to bind these in the same order as kBindSpec
-
-  query->bindValue(":title", strval(d->title_));
-  query->bindValue(":album", strval(d->album_));
-  query->bindValue(":artist", strval(d->artist_));
-  query->bindValue(":albumartist", strval(d->albumartist_));
-  query->bindValue(":track", intval(d->track_));
-  query->bindValue(":disc", intval(d->disc_));
-  query->bindValue(":year", intval(d->year_));
-  query->bindValue(":originalyear", intval(d->originalyear_));
-  query->bindValue(":genre", strval(d->genre_));
-  query->bindValue(":compilation", d->compilation_ ? 1 : 0);
-  query->bindValue(":composer", strval(d->composer_));
-  query->bindValue(":performer", strval(d->performer_));
-  query->bindValue(":grouping", strval(d->grouping_));
-  query->bindValue(":comment", strval(d->comment_));
-  query->bindValue(":lyrics", strval(d->lyrics_));
-
-  query->bindValue(":beginning", d->beginning_);
-  query->bindValue(":length", intval(length_nanosec()));
-
-  query->bindValue(":bitrate", intval(d->bitrate_));
-  query->bindValue(":samplerate", intval(d->samplerate_));
-  query->bindValue(":bitdepth", intval(d->bitdepth_));
-
-  query->bindValue(":source", d->source_);
-  query->bindValue(":directory_id", notnullintval(d->directory_id_));
+  // Remember to add these in the same order as kColumns
+
+  QVariantList values;
+  values.reserve(kColumns.count());
+
+  values << QVariant(strval(d->title_));
+  values << QVariant(strval(d->album_));
+  values << QVariant(strval(d->artist_));
+  values << QVariant(strval(d->albumartist_));
+  values << QVariant(intval(d->track_));
+  values << QVariant(intval(d->disc_));
+  values << QVariant(intval(d->year_));
+  values << QVariant(intval(d->originalyear_));
+  values << QVariant(strval(d->genre_));
+  values << QVariant(d->compilation_ ? 1 : 0);
+  values << QVariant(strval(d->composer_));
+  values << QVariant(strval(d->performer_));
+  values << QVariant(strval(d->grouping_));
+  values << QVariant(strval(d->comment_));
+  values << QVariant(strval(d->lyrics_));
+
+  values << QVariant(d->beginning_);
+  values << QVariant(intval(length_nanosec()));
+
+  values << QVariant(intval(d->bitrate_));
+  values << QVariant(intval(d->samplerate_));
+  values << QVariant(intval(d->bitdepth_));
+
+  values << QVariant(d->source_);
+  values << QVariant(notnullintval(d->directory_id_));
 
   QString url;
   if (d->url_.isValid()) {
@@ -1112,35 +1102,46 @@ void Song::BindToQuery(QSqlQuery *query) const {
       url = d->url_.toEncoded();
     }
   }
-  query->bindValue(":filename", url);
+  values << QVariant(url);
 
-  query->bindValue(":filetype", d->filetype_);
-  query->bindValue(":filesize", notnullintval(d->filesize_));
-  query->bindValue(":mtime", notnullintval(d->mtime_));
-  query->bindValue(":ctime", notnullintval(d->ctime_));
-  query->bindValue(":unavailable", d->unavailable_ ? 1 : 0);
+  values << QVariant(d->filetype_);
+  values << QVariant(notnullintval(d->filesize_));
+  values << QVariant(notnullintval(d->mtime_));
+  values << QVariant(notnullintval(d->ctime_));
+  values << QVariant(d->unavailable_ ? 1 : 0);
 
-  query->bindValue(":playcount", d->playcount_);
-  query->bindValue(":skipcount", d->skipcount_);
-  query->bindValue(":lastplayed", intval(d->lastplayed_));
+  values << QVariant(d->playcount_);
+  values << QVariant(d->skipcount_);
+  values << QVariant(intval(d->lastplayed_));
 
-  query->bindValue(":compilation_detected", d->compilation_detected_ ? 1 : 0);
-  query->bindValue(":compilation_on", d->compilation_on_ ? 1 : 0);
-  query->bindValue(":compilation_off", d->compilation_off_ ? 1 : 0);
-  query->bindValue(":compilation_effective", is_compilation() ? 1 : 0);
+  values << QVariant(d->compilation_detected_ ? 1 : 0);
+  values << QVariant(d->compilation_on_ ? 1 : 0);
+  values << QVariant(d->compilation_off_ ? 1 : 0);
+  values << QVariant(is_compilation() ? 1 : 0);
 
-  query->bindValue(":art_automatic", d->art_automatic_);
-  query->bindValue(":art_manual", d->art_manual_);
+  values << QVariant(d->art_automatic_);
+  values << QVariant(d->art_manual_);
 
-  query->bindValue(":effective_albumartist", this->effective_albumartist());
-  query->bindValue(":effective_originalyear", intval(this->effective_originalyear()));
+  values << QVariant(this->effective_albumartist());
+  values << QVariant(intval(this->effective_originalyear()));
 
-  query->bindValue(":cue_path", d->cue_path_);
+  values << QVariant(d->cue_path_);
 
 #undef intval
 #undef notnullintval
 #undef strval
 
+  return values;
+
+}
+
+void Song::BindToQuery(QSqlQuery *query) const {
+
+  const QVariantList values = ColumnValues();
+  for (int i = 0 ; i < values.count() ; ++i) {
+    query->bindValue(kBindColumns[i], values[i]);
+  }
+
 }
 
 void Song::BindToFtsQuery(QSqlQuery *query) const {
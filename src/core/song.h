@@ -108,6 +108,7 @@ class Song {
 
   static const QStringList kColumns;
   static const QString kColumnSpec;
+  static const QStringList kBindColumns;
   static const QString kBindSpec;
   static const QString kUpdateSpec;
 
@@ -126,6 +127,11 @@ class Song {
 
   static QString JoinSpec(const QString &table);
 
+  // Compact storage shares the text of fields that repeat across songs, like the artist, album and genre, between all songs loaded after it's enabled.
+  // It costs a pool lookup for every one of these fields set, so it's off unless enabled in the collection settings.
+  static void SetCompactStorage(bool compact);
+  static bool compact_storage();
+
   static Source SourceFromURL(const QUrl &url);
   static QString TextForSource(Source source);
   static QIcon IconForSource(Source source);
@@ -171,6 +177,8 @@ class Song {
   static QString Decode(const QString &tag, const QTextCodec *codec = nullptr);
 
   // Save
+  // The values to store in the database, in the same order as kColumns.
+  QVariantList ColumnValues() const;
   void BindToQuery(QSqlQuery *query) const;
   void BindToFtsQuery(QSqlQuery *query) const;
   void ToXesam(QVariantMap *map) const;
@@ -334,6 +342,10 @@ class Song {
  private:
   struct Private;
 
+  // Reads the song from the columns of a SqlRow or SqlStatement, from the ROWID at col followed by kColumns.
+  template <typename T>
+  void InitFromColumns(const T &query, bool reliable_metadata, int col);
+
   QSharedDataPointer<Private> d;
 };
 Q_DECLARE_METATYPE(Song);
@@ -0,0 +1,221 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <sqlite3.h>
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QVariant>
+#include <QString>
+#include <QSqlDatabase>
+
+#include "core/logging.h"
+#include "database.h"
+#include "sqlstatement.h"
+
+SqlStatement::SqlStatement(Database *database, QSqlDatabase &db, const QString &sql)
+    : database_(database),
+      handle_(Database::SqliteHandle(db)),
+      sql_(sql),
+      stmt_(nullptr),
+      column_count_(0),
+      bind_position_(0),
+      error_(SQLITE_OK) {
+
+  if (!handle_) {
+    error_ = SQLITE_MISUSE;
+    error_message_ = "Not an SQLite connection";
+    return;
+  }
+
+  stmt_ = database_->TakeStatement(handle_, sql_);
+  if (!stmt_) {
+    const QByteArray sql_utf8 = sql_.toUtf8();
+    error_ = sqlite3_prepare_v2(handle_, sql_utf8.constData(), sql_utf8.size(), &stmt_, nullptr);
+    if (error_ != SQLITE_OK) {
+      error_message_ = QString::fromUtf8(sqlite3_errmsg(handle_));
+      sqlite3_finalize(stmt_);
+      stmt_ = nullptr;
+      return;
+    }
+  }
+
+  column_count_ = sqlite3_column_count(stmt_);
+
+}
+
+SqlStatement::~SqlStatement() {
+
+  if (!stmt_) return;
+
+  // Reset the statement before it's cached, so it doesn't keep a read transaction open.
+  sqlite3_reset(stmt_);
+  sqlite3_clear_bindings(stmt_);
+  database_->ReturnStatement(handle_, sql_, stmt_);
+
+}
+
+void SqlStatement::bindValue(const QString &placeholder, const QVariant &value) {
+
+  if (!stmt_) return;
+
+  const int index = sqlite3_bind_parameter_index(stmt_, placeholder.toUtf8().constData());
+  if (index == 0) {
+    qLog(Warning) << "No parameter" << placeholder << "in" << sql_;
+    return;
+  }
+  Bind(index, value);
+
+}
+
+void SqlStatement::addBindValue(const QVariant &value) {
+
+  if (!stmt_) return;
+
+  Bind(++bind_position_, value);
+
+}
+
+void SqlStatement::Bind(int index, const QVariant &value) {
+
+  int result = SQLITE_OK;
+  if (value.isNull()) {
+    result = sqlite3_bind_null(stmt_, index);
+  }
+  else {
+    switch (value.type()) {
+      case QVariant::Bool:
+      case QVariant::Int:
+      case QVariant::UInt:
+      case QVariant::LongLong:
+      case QVariant::ULongLong:
+        result = sqlite3_bind_int64(stmt_, index, value.toLongLong());
+        break;
+      case QVariant::Double:
+        result = sqlite3_bind_double(stmt_, index, value.toDouble());
+        break;
+      case QVariant::ByteArray: {
+        const QByteArray data = value.toByteArray();
+        result = sqlite3_bind_blob(stmt_, index, data.constData(), data.size(), SQLITE_TRANSIENT);
+        break;
+      }
+      default: {
+        const QByteArray text = value.toString().toUtf8();
+        result = sqlite3_bind_text(stmt_, index, text.constData(), text.size(), SQLITE_TRANSIENT);
+        break;
+      }
+    }
+  }
+
+  if (result != SQLITE_OK) {
+    error_ = result;
+    error_message_ = QString::fromUtf8(sqlite3_errmsg(handle_));
+  }
+
+}
+
+bool SqlStatement::next() {
+
+  if (!stmt_ || (error_ != SQLITE_OK && error_ != SQLITE_ROW)) return false;
+
+  const int result = sqlite3_step(stmt_);
+  if (result == SQLITE_ROW) {
+    error_ = SQLITE_ROW;
+    return true;
+  }
+
+  if (result == SQLITE_DONE) {
+    error_ = SQLITE_DONE;
+  }
+  else {
+    error_ = result;
+    error_message_ = QString::fromUtf8(sqlite3_errmsg(handle_));
+  }
+  return false;
+
+}
+
+bool SqlStatement::CheckErrors() const {
+
+  if (error_ == SQLITE_OK || error_ == SQLITE_ROW || error_ == SQLITE_DONE) return false;
+
+  qLog(Error) << "db error: " << error_message_;
+  qLog(Error) << "faulty query: " << sql_;
+  return true;
+
+}
+
+bool SqlStatement::isNull(int column) const {
+
+  return column < 0 || column >= column_count_ || sqlite3_column_type(stmt_, column) == SQLITE_NULL;
+
+}
+
+int SqlStatement::toInt(int column) const {
+
+  if (column < 0 || column >= column_count_) return 0;
+  return sqlite3_column_int(stmt_, column);
+
+}
+
+qint64 SqlStatement::toLongLong(int column) const {
+
+  if (column < 0 || column >= column_count_) return 0;
+  return sqlite3_column_int64(stmt_, column);
+
+}
+
+double SqlStatement::toDouble(int column) const {
+
+  if (column < 0 || column >= column_count_) return 0.0;
+  return sqlite3_column_double(stmt_, column);
+
+}
+
+QString SqlStatement::toString(int column) const {
+
+  if (column < 0 || column >= column_count_) return QString();
+
+  // The text is UTF-8 and only valid until the next step, so it's decoded right away.
+  const char *text = reinterpret_cast<const char*>(sqlite3_column_text(stmt_, column));
+  if (!text) return QString();
+  return QString::fromUtf8(text, sqlite3_column_bytes(stmt_, column));
+
+}
+
+QVariant SqlStatement::value(int column) const {
+
+  if (column < 0 || column >= column_count_) return QVariant();
+
+  switch (sqlite3_column_type(stmt_, column)) {
+    case SQLITE_INTEGER:
+      return QVariant(toLongLong(column));
+    case SQLITE_FLOAT:
+      return QVariant(toDouble(column));
+    case SQLITE_BLOB:
+      return QVariant(QByteArray(static_cast<const char*>(sqlite3_column_blob(stmt_, column)), sqlite3_column_bytes(stmt_, column)));
+    case SQLITE_NULL:
+      return QVariant();
+    default:
+      return QVariant(toString(column));
+  }
+
+}
@@ -0,0 +1,79 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SQLSTATEMENT_H
+#define SQLSTATEMENT_H
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <sqlite3.h>
+#include <boost/noncopyable.hpp>
+
+#include <QtGlobal>
+#include <QVariant>
+#include <QString>
+#include <QSqlDatabase>
+
+class Database;
+
+// A query run straight on the SQLite connection behind a QSqlDatabase, for queries that read a lot of rows.
+// The statement is prepared once per connection and SQL text and kept by the Database, so running the same query again skips parsing it.
+// Columns are read from SQLite as they are asked for, without boxing every column of every row in a QVariant like QSqlQuery does.
+class SqlStatement : boost::noncopyable {
+ public:
+  SqlStatement(Database *database, QSqlDatabase &db, const QString &sql);
+  ~SqlStatement();
+
+  bool isValid() const { return stmt_ != nullptr; }
+
+  void bindValue(const QString &placeholder, const QVariant &value);
+  void addBindValue(const QVariant &value);
+
+  // Runs the statement the first time it's called, then steps to the next row.
+  // Returns false when there are no more rows or on errors.
+  bool next();
+
+  // Logs and returns true if the statement couldn't be prepared or run.
+  bool CheckErrors() const;
+
+  // The columns of the current row
+  int count() const { return column_count_; }
+  bool isNull(int column) const;
+  int toInt(int column) const;
+  qint64 toLongLong(int column) const;
+  double toDouble(int column) const;
+  bool toBool(int column) const { return toInt(column) != 0; }
+  QString toString(int column) const;
+  QVariant value(int column) const;
+
+ private:
+  void Bind(int index, const QVariant &value);
+
+  Database *database_;
+  sqlite3 *handle_;
+  QString sql_;
+  sqlite3_stmt *stmt_;
+  int column_count_;
+  int bind_position_;
+  int error_;
+  QString error_message_;
+};
+
+#endif  // SQLSTATEMENT_H
@@ -0,0 +1,86 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+#include "stringpool.h"
+
+const int StringPool::kMinPurgeSize = 1024;
+
+StringPool::StringPool() {}
+
+QString StringPool::Intern(const QString &str) {
+
+  // Empty strings are already shared
+  if (str.isEmpty()) return QString();
+
+  Shard *shard = &shards_[qHash(str) % kShardCount];
+  QMutexLocker l(&shard->mutex);
+
+  QSet<QString>::const_iterator it = shard->strings.constFind(str);
+  if (it != shard->strings.constEnd()) return *it;
+
+  // Purge when the shard has doubled since the last purge, so strings that went out of use don't pile up
+  if (shard->strings.count() >= qMax(kMinPurgeSize, shard->purge_size * 2)) {
+    Purge(shard);
+  }
+
+  shard->strings.insert(str);
+  return str;
+
+}
+
+void StringPool::Purge() {
+
+  for (Shard &shard : shards_) {
+    QMutexLocker l(&shard.mutex);
+    Purge(&shard);
+  }
+
+}
+
+void StringPool::Purge(Shard *shard) {
+
+  QSet<QString>::iterator it = shard->strings.begin();
+  while (it != shard->strings.end()) {
+    if (it->isDetached()) {
+      it = shard->strings.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+  shard->purge_size = shard->strings.count();
+
+}
+
+int StringPool::size() {
+
+  int count = 0;
+  for (Shard &shard : shards_) {
+    QMutexLocker l(&shard.mutex);
+    count += shard.strings.count();
+  }
+  return count;
+
+}
@@ -0,0 +1,60 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include "config.h"
+
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+// Keeps one shared copy of each distinct string, so text that repeats across many objects, like the artist of every song on an album,
+// is only stored once.  Strings nothing but the pool refers to are dropped as the pool grows.  Safe to use from any thread.
+class StringPool {
+ public:
+  StringPool();
+
+  // Returns the pooled copy of str, adding it if it's not there yet.
+  QString Intern(const QString &str);
+
+  // Drops the strings that are only referenced by the pool.
+  void Purge();
+
+  int size();
+
+ private:
+  static const int kShardCount = 16;
+  static const int kMinPurgeSize;
+
+  struct Shard {
+    Shard() : purge_size(0) {}
+    QMutex mutex;
+    QSet<QString> strings;
+    // Size of the shard after the last purge
+    int purge_size;
+  };
+
+  static void Purge(Shard *shard);
+
+  Shard shards_[kShardCount];
+};
+
+#endif  // STRINGPOOL_H
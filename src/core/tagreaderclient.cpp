@@ -26,7 +26,9 @@
 #include <QObject>
 #include <QThread>
 #include <QByteArray>
+#include <QList>
 #include <QString>
+#include <QStringList>
 #include <QImage>
 #include <QtDebug>
 
@@ -37,14 +39,15 @@
 #include "tagreaderclient.h"
 
 const char *TagReaderClient::kWorkerExecutableName = "strawberry-tagreader";
+const int TagReaderClient::kMaxReadFilesBatchSize = 64;
 TagReaderClient *TagReaderClient::sInstance = nullptr;
 
-TagReaderClient::TagReaderClient(QObject *parent) : QObject(parent), worker_pool_(new WorkerPool<HandlerType>(this)) {
+TagReaderClient::TagReaderClient(QObject *parent) : QObject(parent), worker_pool_(new WorkerPool<HandlerType>(this)), worker_count_(QThread::idealThreadCount()) {
 
   sInstance = this;
 
   worker_pool_->SetExecutableName(kWorkerExecutableName);
-  worker_pool_->SetWorkerCount(QThread::idealThreadCount());
+  worker_pool_->SetWorkerCount(worker_count_);
   connect(worker_pool_, SIGNAL(WorkerFailedToStart()), SLOT(WorkerFailedToStart()));
 }
 
@@ -65,6 +68,19 @@ TagReaderReply *TagReaderClient::ReadFile(const QString &filename) {
 
 }
 
+TagReaderReply *TagReaderClient::ReadFiles(const QStringList &filenames) {
+
+  pb::tagreader::Message message;
+  pb::tagreader::ReadFilesRequest *req = message.mutable_read_files_request();
+
+  for (const QString &filename : filenames) {
+    req->add_filenames(DataCommaSizeFromQString(filename));
+  }
+
+  return worker_pool_->SendMessageWithReply(&message);
+
+}
+
 TagReaderReply *TagReaderClient::SaveFile(const QString &filename, const Song &metadata) {
 
   pb::tagreader::Message message;
@@ -113,6 +129,42 @@ void TagReaderClient::ReadFileBlocking(const QString &filename, Song *song) {
 
 }
 
+SongList TagReaderClient::ReadFilesBlocking(const QStringList &filenames) {
+
+  Q_ASSERT(QThread::currentThread() != thread());
+
+  SongList songs;
+  if (filenames.isEmpty()) return songs;
+
+  // Send all the batches before waiting, the worker pool hands them out to the workers round-robin.
+  const int batch_size = qBound(1, (filenames.count() + worker_count_ - 1) / qMax(1, worker_count_), kMaxReadFilesBatchSize);
+
+  QList<TagReaderReply*> replies;
+  QList<int> batch_sizes;
+  for (int i = 0 ; i < filenames.count() ; i += batch_size) {
+    const QStringList batch = filenames.mid(i, batch_size);
+    replies << ReadFiles(batch);
+    batch_sizes << batch.count();
+  }
+
+  for (int i = 0 ; i < replies.count() ; ++i) {
+    TagReaderReply *reply = replies[i];
+    const bool success = reply->WaitForFinished();
+    const pb::tagreader::ReadFilesResponse &response = reply->message().read_files_response();
+    for (int j = 0 ; j < batch_sizes[i] ; ++j) {
+      Song song;
+      if (success && j < response.metadata_size()) {
+        song.InitFromProtobuf(response.metadata(j));
+      }
+      songs << song;
+    }
+    reply->deleteLater();
+  }
+
+  return songs;
+
+}
+
 bool TagReaderClient::SaveFileBlocking(const QString &filename, const Song &metadata) {
 
   Q_ASSERT(QThread::currentThread() != thread());
@@ -28,6 +28,7 @@
 #include <QObject>
 #include <QList>
 #include <QString>
+#include <QStringList>
 #include <QImage>
 
 #include "core/messagehandler.h"
@@ -49,10 +50,13 @@ class TagReaderClient : public QObject {
   typedef HandlerType::ReplyType ReplyType;
 
   static const char *kWorkerExecutableName;
+  static const int kMaxReadFilesBatchSize;
 
   void Start();
 
   ReplyType *ReadFile(const QString &filename);
+  // Reads the tags of all the files in one message, the response has one SongMetadata for each file in the same order.
+  ReplyType *ReadFiles(const QStringList &filenames);
   ReplyType *SaveFile(const QString &filename, const Song &metadata);
   ReplyType *IsMediaFile(const QString &filename);
   ReplyType *LoadEmbeddedArt(const QString &filename);
@@ -60,6 +64,9 @@ class TagReaderClient : public QObject {
   // Convenience functions that call the above functions and wait for a response.
   // These block the calling thread with a semaphore, and must NOT be called from the TagReaderClient's thread.
   void ReadFileBlocking(const QString &filename, Song *song);
+  // Splits the files into one batch per worker so they are all read in parallel.
+  // Returns one song for each file in the same order, songs that couldn't be read are invalid.
+  SongList ReadFilesBlocking(const QStringList &filenames);
   bool SaveFileBlocking(const QString &filename, const Song &metadata);
   bool IsMediaFileBlocking(const QString &filename);
   QImage LoadEmbeddedArtBlocking(const QString &filename);
@@ -74,6 +81,7 @@ class TagReaderClient : public QObject {
   static TagReaderClient *sInstance;
 
   WorkerPool<HandlerType> *worker_pool_;
+  int worker_count_;
   QList<pb::tagreader::Message> message_queue_;
 };
 
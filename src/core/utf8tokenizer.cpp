@@ -0,0 +1,282 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <vector>
+
+#include <QtGlobal>
+#include <QChar>
+#include <QString>
+#include <QVector>
+
+#include "utf8tokenizer.h"
+
+const uint Utf8Tokenizer::kSeparator = 0;
+const uint Utf8Tokenizer::kIgnore = 1;
+
+namespace {
+
+const uint kInvalidCodePoint = 0xFFFFFFFF;
+const uint kMaxCodePoint = 0x10FFFF;
+
+// Lookup table of Utf8Tokenizer::Fold() for every code point, built once from Qt's unicode tables.
+// Code points are split in pages of 256, pages where all code points are separators, or all are letters that are already normalized, aren't stored.
+class FoldTable {
+ public:
+  FoldTable();
+
+  inline uint Lookup(uint code_point) const {
+    if (code_point < 0x80) return ascii_[code_point];
+    if (code_point > kMaxCodePoint) return Utf8Tokenizer::kSeparator;
+    const uint page = code_point >> kPageBits;
+    const int index = pages_[page];
+    if (index == kSeparatorPage) return Utf8Tokenizer::kSeparator;
+    if (index == kIdentityPage) return code_point;
+    return storage_[(index << kPageBits) | (code_point & kPageMask)];
+  }
+
+ private:
+  static const uint kPageBits = 8;
+  static const uint kPageSize = 1 << kPageBits;
+  static const uint kPageMask = kPageSize - 1;
+  static const uint kPageCount = (kMaxCodePoint + 1) >> kPageBits;
+  static const int kSeparatorPage = -1;
+  static const int kIdentityPage = -2;
+
+  static uint Compute(uint code_point);
+
+  uint ascii_[0x80];
+  int pages_[kPageCount];
+  std::vector<uint> storage_;
+};
+
+FoldTable::FoldTable() {
+
+  for (uint c = 0 ; c < 0x80 ; ++c) {
+    ascii_[c] = Compute(c);
+  }
+
+  uint page_values[kPageSize];
+  for (uint page = 0 ; page < kPageCount ; ++page) {
+    bool all_separators = true;
+    bool all_identity = true;
+    for (uint i = 0 ; i < kPageSize ; ++i) {
+      const uint code_point = (page << kPageBits) | i;
+      const uint value = Compute(code_point);
+      page_values[i] = value;
+      if (value != Utf8Tokenizer::kSeparator) all_separators = false;
+      if (value != code_point) all_identity = false;
+    }
+
+    if (all_separators) {
+      pages_[page] = kSeparatorPage;
+    }
+    else if (all_identity) {
+      pages_[page] = kIdentityPage;
+    }
+    else {
+      pages_[page] = int(storage_.size() >> kPageBits);
+      storage_.insert(storage_.end(), page_values, page_values + kPageSize);
+    }
+  }
+
+}
+
+uint FoldTable::Compute(uint code_point) {
+
+  // Lone surrogates are invalid in UTF-8.
+  if (code_point >= 0xD800 && code_point <= 0xDFFF) return Utf8Tokenizer::kSeparator;
+
+  // Combining marks are dropped, so "cafe" followed by a combining acute accent matches "cafe".
+  if (QChar::category(code_point) == QChar::Mark_NonSpacing) return Utf8Tokenizer::kIgnore;
+
+  if (!QChar::isLetterOrNumber(code_point)) return Utf8Tokenizer::kSeparator;
+
+  uint folded = QChar::toCaseFolded(code_point);
+
+  // Strip diacritics by following the canonical decomposition down to the base character.
+  // Compatibility decompositions like the "fi" ligature expand to more than one letter, a single code point can't hold those, so they are left as they are.
+  // Hangul syllables decompose to their jamo, the first one of those isn't the base of the syllable, so leave them alone.
+  if (folded >= 0xAC00 && folded <= 0xD7A3) return folded;
+  for (int depth = 0 ; depth < 4 && QChar::decompositionTag(folded) == QChar::Canonical ; ++depth) {
+    const QVector<uint> decomposition = QChar::decomposition(folded).toUcs4();
+    if (decomposition.isEmpty() || !QChar::isLetterOrNumber(decomposition.first())) break;
+    folded = QChar::toCaseFolded(decomposition.first());
+  }
+
+  // Never clash with the special values.
+  if (folded == Utf8Tokenizer::kSeparator || folded == Utf8Tokenizer::kIgnore) return Utf8Tokenizer::kSeparator;
+
+  return folded;
+
+}
+
+const FoldTable &Table() {
+
+  static const FoldTable table;
+  return table;
+
+}
+
+// Decodes the UTF-8 sequence at data, sets length to the number of bytes it uses.
+// Returns kInvalidCodePoint for invalid or overlong sequences, which are skipped one byte at a time.
+inline uint DecodeUtf8(const uchar *data, const uchar *end, int *length) {
+
+  const uchar lead = data[0];
+  uint code_point;
+  uint min;
+  int n;
+
+  if (lead < 0x80) {
+    *length = 1;
+    return lead;
+  }
+  else if ((lead & 0xE0) == 0xC0) {
+    code_point = lead & 0x1F;
+    min = 0x80;
+    n = 2;
+  }
+  else if ((lead & 0xF0) == 0xE0) {
+    code_point = lead & 0x0F;
+    min = 0x800;
+    n = 3;
+  }
+  else if ((lead & 0xF8) == 0xF0) {
+    code_point = lead & 0x07;
+    min = 0x10000;
+    n = 4;
+  }
+  else {
+    *length = 1;
+    return kInvalidCodePoint;
+  }
+
+  *length = 1;
+  if (end - data < n) return kInvalidCodePoint;
+  for (int i = 1 ; i < n ; ++i) {
+    if ((data[i] & 0xC0) != 0x80) return kInvalidCodePoint;
+    code_point = (code_point << 6) | (data[i] & 0x3F);
+  }
+  if (code_point < min || code_point > kMaxCodePoint) return kInvalidCodePoint;
+
+  *length = n;
+  return code_point;
+
+}
+
+}  // namespace
+
+uint Utf8Tokenizer::Fold(uint code_point) {
+  return Table().Lookup(code_point);
+}
+
+Utf8Tokenizer::Utf8Tokenizer(const char *input, int bytes)
+    : input_(reinterpret_cast<const uchar*>(input)),
+      bytes_(input ? bytes : 0),
+      offset_(0),
+      in_place_(true) {
+
+  // A negative size means the input is null terminated.
+  if (bytes_ < 0) bytes_ = int(qstrlen(input));
+
+}
+
+bool Utf8Tokenizer::Next(const char **token, int *token_bytes, int *start_offset, int *end_offset) {
+
+  const FoldTable &table = Table();
+  const uchar *end = input_ + bytes_;
+
+  // Skip to the start of the next token.
+  while (offset_ < bytes_) {
+    int length = 1;
+    const uint code_point = input_[offset_] < 0x80 ? input_[offset_] : DecodeUtf8(input_ + offset_, end, &length);
+    const uint folded = code_point == kInvalidCodePoint ? kSeparator : table.Lookup(code_point);
+    if (folded != kSeparator && folded != kIgnore) break;
+    offset_ += length;
+  }
+  if (offset_ >= bytes_) return false;
+
+  const int start = offset_;
+  in_place_ = true;
+  buffer_.resize(0);
+
+  while (offset_ < bytes_) {
+    int length = 1;
+    const uint code_point = input_[offset_] < 0x80 ? input_[offset_] : DecodeUtf8(input_ + offset_, end, &length);
+    const uint folded = code_point == kInvalidCodePoint ? kSeparator : table.Lookup(code_point);
+    if (folded == kSeparator) break;
+
+    if (folded != code_point && in_place_) StartCopy(start);
+    if (!in_place_ && folded != kIgnore) {
+      if (folded < 0x80) buffer_.append(char(folded));
+      else AppendUtf8(folded);
+    }
+
+    offset_ += length;
+  }
+
+  if (in_place_) {
+    *token = reinterpret_cast<const char*>(input_ + start);
+    *token_bytes = offset_ - start;
+  }
+  else {
+    *token = buffer_.constData();
+    *token_bytes = buffer_.size();
+  }
+  *start_offset = start;
+  *end_offset = offset_;
+
+  return true;
+
+}
+
+void Utf8Tokenizer::StartCopy(int start) {
+
+  // Everything up to here was already normalized.
+  buffer_.append(reinterpret_cast<const char*>(input_ + start), offset_ - start);
+  in_place_ = false;
+
+}
+
+void Utf8Tokenizer::AppendUtf8(uint code_point) {
+
+  char bytes[4];
+  int n;
+  if (code_point < 0x800) {
+    bytes[0] = char(0xC0 | (code_point >> 6));
+    bytes[1] = char(0x80 | (code_point & 0x3F));
+    n = 2;
+  }
+  else if (code_point < 0x10000) {
+    bytes[0] = char(0xE0 | (code_point >> 12));
+    bytes[1] = char(0x80 | ((code_point >> 6) & 0x3F));
+    bytes[2] = char(0x80 | (code_point & 0x3F));
+    n = 3;
+  }
+  else {
+    bytes[0] = char(0xF0 | (code_point >> 18));
+    bytes[1] = char(0x80 | ((code_point >> 12) & 0x3F));
+    bytes[2] = char(0x80 | ((code_point >> 6) & 0x3F));
+    bytes[3] = char(0x80 | (code_point & 0x3F));
+    n = 4;
+  }
+  buffer_.append(bytes, n);
+
+}
@@ -0,0 +1,58 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef UTF8TOKENIZER_H
+#define UTF8TOKENIZER_H
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QVarLengthArray>
+
+// Splits UTF-8 text into case folded words without diacritics, used for the full text search index.
+// The input is scanned in place, tokens that are already normalized (like most lowercase ASCII words) point straight into the input,
+// others are written to a small buffer owned by the tokenizer, which only goes to the heap for very long words.
+class Utf8Tokenizer {
+ public:
+  Utf8Tokenizer(const char *input, int bytes);
+
+  // Finds the next token and returns false at the end of the input.
+  // The token is only valid until the next call.  The offsets are the byte range of the token in the input, the end is exclusive.
+  bool Next(const char **token, int *token_bytes, int *start_offset, int *end_offset);
+
+  // The normalized form of a single code point, kSeparator for characters that end a token,
+  // and kIgnore for characters that are dropped from a token, like combining diacritical marks.
+  static uint Fold(uint code_point);
+
+  static const uint kSeparator;
+  static const uint kIgnore;
+
+ private:
+  void StartCopy(int start);
+  void AppendUtf8(uint code_point);
+
+  const uchar *input_;
+  int bytes_;
+  int offset_;
+
+  bool in_place_;
+  QVarLengthArray<char, 128> buffer_;
+};
+
+#endif  // UTF8TOKENIZER_H
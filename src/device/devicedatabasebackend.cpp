@@ -45,8 +45,7 @@ void DeviceDatabaseBackend::Init(Database* db) { db_ = db; }
 
 DeviceDatabaseBackend::DeviceList DeviceDatabaseBackend::GetAllDevices() {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   DeviceList ret;
 
@@ -0,0 +1,263 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <atomic>
+#include <functional>
+#include <stdlib.h>
+
+#include <glib.h>
+#include <gst/gst.h>
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QString>
+#include <QUrl>
+
+#include "core/logging.h"
+#include "core/signalchecker.h"
+#include "analysispipeline.h"
+
+AnalysisPipeline::AnalysisPipeline(const QUrl &url)
+    : url_(url),
+      pipeline_(nullptr),
+      convert_element_(nullptr),
+      finishing_early_(false),
+      finished_(false),
+      run_finished_(false),
+      success_(false) {}
+
+AnalysisPipeline::~AnalysisPipeline() { Cleanup(); }
+
+void AnalysisPipeline::AddAnalyzer(Analyzer *analyzer) {
+
+  // The probes point into branches_
+  Q_ASSERT(!pipeline_);
+
+  Branch branch = { this, analyzer };
+  branches_.push_back(branch);
+
+}
+
+GstElement *AnalysisPipeline::CreateElement(const QString &factory_name) {
+
+  GstElement *ret = gst_element_factory_make(factory_name.toLatin1().constData(), nullptr);
+
+  if (ret) {
+    gst_bin_add(GST_BIN(pipeline_), ret);
+  }
+  else {
+    qLog(Warning) << "Unable to create gstreamer element" << factory_name;
+  }
+
+  return ret;
+
+}
+
+bool AnalysisPipeline::Start(FinishedCallback callback) {
+
+  if (pipeline_ || branches_.empty()) return false;
+
+  callback_ = callback;
+
+  pipeline_ = gst_pipeline_new("analysis-pipeline");
+
+  GstElement *decodebin = CreateElement("uridecodebin");
+  convert_element_ = CreateElement("audioconvert");
+  GstElement *tee = CreateElement("tee");
+
+  if (!decodebin || !convert_element_ || !tee || !gst_element_link(convert_element_, tee)) {
+    qLog(Error) << "Failed to create the analysis pipeline for" << url_;
+    Cleanup();
+    return false;
+  }
+
+  for (Branch &branch : branches_) {
+    GstElement *queue = CreateElement("queue");
+    GstElement *convert = CreateElement("audioconvert");
+    GstElement *first = branch.analyzer->CreateElements(pipeline_);
+
+    if (!queue || !convert || !first || !gst_element_link_many(tee, queue, convert, first, nullptr)) {
+      qLog(Error) << "Failed to link the analysis pipeline for" << url_;
+      Cleanup();
+      return false;
+    }
+
+    // Drop the audio as soon as the analyzer is done, before the branch spends any time on it.
+    GstPad *pad = gst_element_get_static_pad(queue, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &BranchProbeCallback, &branch, nullptr);
+    gst_object_unref(pad);
+  }
+
+  g_object_set(decodebin, "uri", url_.toEncoded().constData(), nullptr);
+  CHECKED_GCONNECT(decodebin, "pad-added", &NewPadCallback, this);
+
+  GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+  gst_bus_set_sync_handler(bus, BusCallbackSync, this, nullptr);
+  gst_object_unref(bus);
+
+  gst_element_set_state(pipeline_, GST_STATE_PLAYING);
+
+  return true;
+
+}
+
+bool AnalysisPipeline::Run(int timeout_msec) {
+
+  if (!Start()) return false;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  QMutexLocker l(&mutex_);
+  while (!run_finished_) {
+    const qint64 remaining = timeout_msec - timer.elapsed();
+    if (remaining <= 0 || !finished_condition_.wait(&mutex_, static_cast<unsigned long>(remaining))) break;
+  }
+
+  if (!run_finished_) {
+    // Anything that comes in after the timeout is ignored
+    finished_ = true;
+    qLog(Warning) << "Timed out analyzing" << url_;
+    return false;
+  }
+
+  return success_;
+
+}
+
+void AnalysisPipeline::Finish(bool success) {
+
+  if (finished_.exchange(true)) return;
+
+  if (callback_) callback_(success);
+
+  QMutexLocker l(&mutex_);
+  success_ = success;
+  run_finished_ = true;
+  finished_condition_.wakeAll();
+
+}
+
+void AnalysisPipeline::MaybeFinishEarly() {
+
+  for (const Branch &branch : branches_) {
+    if (!branch.analyzer->done()) return;
+  }
+
+  if (finishing_early_.exchange(true)) return;
+
+  // Handled like the end of the file by the bus callback
+  gst_element_post_message(pipeline_, gst_message_new_application(GST_OBJECT(pipeline_), gst_structure_new_empty("analysis-done")));
+
+}
+
+void AnalysisPipeline::Cleanup() {
+
+  if (!pipeline_) return;
+
+  GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+  gst_bus_set_sync_handler(bus, nullptr, nullptr, nullptr);
+  gst_object_unref(bus);
+
+  gst_element_set_state(pipeline_, GST_STATE_NULL);
+  gst_object_unref(pipeline_);
+  pipeline_ = nullptr;
+  convert_element_ = nullptr;
+
+}
+
+void AnalysisPipeline::NewPadCallback(GstElement*, GstPad *pad, gpointer data) {
+
+  AnalysisPipeline *self = reinterpret_cast<AnalysisPipeline*>(data);
+
+  if (self->finished_) {
+    qLog(Warning) << "Received gstreamer callback after pipeline has stopped.";
+    return;
+  }
+
+  GstPad *const audiopad = gst_element_get_static_pad(self->convert_element_, "sink");
+
+  if (GST_PAD_IS_LINKED(audiopad)) {
+    qLog(Warning) << "audiopad is already linked, unlinking old pad";
+    gst_pad_unlink(audiopad, GST_PAD_PEER(audiopad));
+  }
+
+  gst_pad_link(pad, audiopad);
+  gst_object_unref(audiopad);
+
+  int rate = 0;
+  GstCaps *caps = gst_pad_get_current_caps(pad);
+  if (caps) {
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    gst_structure_get_int(structure, "rate", &rate);
+    gst_caps_unref(caps);
+  }
+
+  for (const Branch &branch : self->branches_) {
+    branch.analyzer->SetSampleRate(rate);
+  }
+
+}
+
+GstPadProbeReturn AnalysisPipeline::BranchProbeCallback(GstPad*, GstPadProbeInfo*, gpointer data) {
+
+  Branch *branch = reinterpret_cast<Branch*>(data);
+
+  if (!branch->analyzer->done()) return GST_PAD_PROBE_OK;
+
+  branch->pipeline->MaybeFinishEarly();
+  return GST_PAD_PROBE_DROP;
+
+}
+
+GstBusSyncReply AnalysisPipeline::BusCallbackSync(GstBus*, GstMessage *msg, gpointer data) {
+
+  AnalysisPipeline *self = reinterpret_cast<AnalysisPipeline*>(data);
+
+  switch (GST_MESSAGE_TYPE(msg)) {
+    case GST_MESSAGE_EOS:
+    case GST_MESSAGE_APPLICATION:
+      self->Finish(true);
+      break;
+
+    case GST_MESSAGE_ERROR: {
+      GError *error = nullptr;
+      gchar *debugs = nullptr;
+      gst_message_parse_error(msg, &error, &debugs);
+      const QString message = QString::fromLocal8Bit(error->message);
+      g_error_free(error);
+      free(debugs);
+
+      qLog(Error) << "Error processing" << self->url_ << ":" << message;
+      self->Finish(false);
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  // Nobody watches the bus, so don't let messages pile up on it
+  return GST_BUS_DROP;
+
+}
@@ -0,0 +1,114 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ANALYSISPIPELINE_H
+#define ANALYSISPIPELINE_H
+
+#include "config.h"
+
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+#include <glib.h>
+#include <gst/gst.h>
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+#include <QUrl>
+
+// Decodes a local file once and passes the audio to any number of analyzers, like the moodbar and the chromaprint fingerprint.
+// Each analyzer gets a branch of its own behind a tee: a queue, an audioconvert and the elements the analyzer adds.
+// The queues give every branch its own streaming thread, so analyzers don't hold each other up.
+class AnalysisPipeline : boost::noncopyable {
+ public:
+  class Analyzer {
+   public:
+    Analyzer() : done_(false) {}
+    virtual ~Analyzer() {}
+
+    // Adds the elements of the branch to bin and returns the one that gets the audio, its sink pad is linked to an audioconvert.
+    virtual GstElement *CreateElements(GstElement *bin) = 0;
+
+    // Called from a streaming thread once the sample rate of the decoded audio is known.
+    virtual void SetSampleRate(int) {}
+
+    // An analyzer that has seen enough calls this, its branch gets no more audio after it.
+    // When all analyzers are done the pipeline finishes without decoding the rest of the file.
+    void set_done() { done_ = true; }
+    bool done() const { return done_; }
+
+   private:
+    std::atomic<bool> done_;
+  };
+
+  // Called from a streaming thread, the pipeline can't be deleted from there.
+  typedef std::function<void(bool success)> FinishedCallback;
+
+  explicit AnalysisPipeline(const QUrl &url);
+  ~AnalysisPipeline();
+
+  const QUrl &url() const { return url_; }
+
+  // Analyzers are added before the pipeline is started and must outlive it.
+  void AddAnalyzer(Analyzer *analyzer);
+
+  // Starts decoding and returns right away.
+  bool Start(FinishedCallback callback = FinishedCallback());
+
+  // Starts decoding and waits until the file is done or timeout_msec has passed.
+  // Returns false on errors and timeouts.
+  bool Run(int timeout_msec);
+
+ private:
+  struct Branch {
+    AnalysisPipeline *pipeline;
+    Analyzer *analyzer;
+  };
+
+  GstElement *CreateElement(const QString &factory_name);
+  void Finish(bool success);
+  void MaybeFinishEarly();
+  void Cleanup();
+
+  static void NewPadCallback(GstElement*, GstPad *pad, gpointer data);
+  static GstPadProbeReturn BranchProbeCallback(GstPad*, GstPadProbeInfo*, gpointer data);
+  static GstBusSyncReply BusCallbackSync(GstBus*, GstMessage *msg, gpointer data);
+
+ private:
+  QUrl url_;
+  std::vector<Branch> branches_;
+
+  GstElement *pipeline_;
+  GstElement *convert_element_;
+
+  FinishedCallback callback_;
+  std::atomic<bool> finishing_early_;
+  std::atomic<bool> finished_;
+
+  // For Run()
+  QMutex mutex_;
+  QWaitCondition finished_condition_;
+  bool run_finished_;
+  bool success_;
+};
+
+#endif  // ANALYSISPIPELINE_H
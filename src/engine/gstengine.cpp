@@ -27,6 +27,7 @@
 #include <gio/gio.h>
 #include <memory>
 #include <vector>
+#include <algorithm>
 #include <math.h>
 #include <string>
 
@@ -82,15 +83,12 @@ GstEngine::GstEngine(TaskManager *task_manager)
     : Engine::Base(),
       task_manager_(task_manager),
       buffering_task_id_(-1),
-      latest_buffer_(nullptr),
       stereo_balance_(0.0f),
       seek_timer_(new QTimer(this)),
       timer_id_(-1),
       next_element_id_(0),
       is_fading_out_to_pause_(false),
-      has_faded_out_(false),
-      scope_chunk_(0),
-      have_new_buffer_(false) {
+      has_faded_out_(false) {
 
   type_ = Engine::GStreamer;
   seek_timer_->setSingleShot(true);
@@ -316,23 +314,12 @@ qint64 GstEngine::length_nanosec() const {
 
 const Engine::Scope &GstEngine::scope(int chunk_length) {
 
-  // The new buffer could have a different size
-  if (have_new_buffer_) {
-    if (latest_buffer_) {
-      scope_chunks_ = ceil(((double)GST_BUFFER_DURATION(latest_buffer_) / (double)(chunk_length * kNsecPerMsec)));
-    }
-
-    // if the buffer is shorter than the chunk length
-    if (scope_chunks_ <= 0) {
-      scope_chunks_ = 1;
-    }
+  Q_UNUSED(chunk_length);
 
-    scope_chunk_ = 0;
-    have_new_buffer_ = false;
-  }
-
-  if (latest_buffer_) {
-    UpdateScope(chunk_length);
+  if (current_pipeline_) {
+    // The most recent samples, the rest is silence if less than a scope has been played yet.
+    const int count = current_pipeline_->scope_buffer().ReadLatest(scope_.data(), scope_.size());
+    std::fill(scope_.begin() + count, scope_.end(), 0);
   }
 
   return scope_;
@@ -411,15 +398,6 @@ GstElement *GstEngine::CreateElement(const QString &factoryName, GstElement *bin
   return element;
 }
 
-void GstEngine::ConsumeBuffer(GstBuffer *buffer, int pipeline_id) {
-
-  // Schedule this to run in the GUI thread.  The buffer gets added to the queue and unreffed by UpdateScope.
-  if (!QMetaObject::invokeMethod(this, "AddBufferToScope", Q_ARG(GstBuffer*, buffer), Q_ARG(int, pipeline_id))) {
-    qLog(Warning) << "Failed to invoke AddBufferToScope on GstEngine";
-  }
-
-}
-
 void GstEngine::SetEqualizerEnabled(bool enabled) {
 
   equalizer_enabled_ = enabled;
@@ -521,22 +499,6 @@ void GstEngine::NewMetaData(int pipeline_id, const Engine::SimpleMetaBundle &bun
   emit MetaData(bundle);
 }
 
-void GstEngine::AddBufferToScope(GstBuffer *buf, int pipeline_id) {
-
-  if (!current_pipeline_ || current_pipeline_->id() != pipeline_id) {
-    gst_buffer_unref(buf);
-    return;
-  }
-
-  if (latest_buffer_) {
-    gst_buffer_unref(latest_buffer_);
-  }
-
-  latest_buffer_ = buf;
-  have_new_buffer_ = true;
-
-}
-
 void GstEngine::FadeoutFinished() {
   fadeout_pipeline_.reset();
   emit FadeoutFinishedSignal();
@@ -746,7 +708,6 @@ shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline() {
   ret->set_buffer_min_fill(buffer_min_fill_);
   ret->SetEqualizerEnabled(equalizer_enabled_);
 
-  ret->AddBufferConsumer(this);
   for (GstBufferConsumer *consumer : buffer_consumers_) {
     ret->AddBufferConsumer(consumer);
   }
@@ -769,51 +730,3 @@ shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline(const QByteArray &gst_ur
   return ret;
 
 }
-
-void GstEngine::UpdateScope(int chunk_length) {
-
-  typedef Engine::Scope::value_type sample_type;
-
-  // Prevent dbz or invalid chunk size
-  if (!GST_CLOCK_TIME_IS_VALID(GST_BUFFER_DURATION(latest_buffer_))) return;
-  if (GST_BUFFER_DURATION(latest_buffer_) == 0) return;
-
-  GstMapInfo map;
-  gst_buffer_map(latest_buffer_, &map, GST_MAP_READ);
-
-  // Determine where to split the buffer
-  int chunk_density = (map.size * kNsecPerMsec) / GST_BUFFER_DURATION(latest_buffer_);
-
-  int chunk_size = chunk_length * chunk_density;
-
-  // In case a buffer doesn't arrive in time
-  if (scope_chunk_ >= scope_chunks_) {
-    scope_chunk_ = 0;
-    return;
-  }
-
-  const sample_type *source = reinterpret_cast<sample_type*>(map.data);
-  sample_type *dest = scope_.data();
-  source += (chunk_size / sizeof(sample_type)) * scope_chunk_;
-
-  int bytes = 0;
-
-  // Make sure we don't go beyond the end of the buffer
-  if (scope_chunk_ == scope_chunks_ - 1) {
-    bytes = qMin(static_cast<Engine::Scope::size_type>(map.size - (chunk_size  * scope_chunk_)), scope_.size() * sizeof(sample_type));
-  }
-  else {
-    bytes = qMin(static_cast<Engine::Scope::size_type>(chunk_size), scope_.size() * sizeof(sample_type));
-  }
-
-  scope_chunk_++;
-  memcpy(dest, source, bytes);
-
-  gst_buffer_unmap(latest_buffer_, &map);
-
-  if (scope_chunk_ == scope_chunks_) {
-    gst_buffer_unref(latest_buffer_);
-    latest_buffer_ = nullptr;
-  }
-
-}
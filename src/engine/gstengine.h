@@ -60,7 +60,7 @@ typedef struct _GTlsDatabase GTlsDatabase;
  * @short GStreamer engine plugin
  * @author Mark Kretschmann <markey@web.de>
  */
-class GstEngine : public Engine::Base, public GstBufferConsumer {
+class GstEngine : public Engine::Base {
   Q_OBJECT
 
  public:
@@ -95,7 +95,6 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   void EnsureInitialised() { gst_startup_->EnsureInitialised(); }
 
   GstElement *CreateElement(const QString &factoryName, GstElement *bin = nullptr, bool showerror = true);
-  void ConsumeBuffer(GstBuffer *buffer, int pipeline_id);
 
  public slots:
 
@@ -124,7 +123,6 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   void EndOfStreamReached(int pipeline_id, bool has_next_track);
   void HandlePipelineError(int pipeline_id, const QString &message, int domain, int error_code);
   void NewMetaData(int pipeline_id, const Engine::SimpleMetaBundle &bundle);
-  void AddBufferToScope(GstBuffer *buf, int pipeline_id);
   void FadeoutFinished();
   void FadeoutPauseFinished();
   void SeekNow();
@@ -160,8 +158,6 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   std::shared_ptr<GstEnginePipeline> CreatePipeline();
   std::shared_ptr<GstEnginePipeline> CreatePipeline(const QByteArray &gst_url, const QUrl &original_url,  qint64 end_nanosec);
 
-  void UpdateScope(int chunk_length);
-
  private:
   static const qint64 kTimerIntervalNanosec = 1000 * kNsecPerMsec;  // 1s
   static const qint64 kPreloadGapNanosec = 3000 * kNsecPerMsec;     // 3s
@@ -178,8 +174,6 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
 
   QList<GstBufferConsumer*> buffer_consumers_;
 
-  GstBuffer *latest_buffer_;
-
   int equalizer_preamp_;
   QList<int> equalizer_gains_;
   float stereo_balance_;
@@ -198,10 +192,6 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   bool is_fading_out_to_pause_;
   bool has_faded_out_;
 
-  int scope_chunk_;
-  bool have_new_buffer_;
-  int scope_chunks_;
-
 #ifdef Q_OS_MACOS
   GTlsDatabase* tls_database_;
 #endif
@@ -25,6 +25,7 @@
 #include <glib.h>
 #include <glib-object.h>
 #include <gst/gst.h>
+#include <gst/audio/audio.h>
 
 #include <QtGlobal>
 #include <QObject>
@@ -52,6 +53,8 @@
 const int GstEnginePipeline::kGstStateTimeoutNanosecs = 10000000;
 const int GstEnginePipeline::kFaderFudgeMsec = 2000;
 
+const int GstEnginePipeline::kScopeBufferSize = 16 * Engine::Base::kScopeSize;
+
 const int GstEnginePipeline::kEqBandCount = 10;
 const int GstEnginePipeline::kEqBandFrequencies[] = { 60, 170, 310, 600, 1000, 3000, 6000, 12000, 14000, 16000 };
 
@@ -76,6 +79,7 @@ GstEnginePipeline::GstEnginePipeline(GstEngine *engine)
       buffer_duration_nanosec_(1 * kNsecPerSec),
       buffer_min_fill_(33),
       buffering_(false),
+      scope_buffer_(kScopeBufferSize),
       segment_start_(0),
       segment_start_received_(false),
       end_offset_nanosec_(-1),
@@ -353,7 +357,11 @@ bool GstEnginePipeline::InitAudioBin() {
   }
 
   gst_element_link_many(queue_, audioconvert_, convert_sink, nullptr);
-  gst_element_link(probe_converter, probe_sink);
+
+  // The scope reads interleaved 16-bit stereo samples.
+  GstCaps *caps16 = gst_caps_new_simple("audio/x-raw", "format", G_TYPE_STRING, GST_AUDIO_NE(S16), "channels", G_TYPE_INT, 2, nullptr);
+  gst_element_link_filtered(probe_converter, probe_sink, caps16);
+  gst_caps_unref(caps16);
 
   // Link the outputs of tee to the queues on each path.
   pad = gst_element_get_static_pad(probe_queue, "sink");
@@ -369,7 +377,6 @@ bool GstEnginePipeline::InitAudioBin() {
     gst_element_link_many(rgvolume_, rglimiter_, audioconvert2_, tee, nullptr);
   }
 
-  // Don't force 16 bit.
   gst_element_link(probe_queue, probe_converter);
 
   if (eq_enabled_ && equalizer_ && equalizer_preamp_ && audio_panorama_) {
@@ -792,6 +799,12 @@ GstPadProbeReturn GstEnginePipeline::HandoffCallback(GstPad*, GstPadProbeInfo *i
   GstEnginePipeline *instance = reinterpret_cast<GstEnginePipeline*>(self);
   GstBuffer *buf = gst_pad_probe_info_get_buffer(info);
 
+  GstMapInfo map;
+  if (gst_buffer_map(buf, &map, GST_MAP_READ)) {
+    instance->scope_buffer_.Write(reinterpret_cast<const int16_t*>(map.data), map.size / sizeof(int16_t));
+    gst_buffer_unmap(buf, &map);
+  }
+
   QList<GstBufferConsumer*> consumers;
   {
     QMutexLocker l(&instance->buffer_consumers_mutex_);
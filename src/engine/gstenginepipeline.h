@@ -45,6 +45,8 @@
 #include <QUrl>
 #include <QTimerEvent>
 
+#include "pcmringbuffer.h"
+
 using std::unique_ptr;
 
 class GstEngine;
@@ -82,6 +84,9 @@ class GstEnginePipeline : public QObject {
   void RemoveBufferConsumer(GstBufferConsumer *consumer);
   void RemoveAllBufferConsumers();
 
+  // The most recent samples sent to the sink, as interleaved 16-bit stereo.  Safe to read from any one thread.
+  const PcmRingBuffer &scope_buffer() const { return scope_buffer_; }
+
   // Control the music playback
   QFuture<GstStateChangeReturn> SetState(GstState state);
   Q_INVOKABLE bool Seek(qint64 nanosec);
@@ -171,6 +176,8 @@ signals:
  private:
   static const int kGstStateTimeoutNanosecs;
   static const int kFaderFudgeMsec;
+  // Samples kept for the scope, about 190ms of 44.1kHz stereo.
+  static const int kScopeBufferSize;
   static const int kEqBandCount;
   static const int kEqBandFrequencies[];
 
@@ -213,6 +220,9 @@ signals:
   // These get called when there is a new audio buffer available
   QList<GstBufferConsumer*> buffer_consumers_;
   QMutex buffer_consumers_mutex_;
+
+  // Written from the streaming thread by HandoffCallback.
+  PcmRingBuffer scope_buffer_;
   qint64 segment_start_;
   bool segment_start_received_;
 
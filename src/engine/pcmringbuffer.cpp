@@ -0,0 +1,92 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+
+#include <QtGlobal>
+
+#include "pcmringbuffer.h"
+
+const int PcmRingBuffer::kMaxReadAttempts = 4;
+
+PcmRingBuffer::PcmRingBuffer(int capacity)
+    : capacity_(1),
+      written_(0),
+      writing_(0) {
+
+  while (capacity_ < capacity) capacity_ *= 2;
+  mask_ = capacity_ - 1;
+
+  samples_.reset(new std::atomic<int16_t>[capacity_]);
+  for (int i = 0; i < capacity_; ++i) samples_[i].store(0, std::memory_order_relaxed);
+
+}
+
+void PcmRingBuffer::Write(const int16_t *samples, int count) {
+
+  if (count <= 0) return;
+
+  // Only the last capacity_ samples would be kept anyway
+  if (count > capacity_) {
+    samples += count - capacity_;
+    count = capacity_;
+  }
+
+  const quint64 start = written_.load(std::memory_order_relaxed);
+  const quint64 end = start + count;
+
+  // Tell readers which samples are about to be overwritten before touching them.
+  writing_.store(end, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (int i = 0; i < count; ++i) {
+    samples_[(start + i) & mask_].store(samples[i], std::memory_order_relaxed);
+  }
+
+  written_.store(end, std::memory_order_release);
+
+}
+
+int PcmRingBuffer::ReadLatest(int16_t *dest, int count) const {
+
+  count = qBound(0, count, capacity_);
+
+  for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt) {
+    const quint64 end = written_.load(std::memory_order_acquire);
+    const int available = end < static_cast<quint64>(count) ? static_cast<int>(end) : count;
+    const quint64 start = end - available;
+
+    for (int i = 0; i < available; ++i) {
+      dest[i] = samples_[(start + i) & mask_].load(std::memory_order_relaxed);
+    }
+
+    // If the writer got far enough to overwrite the oldest sample we copied, the copy is torn.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (writing_.load(std::memory_order_relaxed) - start <= static_cast<quint64>(capacity_)) {
+      return available;
+    }
+  }
+
+  return 0;
+
+}
@@ -0,0 +1,62 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PCMRINGBUFFER_H
+#define PCMRINGBUFFER_H
+
+#include "config.h"
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
+
+#include <QtGlobal>
+
+// The most recent 16-bit samples played, written by one thread and read by another without locking.
+// The writer never waits for readers, it just overwrites the oldest samples.
+// A reader copies the samples it wants and checks afterwards that none of them were overwritten while it was copying, if they were it tries again.
+class PcmRingBuffer : boost::noncopyable {
+ public:
+  // The capacity is rounded up to a power of two.
+  explicit PcmRingBuffer(int capacity);
+
+  int capacity() const { return capacity_; }
+
+  // Only one thread may write.
+  void Write(const int16_t *samples, int count);
+
+  // Copies the count most recently written samples to dest, oldest first.
+  // Returns the number of samples copied, which is less than count if fewer have been written yet.
+  int ReadLatest(int16_t *dest, int count) const;
+
+ private:
+  static const int kMaxReadAttempts;
+
+  int capacity_;
+  quint64 mask_;
+  std::unique_ptr<std::atomic<int16_t>[]> samples_;
+
+  // Total number of samples written, and the total the writer is working towards.
+  // Samples in [written_ - capacity_, written_) are valid unless writing_ has passed them.
+  std::atomic<quint64> written_;
+  std::atomic<quint64> writing_;
+};
+
+#endif  // PCMRINGBUFFER_H
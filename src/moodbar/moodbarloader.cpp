@@ -21,19 +21,29 @@
 
 #include <QObject>
 #include <QThread>
+#include <QtConcurrentRun>
+#include <QFuture>
 #include <QCoreApplication>
 #include <QStandardPaths>
 #include <QIODevice>
 #include <QDir>
 #include <QFileInfo>
+#include <QFile>
+#include <QByteArray>
+#include <QCryptographicHash>
 #include <QNetworkDiskCache>
 #include <QTimer>
+#include <QSettings>
 #include <QString>
 #include <QUrl>
 
 #include "core/application.h"
 #include "core/closure.h"
 #include "core/logging.h"
+#include "core/song.h"
+#include "core/taskmanager.h"
+#include "collection/collectionbackend.h"
+#include "collection/directory.h"
 
 #include "moodbarpipeline.h"
 
@@ -45,20 +55,41 @@
 
 using std::unique_ptr;
 
+const char* MoodbarLoader::kSettingsGenerateAll = "generate_all";
+const int MoodbarLoader::kMinBatchDelayMs = 100;
+
 MoodbarLoader::MoodbarLoader(Application* app, QObject* parent)
     : QObject(parent),
+      app_(app),
       cache_(new QNetworkDiskCache(this)),
       thread_(new QThread(this)),
       kMaxActiveRequests(qMax(1, QThread::idealThreadCount() / 2)),
+      kMaxBatchRequests(qMax(1, QThread::idealThreadCount() / 4)),
+      batch_task_id_(-1),
+      batch_total_(0),
+      batch_done_(0),
+      batch_delay_timer_(new QTimer(this)),
       enabled_(false),
       save_(false) {
 
   cache_->setCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/moodbar");
   cache_->setMaximumCacheSize(60 * 1024 * 1024);  // 60MB - enough for 20,000 moodbars
 
+  batch_clock_.start();
+  batch_delay_timer_->setSingleShot(true);
+  connect(batch_delay_timer_, SIGNAL(timeout()), SLOT(MaybeTakeNextRequest()));
+
   connect(app, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
   ReloadSettings();
 
+  // Carry on with the batch job if it didn't finish last time, but leave startup alone.
+  QSettings s;
+  s.beginGroup(MoodbarSettingsPage::kSettingsGroup);
+  if (s.value(kSettingsGenerateAll, false).toBool()) {
+    DoInAMinuteOrSo(this, SLOT(GenerateAll()));
+  }
+  s.endGroup();
+
 }
 
 MoodbarLoader::~MoodbarLoader() {
@@ -74,6 +105,9 @@ void MoodbarLoader::ReloadSettings() {
   save_ = s.value("save", false).toBool();
   s.endGroup();
 
+  // Stop the batch job, but keep it around so it carries on when moodbars are enabled again after a restart.
+  if (!enabled_ && batch_task_id_ != -1) FinishBatch(false);
+
   MaybeTakeNextRequest();
 
 }
@@ -88,6 +122,14 @@ QStringList MoodbarLoader::MoodFilenames(const QString& song_filename) {
 
 }
 
+QString MoodbarLoader::StoreDir() {
+  return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/moodbars";
+}
+
+QString MoodbarLoader::StoredMoodFilename(const QUrl& url) {
+  return StoreDir() + "/" + QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1).toHex() + ".mood";
+}
+
 MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data, MoodbarPipeline** async_pipeline) {
 
   if (url.scheme() != "file") {
@@ -112,6 +154,16 @@ MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data, Moo
     }
   }
 
+  // The batch job keeps its moodbars outside of the cache, so they aren't evicted.
+  QFile stored_file(StoredMoodFilename(url));
+  if (stored_file.open(QIODevice::ReadOnly)) {
+    qLog(Info) << "Loading stored moodbar data for" << filename;
+    *data = stored_file.readAll();
+    if (!data->isEmpty()) {
+      return Loaded;
+    }
+  }
+
   // Maybe it exists in the cache?
   std::unique_ptr<QIODevice> cache_device(cache_->data(url));
   if (cache_device) {
@@ -122,14 +174,8 @@ MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data, Moo
     }
   }
 
-  if (!thread_->isRunning()) thread_->start(QThread::IdlePriority);
-
   // There was no existing file, analyze the audio file and create one.
-  MoodbarPipeline* pipeline = new MoodbarPipeline(url);
-  pipeline->moveToThread(thread_);
-  NewClosure(pipeline, SIGNAL(Finished(bool)), this, SLOT(RequestFinished(MoodbarPipeline*, QUrl)), pipeline, url);
-
-  requests_[url] = pipeline;
+  MoodbarPipeline* pipeline = CreateRequest(url);
   queued_requests_ << url;
 
   MaybeTakeNextRequest();
@@ -139,19 +185,50 @@ MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data, Moo
 
 }
 
+MoodbarPipeline* MoodbarLoader::CreateRequest(const QUrl& url) {
+
+  if (!thread_->isRunning()) thread_->start(QThread::IdlePriority);
+
+  MoodbarPipeline* pipeline = new MoodbarPipeline(url);
+  pipeline->moveToThread(thread_);
+  NewClosure(pipeline, SIGNAL(Finished(bool)), this, SLOT(RequestFinished(MoodbarPipeline*, QUrl)), pipeline, url);
+
+  requests_[url] = pipeline;
+  return pipeline;
+
+}
+
 void MoodbarLoader::MaybeTakeNextRequest() {
 
   Q_ASSERT(QThread::currentThread() == qApp->thread());
 
-  if (active_requests_.count() >= kMaxActiveRequests || queued_requests_.isEmpty() || !enabled_) {
+  if (active_requests_.count() >= kMaxActiveRequests || !enabled_) {
     return;
   }
 
-  const QUrl url = queued_requests_.takeFirst();
-  active_requests_ << url;
+  if (!queued_requests_.isEmpty()) {
+    const QUrl url = queued_requests_.takeFirst();
+    active_requests_ << url;
+
+    qLog(Info) << "Creating moodbar data for" << url.toLocalFile();
+    QMetaObject::invokeMethod(requests_[url], "Start", Qt::QueuedConnection);
+    return;
+  }
 
-  qLog(Info) << "Creating moodbar data for" << url.toLocalFile();
-  QMetaObject::invokeMethod(requests_[url], "Start", Qt::QueuedConnection);
+  // The batch job only gets the slots the songs being shown don't need, and takes a break after every file.
+  while (!batch_queue_.isEmpty() && batch_active_.count() < kMaxBatchRequests && active_requests_.count() < kMaxActiveRequests && !batch_delay_timer_->isActive()) {
+    const QUrl url = batch_queue_.takeFirst();
+    batch_active_[url] = batch_clock_.elapsed();
+
+    // Somebody asked for this one in the meantime, it's counted when that request is done.
+    if (requests_.contains(url)) continue;
+
+    CreateRequest(url);
+    active_requests_ << url;
+
+    qLog(Debug) << "Creating moodbar data for" << url.toLocalFile() << "in the background";
+    QMetaObject::invokeMethod(requests_[url], "Start", Qt::QueuedConnection);
+  }
 
 }
 
@@ -162,14 +239,27 @@ void MoodbarLoader::RequestFinished(MoodbarPipeline* request, const QUrl& url) {
   if (request->success()) {
     qLog(Info) << "Moodbar data generated successfully for" << url.toLocalFile();
 
-    // Save the data in the cache
-    QNetworkCacheMetaData metadata;
-    metadata.setUrl(url);
-
-    QIODevice* cache_file = cache_->prepare(metadata);
-    if (cache_file) {
-      cache_file->write(request->data());
-      cache_->insert(cache_file);
+    if (batch_active_.contains(url)) {
+      // The cache only has room for the songs that are played, it would throw away most of the collection.
+      QDir().mkpath(StoreDir());
+      QFile stored_file(StoredMoodFilename(url));
+      if (stored_file.open(QIODevice::WriteOnly)) {
+        stored_file.write(request->data());
+      }
+      else {
+        qLog(Warning) << "Error opening mood file for writing" << stored_file.fileName();
+      }
+    }
+    else {
+      // Save the data in the cache
+      QNetworkCacheMetaData metadata;
+      metadata.setUrl(url);
+
+      QIODevice* cache_file = cache_->prepare(metadata);
+      if (cache_file) {
+        cache_file->write(request->data());
+        cache_->insert(cache_file);
+      }
     }
 
     // Save the data alongside the original as well if we're configured to.
@@ -198,6 +288,126 @@ void MoodbarLoader::RequestFinished(MoodbarPipeline* request, const QUrl& url) {
 
   QTimer::singleShot(1000, request, SLOT(deleteLater()));
 
+  if (batch_active_.contains(url)) BatchRequestFinished(url);
+
   MaybeTakeNextRequest();
 
 }
+
+void MoodbarLoader::GenerateAll() {
+
+  if (batch_task_id_ != -1) return;
+
+  if (!enabled_) {
+    qLog(Info) << "Moodbars are disabled, not generating them for the collection";
+    return;
+  }
+
+  // Remembered until the job is done, so it can be picked up again after a restart.
+  // The moodbars that were already created are skipped then, so the stored moodbars are all the progress that needs saving.
+  QSettings s;
+  s.beginGroup(MoodbarSettingsPage::kSettingsGroup);
+  s.setValue(kSettingsGenerateAll, true);
+  s.endGroup();
+
+  batch_task_id_ = app_->task_manager()->StartTask(tr("Generating moodbars"));
+
+  QFuture<QList<QUrl>> future = QtConcurrent::run(&MoodbarLoader::FindMissingMoodbars, app_->collection_backend(), cache_->cacheDirectory());
+  NewClosure(future, [=]() { BatchUrlsLoaded(future.result()); });
+
+}
+
+QList<QUrl> MoodbarLoader::FindMissingMoodbars(CollectionBackend* backend, const QString& cache_dir) {
+
+  // QNetworkDiskCache isn't thread safe, so this only reads the files through a cache of its own.
+  QNetworkDiskCache cache;
+  cache.setCacheDirectory(cache_dir);
+
+  QList<QUrl> ret;
+  QSet<QUrl> seen;
+  for (const Directory& dir : backend->GetAllDirectories()) {
+    for (const Song& song : backend->FindSongsInDirectory(dir.id)) {
+      const QUrl url = song.url();
+
+      // Songs from a cue sheet share the file
+      if (song.is_unavailable() || url.scheme() != "file" || seen.contains(url)) continue;
+      seen << url;
+
+      if (cache.metaData(url).isValid() || QFile::exists(StoredMoodFilename(url))) continue;
+
+      bool has_mood_file = false;
+      for (const QString& possible_mood_file : MoodFilenames(url.toLocalFile())) {
+        if (QFile::exists(possible_mood_file)) {
+          has_mood_file = true;
+          break;
+        }
+      }
+      if (!has_mood_file) ret << url;
+    }
+  }
+
+  return ret;
+
+}
+
+void MoodbarLoader::BatchUrlsLoaded(const QList<QUrl>& urls) {
+
+  // Stopped while the collection was being searched
+  if (batch_task_id_ == -1) return;
+
+  qLog(Info) << "Generating moodbars for" << urls.count() << "songs";
+
+  batch_queue_ = urls;
+  batch_total_ = urls.count();
+  batch_done_ = 0;
+
+  if (batch_queue_.isEmpty()) {
+    FinishBatch(true);
+    return;
+  }
+
+  app_->task_manager()->SetTaskProgress(batch_task_id_, batch_done_, batch_total_);
+  MaybeTakeNextRequest();
+
+}
+
+void MoodbarLoader::BatchRequestFinished(const QUrl& url) {
+
+  const qint64 elapsed = batch_clock_.elapsed() - batch_active_.take(url);
+
+  ++batch_done_;
+  app_->task_manager()->SetTaskProgress(batch_task_id_, batch_done_, batch_total_);
+
+  if (batch_queue_.isEmpty() && batch_active_.isEmpty()) {
+    FinishBatch(true);
+    return;
+  }
+
+  // Rest for half as long as the file took, so the job backs off by itself when the disk is busy.
+  batch_delay_timer_->start(static_cast<int>(qMax(static_cast<qint64>(kMinBatchDelayMs), elapsed / 2)));
+
+}
+
+void MoodbarLoader::FinishBatch(bool complete) {
+
+  app_->task_manager()->SetTaskFinished(batch_task_id_);
+  batch_task_id_ = -1;
+  batch_total_ = 0;
+  batch_done_ = 0;
+  batch_queue_.clear();
+  batch_active_.clear();
+  batch_delay_timer_->stop();
+
+  if (!complete) {
+    qLog(Info) << "Stopped generating moodbars for the collection";
+    return;
+  }
+
+  qLog(Info) << "Finished generating moodbars for the collection";
+
+  QSettings s;
+  s.beginGroup(MoodbarSettingsPage::kSettingsGroup);
+  s.remove(kSettingsGenerateAll);
+  s.endGroup();
+
+}
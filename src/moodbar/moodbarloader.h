@@ -27,8 +27,11 @@
 #include <QStringList>
 #include <QUrl>
 #include <QNetworkDiskCache>
+#include <QElapsedTimer>
 
+class QTimer;
 class Application;
+class CollectionBackend;
 class MoodbarPipeline;
 
 class MoodbarLoader : public QObject {
@@ -53,6 +56,11 @@ class MoodbarLoader : public QObject {
 
   Result Load(const QUrl& url, QByteArray* data, MoodbarPipeline** async_pipeline);
 
+ public slots:
+  // Creates moodbars for every song in the collection that doesn't have one yet, a few at a time in the background.
+  // A job that is still running when Strawberry quits or moodbars are disabled carries on after the next start.
+  void GenerateAll();
+
  private slots:
   void ReloadSettings();
 
@@ -61,17 +69,42 @@ class MoodbarLoader : public QObject {
 
  private:
   static QStringList MoodFilenames(const QString& song_filename);
+  // Where the batch job saves the moodbars it creates.
+  static QString StoreDir();
+  static QString StoredMoodFilename(const QUrl& url);
+  static QList<QUrl> FindMissingMoodbars(CollectionBackend* backend, const QString& cache_dir);
+
+  MoodbarPipeline* CreateRequest(const QUrl& url);
+
+  void BatchUrlsLoaded(const QList<QUrl>& urls);
+  void BatchRequestFinished(const QUrl& url);
+  // Only a complete job is forgotten, otherwise it's resumed after the next start.
+  void FinishBatch(bool complete);
 
  private:
+  static const char* kSettingsGenerateAll;
+  static const int kMinBatchDelayMs;
+
+  Application* app_;
   QNetworkDiskCache* cache_;
   QThread* thread_;
 
   const int kMaxActiveRequests;
+  const int kMaxBatchRequests;
 
   QMap<QUrl, MoodbarPipeline*> requests_;
   QList<QUrl> queued_requests_;
   QSet<QUrl> active_requests_;
 
+  // The batch job started by GenerateAll()
+  int batch_task_id_;
+  int batch_total_;
+  int batch_done_;
+  QList<QUrl> batch_queue_;
+  QElapsedTimer batch_clock_;
+  QMap<QUrl, qint64> batch_active_;  // When each one was started on batch_clock_
+  QTimer* batch_delay_timer_;
+
   bool enabled_;
   bool save_;
 };
@@ -24,9 +24,8 @@
 #include <QUrl>
 
 #include "core/logging.h"
-#include "core/signalchecker.h"
-#include "core/timeconstants.h"
 #include "core/utilities.h"
+#include "engine/analysispipeline.h"
 #include "moodbar/moodbarbuilder.h"
 
 #include "ext/gstmoodbar/gstfastspectrum.h"
@@ -37,10 +36,13 @@ const int MoodbarPipeline::kBands = 128;
 MoodbarPipeline::MoodbarPipeline(const QUrl& local_filename)
     : QObject(nullptr),
       local_filename_(local_filename),
-      pipeline_(nullptr),
-      convert_element_(nullptr),
+      pipeline_(new AnalysisPipeline(local_filename)),
       success_(false),
-      running_(false) {}
+      running_(false) {
+
+  pipeline_->AddAnalyzer(this);
+
+}
 
 MoodbarPipeline::~MoodbarPipeline() { Cleanup(); }
 
@@ -60,12 +62,16 @@ bool MoodbarPipeline::IsAvailable() {
 
 }
 
-GstElement* MoodbarPipeline::CreateElement(const QString& factory_name) {
+void MoodbarPipeline::AddAnalyzer(AnalysisPipeline::Analyzer* analyzer) {
+  pipeline_->AddAnalyzer(analyzer);
+}
+
+GstElement* MoodbarPipeline::CreateElement(const QString& factory_name, GstElement* bin) {
 
   GstElement* ret = gst_element_factory_make(factory_name.toLatin1().constData(), nullptr);
 
   if (ret) {
-    gst_bin_add(GST_BIN(pipeline_), ret);
+    gst_bin_add(GST_BIN(bin), ret);
   }
   else {
     qLog(Warning) << "Unable to create gstreamer element" << factory_name;
@@ -81,117 +87,50 @@ void MoodbarPipeline::Start() {
 
   Utilities::SetThreadIOPriority(Utilities::IOPRIO_CLASS_IDLE);
 
-  if (pipeline_) {
-    return;
-  }
-
-  pipeline_ = gst_pipeline_new("moodbar-pipeline");
-
-  GstElement* decodebin = CreateElement("uridecodebin");
-  convert_element_ = CreateElement("audioconvert");
-  GstElement* spectrum = CreateElement("fastspectrum");
-  GstElement* fakesink = CreateElement("fakesink");
-
-  if (!decodebin || !convert_element_ || !spectrum || !fakesink) {
-    pipeline_ = nullptr;
-    emit Finished(false);
-    return;
-  }
-
-  // Join them together
-  if (!gst_element_link(convert_element_, spectrum) || !gst_element_link(spectrum, fakesink)) {
-    qLog(Error) << "Failed to link elements";
-    pipeline_ = nullptr;
-    emit Finished(false);
+  if (running_) {
     return;
   }
 
   builder_.reset(new MoodbarBuilder);
 
-  // Set properties
-  g_object_set(decodebin, "uri", local_filename_.toEncoded().constData(), nullptr);
-  g_object_set(spectrum, "bands", kBands, nullptr);
-
-  GstFastSpectrum* fast_spectrum = GST_FASTSPECTRUM(spectrum);
-  fast_spectrum->output_callback = [this](double* magnitudes, int size) { builder_->AddFrame(magnitudes, size); };
-
-  // Connect signals
-  CHECKED_GCONNECT(decodebin, "pad-added", &NewPadCallback, this);
-  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
-  gst_bus_set_sync_handler(bus, BusCallbackSync, this, nullptr);
-  gst_object_unref(bus);
-
-  // Start playing
+  // The pipeline calls back from one of its own threads when it's done
   running_ = true;
-  gst_element_set_state(pipeline_, GST_STATE_PLAYING);
-
-}
-
-void MoodbarPipeline::ReportError(GstMessage* msg) {
-
-  GError* error;
-  gchar* debugs;
-
-  gst_message_parse_error(msg, &error, &debugs);
-  QString message = QString::fromLocal8Bit(error->message);
-
-  g_error_free(error);
-  free(debugs);
-
-  qLog(Error) << "Error processing" << local_filename_ << ":" << message;
+  if (!pipeline_->Start([this](bool success) { Stop(success); })) {
+    running_ = false;
+    emit Finished(false);
+  }
 
 }
 
-void MoodbarPipeline::NewPadCallback(GstElement*, GstPad* pad, gpointer data) {
+GstElement* MoodbarPipeline::CreateElements(GstElement* bin) {
 
-  MoodbarPipeline* self = reinterpret_cast<MoodbarPipeline*>(data);
+  GstElement* spectrum = CreateElement("fastspectrum", bin);
+  GstElement* fakesink = CreateElement("fakesink", bin);
 
-  if (!self->running_) {
-    qLog(Warning) << "Received gstreamer callback after pipeline has stopped.";
-    return;
+  if (!spectrum || !fakesink) {
+    return nullptr;
   }
 
-  GstPad* const audiopad = gst_element_get_static_pad(self->convert_element_, "sink");
-
-  if (GST_PAD_IS_LINKED(audiopad)) {
-    qLog(Warning) << "audiopad is already linked, unlinking old pad";
-    gst_pad_unlink(audiopad, GST_PAD_PEER(audiopad));
+  if (!gst_element_link(spectrum, fakesink)) {
+    qLog(Error) << "Failed to link elements";
+    return nullptr;
   }
 
-  gst_pad_link(pad, audiopad);
-  gst_object_unref(audiopad);
+  g_object_set(spectrum, "bands", kBands, nullptr);
 
-  int rate = 0;
-  GstCaps* caps = gst_pad_get_current_caps(pad);
-  GstStructure* structure = gst_caps_get_structure(caps, 0);
-  gst_structure_get_int(structure, "rate", &rate);
-  gst_caps_unref(caps);
+  GstFastSpectrum* fast_spectrum = GST_FASTSPECTRUM(spectrum);
+  fast_spectrum->output_callback = [this](double* magnitudes, int size) { builder_->AddFrame(magnitudes, size); };
 
-  if (self->builder_)
-    self->builder_->Init(kBands, rate);
-  else
-    qLog(Error) << "Builder does not exist";
+  return spectrum;
 
 }
 
-GstBusSyncReply MoodbarPipeline::BusCallbackSync(GstBus*, GstMessage* msg, gpointer data) {
-
-  MoodbarPipeline* self = reinterpret_cast<MoodbarPipeline*>(data);
-
-  switch (GST_MESSAGE_TYPE(msg)) {
-    case GST_MESSAGE_EOS:
-      self->Stop(true);
-      break;
+void MoodbarPipeline::SetSampleRate(int rate) {
 
-    case GST_MESSAGE_ERROR:
-      self->ReportError(msg);
-      self->Stop(false);
-      break;
-
-    default:
-      break;
-  }
-  return GST_BUS_PASS;
+  if (builder_)
+    builder_->Init(kBands, rate);
+  else
+    qLog(Error) << "Builder does not exist";
 
 }
 
@@ -214,14 +153,6 @@ void MoodbarPipeline::Cleanup() {
   Q_ASSERT(QThread::currentThread() != qApp->thread());
 
   running_ = false;
-  if (pipeline_) {
-    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
-    gst_bus_set_sync_handler(bus, nullptr, nullptr, nullptr);
-    gst_object_unref(bus);
-    
-    gst_element_set_state(pipeline_, GST_STATE_NULL);
-    gst_object_unref(pipeline_);
-    pipeline_ = nullptr;
-  }
+  pipeline_.reset();
 
 }
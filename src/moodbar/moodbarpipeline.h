@@ -24,14 +24,15 @@
 #include <QUrl>
 
 #include <gst/gst.h>
-#include <gst/app/gstappsink.h>
 
 #include <memory>
 
+#include "engine/analysispipeline.h"
+
 class MoodbarBuilder;
 
 // Creates moodbar data for a single local music file.
-class MoodbarPipeline : public QObject {
+class MoodbarPipeline : public QObject, public AnalysisPipeline::Analyzer {
   Q_OBJECT
 
  public:
@@ -43,6 +44,14 @@ class MoodbarPipeline : public QObject {
   bool success() const { return success_; }
   const QByteArray& data() const { return data_; }
 
+  // Lets another analyzer use the audio decoded for the moodbar, instead of decoding the file again.
+  // It has to be added before Start() and outlive the MoodbarPipeline.
+  void AddAnalyzer(AnalysisPipeline::Analyzer* analyzer);
+
+  // AnalysisPipeline::Analyzer
+  GstElement* CreateElements(GstElement* bin);
+  void SetSampleRate(int rate);
+
  public slots:
   void Start();
 
@@ -50,26 +59,19 @@ class MoodbarPipeline : public QObject {
   void Finished(bool success);
 
  private:
-  GstElement* CreateElement(const QString& factory_name);
+  GstElement* CreateElement(const QString& factory_name, GstElement* bin);
 
-  void ReportError(GstMessage* message);
   void Stop(bool success);
   void Cleanup();
 
-  static void NewPadCallback(GstElement*, GstPad* pad, gpointer data);
-  static GstFlowReturn NewBufferCallback(GstAppSink* app_sink, gpointer self);
-  static gboolean BusCallback(GstBus*, GstMessage* msg, gpointer data);
-  static GstBusSyncReply BusCallbackSync(GstBus*, GstMessage* msg, gpointer data);
-
  private:
   static bool sIsAvailable;
   static const int kBands;
 
   QUrl local_filename_;
-  GstElement* pipeline_;
-  GstElement* convert_element_;
 
   std::unique_ptr<MoodbarBuilder> builder_;
+  std::unique_ptr<AnalysisPipeline> pipeline_;
 
   bool success_;
   bool running_;
@@ -37,11 +37,12 @@
 #include <QDateTime>
 #include <QString>
 #include <QTime>
+#include <QUrl>
 #include <QtDebug>
 
 #include "chromaprinter.h"
 #include "core/logging.h"
-#include "core/signalchecker.h"
+#include "engine/analysispipeline.h"
 
 #ifndef u_int32_t
 typedef unsigned int u_int32_t;
@@ -53,14 +54,14 @@ static const int kPlayLengthSecs = 30;
 static const int kTimeoutSecs = 10;
 
 Chromaprinter::Chromaprinter(const QString &filename)
-    : filename_(filename),
-      convert_element_(nullptr) {}
+    : filename_(filename) {}
 
 Chromaprinter::~Chromaprinter() {}
 
 GstElement *Chromaprinter::CreateElement(const QString &factory_name, GstElement *bin) {
 
-  GstElement *ret = gst_element_factory_make( factory_name.toLatin1().constData(), factory_name.toLatin1().constData());
+  // No names, the bin can be shared with other analyzers
+  GstElement *ret = gst_element_factory_make(factory_name.toLatin1().constData(), nullptr);
 
   if (ret && bin) gst_bin_add(GST_BIN(bin), ret);
 
@@ -72,29 +73,17 @@ GstElement *Chromaprinter::CreateElement(const QString &factory_name, GstElement
 
 }
 
-QString Chromaprinter::CreateFingerprint() {
-
-  Q_ASSERT(QThread::currentThread() != qApp->thread());
+GstElement *Chromaprinter::CreateElements(GstElement *bin) {
 
   buffer_.open(QIODevice::WriteOnly);
 
-  GstElement *pipeline = gst_pipeline_new("pipeline");
-  GstElement *src = CreateElement("filesrc", pipeline);
-  GstElement *decode = CreateElement("decodebin", pipeline);
-  GstElement *convert = CreateElement("audioconvert", pipeline);
-  GstElement *resample = CreateElement("audioresample", pipeline);
-  GstElement *sink = CreateElement("appsink", pipeline);
+  GstElement *resample = CreateElement("audioresample", bin);
+  GstElement *sink = CreateElement("appsink", bin);
 
-  if (!src || !decode || !convert || !resample || !sink) {
-    return QString();
+  if (!resample || !sink) {
+    return nullptr;
   }
 
-  convert_element_ = convert;
-
-  // Connect the elements
-  gst_element_link_many(src, decode, nullptr);
-  gst_element_link_many(convert, resample, nullptr);
-
   // Chromaprint expects mono 16-bit ints at a sample rate of 11025Hz.
   GstCaps *caps = gst_caps_new_simple(
       "audio/x-raw",
@@ -102,8 +91,12 @@ QString Chromaprinter::CreateFingerprint() {
       "channels", G_TYPE_INT, kDecodeChannels,
       "rate", G_TYPE_INT, kDecodeRate,
       NULL);
-  gst_element_link_filtered(resample, sink, caps);
+  const bool linked = gst_element_link_filtered(resample, sink, caps);
   gst_caps_unref(caps);
+  if (!linked) {
+    qLog(Error) << "Failed to link elements";
+    return nullptr;
+  }
 
   GstAppSinkCallbacks callbacks;
   memset(&callbacks, 0, sizeof(callbacks));
@@ -112,45 +105,35 @@ QString Chromaprinter::CreateFingerprint() {
   g_object_set(G_OBJECT(sink), "sync", FALSE, nullptr);
   g_object_set(G_OBJECT(sink), "emit-signals", TRUE, nullptr);
 
-  // Set the filename
-  g_object_set(src, "location", filename_.toUtf8().constData(), nullptr);
+  return resample;
+
+}
 
-  // Connect signals
-  GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
-  CHECKED_GCONNECT(decode, "pad-added", &NewPadCallback, this);
+QString Chromaprinter::CreateFingerprint() {
 
-  // Play only first x seconds
-  gst_element_set_state(pipeline, GST_STATE_PAUSED);
-  // wait for state change before seeking
-  gst_element_get_state(pipeline, nullptr, nullptr, kTimeoutSecs * GST_SECOND);
-  gst_element_seek(pipeline, 1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET, 0 * GST_SECOND, GST_SEEK_TYPE_SET, kPlayLengthSecs * GST_SECOND);
+  Q_ASSERT(QThread::currentThread() != qApp->thread());
 
   QTime time;
   time.start();
 
-  // Start playing
-  gst_element_set_state(pipeline, GST_STATE_PLAYING);
+  {
+    // Stops decoding once the first kPlayLengthSecs are in the buffer.
+    // Whatever made it into the buffer is used if it times out, the timeout covers both prerolling and decoding.
+    AnalysisPipeline pipeline(QUrl::fromLocalFile(filename_));
+    pipeline.AddAnalyzer(this);
+    pipeline.Run(2 * kTimeoutSecs * 1000);
+  }
 
-  // Wait until EOS or error
-  GstMessage *msg = gst_bus_timed_pop_filtered(bus, kTimeoutSecs * GST_SECOND, static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
-  if (msg != nullptr) {
-    if (msg->type == GST_MESSAGE_ERROR) {
-      // Report error
-      GError *error = nullptr;
-      gchar *debugs = nullptr;
+  qLog(Debug) << "Decode time:" << time.elapsed();
 
-      gst_message_parse_error(msg, &error, &debugs);
-      QString message = QString::fromLocal8Bit(error->message);
+  return Fingerprint();
 
-      g_error_free(error);
-      free(debugs);
+}
 
-      qLog(Debug) << "Error processing" << filename_ << ":" << message;
-    }
-    gst_message_unref(msg);
-  }
+QString Chromaprinter::Fingerprint() {
 
-  int decode_time = time.restart();
+  QTime time;
+  time.start();
 
   buffer_.close();
 
@@ -185,35 +168,13 @@ QString Chromaprinter::CreateFingerprint() {
     chromaprint_dealloc(encoded);
   }
   chromaprint_free(chromaprint);
-  int codegen_time = time.elapsed();
 
-  qLog(Debug) << "Decode time:" << decode_time << "Codegen time:" << codegen_time;
-
-  // Cleanup
-  callbacks.new_sample = nullptr;
-  gst_object_unref(bus);
-  gst_element_set_state(pipeline, GST_STATE_NULL);
-  gst_object_unref(pipeline);
+  qLog(Debug) << "Codegen time:" << time.elapsed();
 
   return fingerprint;
 
 }
 
-void Chromaprinter::NewPadCallback(GstElement*, GstPad *pad, gpointer data) {
-
-  Chromaprinter *instance = reinterpret_cast<Chromaprinter*>(data);
-  GstPad *const audiopad = gst_element_get_static_pad(instance->convert_element_, "sink");
-
-  if (GST_PAD_IS_LINKED(audiopad)) {
-    qLog(Warning) << "audiopad is already linked, unlinking old pad";
-    gst_pad_unlink(audiopad, GST_PAD_PEER(audiopad));
-  }
-
-  gst_pad_link(pad, audiopad);
-  gst_object_unref(audiopad);
-
-}
-
 GstFlowReturn Chromaprinter::NewBufferCallback(GstAppSink *app_sink, gpointer self) {
 
   Chromaprinter *me = reinterpret_cast<Chromaprinter*>(self);
@@ -230,7 +191,11 @@ GstFlowReturn Chromaprinter::NewBufferCallback(GstAppSink *app_sink, gpointer se
   }
   gst_sample_unref(sample);
 
+  // Only the beginning of the song is used
+  if (me->buffer_.size() >= kPlayLengthSecs * kDecodeRate * kDecodeChannels * static_cast<qint64>(sizeof(int16_t))) {
+    me->set_done();
+  }
+
   return GST_FLOW_OK;
 
 }
-
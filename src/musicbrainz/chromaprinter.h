@@ -30,9 +30,11 @@
 #include <QBuffer>
 #include <QString>
 
-class Chromaprinter {
+#include "engine/analysispipeline.h"
+
+class Chromaprinter : public AnalysisPipeline::Analyzer {
   // Creates a Chromaprint fingerprint from a song.
-  // Uses GStreamer to open and decode the file as PCM data and passes this to Chromaprint's code generator.
+  // Takes the first seconds of the song as PCM data from an AnalysisPipeline and passes this to Chromaprint's code generator.
   // The generated code can be used to identify a song via Acoustid.
   // You should create one Chromaprinter for each file you want to fingerprint.
   // This class works well with QtConcurrentMap.
@@ -46,17 +48,21 @@ class Chromaprinter {
   // Returns an empty string if no fingerprint could be created.
   QString CreateFingerprint();
 
+  // To fingerprint a song that is decoded for something else anyway, add the Chromaprinter to that AnalysisPipeline instead.
+  // Once the pipeline has finished this returns the fingerprint, or an empty string.
+  QString Fingerprint();
+
+  // AnalysisPipeline::Analyzer
+  GstElement *CreateElements(GstElement *bin);
+
  private:
   GstElement *CreateElement(const QString &factory_name, GstElement *bin = nullptr);
 
-  static void NewPadCallback(GstElement*, GstPad *pad, gpointer data);
   static GstFlowReturn NewBufferCallback(GstAppSink *app_sink, gpointer self);
 
  private:
   QString filename_;
 
-  GstElement *convert_element_;
-
   QBuffer buffer_;
 
 };
@@ -0,0 +1,121 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <memory>
+
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QVariant>
+#include <QUrl>
+
+#include "core/song.h"
+#include "collection/sqlrow.h"
+#include "playlistbackend.h"
+#include "playlistitem.h"
+#include "lazyplaylistitem.h"
+
+const int PlaylistItemPager::kPageSize = 500;
+const int PlaylistItemPager::kMaxPages = 20;
+
+PlaylistItemPager::PlaylistItemPager(PlaylistBackend *backend) : backend_(backend) {}
+
+int PlaylistItemPager::AddPage(const QList<int> &ids) {
+
+  QMutexLocker l(&mutex_);
+  page_ids_ << ids;
+  return page_ids_.count() - 1;
+
+}
+
+PlaylistItemPtr PlaylistItemPager::Item(int page, int id) {
+
+  QMutexLocker l(&mutex_);
+
+  if (pages_.contains(page)) {
+    recent_pages_.removeOne(page);
+  }
+  else {
+    pages_.insert(page, backend_->GetPlaylistItemsById(page_ids_.value(page)));
+    while (recent_pages_.count() >= kMaxPages) {
+      pages_.remove(recent_pages_.takeFirst());
+    }
+  }
+  recent_pages_ << page;
+
+  return pages_[page].value(id);
+
+}
+
+LazyPlaylistItem::LazyPlaylistItem(const Song::Source &source, int id, int collection_id, const QUrl &url, std::shared_ptr<PlaylistItemPager> pager, int page)
+    : PlaylistItem(source),
+      id_(id),
+      collection_id_(collection_id),
+      url_(url),
+      pager_(pager),
+      page_(page) {}
+
+PlaylistItemPtr LazyPlaylistItem::Item() const {
+
+  if (item_) return item_;
+
+  PlaylistItemPtr item = pager_->Item(page_, id_);
+  if (item) return item;
+
+  // The row was removed from the database since the playlist was restored
+  return PlaylistItemPtr(PlaylistItem::NewFromSource(source_));
+
+}
+
+PlaylistItem::Options LazyPlaylistItem::options() const { return Item()->options(); }
+
+QList<QAction*> LazyPlaylistItem::actions() { return Item()->actions(); }
+
+bool LazyPlaylistItem::InitFromQuery(const SqlRow &query) {
+  Q_UNUSED(query);
+  return false;
+}
+
+void LazyPlaylistItem::Reload() {
+
+  if (!item_) item_ = Item();
+  item_->Reload();
+
+}
+
+Song LazyPlaylistItem::Metadata() const {
+  if (HasTemporaryMetadata()) return temp_metadata_;
+  return Item()->Metadata();
+}
+
+QUrl LazyPlaylistItem::Url() const {
+  if (item_) return item_->Url();
+  return url_;
+}
+
+QVariant LazyPlaylistItem::DatabaseValue(DatabaseColumn column) const {
+
+  if (column == Column_CollectionId && source_ == Song::Source_Collection) return collection_id_;
+  return PlaylistItem::DatabaseValue(column);
+
+}
+
+Song LazyPlaylistItem::DatabaseSongMetadata() const { return Item()->DatabaseSongMetadata(); }
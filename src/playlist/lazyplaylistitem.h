@@ -0,0 +1,103 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LAZYPLAYLISTITEM_H
+#define LAZYPLAYLISTITEM_H
+
+#include "config.h"
+
+#include <memory>
+#include <stdbool.h>
+
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QVariant>
+#include <QUrl>
+#include <QAction>
+
+#include "core/song.h"
+#include "playlistitem.h"
+
+class PlaylistBackend;
+class SqlRow;
+
+// Loads the full items of a lazily restored playlist from the database a page at a time.
+// Only the most recently used pages are kept, so memory use doesn't grow with the size of the playlist.
+class PlaylistItemPager {
+ public:
+  explicit PlaylistItemPager(PlaylistBackend *backend);
+
+  static const int kPageSize;
+  static const int kMaxPages;
+
+  // Adds a page of playlist_items ROWIDs and returns its number.
+  int AddPage(const QList<int> &ids);
+
+  PlaylistItemPtr Item(int page, int id);
+
+ private:
+  PlaylistBackend *backend_;
+
+  QMutex mutex_;
+  QList<QList<int>> page_ids_;
+  QHash<int, QHash<int, PlaylistItemPtr>> pages_;
+  // Loaded pages, least recently used first
+  QList<int> recent_pages_;
+};
+
+// A playlist item restored from just its ROWID, source and URL.
+// The rest of the metadata is loaded through the pager the first time it's needed.
+class LazyPlaylistItem : public PlaylistItem {
+ public:
+  LazyPlaylistItem(const Song::Source &source, int id, int collection_id, const QUrl &url, std::shared_ptr<PlaylistItemPager> pager, int page);
+
+  Options options() const;
+  QList<QAction*> actions();
+
+  bool InitFromQuery(const SqlRow &query);
+  void Reload();
+
+  Song Metadata() const;
+  QUrl Url() const;
+
+  bool IsLocalCollectionItem() const { return source_ == Song::Source_Collection; }
+
+  // The playlist_items ROWID the item was restored from.
+  int id() const { return id_; }
+  bool is_reloaded() const { return item_ != nullptr; }
+
+ protected:
+  QVariant DatabaseValue(DatabaseColumn column) const;
+  Song DatabaseSongMetadata() const;
+
+ private:
+  PlaylistItemPtr Item() const;
+
+  int id_;
+  int collection_id_;
+  QUrl url_;
+  std::shared_ptr<PlaylistItemPager> pager_;
+  int page_;
+
+  // Set once the item has been reloaded, so the changes aren't lost when its page is dropped.
+  PlaylistItemPtr item_;
+};
+
+#endif  // LAZYPLAYLISTITEM_H
@@ -41,6 +41,8 @@
 #include <QBuffer>
 #include <QFile>
 #include <QList>
+#include <QVector>
+#include <QHash>
 #include <QMap>
 #include <QSet>
 #include <QMimeData>
@@ -67,6 +69,7 @@
 #include "core/mimedata.h"
 #include "core/tagreaderclient.h"
 #include "core/song.h"
+#include "core/taskmanager.h"
 #include "core/timeconstants.h"
 #include "collection/collection.h"
 #include "collection/collectionbackend.h"
@@ -76,6 +79,7 @@
 #include "playlistitem.h"
 #include "playlistview.h"
 #include "playlistsequence.h"
+#include "playlistsorter.h"
 #include "playlistbackend.h"
 #include "playlistfilter.h"
 #include "playlistitemmimedata.h"
@@ -115,6 +119,8 @@ const char *Playlist::kWriteMetadata = "write_metadata";
 
 const int Playlist::kUndoStackSize = 20;
 const int Playlist::kUndoItemLimit = 500;
+const int Playlist::kUndoMemoryLimit = 1024 * 1024;
+const int Playlist::kBackgroundInsertSize = 5000;
 
 const qint64 Playlist::kMinScrobblePointNsecs = 31ll * kNsecPerSec;
 const qint64 Playlist::kMaxScrobblePointNsecs = 240ll * kNsecPerSec;
@@ -142,6 +148,7 @@ Playlist::Playlist(PlaylistBackend *backend, TaskManager *task_manager, Collecti
       scrobble_point_(-1) {
 
   undo_stack_->setUndoLimit(kUndoStackSize);
+  connect(undo_stack_, SIGNAL(indexChanged(int)), SLOT(TrimUndoStack()));
 
   connect(this, SIGNAL(rowsInserted(const QModelIndex&, int, int)), SIGNAL(PlaylistChanged()));
   connect(this, SIGNAL(rowsRemoved(const QModelIndex&, int, int)), SIGNAL(PlaylistChanged()));
@@ -180,6 +187,40 @@ void Playlist::InsertSongItems(const SongList &songs, int pos, bool play_now, bo
 
 }
 
+template <typename T>
+void Playlist::InsertSongItemsInBackground(const SongList &songs, int pos, bool play_now, bool enqueue, bool enqueue_next) {
+
+  const int task_id = task_manager_->StartTask(tr("Adding songs to playlist"));
+  QFuture<PlaylistItemList> future = QtConcurrent::run(&Playlist::NewSongItems<T>, songs, task_manager_, task_id);
+  NewClosure(future, this, SLOT(SongItemsCreated(QFuture<PlaylistItemList>, int, bool, bool, bool, int)), future, pos, play_now, enqueue, enqueue_next, task_id);
+
+}
+
+template <typename T>
+PlaylistItemList Playlist::NewSongItems(const SongList &songs, TaskManager *task_manager, int task_id) {
+
+  PlaylistItemList items;
+  items.reserve(songs.count());
+
+  for (const Song &song : songs) {
+    items << PlaylistItemPtr(new T(song));
+    if (items.count() % 1000 == 0) task_manager->SetTaskProgress(task_id, items.count(), songs.count());
+  }
+
+  return items;
+
+}
+
+void Playlist::SongItemsCreated(QFuture<PlaylistItemList> future, int pos, bool play_now, bool enqueue, bool enqueue_next, int task_id) {
+
+  task_manager_->SetTaskFinished(task_id);
+
+  // The playlist could have got shorter while the items were created
+  if (pos > items_.count()) pos = -1;
+  InsertItems(future.result(), pos, play_now, enqueue, enqueue_next);
+
+}
+
 QVariant Playlist::headerData(int section, Qt::Orientation, int role) const {
 
   if (role != Qt::DisplayRole && role != Qt::ToolTipRole) return QVariant();
@@ -283,7 +324,7 @@ QVariant Playlist::data(const QModelIndex &index, int role) const {
       PlaylistItemPtr item = items_[index.row()];
       Song song = item->Metadata();
 
-      // Don't forget to change Playlist::CompareItems when adding new columns
+      // Don't forget to change PlaylistSorter when adding new columns
       switch (index.column()) {
         case Column_Title:              return song.PrettyTitle();
         case Column_Artist:             return song.artist();
@@ -604,8 +645,7 @@ void Playlist::set_current_row(int i, bool is_stopping) {
     ReshuffleIndices();
 
     // Bring the one we've been asked to play to the start of the list
-    virtual_items_.takeAt(virtual_items_.indexOf(i));
-    virtual_items_.prepend(i);
+    virtual_items_.Move(i, 0);
     current_virtual_index_ = 0;
   }
   else if (is_shuffled_) {
@@ -621,7 +661,7 @@ void Playlist::set_current_row(int i, bool is_stopping) {
 
   if (current_item_index_.isValid()) {
     last_played_item_index_ = current_item_index_;
-    Save();
+    if (CanSave()) backend_->SetLastPlayedAsync(id_, last_played_row());
   }
 
   UpdateScrobblePoint();
@@ -671,7 +711,14 @@ bool Playlist::dropMimeData(const QMimeData *data, Qt::DropAction action, int ro
   if (const SongMimeData *song_data = qobject_cast<const SongMimeData*>(data)) {
     // Dragged from a collection
     // We want to check if these songs are from the actual local file backend, if they are we treat them differently.
-    if (song_data->backend && song_data->backend->songs_table() == SCollection::kSongsTable)
+    const bool collection_songs = song_data->backend && song_data->backend->songs_table() == SCollection::kSongsTable;
+    if (song_data->songs.count() >= kBackgroundInsertSize) {
+      if (collection_songs)
+        InsertSongItemsInBackground<CollectionPlaylistItem>(song_data->songs, row, play_now, enqueue_now, enqueue_next_now);
+      else
+        InsertSongItemsInBackground<SongPlaylistItem>(song_data->songs, row, play_now, enqueue_now, enqueue_next_now);
+    }
+    else if (collection_songs)
       InsertSongItems<CollectionPlaylistItem>(song_data->songs, row, play_now, enqueue_now, enqueue_next_now);
     else
       InsertSongItems<SongPlaylistItem>(song_data->songs, row, play_now, enqueue_now, enqueue_next_now);
@@ -803,7 +850,7 @@ void Playlist::MoveItemsWithoutUndo(const QList<int> &source_rows, int pos) {
   current_virtual_index_ = virtual_items_.indexOf(current_row());
 
   layoutChanged();
-  Save();
+  if (CanSave()) backend_->MovePlaylistItemsAsync(id_, source_rows, pos, last_played_row());
 
 }
 
@@ -853,7 +900,7 @@ void Playlist::MoveItemsWithoutUndo(int start, const QList<int> &dest_rows) {
   current_virtual_index_ = virtual_items_.indexOf(current_row());
 
   layoutChanged();
-  Save();
+  if (CanSave()) backend_->MovePlaylistItemsBackAsync(id_, pos, dest_rows, last_played_row());
 
 }
 
@@ -864,11 +911,13 @@ void Playlist::InsertItems(const PlaylistItemList &itemsIn, int pos, bool play_n
 
   PlaylistItemList items = itemsIn;
 
-  // exercise vetoes
+  // exercise vetoes, the songs are only needed when someone is listening
   SongList songs;
 
-  for (const PlaylistItemPtr item : items) {
-    songs << item->Metadata();
+  if (!veto_listeners_.isEmpty()) {
+    for (const PlaylistItemPtr item : items) {
+      songs << item->Metadata();
+    }
   }
 
   const int song_count = songs.length();
@@ -922,21 +971,36 @@ void Playlist::InsertItemsWithoutUndo(const PlaylistItemList &items, int pos, bo
 
   const int start = pos == -1 ? items_.count() : pos;
   const int end = start + items.count() - 1;
+  const PlaylistItemPtr current = current_item();
 
   beginInsertRows(QModelIndex(), start, end);
+
+  // Splice the items in with one copy of the list, instead of shifting the rest of the list for every item
+  if (start == items_.count()) {
+    items_.reserve(items_.count() + items.count());
+    items_.append(items);
+  }
+  else {
+    PlaylistItemList new_items;
+    new_items.reserve(items_.count() + items.count());
+    new_items.append(items_.mid(0, start));
+    new_items.append(items);
+    new_items.append(items_.mid(start));
+    items_ = new_items;
+  }
+
+  collection_items_by_id_.reserve(collection_items_by_id_.count() + items.count());
   for (int i = start; i <= end; ++i) {
-    PlaylistItemPtr item = items[i - start];
-    items_.insert(i, item);
-    virtual_items_ << virtual_items_.count();
+    const PlaylistItemPtr &item = items_[i];
 
     if (item->source() == Song::Source_Collection) {
-      int id = item->Metadata().id();
+      int id = item->collection_id();
       if (id != -1) {
         collection_items_by_id_.insertMulti(id, item);
       }
     }
 
-    if (item == current_item()) {
+    if (current && item == current) {
       // It's one we removed before that got re-added through an undo
       current_item_index_ = index(i, 0);
       last_played_item_index_ = current_item_index_;
@@ -960,8 +1024,8 @@ void Playlist::InsertItemsWithoutUndo(const PlaylistItemList &items, int pos, bo
     queue_->InsertFirst(indexes);
   }
 
-  Save();
-  ReshuffleIndices();
+  if (CanSave()) backend_->InsertPlaylistItemsAsync(id_, start, items, last_played_row());
+  InsertVirtualIndices(start, items.count());
 
 }
 
@@ -1010,6 +1074,9 @@ void Playlist::UpdateItems(const SongList &songs) {
   QLinkedList<Song> songs_list;
   for (const Song &song : songs) songs_list.append(song);
 
+  QList<int> updated_rows;
+  PlaylistItemList updated_items;
+
   for (int i = 0; i < items_.size(); i++) {
     // Update current items list
     QMutableLinkedListIterator<Song> it(songs_list);
@@ -1036,6 +1103,8 @@ void Playlist::UpdateItems(const SongList &songs) {
           new_item = PlaylistItemPtr(new SongPlaylistItem(song));
         }
         items_[i] = new_item;
+        updated_rows << i;
+        updated_items << new_item;
         emit dataChanged(index(i, 0), index(i, ColumnCount - 1));
         // Also update undo actions
         for (int i = 0; i < undo_stack_->count(); i++) {
@@ -1051,7 +1120,10 @@ void Playlist::UpdateItems(const SongList &songs) {
       }
     }
   }
-  Save();
+
+  if (CanSave() && !updated_rows.isEmpty()) {
+    backend_->UpdatePlaylistItemsAsync(id_, updated_rows, updated_items);
+  }
 
 }
 
@@ -1092,69 +1164,6 @@ QMimeData *Playlist::mimeData(const QModelIndexList &indexes) const {
 
 }
 
-bool Playlist::CompareItems(int column, Qt::SortOrder order, shared_ptr<PlaylistItem> _a, shared_ptr<PlaylistItem> _b) {
-
-  shared_ptr<PlaylistItem> a = order == Qt::AscendingOrder ? _a : _b;
-  shared_ptr<PlaylistItem> b = order == Qt::AscendingOrder ? _b : _a;
-
-#define cmp(field) return a->Metadata().field() < b->Metadata().field()
-#define strcmp(field) return QString::localeAwareCompare(a->Metadata().field().toLower(), b->Metadata().field().toLower()) < 0;
-
-  switch (column) {
-
-    case Column_Title:        strcmp(title);
-    case Column_Artist:       strcmp(artist);
-    case Column_Album:        strcmp(album);
-    case Column_Length:       cmp(length_nanosec);
-    case Column_Track:        cmp(track);
-    case Column_Disc:         cmp(disc);
-    case Column_Year:         cmp(year);
-    case Column_OriginalYear: cmp(originalyear);
-    case Column_Genre:        strcmp(genre);
-    case Column_AlbumArtist:  strcmp(playlist_albumartist);
-    case Column_Composer:     strcmp(composer);
-    case Column_Performer:    strcmp(performer);
-    case Column_Grouping:     strcmp(grouping);
-
-    case Column_PlayCount:    cmp(playcount);
-    case Column_SkipCount:    cmp(skipcount);
-    case Column_LastPlayed:   cmp(lastplayed);
-
-    case Column_Bitrate:      cmp(bitrate);
-    case Column_Samplerate:   cmp(samplerate);
-    case Column_Bitdepth:     cmp(bitdepth);
-    case Column_Filename:
-      return (QString::localeAwareCompare(a->Url().path().toLower(), b->Url().path().toLower()) < 0);
-    case Column_BaseFilename: cmp(basefilename);
-    case Column_Filesize:     cmp(filesize);
-    case Column_Filetype:     cmp(filetype);
-    case Column_DateModified: cmp(mtime);
-    case Column_DateCreated:  cmp(ctime);
-
-    case Column_Comment:      strcmp(comment);
-    case Column_Source:       cmp(source);
-    default: qLog(Error) << "No such column" << column;
-  }
-
-#undef cmp
-#undef strcmp
-
-  return false;
-
-}
-
-bool Playlist::ComparePathDepths(Qt::SortOrder order, shared_ptr<PlaylistItem> _a, shared_ptr<PlaylistItem> _b) {
-
-  shared_ptr<PlaylistItem> a = order == Qt::AscendingOrder ? _a : _b;
-  shared_ptr<PlaylistItem> b = order == Qt::AscendingOrder ? _b : _a;
-
-  int a_dir_level = a->Url().path().count('/');
-  int b_dir_level = b->Url().path().count('/');
-
-  return a_dir_level < b_dir_level;
-
-}
-
 QString Playlist::column_name(Column column) {
 
   switch (column) {
@@ -1217,51 +1226,82 @@ void Playlist::sort(int column, Qt::SortOrder order) {
 
   if (ignore_sorting_) return;
 
-  PlaylistItemList new_items(items_);
-  PlaylistItemList::iterator begin = new_items.begin();
+  Sort(PlaylistSorter::ColumnSortSpec(column, order));
 
-  if (column == Column_Album) {
-    // When sorting by album, also take into account discs and tracks.
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, Column_Track, order, _1, _2));
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, Column_Disc, order, _1, _2));
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, Column_Album, order, _1, _2));
-  }
-  else if (column == Column_Filename) {
-    // When sorting by full paths we also expect a hierarchical order. This returns a breath-first ordering of paths.
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, Column_Filename, order, _1, _2));
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::ComparePathDepths, order, _1, _2));
-  }
-  else {
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, column, order, _1, _2));
-  }
+}
+
+void Playlist::Sort(const PlaylistSorter::SortSpec &spec) {
 
-  undo_stack_->push(new PlaylistUndoCommands::SortItems(this, column, order, new_items));
+  if (spec.isEmpty()) return;
+
+  sort_spec_ = spec;
+  const QList<int> old_rows = PlaylistSorter::Sort(items_, spec);
+
+  undo_stack_->push(new PlaylistUndoCommands::SortItems(this, spec.first().column, spec.first().order, old_rows));
 
   ReshuffleIndices();
 
 }
 
-void Playlist::ReOrderWithoutUndo(const PlaylistItemList &new_items) {
+void Playlist::AddSortColumn(int column) {
+
+  if (ignore_sorting_) return;
+
+  PlaylistSorter::SortSpec spec = sort_spec_;
+
+  // Sorting on a column that's already sorted on flips its order, otherwise it's sorted on after the others.
+  bool found = false;
+  for (PlaylistSorter::SortColumn &sort_column : spec) {
+    if (sort_column.column == column) {
+      sort_column.order = sort_column.order == Qt::AscendingOrder ? Qt::DescendingOrder : Qt::AscendingOrder;
+      found = true;
+    }
+  }
+  if (!found) spec << PlaylistSorter::ColumnSortSpec(column, Qt::AscendingOrder);
+
+  Sort(spec);
+
+}
+
+void Playlist::ReOrderWithoutUndo(const QList<int> &old_rows) {
+
+  if (old_rows.count() != items_.count()) return;
 
   layoutAboutToBeChanged();
 
   PlaylistItemList old_items = items_;
-  items_ = new_items;
-
-  QMap<const PlaylistItem*, int> new_rows;
-  for (int i = 0; i < new_items.length(); ++i) {
-    new_rows[new_items[i].get()] = i;
+  QVector<int> new_rows(old_rows.count());
+  for (int i = 0; i < old_rows.count(); ++i) {
+    items_[i] = old_items[old_rows[i]];
+    new_rows[old_rows[i]] = i;
   }
 
   for (const QModelIndex &idx : persistentIndexList()) {
-    const PlaylistItem *item = old_items[idx.row()].get();
-    changePersistentIndex(idx, index(new_rows[item], idx.column(), idx.parent()));
+    changePersistentIndex(idx, index(new_rows[idx.row()], idx.column(), idx.parent()));
   }
 
   layoutChanged();
 
   emit PlaylistChanged();
-  Save();
+  if (CanSave()) backend_->ReorderPlaylistItemsAsync(id_, old_rows, last_played_row());
+
+}
+
+void Playlist::TrimUndoStack() {
+
+  qint64 cost = 0;
+  for (int i = 0; i < undo_stack_->count(); ++i) {
+    const PlaylistUndoCommands::Base *command = dynamic_cast<const PlaylistUndoCommands::Base*>(undo_stack_->command(i));
+    if (command) cost += command->cost();
+  }
+
+  // Evict the oldest commands that are done first, but always keep the last one so it can be undone.
+  for (int i = 0; cost > kUndoMemoryLimit && i < undo_stack_->index() - 1; ++i) {
+    PlaylistUndoCommands::Base *command = dynamic_cast<PlaylistUndoCommands::Base*>(const_cast<QUndoCommand*>(undo_stack_->command(i)));
+    if (!command || command->evicted()) continue;
+    cost -= command->cost();
+    command->Evict();
+  }
 
 }
 
@@ -1282,7 +1322,7 @@ void Playlist::SetCurrentIsPaused(bool paused) {
 }
 
 void Playlist::Save() const {
-  if (!backend_ || is_loading_) return;
+  if (!CanSave()) return;
 
   backend_->SavePlaylistAsync(id_, items_, last_played_row());
 
@@ -1294,6 +1334,7 @@ void Playlist::Restore() {
 
   items_.clear();
   virtual_items_.clear();
+  shuffled_album_ends_.clear();
   collection_items_by_id_.clear();
 
   cancel_restore_ = false;
@@ -1307,13 +1348,15 @@ void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
   if (cancel_restore_) return;
 
   PlaylistItemList items = future.result();
+  const int loaded_count = items.count();
+  const int previous_count = items_.count();
 
   // Backend returns empty elements for collection items which it couldn't match (because they got deleted); we don't need those
   QMutableListIterator<PlaylistItemPtr> it(items);
   while (it.hasNext()) {
     PlaylistItemPtr item = it.next();
 
-    if (item->IsLocalCollectionItem() && item->Metadata().url().isEmpty()) {
+    if (item->IsLocalCollectionItem() && item->Url().isEmpty()) {
       it.remove();
     }
   }
@@ -1322,6 +1365,11 @@ void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
   InsertItems(items, 0);
   is_loading_ = false;
 
+  // Edits are saved by row, so save everything if the playlist doesn't have exactly the items the backend loaded
+  if (previous_count > 0 || rowCount() != loaded_count) {
+    Save();
+  }
+
   PlaylistBackend::Playlist p = backend_->GetPlaylist(id_);
 
   // The newly loaded list of items might be shorter than it was before so look out for a bad last_played index
@@ -1431,7 +1479,7 @@ PlaylistItemList Playlist::RemoveItemsWithoutUndo(int row, int count) {
     ret << item;
 
     if (item->source() == Song::Source_Collection) {
-      int id = item->Metadata().id();
+      int id = item->collection_id();
       if (id != -1) {
         collection_items_by_id_.remove(id, item);
       }
@@ -1440,13 +1488,7 @@ PlaylistItemList Playlist::RemoveItemsWithoutUndo(int row, int count) {
 
   endRemoveRows();
 
-  QList<int>::iterator it = virtual_items_.begin();
-  while (it != virtual_items_.end()) {
-    if (*it >= items_.count())
-      it = virtual_items_.erase(it);
-    else
-      ++it;
-  }
+  virtual_items_.RemoveFrom(items_.count());
 
   // Reset current_virtual_index_
   if (current_row() == -1)
@@ -1459,7 +1501,7 @@ PlaylistItemList Playlist::RemoveItemsWithoutUndo(int row, int count) {
   else
     current_virtual_index_ = virtual_items_.indexOf(current_row());
 
-  Save();
+  if (CanSave()) backend_->RemovePlaylistItemsAsync(id_, row, count, last_played_row());
   return ret;
 
 }
@@ -1565,8 +1607,6 @@ void Playlist::Clear() {
     undo_stack_->push(new PlaylistUndoCommands::RemoveItems(this, 0, count));
   }
 
-  Save();
-
 }
 
 void Playlist::RemoveItemsNotInQueue() {
@@ -1601,8 +1641,10 @@ void Playlist::RemoveItemsNotInQueue() {
 
 void Playlist::ReloadItems(const QList<int> &rows) {
 
+  PlaylistItemList items;
   for (int row : rows) {
     PlaylistItemPtr item = item_at(row);
+    items << item;
 
     item->Reload();
 
@@ -1614,7 +1656,7 @@ void Playlist::ReloadItems(const QList<int> &rows) {
     }
   }
 
-  Save();
+  if (CanSave()) backend_->UpdatePlaylistItemsAsync(id_, rows, items);
 
 }
 
@@ -1634,7 +1676,9 @@ void Playlist::SongInsertVetoListenerDestroyed() {
 
 void Playlist::Shuffle() {
 
-  PlaylistItemList new_items(items_);
+  QList<int> old_rows;
+  old_rows.reserve(items_.count());
+  for (int i = 0; i < items_.count(); ++i) old_rows << i;
 
   int begin = 0;
 
@@ -1642,10 +1686,10 @@ void Playlist::Shuffle() {
   for (int i = begin; i < count; ++i) {
     int new_pos = i + (rand() % (count - i));
 
-    std::swap(new_items[i], new_items[new_pos]);
+    std::swap(old_rows[i], old_rows[new_pos]);
   }
 
-  undo_stack_->push(new PlaylistUndoCommands::ShuffleItems(this, new_items));
+  undo_stack_->push(new PlaylistUndoCommands::ShuffleItems(this, old_rows));
 
 }
 
@@ -1667,28 +1711,34 @@ void Playlist::ReshuffleIndices() {
     return;
   }
 
+  shuffled_album_ends_.clear();
+
   if (playlist_sequence_->shuffle_mode() == PlaylistSequence::Shuffle_Off) {
     // No shuffling - sort the virtual item list normally.
-    std::sort(virtual_items_.begin(), virtual_items_.end());
+    virtual_items_.Reset(items_.count());
     if (current_row() != -1)
       current_virtual_index_ = virtual_items_.indexOf(current_row());
     return;
   }
 
-  // If the user is already playing a song, advance the begin iterator to only shuffle items that haven't been played yet.
-  QList<int>::iterator begin = virtual_items_.begin();
-  QList<int>::iterator end = virtual_items_.end();
+  // If the user is already playing a song, only shuffle items that haven't been played yet.
+  if (playlist_sequence_->shuffle_mode() != PlaylistSequence::Shuffle_Albums) {
+    virtual_items_.Shuffle(current_virtual_index_ + 1);
+    return;
+  }
+
+  // Albums are sorted as a list, advance the begin iterator past the items that have been played.
+  QList<int> virtual_items = virtual_items_.ToList();
+  QList<int>::iterator begin = virtual_items.begin();
+  QList<int>::iterator end = virtual_items.end();
   if (current_virtual_index_ != -1)
     std::advance(begin, current_virtual_index_ + 1);
 
   switch (playlist_sequence_->shuffle_mode()) {
     case PlaylistSequence::Shuffle_Off:
-      // Handled above.
-      break;
-
     case PlaylistSequence::Shuffle_All:
     case PlaylistSequence::Shuffle_InsideAlbum:
-      std::random_shuffle(begin, end);
+      // Handled above.
       break;
 
     case PlaylistSequence::Shuffle_Albums: {
@@ -1726,10 +1776,82 @@ void Playlist::ReshuffleIndices() {
       // Sort the virtual items
       std::stable_sort(begin, end, std::bind(AlbumShuffleComparator, album_key_positions, album_keys, _1, _2));
 
+      // Remember where each album ends, so songs added later can join it
+      for (QList<int>::iterator it = begin; it != end; ++it) {
+        shuffled_album_ends_[album_keys[*it]] = *it;
+      }
+
       break;
     }
   }
 
+  virtual_items_.SetList(virtual_items);
+
+}
+
+void Playlist::InsertVirtualIndices(int start, int count) {
+
+  const PlaylistSequence::ShuffleMode shuffle_mode = playlist_sequence_ ? playlist_sequence_->shuffle_mode() : PlaylistSequence::Shuffle_Off;
+
+  // The rows after the new ones moved down
+  for (QHash<QString, int>::iterator it = shuffled_album_ends_.begin(); it != shuffled_album_ends_.end(); ++it) {
+    if (it.value() >= start) it.value() += count;
+  }
+
+  if (shuffle_mode == PlaylistSequence::Shuffle_Off) {
+    virtual_items_.Insert(start, count, start);
+    if (current_row() != -1) current_virtual_index_ = virtual_items_.indexOf(current_row());
+    return;
+  }
+
+  // Add the new rows at the end first, then move them to their place one by one.
+  const int old_count = virtual_items_.count();
+  virtual_items_.Insert(start, count, old_count);
+
+  for (int i = 0; i < count; ++i) {
+    const int row = start + i;
+    // The number of rows placed so far, the ones still waiting are after them.
+    const int placed = old_count + i;
+    // Songs that were already played keep their place, the new ones are shuffled in after the current one.
+    const int begin = qBound(0, current_virtual_index_ + 1, placed);
+
+    switch (shuffle_mode) {
+      case PlaylistSequence::Shuffle_Off:
+        break;
+
+      case PlaylistSequence::Shuffle_All:
+      case PlaylistSequence::Shuffle_InsideAlbum:
+        virtual_items_.Move(row, begin + rand() % (placed - begin + 1));
+        break;
+
+      case PlaylistSequence::Shuffle_Albums: {
+        const QString key = items_[row]->Metadata().AlbumKey();
+        int pos = -1;
+
+        // Add it to the end of its album if that hasn't been played yet
+        if (shuffled_album_ends_.contains(key)) {
+          const int album_end = shuffled_album_ends_[key];
+          const int album_end_pos = virtual_items_.indexOf(album_end);
+          if (album_end_pos >= begin && album_end_pos < placed && items_[album_end]->Metadata().AlbumKey() == key) {
+            pos = album_end_pos + 1;
+          }
+        }
+
+        // Otherwise start a new album at a random place between two others
+        if (pos == -1) {
+          pos = begin + rand() % (placed - begin + 1);
+          while (pos > begin && pos < placed && items_[virtual_items_[pos - 1]]->Metadata().AlbumKey() == items_[virtual_items_[pos]]->Metadata().AlbumKey()) {
+            ++pos;
+          }
+        }
+
+        virtual_items_.Move(row, pos);
+        shuffled_album_ends_[key] = row;
+        break;
+      }
+    }
+  }
+
 }
 
 void Playlist::set_sequence(PlaylistSequence *v) {
@@ -1820,10 +1942,11 @@ void Playlist::InvalidateDeletedSongs() {
 
   for (int row = 0; row < items_.count(); ++row) {
     PlaylistItemPtr item = items_[row];
-    Song song = item->Metadata();
+    // The URL doesn't need the metadata of lazily restored items
+    const QUrl url = item->Url();
 
-    if (song.url().scheme() == "file") {
-      bool exists = QFile::exists(song.url().toLocalFile());
+    if (url.scheme() == "file") {
+      bool exists = QFile::exists(url.toLocalFile());
 
       if (!exists && !item->HasForegroundColor(kInvalidSongPriority)) {
         // gray out the song if it's not there
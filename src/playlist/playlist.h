@@ -33,7 +33,9 @@
 #include <QPersistentModelIndex>
 #include <QFuture>
 #include <QList>
+#include <QHash>
 #include <QMap>
+#include <QMultiHash>
 #include <QMetaType>
 #include <QMimeData>
 #include <QVariant>
@@ -46,7 +48,9 @@
 #include "core/song.h"
 #include "core/tagreaderclient.h"
 #include "playlistitem.h"
+#include "playlistorder.h"
 #include "playlistsequence.h"
+#include "playlistsorter.h"
 
 class CollectionBackend;
 class PlaylistBackend;
@@ -159,12 +163,14 @@ class Playlist : public QAbstractListModel {
 
   static const int kUndoStackSize;
   static const int kUndoItemLimit;
+  // The oldest undo commands are evicted when the stack holds more than this many bytes
+  static const int kUndoMemoryLimit;
+  // Dropping this many songs creates the playlist items in the background
+  static const int kBackgroundInsertSize;
 
   static const qint64 kMinScrobblePointNsecs;
   static const qint64 kMaxScrobblePointNsecs;
 
-  static bool CompareItems(int column, Qt::SortOrder order, PlaylistItemPtr a, PlaylistItemPtr b);
-
   static QString column_name(Column column);
   static QString abbreviated_column_name(Column column);
 
@@ -177,6 +183,7 @@ class Playlist : public QAbstractListModel {
 
   // Accessors
   QSortFilterProxyModel *proxy() const;
+  PlaylistFilter *filter() const { return proxy_; }
   Queue *queue() const { return queue_; }
 
   int id() const { return id_; }
@@ -269,10 +276,12 @@ class Playlist : public QAbstractListModel {
   QMimeData *mimeData(const QModelIndexList &indexes) const;
   bool dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column, const QModelIndex &parent);
   void sort(int column, Qt::SortOrder order);
+  // Sorts on several columns at once
+  void Sort(const PlaylistSorter::SortSpec &spec);
+  // Sorts on column after the columns the playlist was last sorted on
+  void AddSortColumn(int column);
   bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex());
 
-  static bool ComparePathDepths(Qt::SortOrder, PlaylistItemPtr, PlaylistItemPtr);
-
  public slots:
   void set_current_row(int index, bool is_stopping = false);
   void Paused();
@@ -319,9 +328,15 @@ private:
   int NextVirtualIndex(int i, bool ignore_repeat_track) const;
   int PreviousVirtualIndex(int i, bool ignore_repeat_track) const;
   bool FilterContainsVirtualIndex(int i) const;
+  // Adds the count rows inserted at start to the play order without reshuffling the rest.
+  void InsertVirtualIndices(int start, int count);
 
   template <typename T>
   void InsertSongItems(const SongList &songs, int pos, bool play_now, bool enqueue, bool enqueue_next = false);
+  template <typename T>
+  void InsertSongItemsInBackground(const SongList &songs, int pos, bool play_now, bool enqueue, bool enqueue_next);
+  template <typename T>
+  static PlaylistItemList NewSongItems(const SongList &songs, TaskManager *task_manager, int task_id);
 
   // Modify the playlist without changing the undo stack.  These are used by our friends in PlaylistUndoCommands
   void InsertItemsWithoutUndo(const PlaylistItemList &items, int pos, bool enqueue = false, bool enqueue_next = false);
@@ -329,7 +344,10 @@ private:
   void MoveItemsWithoutUndo(const QList<int> &source_rows, int pos);
   void MoveItemWithoutUndo(int source, int dest);
   void MoveItemsWithoutUndo(int start, const QList<int> &dest_rows);
-  void ReOrderWithoutUndo(const PlaylistItemList &new_items);
+  void ReOrderWithoutUndo(const QList<int> &old_rows);
+
+  // Edits are saved to the backend as they happen, except while the items are being restored from it
+  bool CanSave() const { return backend_ && !is_loading_; }
 
   void RemoveItemsNotInQueue();
 
@@ -344,7 +362,9 @@ private:
   void SongSaveComplete(TagReaderReply *reply, const QPersistentModelIndex &index);
   void ItemReloadComplete(const QPersistentModelIndex &index);
   void ItemsLoaded(QFuture<PlaylistItemList> future);
+  void SongItemsCreated(QFuture<PlaylistItemList> future, int pos, bool play_now, bool enqueue, bool enqueue_next, int task_id);
   void SongInsertVetoListenerDestroyed();
+  void TrimUndoStack();
 
 private:
   bool is_loading_;
@@ -362,9 +382,11 @@ private:
 
   PlaylistItemList items_;
   // Contains the indices into items_ in the order that they will be played.
-  QList<int> virtual_items_;
+  PlaylistOrder virtual_items_;
+  // When shuffling albums, album key -> the last index into items_ of that album in virtual_items_.
+  QHash<QString, int> shuffled_album_ends_;
   // A map of collection ID to playlist item - for fast lookups when collection items change.
-  QMultiMap<int, PlaylistItemPtr> collection_items_by_id_;
+  QMultiHash<int, PlaylistItemPtr> collection_items_by_id_;
 
   QPersistentModelIndex current_item_index_;
   QPersistentModelIndex last_played_item_index_;
@@ -378,6 +400,7 @@ private:
 
   // Hack to stop QTreeView::setModel sorting the playlist
   bool ignore_sorting_;
+  PlaylistSorter::SortSpec sort_spec_;
 
   QUndoStack *undo_stack_;
 
@@ -27,7 +27,9 @@
 #include <QDir>
 #include <QFile>
 #include <QByteArray>
+#include <QDataStream>
 #include <QHash>
+#include <QSet>
 #include <QList>
 #include <QVariant>
 #include <QString>
@@ -42,11 +44,13 @@
 #include "core/database.h"
 #include "core/logging.h"
 #include "core/scopedtransaction.h"
+#include "core/sqlstatement.h"
 #include "core/song.h"
 #include "collection/collectionbackend.h"
 #include "collection/sqlrow.h"
 #include "playlistitem.h"
 #include "songplaylistitem.h"
+#include "lazyplaylistitem.h"
 #include "playlistbackend.h"
 #include "playlistparsers/cueparser.h"
 
@@ -54,6 +58,30 @@ using std::placeholders::_1;
 using std::shared_ptr;
 
 const int PlaylistBackend::kSongTableJoins = 2;
+const int PlaylistBackend::kJournalCompactSize = 100;
+const int PlaylistBackend::kLazyRestoreSize = 5000;
+
+namespace {
+
+QByteArray EncodeRows(const QList<int> &rows) {
+
+  QByteArray data;
+  QDataStream s(&data, QIODevice::WriteOnly);
+  s << rows;
+  return data;
+
+}
+
+QList<int> DecodeRows(QByteArray data) {
+
+  QList<int> rows;
+  QDataStream s(&data, QIODevice::ReadOnly);
+  s >> rows;
+  return rows;
+
+}
+
+}  // namespace
 
 PlaylistBackend::PlaylistBackend(Application *app, QObject *parent)
     : QObject(parent), app_(app), db_(app_->database()) {}
@@ -72,8 +100,7 @@ PlaylistBackend::PlaylistList PlaylistBackend::GetAllFavoritePlaylists() {
 
 PlaylistBackend::PlaylistList PlaylistBackend::GetPlaylists(GetPlaylistsFlags flags) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   PlaylistList ret;
 
@@ -111,8 +138,7 @@ PlaylistBackend::PlaylistList PlaylistBackend::GetPlaylists(GetPlaylistsFlags fl
 
 PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(int id) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QSqlQuery q(db);
   q.prepare("SELECT ROWID, name, last_played, special_type, ui_path, is_favorite FROM playlists WHERE ROWID=:id");
@@ -135,64 +161,243 @@ PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(int id) {
 
 }
 
-QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
+QString PlaylistBackend::PlaylistRowsQuery(const QString &condition) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  return "SELECT songs.ROWID, " + Song::JoinSpec("songs") +
+         ","
+         "       p.ROWID, " +
+         Song::JoinSpec("p") +
+         ","
+         "       p.type"
+         " FROM playlist_items AS p"
+         " LEFT JOIN songs"
+         "    ON p.collection_id = songs.ROWID"
+         " WHERE " + condition;
 
-  QString query = "SELECT songs.ROWID, " + Song::JoinSpec("songs") +
-                  ","
-                  "       p.ROWID, " +
-                  Song::JoinSpec("p") +
-                  ","
-                  "       p.type"
-                  " FROM playlist_items AS p"
-                  " LEFT JOIN songs"
-                  "    ON p.collection_id = songs.ROWID"
-                  " WHERE p.playlist = :playlist";
-  QSqlQuery q(db);
-  // Forward iterations only may be faster
-  q.setForwardOnly(true);
-  q.prepare(query);
-  q.bindValue(":playlist", playlist);
-  q.exec();
+}
+
+QHash<int, PlaylistItemPtr> PlaylistBackend::NewPlaylistItemsFromQuery(SqlStatement &q) {
+
+  // The playlist item ROWID comes after the joined song table and its ROWID
+  const int rowid_column = Song::kColumns.count() + 1;
 
-  return q;
+  // it's probable that we'll have a few songs associated with the same CUE so we're caching results of parsing CUEs
+  std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
+  QHash<int, PlaylistItemPtr> items_by_rowid;
+  while (q.next()) {
+    // The items are read straight from the statement's current row
+    items_by_rowid.insert(q.toInt(rowid_column), NewPlaylistItemFromQuery(SqlRow(q), state_ptr));
+  }
+  return items_by_rowid;
 
 }
 
 QList<PlaylistItemPtr> PlaylistBackend::GetPlaylistItems(int playlist) {
 
-  QSqlQuery q = GetPlaylistRows(playlist);
-  // Note that as this only accesses the query, not the db, we don't need the mutex.
-  if (db_->CheckErrors(q)) return QList<PlaylistItemPtr>();
+  QSqlDatabase db(db_->ConnectReadOnly());
+  const QList<int> order = LoadItemOrder(db, playlist);
+
+  if (order.count() > kLazyRestoreSize) {
+    return GetLazyPlaylistItems(db, playlist, order);
+  }
+
+  SqlStatement q(db_, db, PlaylistRowsQuery("p.playlist = :playlist"));
+  q.bindValue(":playlist", playlist);
+  QHash<int, PlaylistItemPtr> items_by_rowid = NewPlaylistItemsFromQuery(q);
+  if (q.CheckErrors()) return QList<PlaylistItemPtr>();
 
-  // it's probable that we'll have a few songs associated with the same CUE so we're caching results of parsing CUEs
-  std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
   QList<PlaylistItemPtr> playlistitems;
+  playlistitems.reserve(order.count());
+  for (int rowid : order) {
+    if (items_by_rowid.contains(rowid)) playlistitems << items_by_rowid.take(rowid);
+  }
+  return playlistitems;
+
+}
+
+QList<PlaylistItemPtr> PlaylistBackend::GetLazyPlaylistItems(QSqlDatabase &db, int playlist, const QList<int> &order) {
+
+  qLog(Debug) << "Restoring" << order.count() << "items of playlist" << playlist << "lazily";
+
+  struct Row {
+    Song::Source source;
+    int collection_id;
+    QString filename;
+  };
+
+  // Only what's needed to place the items in the playlist, the metadata is loaded by the pager
+  QSqlQuery q(db);
+  q.setForwardOnly(true);
+  q.prepare("SELECT p.ROWID, p.type, p.collection_id, p.filename, songs.filename FROM playlist_items AS p LEFT JOIN songs ON p.collection_id = songs.ROWID WHERE p.playlist = :playlist");
+  q.bindValue(":playlist", playlist);
+  q.exec();
+  if (db_->CheckErrors(q)) return QList<PlaylistItemPtr>();
+
+  QHash<int, Row> rows;
+  rows.reserve(order.count());
   while (q.next()) {
-    playlistitems << NewPlaylistItemFromQuery(SqlRow(q), state_ptr);
+    Row row;
+    row.source = Song::Source(q.value(1).toInt());
+    row.collection_id = q.value(2).isNull() ? -1 : q.value(2).toInt();
+    // Collection items get their URL from the songs table, it's empty if the song was deleted
+    row.filename = q.value(row.source == Song::Source_Collection ? 4 : 3).toString();
+    rows.insert(q.value(0).toInt(), row);
+  }
+
+  std::shared_ptr<PlaylistItemPager> pager(new PlaylistItemPager(this));
+  QList<PlaylistItemPtr> playlistitems;
+  playlistitems.reserve(order.count());
+  for (int i = 0; i < order.count(); i += PlaylistItemPager::kPageSize) {
+    const QList<int> ids = order.mid(i, PlaylistItemPager::kPageSize);
+    const int page = pager->AddPage(ids);
+    for (int id : ids) {
+      if (!rows.contains(id)) continue;
+      const Row &row = rows[id];
+      Song song(row.source);
+      if (!row.filename.isEmpty()) song.set_url(QUrl::fromEncoded(row.filename.toUtf8()));
+      playlistitems << PlaylistItemPtr(new LazyPlaylistItem(row.source, id, row.collection_id, song.url(), pager, page));
+    }
   }
   return playlistitems;
 
 }
 
-QList<Song> PlaylistBackend::GetPlaylistSongs(int playlist) {
+QHash<int, PlaylistItemPtr> PlaylistBackend::GetPlaylistItemsById(const QList<int> &ids) {
 
-  QSqlQuery q = GetPlaylistRows(playlist);
-  // Note that as this only accesses the query, not the db, we don't need the mutex.
-  if (db_->CheckErrors(q)) return QList<Song>();
+  if (ids.isEmpty()) return QHash<int, PlaylistItemPtr>();
 
-  // it's probable that we'll have a few songs associated with the same CUE so we're caching results of parsing CUEs
-  std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
+  QSqlDatabase db(db_->ConnectReadOnly());
+
+  // The ids are bound instead of put in the SQL, so pages of the same size share the prepared statement
+  QStringList placeholders;
+  for (int i = 0; i < ids.count(); ++i) placeholders << "?";
+
+  SqlStatement q(db_, db, PlaylistRowsQuery("p.ROWID IN (" + placeholders.join(",") + ")"));
+  for (int id : ids) q.addBindValue(id);
+  QHash<int, PlaylistItemPtr> items_by_rowid = NewPlaylistItemsFromQuery(q);
+  if (q.CheckErrors()) return QHash<int, PlaylistItemPtr>();
+
+  return items_by_rowid;
+
+}
+
+QList<Song> PlaylistBackend::GetPlaylistSongs(int playlist) {
+
+  // Lazily restored items load their metadata a page at a time, so this doesn't hold every full item at once
   QList<Song> songs;
-  while (q.next()) {
-    songs << NewSongFromQuery(SqlRow(q), state_ptr);
+  for (PlaylistItemPtr item : GetPlaylistItems(playlist)) {
+    if (item) songs << item->Metadata();
   }
   return songs;
 
 }
 
+QList<int> PlaylistBackend::LoadItemOrder(QSqlDatabase &db, int playlist, int *journal_size) {
+
+  QList<int> order;
+
+  QSqlQuery q(db);
+  q.prepare("SELECT item_order FROM playlists WHERE ROWID=:playlist");
+  q.bindValue(":playlist", playlist);
+  q.exec();
+  if (db_->CheckErrors(q)) return order;
+
+  if (q.next() && !q.value(0).isNull()) {
+    order = DecodeRows(q.value(0).toByteArray());
+  }
+  else {
+    // Playlists that were never compacted keep their items in ROWID order
+    q.prepare("SELECT ROWID FROM playlist_items WHERE playlist=:playlist ORDER BY ROWID");
+    q.bindValue(":playlist", playlist);
+    q.exec();
+    if (db_->CheckErrors(q)) return order;
+    while (q.next()) {
+      order << q.value(0).toInt();
+    }
+  }
+
+  q.prepare("SELECT operation, position, rows FROM playlist_items_journal WHERE playlist=:playlist ORDER BY ROWID");
+  q.bindValue(":playlist", playlist);
+  q.exec();
+  if (db_->CheckErrors(q)) return order;
+
+  int size = 0;
+  while (q.next()) {
+    ApplyJournalOperation(&order, JournalOperation(q.value(0).toInt()), q.value(1).toInt(), DecodeRows(q.value(2).toByteArray()));
+    ++size;
+  }
+  if (journal_size) *journal_size = size;
+
+  return order;
+
+}
+
+QList<int> *PlaylistBackend::ItemOrder(QSqlDatabase &db, int playlist) {
+
+  if (!item_orders_.contains(playlist)) {
+    int journal_size = 0;
+    item_orders_.insert(playlist, LoadItemOrder(db, playlist, &journal_size));
+    journal_sizes_.insert(playlist, journal_size);
+  }
+  return &item_orders_[playlist];
+
+}
+
+void PlaylistBackend::ApplyJournalOperation(QList<int> *order, JournalOperation operation, int position, const QList<int> &rows) {
+
+  switch (operation) {
+    case JournalOperation_Insert: {
+      // rows are the ROWIDs of the inserted items
+      const int start = qBound(0, position, order->count());
+      for (int i = 0; i < rows.count(); ++i) {
+        order->insert(start + i, rows[i]);
+      }
+      break;
+    }
+
+    case JournalOperation_Remove: {
+      // rows are the ROWIDs of the removed items
+      const int start = qBound(0, position, order->count());
+      order->erase(order->begin() + start, order->begin() + qMin(start + rows.count(), order->count()));
+      break;
+    }
+
+    case JournalOperation_Move: {
+      // rows are the source rows, the same as Playlist::MoveItemsWithoutUndo(source_rows, pos)
+      const int pos = position < 0 ? order->count() : position;
+      QList<int> moved;
+      int start = pos;
+      int offset = 0;
+      for (int source_row : rows) {
+        moved << order->takeAt(source_row - offset);
+        if (pos > source_row) start--;
+        offset++;
+      }
+      for (int i = 0; i < moved.count(); ++i) {
+        order->insert(start + i, moved[i]);
+      }
+      break;
+    }
+
+    case JournalOperation_MoveBack: {
+      // rows are the destination rows, the same as Playlist::MoveItemsWithoutUndo(start, dest_rows)
+      int start = position;
+      for (int dest_row : rows) {
+        if (dest_row < position) start--;
+      }
+      if (start < 0) start = order->count() - rows.count();
+      QList<int> moved;
+      for (int i = 0; i < rows.count(); ++i) {
+        moved << order->takeAt(start);
+      }
+      for (int i = 0; i < rows.count(); ++i) {
+        order->insert(rows[i], moved[i]);
+      }
+      break;
+    }
+  }
+
+}
 PlaylistItemPtr PlaylistBackend::NewPlaylistItemFromQuery(const SqlRow &row, std::shared_ptr<NewSongFromQueryState> state) {
 
   // The song tables get joined first, plus one each for the song ROWIDs
@@ -209,12 +414,6 @@ PlaylistItemPtr PlaylistBackend::NewPlaylistItemFromQuery(const SqlRow &row, std
 
 }
 
-Song PlaylistBackend::NewSongFromQuery(const SqlRow &row, std::shared_ptr<NewSongFromQueryState> state) {
-
-  return NewPlaylistItemFromQuery(row, state)->Metadata();
-
-}
-
 // If song had a CUE and the CUE still exists, the metadata from it will be applied here.
 
 PlaylistItemPtr PlaylistBackend::RestoreCueData(PlaylistItemPtr item, std::shared_ptr<NewSongFromQueryState> state) {
@@ -222,8 +421,6 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(PlaylistItemPtr item, std::share
   // We need collection to run a CueParser; also, this method applies only to file-type PlaylistItems
   if (item->source() != Song::Source_LocalFile) return item;
 
-  CueParser cue_parser(app_->collection_backend());
-
   Song song = item->Metadata();
   // we're only interested in .cue songs here
   if (!song.has_cue()) return item;
@@ -243,6 +440,7 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(PlaylistItemPtr item, std::share
       QFile cue(cue_path);
       cue.open(QIODevice::ReadOnly);
 
+      CueParser cue_parser(app_->collection_backend());
       song_list = cue_parser.Load(&cue, cue_path, QDir(cue_path.section('/', 0, -2)));
       state->cached_cues_[cue_path] = song_list;
     }
@@ -270,6 +468,48 @@ void PlaylistBackend::SavePlaylistAsync(int playlist, const PlaylistItemList &it
 
 }
 
+void PlaylistBackend::InsertPlaylistItemsAsync(int playlist, int pos, const PlaylistItemList &items, int last_played) {
+
+  metaObject()->invokeMethod(this, "InsertPlaylistItems", Qt::QueuedConnection, Q_ARG(int, playlist), Q_ARG(int, pos), Q_ARG(PlaylistItemList, items), Q_ARG(int, last_played));
+
+}
+
+void PlaylistBackend::RemovePlaylistItemsAsync(int playlist, int pos, int count, int last_played) {
+
+  metaObject()->invokeMethod(this, "RemovePlaylistItems", Qt::QueuedConnection, Q_ARG(int, playlist), Q_ARG(int, pos), Q_ARG(int, count), Q_ARG(int, last_played));
+
+}
+
+void PlaylistBackend::MovePlaylistItemsAsync(int playlist, const QList<int> &source_rows, int pos, int last_played) {
+
+  metaObject()->invokeMethod(this, "MovePlaylistItems", Qt::QueuedConnection, Q_ARG(int, playlist), Q_ARG(QList<int>, source_rows), Q_ARG(int, pos), Q_ARG(int, last_played));
+
+}
+
+void PlaylistBackend::MovePlaylistItemsBackAsync(int playlist, int start, const QList<int> &dest_rows, int last_played) {
+
+  metaObject()->invokeMethod(this, "MovePlaylistItemsBack", Qt::QueuedConnection, Q_ARG(int, playlist), Q_ARG(int, start), Q_ARG(QList<int>, dest_rows), Q_ARG(int, last_played));
+
+}
+
+void PlaylistBackend::ReorderPlaylistItemsAsync(int playlist, const QList<int> &old_rows, int last_played) {
+
+  metaObject()->invokeMethod(this, "ReorderPlaylistItems", Qt::QueuedConnection, Q_ARG(int, playlist), Q_ARG(QList<int>, old_rows), Q_ARG(int, last_played));
+
+}
+
+void PlaylistBackend::UpdatePlaylistItemsAsync(int playlist, const QList<int> &rows, const PlaylistItemList &items) {
+
+  metaObject()->invokeMethod(this, "UpdatePlaylistItems", Qt::QueuedConnection, Q_ARG(int, playlist), Q_ARG(QList<int>, rows), Q_ARG(PlaylistItemList, items));
+
+}
+
+void PlaylistBackend::SetLastPlayedAsync(int playlist, int last_played) {
+
+  metaObject()->invokeMethod(this, "SetLastPlayed", Qt::QueuedConnection, Q_ARG(int, playlist), Q_ARG(int, last_played));
+
+}
+
 void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList &items, int last_played) {
 
   QMutexLocker l(db_->Mutex());
@@ -277,36 +517,326 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList &items,
 
   qLog(Debug) << "Saving playlist" << playlist;
 
-  QSqlQuery clear(db);
-  clear.prepare("DELETE FROM playlist_items WHERE playlist = :playlist");
+  QSqlQuery select(db);
+  select.prepare("SELECT ROWID FROM playlist_items WHERE playlist = :playlist");
+  QSqlQuery remove(db);
+  remove.prepare("DELETE FROM playlist_items WHERE ROWID = :id");
   QSqlQuery insert(db);
   insert.prepare("INSERT INTO playlist_items (playlist, type, collection_id, " + Song::kColumnSpec + ") VALUES (:playlist, :type, :collection_id, " + Song::kBindSpec + ")");
   QSqlQuery update(db);
-  update.prepare("UPDATE playlists SET last_played=:last_played WHERE ROWID=:playlist");
+  update.prepare("UPDATE playlist_items SET type=:type, collection_id=:collection_id, " + Song::kUpdateSpec + " WHERE ROWID=:id");
 
   ScopedTransaction transaction(&db);
 
-  // Clear the existing items in the playlist
-  clear.bindValue(":playlist", playlist);
-  clear.exec();
-  if (db_->CheckErrors(clear)) return;
+  select.bindValue(":playlist", playlist);
+  select.exec();
+  if (db_->CheckErrors(select)) return;
+  QSet<int> existing;
+  while (select.next()) existing << select.value(0).toInt();
 
-  // Save the new ones
+  // Lazily restored items keep their rows, their pager looks them up by ROWID.
+  // Everything else is inserted again before the old rows are removed, so items copied from other lazy playlists can still be read.
+  QList<int> order;
+  QSet<int> kept;
   for (const PlaylistItemPtr item : items) {
+    LazyPlaylistItem *lazy_item = dynamic_cast<LazyPlaylistItem*>(item.get());
+    if (lazy_item && existing.contains(lazy_item->id()) && !kept.contains(lazy_item->id())) {
+      kept << lazy_item->id();
+      order << lazy_item->id();
+      if (lazy_item->is_reloaded()) {
+        item->BindToQuery(&update);
+        update.bindValue(":id", lazy_item->id());
+        update.exec();
+        if (db_->CheckErrors(update)) return;
+      }
+      continue;
+    }
+
     insert.bindValue(":playlist", playlist);
     item->BindToQuery(&insert);
 
     insert.exec();
-    db_->CheckErrors(insert);
+    if (db_->CheckErrors(insert)) return;
+    order << insert.lastInsertId().toInt();
   }
 
+  // Clear the rows that are no longer in the playlist
+  for (int id : existing) {
+    if (kept.contains(id)) continue;
+    remove.bindValue(":id", id);
+    remove.exec();
+    if (db_->CheckErrors(remove)) return;
+  }
+
+  if (!WriteItemOrder(db, playlist, order)) return;
+
   // Update the last played track number
-  update.bindValue(":last_played", last_played);
+  if (!UpdateLastPlayed(db, playlist, last_played)) return;
+
+  transaction.Commit();
+
+  item_orders_[playlist] = order;
+  journal_sizes_[playlist] = 0;
+
+}
+
+void PlaylistBackend::InsertPlaylistItems(int playlist, int pos, const PlaylistItemList &items, int last_played) {
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QList<int> *order = ItemOrder(db, playlist);
+  if (pos < 0 || pos > order->count()) pos = order->count();
+
+  QSqlQuery insert(db);
+  insert.prepare("INSERT INTO playlist_items (playlist, type, collection_id, " + Song::kColumnSpec + ") VALUES (:playlist, :type, :collection_id, " + Song::kBindSpec + ")");
+
+  ScopedTransaction transaction(&db);
+
+  // Only the new items are written, the order of the rest is unchanged
+  QList<int> rows;
+  for (const PlaylistItemPtr item : items) {
+    insert.bindValue(":playlist", playlist);
+    item->BindToQuery(&insert);
+
+    insert.exec();
+    if (db_->CheckErrors(insert)) return;
+    rows << insert.lastInsertId().toInt();
+  }
+
+  if (!AppendJournal(db, playlist, JournalOperation_Insert, pos, rows)) return;
+  if (!UpdateLastPlayed(db, playlist, last_played)) return;
+
+  transaction.Commit();
+
+  ApplyJournalOperation(order, JournalOperation_Insert, pos, rows);
+  JournalAppended(playlist);
+
+}
+
+void PlaylistBackend::RemovePlaylistItems(int playlist, int pos, int count, int last_played) {
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QList<int> *order = ItemOrder(db, playlist);
+  if (pos < 0 || count <= 0 || pos + count > order->count()) {
+    qLog(Error) << "Can't remove items" << pos << "to" << pos + count << "from playlist" << playlist << "with" << order->count() << "items";
+    return;
+  }
+  const QList<int> rows = order->mid(pos, count);
+  const bool remove_all = count == order->count();
+
+  QSqlQuery remove(db);
+  if (remove_all) {
+    remove.prepare("DELETE FROM playlist_items WHERE playlist=:playlist");
+  }
+  else {
+    remove.prepare("DELETE FROM playlist_items WHERE ROWID=:id");
+  }
+
+  ScopedTransaction transaction(&db);
+
+  if (remove_all) {
+    // Nothing is left to keep a journal for
+    remove.bindValue(":playlist", playlist);
+    remove.exec();
+    if (db_->CheckErrors(remove)) return;
+    if (!WriteItemOrder(db, playlist, QList<int>())) return;
+  }
+  else {
+    for (int rowid : rows) {
+      remove.bindValue(":id", rowid);
+      remove.exec();
+      if (db_->CheckErrors(remove)) return;
+    }
+    if (!AppendJournal(db, playlist, JournalOperation_Remove, pos, rows)) return;
+  }
+
+  if (!UpdateLastPlayed(db, playlist, last_played)) return;
+
+  transaction.Commit();
+
+  if (remove_all) {
+    order->clear();
+    journal_sizes_[playlist] = 0;
+  }
+  else {
+    ApplyJournalOperation(order, JournalOperation_Remove, pos, rows);
+    JournalAppended(playlist);
+  }
+
+}
+
+void PlaylistBackend::MovePlaylistItems(int playlist, const QList<int> &source_rows, int pos, int last_played) {
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QList<int> *order = ItemOrder(db, playlist);
+
+  ScopedTransaction transaction(&db);
+
+  if (!AppendJournal(db, playlist, JournalOperation_Move, pos, source_rows)) return;
+  if (!UpdateLastPlayed(db, playlist, last_played)) return;
+
+  transaction.Commit();
+
+  ApplyJournalOperation(order, JournalOperation_Move, pos, source_rows);
+  JournalAppended(playlist);
+
+}
+
+void PlaylistBackend::MovePlaylistItemsBack(int playlist, int start, const QList<int> &dest_rows, int last_played) {
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QList<int> *order = ItemOrder(db, playlist);
+
+  ScopedTransaction transaction(&db);
+
+  if (!AppendJournal(db, playlist, JournalOperation_MoveBack, start, dest_rows)) return;
+  if (!UpdateLastPlayed(db, playlist, last_played)) return;
+
+  transaction.Commit();
+
+  ApplyJournalOperation(order, JournalOperation_MoveBack, start, dest_rows);
+  JournalAppended(playlist);
+
+}
+
+void PlaylistBackend::ReorderPlaylistItems(int playlist, const QList<int> &old_rows, int last_played) {
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QList<int> *order = ItemOrder(db, playlist);
+  if (old_rows.count() != order->count()) {
+    qLog(Error) << "Can't reorder playlist" << playlist << "with" << order->count() << "items to" << old_rows.count() << "items";
+    return;
+  }
+
+  // Every item can move, so write the new order directly instead of journaling it
+  QList<int> new_order;
+  new_order.reserve(old_rows.count());
+  for (int row : old_rows) {
+    new_order << order->value(row, -1);
+  }
+
+  ScopedTransaction transaction(&db);
+
+  if (!WriteItemOrder(db, playlist, new_order)) return;
+  if (!UpdateLastPlayed(db, playlist, last_played)) return;
+
+  transaction.Commit();
+
+  *order = new_order;
+  journal_sizes_[playlist] = 0;
+
+}
+
+void PlaylistBackend::UpdatePlaylistItems(int playlist, const QList<int> &rows, const PlaylistItemList &items) {
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  const QList<int> *order = ItemOrder(db, playlist);
+
+  QSqlQuery update(db);
+  update.prepare("UPDATE playlist_items SET type=:type, collection_id=:collection_id, " + Song::kUpdateSpec + " WHERE ROWID=:id");
+
+  ScopedTransaction transaction(&db);
+
+  for (int i = 0; i < rows.count() && i < items.count(); ++i) {
+    if (rows[i] < 0 || rows[i] >= order->count()) continue;
+
+    items[i]->BindToQuery(&update);
+    update.bindValue(":id", order->at(rows[i]));
+    update.exec();
+    if (db_->CheckErrors(update)) return;
+  }
+
+  transaction.Commit();
+
+}
+
+void PlaylistBackend::SetLastPlayed(int playlist, int last_played) {
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  UpdateLastPlayed(db, playlist, last_played);
+
+}
+
+void PlaylistBackend::CompactPlaylist(int playlist) {
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  // Removed since the compaction was queued
+  if (!item_orders_.contains(playlist)) return;
+
+  qLog(Debug) << "Compacting playlist" << playlist;
+
+  ScopedTransaction transaction(&db);
+
+  if (!WriteItemOrder(db, playlist, item_orders_[playlist])) return;
+
+  transaction.Commit();
+
+  journal_sizes_[playlist] = 0;
+
+}
+
+bool PlaylistBackend::AppendJournal(QSqlDatabase &db, int playlist, JournalOperation operation, int position, const QList<int> &rows) {
+
+  QSqlQuery q(db);
+  q.prepare("INSERT INTO playlist_items_journal (playlist, operation, position, rows) VALUES (:playlist, :operation, :position, :rows)");
+  q.bindValue(":playlist", playlist);
+  q.bindValue(":operation", operation);
+  q.bindValue(":position", position);
+  q.bindValue(":rows", EncodeRows(rows));
+  q.exec();
+  return !db_->CheckErrors(q);
+
+}
+
+void PlaylistBackend::JournalAppended(int playlist) {
+
+  // A long journal makes loading the playlist slower, so fold it into the order after the edits that are already queued.
+  if (++journal_sizes_[playlist] == kJournalCompactSize) {
+    metaObject()->invokeMethod(this, "CompactPlaylist", Qt::QueuedConnection, Q_ARG(int, playlist));
+  }
+
+}
+
+bool PlaylistBackend::WriteItemOrder(QSqlDatabase &db, int playlist, const QList<int> &order) {
+
+  QSqlQuery update(db);
+  update.prepare("UPDATE playlists SET item_order=:item_order WHERE ROWID=:playlist");
+  update.bindValue(":item_order", EncodeRows(order));
   update.bindValue(":playlist", playlist);
   update.exec();
-  if (db_->CheckErrors(update)) return;
+  if (db_->CheckErrors(update)) return false;
 
-  transaction.Commit();
+  QSqlQuery clear(db);
+  clear.prepare("DELETE FROM playlist_items_journal WHERE playlist=:playlist");
+  clear.bindValue(":playlist", playlist);
+  clear.exec();
+  return !db_->CheckErrors(clear);
+
+}
+
+bool PlaylistBackend::UpdateLastPlayed(QSqlDatabase &db, int playlist, int last_played) {
+
+  QSqlQuery update(db);
+  update.prepare("UPDATE playlists SET last_played=:last_played WHERE ROWID=:playlist");
+  update.bindValue(":last_played", last_played);
+  update.bindValue(":playlist", playlist);
+  update.exec();
+  return !db_->CheckErrors(update);
 
 }
 
@@ -334,9 +864,12 @@ void PlaylistBackend::RemovePlaylist(int id) {
   delete_playlist.prepare("DELETE FROM playlists WHERE ROWID=:id");
   QSqlQuery delete_items(db);
   delete_items.prepare("DELETE FROM playlist_items WHERE playlist=:id");
+  QSqlQuery delete_journal(db);
+  delete_journal.prepare("DELETE FROM playlist_items_journal WHERE playlist=:id");
 
   delete_playlist.bindValue(":id", id);
   delete_items.bindValue(":id", id);
+  delete_journal.bindValue(":id", id);
 
   ScopedTransaction transaction(&db);
 
@@ -346,8 +879,14 @@ void PlaylistBackend::RemovePlaylist(int id) {
   delete_items.exec();
   if (db_->CheckErrors(delete_items)) return;
 
+  delete_journal.exec();
+  if (db_->CheckErrors(delete_journal)) return;
+
   transaction.Commit();
 
+  item_orders_.remove(id);
+  journal_sizes_.remove(id);
+
 }
 
 void PlaylistBackend::RenamePlaylist(int id, const QString &new_name) {
@@ -33,6 +33,7 @@
 #include <QSet>
 #include <QString>
 #include <QVector>
+#include <QSqlDatabase>
 #include <QSqlQuery>
 
 #include "core/song.h"
@@ -41,6 +42,7 @@
 
 class Application;
 class Database;
+class SqlStatement;
 
 class PlaylistBackend : public QObject {
   Q_OBJECT
@@ -61,6 +63,18 @@ class PlaylistBackend : public QObject {
   typedef QList<Playlist> PlaylistList;
 
   static const int kSongTableJoins;
+  static const int kJournalCompactSize;
+  // Playlists with more items than this are restored with LazyPlaylistItems
+  static const int kLazyRestoreSize;
+
+  // Edits recorded in playlist_items_journal, replayed on top of playlists.item_order when a playlist is loaded.
+  // Inserts and removals store the ROWIDs of the items, moves store playlist rows like Playlist::MoveItemsWithoutUndo.
+  enum JournalOperation {
+    JournalOperation_Insert = 1,
+    JournalOperation_Remove = 2,
+    JournalOperation_Move = 3,
+    JournalOperation_MoveBack = 4
+  };
 
   PlaylistList GetAllPlaylists();
   PlaylistList GetAllOpenPlaylists();
@@ -68,6 +82,8 @@ class PlaylistBackend : public QObject {
   PlaylistBackend::Playlist GetPlaylist(int id);
 
   QList<PlaylistItemPtr> GetPlaylistItems(int playlist);
+  // The full items for the given playlist_items ROWIDs, used by PlaylistItemPager.
+  QHash<int, PlaylistItemPtr> GetPlaylistItemsById(const QList<int> &ids);
   QList<Song> GetPlaylistSongs(int playlist);
 
   void SetPlaylistOrder(const QList<int> &ids);
@@ -75,6 +91,13 @@ class PlaylistBackend : public QObject {
 
   int CreatePlaylist(const QString &name, const QString &special_type);
   void SavePlaylistAsync(int playlist, const PlaylistItemList &items, int last_played);
+  void InsertPlaylistItemsAsync(int playlist, int pos, const PlaylistItemList &items, int last_played);
+  void RemovePlaylistItemsAsync(int playlist, int pos, int count, int last_played);
+  void MovePlaylistItemsAsync(int playlist, const QList<int> &source_rows, int pos, int last_played);
+  void MovePlaylistItemsBackAsync(int playlist, int start, const QList<int> &dest_rows, int last_played);
+  void ReorderPlaylistItemsAsync(int playlist, const QList<int> &old_rows, int last_played);
+  void UpdatePlaylistItemsAsync(int playlist, const QList<int> &rows, const PlaylistItemList &items);
+  void SetLastPlayedAsync(int playlist, int last_played);
   void RenamePlaylist(int id, const QString &new_name);
   void FavoritePlaylist(int id, bool is_favorite);
   void RemovePlaylist(int id);
@@ -83,6 +106,14 @@ class PlaylistBackend : public QObject {
 
  public slots:
   void SavePlaylist(int playlist, const PlaylistItemList &items, int last_played);
+  void InsertPlaylistItems(int playlist, int pos, const PlaylistItemList &items, int last_played);
+  void RemovePlaylistItems(int playlist, int pos, int count, int last_played);
+  void MovePlaylistItems(int playlist, const QList<int> &source_rows, int pos, int last_played);
+  void MovePlaylistItemsBack(int playlist, int start, const QList<int> &dest_rows, int last_played);
+  void ReorderPlaylistItems(int playlist, const QList<int> &old_rows, int last_played);
+  void UpdatePlaylistItems(int playlist, const QList<int> &rows, const PlaylistItemList &items);
+  void SetLastPlayed(int playlist, int last_played);
+  void CompactPlaylist(int playlist);
 
  private:
   struct NewSongFromQueryState {
@@ -90,9 +121,20 @@ class PlaylistBackend : public QObject {
     QMutex mutex_;
   };
 
-  QSqlQuery GetPlaylistRows(int playlist);
+  // The items matching condition joined with their collection songs, see NewPlaylistItemFromQuery for the columns.
+  static QString PlaylistRowsQuery(const QString &condition);
+  QHash<int, PlaylistItemPtr> NewPlaylistItemsFromQuery(SqlStatement &q);
+  QList<PlaylistItemPtr> GetLazyPlaylistItems(QSqlDatabase &db, int playlist, const QList<int> &order);
+
+  // The ROWIDs of a playlist's items in playlist order, from the compacted order and the journal.
+  QList<int> LoadItemOrder(QSqlDatabase &db, int playlist, int *journal_size = nullptr);
+  QList<int> *ItemOrder(QSqlDatabase &db, int playlist);
+  static void ApplyJournalOperation(QList<int> *order, JournalOperation operation, int position, const QList<int> &rows);
+  bool AppendJournal(QSqlDatabase &db, int playlist, JournalOperation operation, int position, const QList<int> &rows);
+  void JournalAppended(int playlist);
+  bool WriteItemOrder(QSqlDatabase &db, int playlist, const QList<int> &order);
+  bool UpdateLastPlayed(QSqlDatabase &db, int playlist, int last_played);
 
-  Song NewSongFromQuery(const SqlRow &row, std::shared_ptr<NewSongFromQueryState> state);
   PlaylistItemPtr NewPlaylistItemFromQuery(const SqlRow &row, std::shared_ptr<NewSongFromQueryState> state);
   PlaylistItemPtr RestoreCueData(PlaylistItemPtr item, std::shared_ptr<NewSongFromQueryState> state);
 
@@ -105,6 +147,10 @@ class PlaylistBackend : public QObject {
 
   Application *app_;
   Database *db_;
+
+  // Current item order and journal length of the playlists edited since startup, only used with the database mutex held.
+  QHash<int, QList<int>> item_orders_;
+  QHash<int, int> journal_sizes_;
 };
 
 #endif  // PLAYLISTBACKEND_H
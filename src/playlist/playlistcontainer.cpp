@@ -47,6 +47,7 @@
 
 #include "core/iconloader.h"
 #include "playlist.h"
+#include "playlistfilter.h"
 #include "playlisttabbar.h"
 #include "playlistview.h"
 #include "playlistcontainer.h"
@@ -193,7 +194,7 @@ void PlaylistContainer::SetViewModel(Playlist *playlist) {
   emit ViewSelectionModelChanged();
 
   // Update filter
-  ui_->filter->setText(playlist->proxy()->filterRegExp().pattern());
+  ui_->filter->setText(playlist->filter()->filter_text());
 
   // Update the no matches label
   connect(playlist_->proxy(), SIGNAL(modelReset()), SLOT(UpdateNoMatchesLabel()));
@@ -354,7 +355,7 @@ void PlaylistContainer::MaybeUpdateFilter() {
 
 void PlaylistContainer::UpdateFilter() {
 
-  manager_->current()->proxy()->setFilterFixedString(ui_->filter->text());
+  manager_->current()->filter()->SetFilter(ui_->filter->text());
   ui_->playlist->JumpToCurrentlyPlayingTrack();
 
   UpdateNoMatchesLabel();
@@ -22,24 +22,51 @@
 
 #include <stdbool.h>
 
+#include <memory>
+
 #include <QObject>
+#include <QtConcurrentRun>
+#include <QFutureInterface>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QVector>
 #include <QString>
 #include <QRegExp>
+#include <QTimer>
 #include <QAbstractItemModel>
 #include <QSortFilterProxyModel>
 
 #include "playlist/playlist.h"
 #include "playlistfilter.h"
 #include "playlistfilterparser.h"
+#include "playlistitem.h"
+
+const int PlaylistFilter::kBackgroundFilterSize = 10000;
+const int PlaylistFilter::kBackgroundFilterChunkSize = 2000;
+const int PlaylistFilter::kPublishIntervalMsec = 100;
 
 PlaylistFilter::PlaylistFilter(QObject *parent)
     : QSortFilterProxyModel(parent),
       filter_tree_(new NopFilter),
-    query_hash_(0)
+    query_hash_(0),
+    query_serial_(1),
+    narrowed_serial_(0),
+    background_(false),
+    background_watcher_(new QFutureWatcher<BackgroundChunk>(this)),
+    publish_timer_(new QTimer(this))
 
 {
   setDynamicSortFilter(true);
 
+  publish_timer_->setSingleShot(true);
+  publish_timer_->setInterval(kPublishIntervalMsec);
+  connect(publish_timer_, SIGNAL(timeout()), SLOT(Publish()));
+
+  connect(background_watcher_, SIGNAL(resultsReadyAt(int,int)), SLOT(BackgroundResultsReady(int,int)));
+  connect(background_watcher_, SIGNAL(finished()), SLOT(BackgroundFinished()));
+
   column_names_["title"] = Playlist::Column_Title;
   column_names_["name"] = Playlist::Column_Title;
   column_names_["artist"] = Playlist::Column_Artist;
@@ -71,6 +98,7 @@ PlaylistFilter::PlaylistFilter(QObject *parent)
 }
 
 PlaylistFilter::~PlaylistFilter() {
+  background_watcher_->cancel();
 }
 
 void PlaylistFilter::sort(int column, Qt::SortOrder order) {
@@ -78,20 +106,219 @@ void PlaylistFilter::sort(int column, Qt::SortOrder order) {
   sourceModel()->sort(column, order);
 }
 
-bool PlaylistFilter::filterAcceptsRow(int row, const QModelIndex &parent) const {
+void PlaylistFilter::setSourceModel(QAbstractItemModel *source_model) {
+
+  if (sourceModel()) disconnect(sourceModel(), nullptr, this, nullptr);
+  fields_.clear();
+
+  // Connected before the proxy model connects its own slots, so the cached fields are dropped before the changed rows are filtered again.
+  if (source_model) {
+    connect(source_model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), SLOT(SourceDataChanged(QModelIndex,QModelIndex)));
+    connect(source_model, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)), SLOT(SourceRowsAboutToBeRemoved(QModelIndex,int,int)));
+    connect(source_model, SIGNAL(modelReset()), SLOT(SourceModelReset()));
+  }
+
+  QSortFilterProxyModel::setSourceModel(source_model);
+
+}
+
+void PlaylistFilter::SetFilter(const QString &filter) {
+
+  CancelBackgroundFilter();
+
+  Playlist *playlist = static_cast<Playlist*>(sourceModel());
+  if (!playlist || playlist->rowCount() < kBackgroundFilterSize) {
+    setFilterFixedString(filter);
+    return;
+  }
+
+  SetQuery(filter);
+
+  // The items can change on this thread while the worker runs, so it only gets copies of their fields.
+  QVector<BackgroundItem> items;
+  items.reserve(playlist->rowCount());
+  background_items_.reserve(playlist->rowCount());
+  for (int row = 0; row < playlist->rowCount(); ++row) {
+    BackgroundItem background_item;
+    background_item.item = playlist->item_at(row);
+    const CachedFields *fields = Fields(background_item.item);
+    background_item.fields = fields->fields;
+    background_item.skip = narrowed_serial_ != 0 && fields->tested_query == narrowed_serial_ && !fields->matched;
+    items << background_item;
+    background_items_.insert(background_item.item.get());
+  }
+
+  background_ = true;
+
+  QFutureInterface<BackgroundChunk> future_interface;
+  future_interface.reportStarted();
+  background_watcher_->setFuture(future_interface.future());
+  QtConcurrent::run(&PlaylistFilter::FilterItems, future_interface, filter_tree_, items, query_serial_);
+
+}
+
+QString PlaylistFilter::filter_text() const {
+  return background_ ? query_ : filterRegExp().pattern();
+}
 
-  QString filter = filterRegExp().pattern();
+void PlaylistFilter::CancelBackgroundFilter() {
 
-  uint hash = qHash(filter);
-  if (hash != query_hash_) {
-    // Parse the query
-    FilterParser p(filter, column_names_, numerical_columns_);
-    filter_tree_.reset(p.parse());
+  if (!background_) return;
+
+  background_ = false;
+  background_items_.clear();
+  background_watcher_->cancel();
+  publish_timer_->stop();
+
+}
 
-    query_hash_ = hash;
+void PlaylistFilter::FilterItems(QFutureInterface<BackgroundChunk> future_interface, std::shared_ptr<FilterTree> filter_tree, QVector<BackgroundItem> items, int query) {
+
+  for (int begin = 0; begin < items.count() && !future_interface.isCanceled(); begin += kBackgroundFilterChunkSize) {
+    BackgroundChunk chunk;
+    chunk.query = query;
+    chunk.items = items.mid(begin, kBackgroundFilterChunkSize);
+    for (const BackgroundItem &background_item : chunk.items) {
+      chunk.matched << (!background_item.skip && filter_tree->accept(*background_item.fields));
+    }
+    future_interface.reportResult(chunk);
+  }
+
+  future_interface.reportFinished();
+
+}
+
+void PlaylistFilter::BackgroundResultsReady(int begin, int end) {
+
+  for (int i = begin; i < end; ++i) {
+    const BackgroundChunk chunk = background_watcher_->resultAt(i);
+    if (!background_ || chunk.query != query_serial_) continue;
+
+    for (int j = 0; j < chunk.items.count(); ++j) {
+      const BackgroundItem &background_item = chunk.items[j];
+      CachedFields &fields = fields_[background_item.item.get()];
+      fields.item = background_item.item;
+      fields.fields = background_item.fields;
+      fields.tested_query = query_serial_;
+      fields.matched = chunk.matched[j];
+      background_items_.remove(background_item.item.get());
+    }
+  }
+
+  if (!publish_timer_->isActive()) publish_timer_->start();
+
+}
+
+void PlaylistFilter::BackgroundFinished() {
+
+  if (!background_) return;
+
+  background_ = false;
+  background_items_.clear();
+  publish_timer_->stop();
+
+  // Every item is tested now, so this only looks the results up.
+  setFilterFixedString(query_);
+
+}
+
+void PlaylistFilter::Publish() {
+  if (background_) invalidateFilter();
+}
+
+void PlaylistFilter::SetQuery(const QString &filter) const {
+
+  // Parse the query
+  FilterParser p(filter, column_names_, numerical_columns_);
+  filter_tree_.reset(p.parse());
+
+  narrowed_serial_ = FilterParser::IsNarrowing(query_, filter) ? query_serial_ : 0;
+  ++query_serial_;
+  query_hash_ = qHash(filter);
+  query_ = filter;
+
+}
+
+bool PlaylistFilter::filterAcceptsRow(int row, const QModelIndex &parent) const {
+
+  Q_UNUSED(parent);
+
+  // While filtering in the background the filter text is only set when the worker is done
+  if (!background_) {
+    QString filter = filterRegExp().pattern();
+    if (qHash(filter) != query_hash_) SetQuery(filter);
   }
 
   // Test the row
-  return filter_tree_->accept(row, parent, sourceModel());
+  Playlist *playlist = static_cast<Playlist*>(sourceModel());
+  if (!playlist || !playlist->has_item_at(row)) return false;
+
+  const PlaylistItemPtr &item = playlist->item_at(row);
+  if (background_ && background_items_.contains(item.get())) {
+    // The worker hasn't got to this one yet, keep showing the result of the previous filter
+    QHash<const PlaylistItem*, CachedFields>::const_iterator it = fields_.constFind(item.get());
+    return it != fields_.constEnd() && it->item.lock() == item && it->matched;
+  }
+
+  CachedFields *fields = Fields(item);
+  if (fields->tested_query != query_serial_) {
+    // If the filter got narrower, items that didn't match before won't match now either.
+    if (narrowed_serial_ == 0 || fields->tested_query != narrowed_serial_ || fields->matched) {
+      fields->matched = filter_tree_->accept(*fields->fields);
+    }
+    fields->tested_query = query_serial_;
+  }
+  return fields->matched;
+
+}
+
+PlaylistFilter::CachedFields *PlaylistFilter::Fields(const PlaylistItemPtr &item) const {
+
+  QHash<const PlaylistItem*, CachedFields>::iterator it = fields_.find(item.get());
+  // An item that was deleted without us noticing could have left its fields behind for a new item at the same address.
+  if (it != fields_.end() && it->item.lock() == item) return &it.value();
+
+  if (fields_.count() >= 1024 && fields_.count() >= sourceModel()->rowCount() * 2) PurgeFields();
+
+  CachedFields fields;
+  fields.item = item;
+  fields.fields = std::make_shared<const FilterFields>(item->Metadata());
+  return &fields_.insert(item.get(), fields).value();
+
+}
+
+void PlaylistFilter::PurgeFields() const {
+
+  QHash<const PlaylistItem*, CachedFields>::iterator it = fields_.begin();
+  while (it != fields_.end()) {
+    if (it->item.expired()) {
+      it = fields_.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+
+}
+
+void PlaylistFilter::SourceDataChanged(const QModelIndex &top_left, const QModelIndex &bottom_right) {
+
+  Playlist *playlist = static_cast<Playlist*>(sourceModel());
+  for (int row = top_left.row(); row <= bottom_right.row(); ++row) {
+    if (playlist->has_item_at(row)) fields_.remove(playlist->item_at(row).get());
+  }
+
+}
+
+void PlaylistFilter::SourceRowsAboutToBeRemoved(const QModelIndex&, int start, int end) {
+
+  Playlist *playlist = static_cast<Playlist*>(sourceModel());
+  for (int row = start; row <= end; ++row) {
+    if (playlist->has_item_at(row)) fields_.remove(playlist->item_at(row).get());
+  }
+
+}
 
+void PlaylistFilter::SourceModelReset() {
+  fields_.clear();
 }
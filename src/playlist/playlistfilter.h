@@ -25,17 +25,25 @@
 
 #include <stdbool.h>
 
+#include <memory>
+
 #include <QtGlobal>
 #include <QObject>
+#include <QHash>
 #include <QMap>
 #include <QSet>
-#include <QScopedPointer>
+#include <QList>
+#include <QVector>
 #include <QString>
+#include <QFutureInterface>
+#include <QFutureWatcher>
 #include <QSortFilterProxyModel>
 
 #include "playlist.h"
+#include "playlistfilterparser.h"
+#include "playlistitem.h"
 
-class FilterTree;
+class QTimer;
 
 class PlaylistFilter : public QSortFilterProxyModel {
   Q_OBJECT
@@ -44,17 +52,87 @@ class PlaylistFilter : public QSortFilterProxyModel {
   PlaylistFilter(QObject *parent = nullptr);
   ~PlaylistFilter();
 
+  // Playlists this big are filtered on a worker thread
+  static const int kBackgroundFilterSize;
+  // Number of items the worker tests before publishing the results
+  static const int kBackgroundFilterChunkSize;
+  // Minimum time between updating the view with results from the worker
+  static const int kPublishIntervalMsec;
+
+  // Sets the filter text, filtering a big playlist in the background.
+  // Items keep the result of the previous filter until the worker gets to them.
+  void SetFilter(const QString &filter);
+  QString filter_text() const;
+
   // QAbstractItemModel
   void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
 
+  // QAbstractProxyModel
+  void setSourceModel(QAbstractItemModel *source_model);
+
   // QSortFilterProxyModel
   // public so Playlist::NextVirtualIndex and friends can get at it
   bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const;
 
-private:
+ private slots:
+  void SourceDataChanged(const QModelIndex &top_left, const QModelIndex &bottom_right);
+  void SourceRowsAboutToBeRemoved(const QModelIndex &parent, int start, int end);
+  void SourceModelReset();
+
+  void BackgroundResultsReady(int begin, int end);
+  void BackgroundFinished();
+  void Publish();
+
+ private:
+  // The fields of a playlist item the filter is tested on, and whether it matched the last filter it was tested with.
+  struct CachedFields {
+    CachedFields() : tested_query(0), matched(false) {}
+    std::weak_ptr<PlaylistItem> item;
+    std::shared_ptr<const FilterFields> fields;
+    int tested_query;
+    bool matched;
+  };
+
+  // An item for the worker to test and a copy of its fields, the worker never reads the item itself.
+  struct BackgroundItem {
+    BackgroundItem() : skip(false) {}
+    PlaylistItemPtr item;
+    std::shared_ptr<const FilterFields> fields;
+    // Set when the filter got narrower and the item didn't match before
+    bool skip;
+  };
+
+  // The results of testing one chunk of items on the worker.
+  struct BackgroundChunk {
+    BackgroundChunk() : query(0) {}
+    int query;
+    QVector<BackgroundItem> items;
+    QList<bool> matched;
+  };
+
+  static void FilterItems(QFutureInterface<BackgroundChunk> future_interface, std::shared_ptr<FilterTree> filter_tree, QVector<BackgroundItem> items, int query);
+
+  void SetQuery(const QString &filter) const;
+  void CancelBackgroundFilter();
+  CachedFields *Fields(const PlaylistItemPtr &item) const;
+  void PurgeFields() const;
+
+ private:
   // Mutable because they're modified from filterAcceptsRow() const
-  mutable QScopedPointer<FilterTree> filter_tree_;
+  mutable std::shared_ptr<FilterTree> filter_tree_;
   mutable uint query_hash_;
+  mutable QString query_;
+  // Counts the filters, so the cached fields can tell which one they were tested with
+  mutable int query_serial_;
+  // The filter before this one if this one can only match items that one matched, otherwise 0
+  mutable int narrowed_serial_;
+  mutable QHash<const PlaylistItem*, CachedFields> fields_;
+
+  // Set while the worker is testing the items in background_items_ against query_
+  bool background_;
+  QSet<const PlaylistItem*> background_items_;
+  QFutureWatcher<BackgroundChunk> *background_watcher_;
+  QTimer *publish_timer_;
 
   QMap<QString, int> column_names_;
   QSet<int> numerical_columns_;
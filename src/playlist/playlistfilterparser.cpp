@@ -29,9 +29,13 @@
 #include <QScopedPointer>
 #include <QVariant>
 #include <QString>
+#include <QStringList>
+#include <QRegExp>
+#include <QUrl>
 #include <QtAlgorithms>
-#include <QAbstractItemModel>
 
+#include "core/song.h"
+#include "core/timeconstants.h"
 #include "playlist.h"
 #include "playlistfilterparser.h"
 
@@ -112,41 +116,57 @@ class LexicalLeComparator : public SearchTermComparator {
   QString search_term_;
 };
 
-class GtComparator : public SearchTermComparator {
+class NumericalComparator {
+ public:
+  virtual ~NumericalComparator() {}
+  virtual bool Matches(int element) const = 0;
+};
+
+class NumericalEqComparator : public NumericalComparator {
+ public:
+  explicit NumericalEqComparator(int value) : search_term_(value) {}
+  virtual bool Matches(int element) const {
+    return element == search_term_;
+  }
+ private:
+  int search_term_;
+};
+
+class GtComparator : public NumericalComparator {
  public:
   explicit GtComparator(int value) : search_term_(value) {}
-  virtual bool Matches(const QString &element) const {
-    return element.toInt() > search_term_;
+  virtual bool Matches(int element) const {
+    return element > search_term_;
   }
  private:
   int search_term_;
 };
 
-class GeComparator : public SearchTermComparator {
+class GeComparator : public NumericalComparator {
  public:
   explicit GeComparator(int value) : search_term_(value) {}
-  virtual bool Matches(const QString &element) const {
-    return element.toInt() >= search_term_;
+  virtual bool Matches(int element) const {
+    return element >= search_term_;
   }
  private:
   int search_term_;
 };
 
-class LtComparator : public SearchTermComparator {
+class LtComparator : public NumericalComparator {
  public:
   explicit LtComparator(int value) : search_term_(value) {}
-  virtual bool Matches(const QString &element) const {
-    return element.toInt() < search_term_;
+  virtual bool Matches(int element) const {
+    return element < search_term_;
   }
  private:
   int search_term_;
 };
 
-class LeComparator : public SearchTermComparator {
+class LeComparator : public NumericalComparator {
  public:
   explicit LeComparator(int value) : search_term_(value) {}
-  virtual bool Matches(const QString &element) const {
-    return element.toInt() <= search_term_;
+  virtual bool Matches(int element) const {
+    return element <= search_term_;
   }
  private:
   int search_term_;
@@ -169,26 +189,14 @@ class DropTailComparatorDecorator : public SearchTermComparator {
   QScopedPointer<SearchTermComparator> cmp_;
 };
 
-class RatingComparatorDecorator : public SearchTermComparator {
- public:
-  explicit RatingComparatorDecorator(SearchTermComparator *cmp) : cmp_(cmp) {}
-  virtual bool Matches(const QString &element) const {
-    return cmp_->Matches(
-        QString::number(static_cast<int>(element.toDouble() * 10.0 + 0.5)));
-  }
- private:
-  QScopedPointer<SearchTermComparator> cmp_;
-};
-
 // filter that applies a SearchTermComparator to all fields of a playlist entry
 class FilterTerm : public FilterTree {
  public:
   explicit FilterTerm(SearchTermComparator *comparator, const QList<int> &columns) : cmp_(comparator), columns_(columns) {}
 
-  virtual bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const {
+  virtual bool accept(const FilterFields &fields) const {
     for (int i : columns_) {
-      QModelIndex idx(model->index(row, i, parent));
-      if (cmp_->Matches(idx.data().toString().toLower())) return true;
+      if (cmp_->Matches(fields.text(i))) return true;
     }
     return false;
   }
@@ -203,9 +211,8 @@ class FilterColumnTerm : public FilterTree {
  public:
   FilterColumnTerm(int column, SearchTermComparator *comparator) : col(column), cmp_(comparator) {}
 
-  virtual bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const {
-    QModelIndex idx(model->index(row, col, parent));
-    return cmp_->Matches(idx.data().toString().toLower());
+  virtual bool accept(const FilterFields &fields) const {
+    return cmp_->Matches(fields.text(col));
   }
   virtual FilterType type() { return Column; }
  private:
@@ -213,12 +220,26 @@ class FilterColumnTerm : public FilterTree {
   QScopedPointer<SearchTermComparator> cmp_;
 };
 
+// filter that applies a NumericalComparator to the number in one specific field of a playlist entry
+class FilterNumericalColumnTerm : public FilterTree {
+ public:
+  FilterNumericalColumnTerm(int column, NumericalComparator *comparator) : col(column), cmp_(comparator) {}
+
+  virtual bool accept(const FilterFields &fields) const {
+    return cmp_->Matches(fields.number(col));
+  }
+  virtual FilterType type() { return Column; }
+ private:
+  int col;
+  QScopedPointer<NumericalComparator> cmp_;
+};
+
 class NotFilter : public FilterTree {
  public:
   explicit NotFilter(const FilterTree *inv) : child_(inv) {}
 
-  virtual bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const {
-    return !child_->accept(row, parent, model);
+  virtual bool accept(const FilterFields &fields) const {
+    return !child_->accept(fields);
   }
   virtual FilterType type() { return Not; }
  private:
@@ -229,9 +250,9 @@ class OrFilter : public FilterTree {
  public:
   ~OrFilter() { qDeleteAll(children_); }
   virtual void add(FilterTree *child) { children_.append(child); }
-  virtual bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const {
+  virtual bool accept(const FilterFields &fields) const {
     for (FilterTree *child : children_) {
-      if (child->accept(row, parent, model)) return true;
+      if (child->accept(fields)) return true;
     }
     return false;
   }
@@ -244,9 +265,9 @@ class AndFilter : public FilterTree {
  public:
   virtual ~AndFilter() { qDeleteAll(children_); }
   virtual void add(FilterTree *child) { children_.append(child); }
-  virtual bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const {
+  virtual bool accept(const FilterFields &fields) const {
     for (FilterTree *child : children_) {
-      if (!child->accept(row, parent, model)) return false;
+      if (!child->accept(fields)) return false;
     }
     return true;
   }
@@ -255,6 +276,101 @@ class AndFilter : public FilterTree {
   QList<FilterTree*> children_;
 };
 
+FilterFields::FilterFields() {
+
+  for (int i = 0; i < kNumberCount; ++i) numbers_[i] = 0;
+
+}
+
+FilterFields::FilterFields(const Song &song) {
+
+  texts_[TextSlot(Playlist::Column_Title)] = song.PrettyTitle().toLower();
+  texts_[TextSlot(Playlist::Column_Artist)] = song.artist().toLower();
+  texts_[TextSlot(Playlist::Column_Album)] = song.album().toLower();
+  texts_[TextSlot(Playlist::Column_AlbumArtist)] = song.playlist_albumartist().toLower();
+  texts_[TextSlot(Playlist::Column_Performer)] = song.performer().toLower();
+  texts_[TextSlot(Playlist::Column_Composer)] = song.composer().toLower();
+  texts_[TextSlot(Playlist::Column_Year)] = QString::number(song.year());
+  texts_[TextSlot(Playlist::Column_OriginalYear)] = QString::number(song.effective_originalyear());
+  texts_[TextSlot(Playlist::Column_Track)] = QString::number(song.track());
+  texts_[TextSlot(Playlist::Column_Disc)] = QString::number(song.disc());
+  texts_[TextSlot(Playlist::Column_Length)] = QString::number(song.length_nanosec());
+  texts_[TextSlot(Playlist::Column_Genre)] = song.genre().toLower();
+  texts_[TextSlot(Playlist::Column_Samplerate)] = QString::number(song.samplerate());
+  texts_[TextSlot(Playlist::Column_Bitdepth)] = QString::number(song.bitdepth());
+  texts_[TextSlot(Playlist::Column_Bitrate)] = QString::number(song.bitrate());
+  texts_[TextSlot(Playlist::Column_Filename)] = song.url().toString().toLower();
+  texts_[TextSlot(Playlist::Column_Grouping)] = song.grouping().toLower();
+  texts_[TextSlot(Playlist::Column_Comment)] = song.comment().simplified().toLower();
+
+  numbers_[NumberSlot(Playlist::Column_Year)] = song.year();
+  numbers_[NumberSlot(Playlist::Column_OriginalYear)] = song.effective_originalyear();
+  numbers_[NumberSlot(Playlist::Column_Track)] = song.track();
+  numbers_[NumberSlot(Playlist::Column_Disc)] = song.disc();
+  numbers_[NumberSlot(Playlist::Column_Length)] = song.length_nanosec() / kNsecPerSec;
+  numbers_[NumberSlot(Playlist::Column_Samplerate)] = song.samplerate();
+  numbers_[NumberSlot(Playlist::Column_Bitdepth)] = song.bitdepth();
+  numbers_[NumberSlot(Playlist::Column_Bitrate)] = song.bitrate();
+
+}
+
+const QString &FilterFields::text(int column) const {
+
+  static const QString kEmpty;
+  const int slot = TextSlot(column);
+  return slot == -1 ? kEmpty : texts_[slot];
+
+}
+
+int FilterFields::number(int column) const {
+
+  const int slot = NumberSlot(column);
+  return slot == -1 ? 0 : numbers_[slot];
+
+}
+
+int FilterFields::TextSlot(int column) {
+
+  switch (column) {
+    case Playlist::Column_Title:        return 0;
+    case Playlist::Column_Artist:       return 1;
+    case Playlist::Column_Album:        return 2;
+    case Playlist::Column_AlbumArtist:  return 3;
+    case Playlist::Column_Performer:    return 4;
+    case Playlist::Column_Composer:     return 5;
+    case Playlist::Column_Year:         return 6;
+    case Playlist::Column_OriginalYear: return 7;
+    case Playlist::Column_Track:        return 8;
+    case Playlist::Column_Disc:         return 9;
+    case Playlist::Column_Length:       return 10;
+    case Playlist::Column_Genre:        return 11;
+    case Playlist::Column_Samplerate:   return 12;
+    case Playlist::Column_Bitdepth:     return 13;
+    case Playlist::Column_Bitrate:      return 14;
+    case Playlist::Column_Filename:     return 15;
+    case Playlist::Column_Grouping:     return 16;
+    case Playlist::Column_Comment:      return 17;
+    default:                            return -1;
+  }
+
+}
+
+int FilterFields::NumberSlot(int column) {
+
+  switch (column) {
+    case Playlist::Column_Year:         return 0;
+    case Playlist::Column_OriginalYear: return 1;
+    case Playlist::Column_Track:        return 2;
+    case Playlist::Column_Disc:         return 3;
+    case Playlist::Column_Length:       return 4;
+    case Playlist::Column_Samplerate:   return 5;
+    case Playlist::Column_Bitdepth:     return 6;
+    case Playlist::Column_Bitrate:      return 7;
+    default:                            return -1;
+  }
+
+}
+
 FilterParser::FilterParser(const QString &filter, const QMap<QString, int> &columns, const QSet<int> &numerical_cols) : filterstring_(filter), columns_(columns), numerical_columns_(numerical_cols) {}
 
 FilterTree *FilterParser::parse() {
@@ -263,6 +379,23 @@ FilterTree *FilterParser::parse() {
   return parseOrGroup();
 }
 
+bool FilterParser::IsNarrowing(const QString &previous_filter, const QString &filter) {
+
+  if (!filter.startsWith(previous_filter)) return false;
+
+  // Only plain words are safe, typing on the last word or adding another word can then only make the filter match less.
+  // Anything else, like a word turning into 'OR' or a prefix into a column, can make it match more.
+  for (const QChar &c : filter) {
+    if (c == '"' || c == ':' || c == '-' || c == '(' || c == ')' || c == '<' || c == '>' || c == '=' || c == '!') return false;
+  }
+  for (const QString &word : filter.split(QRegExp("\\s+"), QString::SkipEmptyParts)) {
+    if (word == "AND" || word == "OR") return false;
+  }
+
+  return true;
+
+}
+
 void FilterParser::advance() {
   while (iter_ != end_ && iter_->isSpace()) {
     ++iter_;
@@ -442,7 +575,7 @@ FilterTree *FilterParser::createSearchTermTreeNode(const QString &col, const QSt
     cmp = new NeComparator(search);
   }
   else if (!col.isEmpty() && columns_.contains(col) && numerical_columns_.contains(columns_[col])) {
-    // the length column contains the time in seconds (nano seconds, actually - the "nano" part is handled by the DropTailComparatorDecorator,  though).
+    // the length column contains the time in seconds (nano seconds, actually - FilterFields::number() gives seconds, though).
     int search_value;
     if (columns_[col] == Playlist::Column_Length) {
       search_value = parseTime(search);
@@ -451,22 +584,23 @@ FilterTree *FilterParser::createSearchTermTreeNode(const QString &col, const QSt
       search_value = search.toInt();
     }
     // alright, back to deciding which comparator we'll use
+    NumericalComparator *numerical_cmp = nullptr;
     if (prefix == ">") {
-      cmp = new GtComparator(search_value);
+      numerical_cmp = new GtComparator(search_value);
     }
     else if (prefix == ">=") {
-      cmp = new GeComparator(search_value);
+      numerical_cmp = new GeComparator(search_value);
     }
     else if (prefix == "<") {
-      cmp = new LtComparator(search_value);
+      numerical_cmp = new LtComparator(search_value);
     }
     else if (prefix == "<=") {
-      cmp = new LeComparator(search_value);
+      numerical_cmp = new LeComparator(search_value);
     }
     else {
-      // convert back because for time/rating
-      cmp = new EqComparator(QString::number(search_value));
+      numerical_cmp = new NumericalEqComparator(search_value);
     }
+    return new FilterNumericalColumnTerm(columns_[col], numerical_cmp);
   }
   else {
     if (prefix == "=") {
@@ -495,7 +629,9 @@ FilterTree *FilterParser::createSearchTermTreeNode(const QString &col, const QSt
     return new FilterColumnTerm(columns_[col], cmp);
   }
   else {
-    return new FilterTerm(cmp, columns_.values());
+    // Some columns have more than one name, test them once
+    QList<int> columns = columns_.values().toSet().toList();
+    return new FilterTerm(cmp, columns);
   }
 }
 
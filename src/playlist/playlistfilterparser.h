@@ -28,15 +28,35 @@
 #include <QMap>
 #include <QSet>
 #include <QString>
-#include <QAbstractItemModel>
 
-class QModelIndex;
+class Song;
+
+// The lowercased text and the numbers of the filterable columns of a playlist entry, taken from its metadata once so it can be tested against any number of filters.
+class FilterFields {
+ public:
+  FilterFields();
+  explicit FilterFields(const Song &song);
+
+  // The text of the column as shown in the playlist
+  const QString &text(int column) const;
+  int number(int column) const;
+
+ private:
+  static const int kTextCount = 18;
+  static const int kNumberCount = 8;
+
+  static int TextSlot(int column);
+  static int NumberSlot(int column);
+
+  QString texts_[kTextCount];
+  int numbers_[kNumberCount];
+};
 
 // structure for filter parse tree
 class FilterTree {
  public:
   virtual ~FilterTree() {}
-  virtual bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const = 0;
+  virtual bool accept(const FilterFields &fields) const = 0;
   enum FilterType {
     Nop = 0,
     Or,
@@ -51,7 +71,7 @@ class FilterTree {
 // trivial filter that accepts *anything*
 class NopFilter : public FilterTree {
  public:
-  virtual bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const { return true; }
+  virtual bool accept(const FilterFields&) const { return true; }
   virtual FilterType type() { return Nop; }
 };
 
@@ -78,6 +98,9 @@ class FilterParser {
 
   FilterTree *parse();
 
+  // Returns true if filter can only match entries that previous_filter matches too.
+  static bool IsNarrowing(const QString &previous_filter, const QString &filter);
+
  private:
   void advance();
   FilterTree *parseOrGroup();
@@ -33,8 +33,11 @@
 #include <QAction>
 #include <QActionGroup>
 #include <QContextMenuEvent>
+#include <QMouseEvent>
+#include <QStyle>
 #include <QtEvents>
 
+#include "playlist.h"
 #include "playlistheader.h"
 #include "playlistview.h"
 
@@ -148,6 +151,24 @@ void PlaylistHeader::enterEvent(QEvent*) {
   emit MouseEntered();
 }
 
+void PlaylistHeader::mousePressEvent(QMouseEvent *e) {
+
+  // Shift clicking a column sorts on it after the columns that are already sorted on.
+  const int section = logicalIndexAt(e->pos());
+  if (section != -1 && e->button() == Qt::LeftButton && (e->modifiers() & Qt::ShiftModifier) && isSortIndicatorShown() && view_->playlist()) {
+    // Leave clicks on the edges of the section for resizing
+    const int margin = style()->pixelMetric(QStyle::PM_HeaderGripMargin, nullptr, this);
+    const int x = e->pos().x() - sectionViewportPosition(section);
+    if (x > margin && x < sectionSize(section) - margin) {
+      view_->playlist()->AddSortColumn(section);
+      return;
+    }
+  }
+
+  StretchHeaderView::mousePressEvent(e);
+
+}
+
 void PlaylistHeader::ResetColumns() {
   view_->ResetColumns();
 }
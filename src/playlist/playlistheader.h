@@ -47,6 +47,7 @@ class PlaylistHeader : public StretchHeaderView {
   // QWidget
   void contextMenuEvent(QContextMenuEvent *e);
   void enterEvent(QEvent *);
+  void mousePressEvent(QMouseEvent *e);
 
  signals:
   void SectionVisibilityChanged(int logical, bool visible);
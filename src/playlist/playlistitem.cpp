@@ -25,6 +25,7 @@
 
 #include <QtConcurrentRun>
 #include <QFuture>
+#include <QVariant>
 #include <QString>
 #include <QColor>
 #include <QSqlQuery>
@@ -40,6 +41,8 @@
 
 #include "internet/internetplaylistitem.h"
 
+const Song PlaylistItem::kNoMetadata;
+
 PlaylistItem::~PlaylistItem() {}
 
 PlaylistItem *PlaylistItem::NewFromSource(const Song::Source &source) {
@@ -72,12 +75,19 @@ void PlaylistItem::BindToQuery(QSqlQuery *query) const {
 
 }
 
+int PlaylistItem::collection_id() const {
+
+  const QVariant id = DatabaseValue(Column_CollectionId);
+  return id.isNull() ? -1 : id.toInt();
+
+}
+
 void PlaylistItem::SetTemporaryMetadata(const Song &metadata) {
   temp_metadata_ = metadata;
 }
 
 void PlaylistItem::ClearTemporaryMetadata() {
-  temp_metadata_ = Song();
+  temp_metadata_ = kNoMetadata;
 }
 
 static void ReloadPlaylistItem(PlaylistItemPtr item) {
@@ -46,8 +46,10 @@
 class SqlRow;
 
 class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
+  friend class LazyPlaylistItem;
+
  public:
-  PlaylistItem(const Song::Source &source) : should_skip_(false), source_(source) {}
+  PlaylistItem(const Song::Source &source) : should_skip_(false), source_(source), temp_metadata_(kNoMetadata) {}
   virtual ~PlaylistItem();
 
   static PlaylistItem *NewFromSource(const Song::Source &source);
@@ -78,6 +80,9 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
   virtual Song Metadata() const = 0;
   virtual QUrl Url() const = 0;
 
+  // The id of the song in the collection, or -1. Unlike Metadata().id() this doesn't need the item's metadata to be loaded.
+  int collection_id() const;
+
   void SetTemporaryMetadata(const Song &metadata);
   void ClearTemporaryMetadata();
   bool HasTemporaryMetadata() const { return temp_metadata_.is_valid(); }
@@ -114,6 +119,8 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
 
   Song::Source source_;
 
+  // Items without temporary metadata all share this one, so they don't allocate a song each
+  static const Song kNoMetadata;
   Song temp_metadata_;
 
   QMap<short, QColor> background_colors_;
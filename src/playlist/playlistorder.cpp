@@ -0,0 +1,337 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QList>
+#include <QVector>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+#  include <QRandomGenerator>
+#endif
+
+#include "playlistorder.h"
+
+namespace {
+
+// Priorities use the full 32 bits, rand() may only give 15 which makes ties and unbalanced trees likely on large playlists.
+quint32 Random() {
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+  return QRandomGenerator::global()->generate();
+#else
+  return (static_cast<quint32>(qrand() & 0xffff) << 16) | static_cast<quint32>(qrand() & 0xffff);
+#endif
+}
+
+quint32 RandomBounded(quint32 bound) {
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+  return QRandomGenerator::global()->bounded(bound);
+#else
+  return Random() % bound;
+#endif
+}
+
+}  // namespace
+
+PlaylistOrder::PlaylistOrder() : root_(-1) {}
+
+void PlaylistOrder::clear() {
+
+  nodes_.clear();
+  root_ = -1;
+
+}
+
+int PlaylistOrder::at(int pos) const {
+
+  Q_ASSERT(pos >= 0 && pos < count());
+
+  int node = root_;
+  while (node != -1) {
+    const int left_size = size(nodes_[node].left);
+    if (pos < left_size) {
+      node = nodes_[node].left;
+    }
+    else if (pos == left_size) {
+      return node;
+    }
+    else {
+      pos -= left_size + 1;
+      node = nodes_[node].right;
+    }
+  }
+  return -1;
+
+}
+
+int PlaylistOrder::indexOf(int row) const {
+
+  if (row < 0 || row >= count()) return -1;
+
+  // Walk up to the root, counting everything that comes before the row on the way.
+  int pos = size(nodes_[row].left);
+  int node = row;
+  while (nodes_[node].parent != -1) {
+    const int parent = nodes_[node].parent;
+    if (nodes_[parent].right == node) {
+      pos += size(nodes_[parent].left) + 1;
+    }
+    node = parent;
+  }
+  return pos;
+
+}
+
+void PlaylistOrder::Insert(int row, int count, int pos) {
+
+  if (count <= 0) return;
+
+  const int old_count = nodes_.count();
+  row = qBound(0, row, old_count);
+
+  // Renumber the rows after the new ones.
+  if (row < old_count) {
+    for (Node &node : nodes_) {
+      if (node.left >= row) node.left += count;
+      if (node.right >= row) node.right += count;
+      if (node.parent >= row) node.parent += count;
+    }
+    if (root_ >= row) root_ += count;
+  }
+
+  Node node;
+  node.left = -1;
+  node.right = -1;
+  node.parent = -1;
+  node.size = 1;
+  nodes_.insert(row, count, node);
+
+  int middle = -1;
+  for (int i = row; i < row + count; ++i) {
+    nodes_[i].priority = Random();
+    middle = Merge(middle, i);
+  }
+
+  int left = -1;
+  int right = -1;
+  Split(root_, qBound(0, pos, old_count), &left, &right);
+  root_ = Merge(Merge(left, middle), right);
+  nodes_[root_].parent = -1;
+
+}
+
+void PlaylistOrder::Move(int row, int pos) {
+
+  if (row < 0 || row >= count()) return;
+
+  Detach(row);
+  Attach(row, qBound(0, pos, count() - 1));
+
+}
+
+void PlaylistOrder::RemoveFrom(int row) {
+
+  if (row < 0) row = 0;
+  if (row >= count()) return;
+
+  for (int i = row; i < count(); ++i) {
+    Detach(i);
+  }
+  nodes_.resize(row);
+
+}
+
+void PlaylistOrder::Reset(int count) {
+
+  QList<int> rows;
+  rows.reserve(count);
+  for (int i = 0; i < count; ++i) rows << i;
+  SetList(rows);
+
+}
+
+QList<int> PlaylistOrder::ToList() const {
+
+  return Rows(root_);
+
+}
+
+void PlaylistOrder::SetList(const QList<int> &rows) {
+
+  nodes_.resize(rows.count());
+  root_ = Build(rows);
+
+}
+
+void PlaylistOrder::Shuffle(int pos) {
+
+  if (pos < 0) pos = 0;
+  if (pos >= count() - 1) return;
+
+  int left = -1;
+  int right = -1;
+  Split(root_, pos, &left, &right);
+
+  // Fisher-Yates over the rows after pos, then the tree for them is built again in one pass.
+  QList<int> rows = Rows(right);
+  for (int i = rows.count() - 1; i > 0; --i) {
+    rows.swap(i, static_cast<int>(RandomBounded(static_cast<quint32>(i) + 1)));
+  }
+
+  root_ = Merge(left, Build(rows));
+  nodes_[root_].parent = -1;
+
+}
+
+QList<int> PlaylistOrder::Rows(int node) const {
+
+  QList<int> rows;
+  rows.reserve(size(node));
+
+  QVector<int> stack;
+  while (node != -1 || !stack.isEmpty()) {
+    while (node != -1) {
+      stack.append(node);
+      node = nodes_[node].left;
+    }
+    node = stack.takeLast();
+    rows << node;
+    node = nodes_[node].right;
+  }
+  return rows;
+
+}
+
+int PlaylistOrder::Build(const QList<int> &rows) {
+
+  for (int row : rows) {
+    Node &node = nodes_[row];
+    node.left = -1;
+    node.right = -1;
+    node.parent = -1;
+    node.priority = Random();
+  }
+
+  // Build the tree in one pass, the right spine of the tree built so far is kept on the stack.
+  QVector<int> stack;
+  for (int row : rows) {
+    int last = -1;
+    while (!stack.isEmpty() && nodes_[stack.last()].priority < nodes_[row].priority) {
+      last = stack.takeLast();
+    }
+    nodes_[row].left = last;
+    if (!stack.isEmpty()) nodes_[stack.last()].right = row;
+    stack.append(row);
+  }
+
+  const int root = UpdateTree(stack.isEmpty() ? -1 : stack.first());
+  if (root != -1) nodes_[root].parent = -1;
+  return root;
+
+}
+
+void PlaylistOrder::Update(int node) {
+
+  Node &n = nodes_[node];
+  n.size = 1 + size(n.left) + size(n.right);
+  if (n.left != -1) nodes_[n.left].parent = node;
+  if (n.right != -1) nodes_[n.right].parent = node;
+
+}
+
+int PlaylistOrder::UpdateTree(int node) {
+
+  if (node == -1) return -1;
+  UpdateTree(nodes_[node].left);
+  UpdateTree(nodes_[node].right);
+  Update(node);
+  return node;
+
+}
+
+void PlaylistOrder::Split(int node, int pos, int *left, int *right) {
+
+  if (node == -1) {
+    *left = -1;
+    *right = -1;
+    return;
+  }
+
+  const int left_size = size(nodes_[node].left);
+  if (pos <= left_size) {
+    Split(nodes_[node].left, pos, left, &nodes_[node].left);
+    *right = node;
+  }
+  else {
+    Split(nodes_[node].right, pos - left_size - 1, &nodes_[node].right, right);
+    *left = node;
+  }
+  Update(node);
+
+}
+
+int PlaylistOrder::Merge(int left, int right) {
+
+  if (left == -1) return right;
+  if (right == -1) return left;
+
+  if (nodes_[left].priority > nodes_[right].priority) {
+    nodes_[left].right = Merge(nodes_[left].right, right);
+    Update(left);
+    return left;
+  }
+  else {
+    nodes_[right].left = Merge(left, nodes_[right].left);
+    Update(right);
+    return right;
+  }
+
+}
+
+void PlaylistOrder::Attach(int row, int pos) {
+
+  int left = -1;
+  int right = -1;
+  Split(root_, pos, &left, &right);
+
+  Node &node = nodes_[row];
+  node.left = -1;
+  node.right = -1;
+  node.size = 1;
+
+  root_ = Merge(Merge(left, row), right);
+  nodes_[root_].parent = -1;
+
+}
+
+void PlaylistOrder::Detach(int row) {
+
+  const int pos = indexOf(row);
+
+  int left = -1;
+  int middle = -1;
+  int right = -1;
+  Split(root_, pos, &left, &middle);
+  Split(middle, 1, &middle, &right);
+
+  root_ = Merge(left, right);
+  if (root_ != -1) nodes_[root_].parent = -1;
+  nodes_[row].parent = -1;
+
+}
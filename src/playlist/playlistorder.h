@@ -0,0 +1,91 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PLAYLISTORDER_H
+#define PLAYLISTORDER_H
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QList>
+#include <QVector>
+
+// The order the rows of a playlist are played in, a permutation of the rows 0 to count() - 1.
+// Kept in a treap keyed on position, so looking up the row at a position, the position of a row,
+// inserting and removing are all O(log n) instead of shifting or searching the whole list.
+class PlaylistOrder {
+ public:
+  PlaylistOrder();
+
+  int count() const { return nodes_.count(); }
+  bool isEmpty() const { return nodes_.isEmpty(); }
+  void clear();
+
+  // Returns the row played at position pos.
+  int at(int pos) const;
+  int operator[](int pos) const { return at(pos); }
+
+  // Returns the position of row, or -1 if it's not there.
+  int indexOf(int row) const;
+
+  // Adds count new rows starting at row, the rows from row on are renumbered to make room.
+  // The new rows are played one after the other starting at position pos.
+  void Insert(int row, int count, int pos);
+
+  // Moves row to position pos.
+  void Move(int row, int pos);
+
+  // Removes the rows from row to count() - 1, wherever they are in the order.
+  void RemoveFrom(int row);
+
+  // Plays the rows in the order they are in the playlist.
+  void Reset(int count);
+
+  QList<int> ToList() const;
+  void SetList(const QList<int> &rows);
+
+  // Plays the rows from position pos on in a random order, the positions before it are left alone.
+  void Shuffle(int pos);
+
+ private:
+  struct Node {
+    int left;
+    int right;
+    int parent;
+    int size;
+    quint32 priority;
+  };
+
+  int size(int node) const { return node == -1 ? 0 : nodes_[node].size; }
+  void Update(int node);
+  void Split(int node, int pos, int *left, int *right);
+  int Merge(int left, int right);
+  int UpdateTree(int node);
+  // Returns the rows of the tree under node, in order.
+  QList<int> Rows(int node) const;
+  // Builds a tree of rows in the given order and returns its root, the nodes of the rows must not be in another tree.
+  int Build(const QList<int> &rows);
+  void Attach(int row, int pos);
+  void Detach(int row);
+
+  QVector<Node> nodes_;
+  int root_;
+};
+
+#endif  // PLAYLISTORDER_H
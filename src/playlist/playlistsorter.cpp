@@ -0,0 +1,266 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <QtGlobal>
+#include <QtConcurrentMap>
+#include <QThread>
+#include <QList>
+#include <QString>
+#include <QUrl>
+#include <QCollator>
+#include <QCollatorSortKey>
+
+#include "core/logging.h"
+#include "core/song.h"
+#include "playlist.h"
+#include "playlistitem.h"
+#include "playlistsorter.h"
+
+const int PlaylistSorter::kColumnPathDepth = -1;
+const int PlaylistSorter::kParallelSortSize = 20000;
+
+namespace {
+
+// The keys of one sort column for every item, indexed like the items.
+struct SortKeys {
+  SortKeys(const PlaylistSorter::SortColumn &_column, bool _text) : column(_column.column), order(_column.order), text(_text) {}
+  int column;
+  Qt::SortOrder order;
+  bool text;
+  std::vector<qint64> numbers;
+  std::vector<QCollatorSortKey> texts;
+};
+
+// A range of items that is handled on one thread.
+struct Chunk {
+  Chunk(int _begin = 0, int _end = 0) : begin(_begin), end(_end) {}
+  int begin;
+  int end;
+};
+
+bool IsTextColumn(int column) {
+
+  switch (column) {
+    case Playlist::Column_Title:
+    case Playlist::Column_Artist:
+    case Playlist::Column_Album:
+    case Playlist::Column_Genre:
+    case Playlist::Column_AlbumArtist:
+    case Playlist::Column_Composer:
+    case Playlist::Column_Performer:
+    case Playlist::Column_Grouping:
+    case Playlist::Column_Filename:
+    case Playlist::Column_BaseFilename:
+    case Playlist::Column_Comment:
+      return true;
+    default:
+      return false;
+  }
+
+}
+
+bool IsNumberColumn(int column) {
+
+  switch (column) {
+    case PlaylistSorter::kColumnPathDepth:
+    case Playlist::Column_Length:
+    case Playlist::Column_Track:
+    case Playlist::Column_Disc:
+    case Playlist::Column_Year:
+    case Playlist::Column_OriginalYear:
+    case Playlist::Column_PlayCount:
+    case Playlist::Column_SkipCount:
+    case Playlist::Column_LastPlayed:
+    case Playlist::Column_Bitrate:
+    case Playlist::Column_Samplerate:
+    case Playlist::Column_Bitdepth:
+    case Playlist::Column_Filesize:
+    case Playlist::Column_Filetype:
+    case Playlist::Column_DateModified:
+    case Playlist::Column_DateCreated:
+    case Playlist::Column_Source:
+      return true;
+    default:
+      return false;
+  }
+
+}
+
+QString TextKey(int column, const PlaylistItemPtr &item, const Song &song) {
+
+  switch (column) {
+    case Playlist::Column_Title:        return song.title().toLower();
+    case Playlist::Column_Artist:       return song.artist().toLower();
+    case Playlist::Column_Album:        return song.album().toLower();
+    case Playlist::Column_Genre:        return song.genre().toLower();
+    case Playlist::Column_AlbumArtist:  return song.playlist_albumartist().toLower();
+    case Playlist::Column_Composer:     return song.composer().toLower();
+    case Playlist::Column_Performer:    return song.performer().toLower();
+    case Playlist::Column_Grouping:     return song.grouping().toLower();
+    case Playlist::Column_Filename:     return item->Url().path().toLower();
+    case Playlist::Column_BaseFilename: return song.basefilename().toLower();
+    case Playlist::Column_Comment:      return song.comment().toLower();
+    default:                            return QString();
+  }
+
+}
+
+qint64 NumberKey(int column, const PlaylistItemPtr &item, const Song &song) {
+
+  switch (column) {
+    case PlaylistSorter::kColumnPathDepth: return item->Url().path().count('/');
+    case Playlist::Column_Length:          return song.length_nanosec();
+    case Playlist::Column_Track:           return song.track();
+    case Playlist::Column_Disc:            return song.disc();
+    case Playlist::Column_Year:            return song.year();
+    case Playlist::Column_OriginalYear:    return song.originalyear();
+    case Playlist::Column_PlayCount:       return song.playcount();
+    case Playlist::Column_SkipCount:       return song.skipcount();
+    case Playlist::Column_LastPlayed:      return song.lastplayed();
+    case Playlist::Column_Bitrate:         return song.bitrate();
+    case Playlist::Column_Samplerate:      return song.samplerate();
+    case Playlist::Column_Bitdepth:        return song.bitdepth();
+    case Playlist::Column_Filesize:        return song.filesize();
+    case Playlist::Column_Filetype:        return song.filetype();
+    case Playlist::Column_DateModified:    return song.mtime();
+    case Playlist::Column_DateCreated:     return song.ctime();
+    case Playlist::Column_Source:          return song.source();
+    default:                               return 0;
+  }
+
+}
+
+QList<Chunk> Chunks(int count) {
+
+  const int chunk_count = count >= PlaylistSorter::kParallelSortSize ? qMax(1, QThread::idealThreadCount()) : 1;
+  const int chunk_size = (count + chunk_count - 1) / chunk_count;
+
+  QList<Chunk> chunks;
+  for (int begin = 0; begin < count; begin += chunk_size) {
+    chunks << Chunk(begin, qMin(count, begin + chunk_size));
+  }
+  return chunks;
+
+}
+
+}  // namespace
+
+PlaylistSorter::SortSpec PlaylistSorter::ColumnSortSpec(int column, Qt::SortOrder order) {
+
+  SortSpec spec;
+
+  if (column == Playlist::Column_Album) {
+    // When sorting by album, also take into account discs and tracks.
+    spec << SortColumn(Playlist::Column_Album, order) << SortColumn(Playlist::Column_Disc, order) << SortColumn(Playlist::Column_Track, order);
+  }
+  else if (column == Playlist::Column_Filename) {
+    // When sorting by full paths we also expect a hierarchical order. This returns a breath-first ordering of paths.
+    spec << SortColumn(kColumnPathDepth, order) << SortColumn(Playlist::Column_Filename, order);
+  }
+  else {
+    spec << SortColumn(column, order);
+  }
+
+  return spec;
+
+}
+
+QList<int> PlaylistSorter::Sort(const PlaylistItemList &items, const SortSpec &spec) {
+
+  const int count = items.count();
+
+  std::vector<SortKeys> keys;
+  for (const SortColumn &column : spec) {
+    if (IsTextColumn(column.column)) {
+      keys.push_back(SortKeys(column, true));
+    }
+    else if (IsNumberColumn(column.column)) {
+      keys.push_back(SortKeys(column, false));
+    }
+    else {
+      qLog(Error) << "No such column" << column.column;
+    }
+  }
+  if (keys.empty() || count < 2) {
+    QList<int> rows;
+    for (int i = 0; i < count; ++i) rows << i;
+    return rows;
+  }
+
+  // Fill the keys, QCollatorSortKey can't be default constructed so start with empty ones.
+  const QCollatorSortKey empty_key = QCollator().sortKey(QString());
+  for (SortKeys &column_keys : keys) {
+    if (column_keys.text) column_keys.texts.resize(count, empty_key);
+    else column_keys.numbers.resize(count);
+  }
+
+  QList<Chunk> chunks = Chunks(count);
+  QtConcurrent::blockingMap(chunks, [&items, &keys](const Chunk &chunk) {
+    // Every thread has its own collator, they are not safe to share
+    QCollator collator;
+    for (int i = chunk.begin; i < chunk.end; ++i) {
+      const PlaylistItemPtr &item = items[i];
+      const Song song = item->Metadata();
+      for (SortKeys &column_keys : keys) {
+        if (column_keys.text) column_keys.texts[i] = collator.sortKey(TextKey(column_keys.column, item, song));
+        else column_keys.numbers[i] = NumberKey(column_keys.column, item, song);
+      }
+    }
+  });
+
+  // Items that compare equal keep their order, so the sort is stable.
+  auto compare = [&keys](int a, int b) {
+    for (const SortKeys &column_keys : keys) {
+      int result = 0;
+      if (column_keys.text) {
+        result = column_keys.texts[a].compare(column_keys.texts[b]);
+      }
+      else if (column_keys.numbers[a] != column_keys.numbers[b]) {
+        result = column_keys.numbers[a] < column_keys.numbers[b] ? -1 : 1;
+      }
+      if (result != 0) return column_keys.order == Qt::AscendingOrder ? result < 0 : result > 0;
+    }
+    return a < b;
+  };
+
+  std::vector<int> rows(count);
+  std::iota(rows.begin(), rows.end(), 0);
+
+  // Sort each chunk on its own thread, then merge them.
+  QtConcurrent::blockingMap(chunks, [&rows, &compare](const Chunk &chunk) {
+    std::sort(rows.begin() + chunk.begin, rows.begin() + chunk.end, compare);
+  });
+  for (int i = 1; i < chunks.count(); ++i) {
+    std::inplace_merge(rows.begin(), rows.begin() + chunks[i].begin, rows.begin() + chunks[i].end, compare);
+  }
+
+  QList<int> sorted_rows;
+  sorted_rows.reserve(count);
+  for (int row : rows) {
+    sorted_rows << row;
+  }
+  return sorted_rows;
+
+}
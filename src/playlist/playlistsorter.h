@@ -0,0 +1,55 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2018, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PLAYLISTSORTER_H
+#define PLAYLISTSORTER_H
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QList>
+
+#include "playlistitem.h"
+
+// Sorts playlist items on one or more columns.
+// The sort keys of every item are extracted once, strings as locale aware collation keys,
+// then the items are sorted in a single stable pass comparing only the keys.
+class PlaylistSorter {
+ public:
+  // Sorts on the number of directories in the path, used with Playlist::Column_Filename.
+  static const int kColumnPathDepth;
+
+  // Keys are extracted and sorted on several threads for playlists this big
+  static const int kParallelSortSize;
+
+  struct SortColumn {
+    SortColumn(int _column = -1, Qt::SortOrder _order = Qt::AscendingOrder) : column(_column), order(_order) {}
+    int column;
+    Qt::SortOrder order;
+  };
+  typedef QList<SortColumn> SortSpec;
+
+  // The columns sorting on column from the header really sorts on, ie. disc and track after album.
+  static SortSpec ColumnSortSpec(int column, Qt::SortOrder order);
+
+  // Returns the rows of items in sorted order.
+  static QList<int> Sort(const PlaylistItemList &items, const SortSpec &spec);
+};
+
+#endif  // PLAYLISTSORTER_H
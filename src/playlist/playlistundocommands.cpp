@@ -22,7 +22,9 @@
 
 #include <memory>
 
+#include <QtGlobal>
 #include <QList>
+#include <QVector>
 #include <QUrl>
 #include <QUndoStack>
 
@@ -33,7 +35,78 @@
 
 namespace PlaylistUndoCommands {
 
-Base::Base(Playlist* playlist) : QUndoCommand(0), playlist_(playlist) {}
+namespace {
+// A PlaylistItemPtr in a QList is a pointer to a heap allocated shared pointer
+const int kItemCost = sizeof(void*) + sizeof(PlaylistItemPtr);
+}
+
+Base::Base(Playlist* playlist) : QUndoCommand(0), playlist_(playlist), evicted_(false) {}
+
+void Base::Evict() {
+
+  evicted_ = true;
+  Release();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+  // The stack drops obsolete commands instead of undoing them
+  setObsolete(true);
+#endif
+
+}
+
+
+Permutation::Permutation(const QList<int> &old_rows) : runs_(false) {
+
+  const int count = old_rows.count();
+
+  QVector<int> runs;
+  for (int i = 0; i < count && runs.count() < count;) {
+    int step = 1;
+    if (i + 1 < count && old_rows[i + 1] == old_rows[i] - 1) step = -1;
+    int length = 1;
+    while (i + length < count && old_rows[i + length] == old_rows[i] + step * length) ++length;
+    runs << old_rows[i] << step * length;
+    i += length;
+  }
+
+  runs_ = runs.count() < count;
+  if (runs_) {
+    data_ = runs;
+  }
+  else {
+    data_ = old_rows.toVector();
+  }
+  data_.squeeze();
+
+}
+
+QList<int> Permutation::old_rows() const {
+
+  if (!runs_) return data_.toList();
+
+  QList<int> rows;
+  for (int i = 0; i < data_.count(); i += 2) {
+    const int first = data_[i];
+    const int step = data_[i + 1] < 0 ? -1 : 1;
+    for (int j = 0; j < qAbs(data_[i + 1]); ++j) {
+      rows << first + step * j;
+    }
+  }
+  return rows;
+
+}
+
+QList<int> Permutation::new_rows() const {
+
+  const QList<int> rows = old_rows();
+
+  QVector<int> new_rows(rows.count());
+  for (int i = 0; i < rows.count(); ++i) {
+    new_rows[rows[i]] = i;
+  }
+  return new_rows.toList();
+
+}
+
 
 
 InsertItems::InsertItems(Playlist *playlist, const PlaylistItemList &items, int pos, bool enqueue, bool enqueue_next)
@@ -47,10 +120,12 @@ InsertItems::InsertItems(Playlist *playlist, const PlaylistItemList &items, int
 }
 
 void InsertItems::redo() {
+  if (evicted_) return;
   playlist_->InsertItemsWithoutUndo(items_, pos_, enqueue_, enqueue_next_);
 }
 
 void InsertItems::undo() {
+  if (evicted_) return;
   const int start = pos_ == -1 ? playlist_->rowCount() - items_.count() : pos_;
   playlist_->RemoveItemsWithoutUndo(start, items_.count());
 }
@@ -66,6 +141,10 @@ bool InsertItems::UpdateItem(const PlaylistItemPtr &updated_item) {
   return false;
 }
 
+int InsertItems::cost() const { return items_.count() * kItemCost; }
+
+void InsertItems::Release() { items_.clear(); }
+
 
 RemoveItems::RemoveItems(Playlist *playlist, int pos, int count) : Base(playlist) {
   setText(tr("remove %n songs", "", count));
@@ -74,16 +153,19 @@ RemoveItems::RemoveItems(Playlist *playlist, int pos, int count) : Base(playlist
 }
 
 void RemoveItems::redo() {
+  if (evicted_) return;
   for (int i = 0; i < ranges_.count(); ++i)
     ranges_[i].items_ = playlist_->RemoveItemsWithoutUndo(ranges_[i].pos_, ranges_[i].count_);
 }
 
 void RemoveItems::undo() {
+  if (evicted_) return;
   for (int i = ranges_.count() - 1; i >= 0; --i)
     playlist_->InsertItemsWithoutUndo(ranges_[i].items_, ranges_[i].pos_);
 }
 
 bool RemoveItems::mergeWith(const QUndoCommand *other) {
+  if (evicted_) return false;
   const RemoveItems* remove_command = static_cast<const RemoveItems*>(other);
   ranges_.append(remove_command->ranges_);
 
@@ -94,6 +176,14 @@ bool RemoveItems::mergeWith(const QUndoCommand *other) {
   return true;
 }
 
+int RemoveItems::cost() const {
+  int cost = 0;
+  for (const Range &range : ranges_) cost += sizeof(Range) + range.items_.count() * kItemCost;
+  return cost;
+}
+
+void RemoveItems::Release() { ranges_.clear(); }
+
 
 MoveItems::MoveItems(Playlist *playlist, const QList<int> &source_rows, int pos)
   : Base(playlist),
@@ -104,22 +194,35 @@ MoveItems::MoveItems(Playlist *playlist, const QList<int> &source_rows, int pos)
 }
 
 void MoveItems::redo() {
+  if (evicted_) return;
   playlist_->MoveItemsWithoutUndo(source_rows_, pos_);
 }
 
 void MoveItems::undo() {
+  if (evicted_) return;
   playlist_->MoveItemsWithoutUndo(pos_, source_rows_);
 }
 
-ReOrderItems::ReOrderItems(Playlist* playlist, const PlaylistItemList &new_items)
-    : Base(playlist), old_items_(playlist->items_), new_items_(new_items) {}
+int MoveItems::cost() const { return source_rows_.count() * sizeof(void*); }
 
-void ReOrderItems::undo() { playlist_->ReOrderWithoutUndo(old_items_); }
+void MoveItems::Release() { source_rows_.clear(); }
 
-void ReOrderItems::redo() { playlist_->ReOrderWithoutUndo(new_items_); }
 
-SortItems::SortItems(Playlist* playlist, int column, Qt::SortOrder order, const PlaylistItemList &new_items)
-  : ReOrderItems(playlist, new_items)
+ReOrderItems::ReOrderItems(Playlist* playlist, const QList<int> &old_rows)
+    : Base(playlist), rows_(old_rows) {}
+
+void ReOrderItems::undo() {
+  if (evicted_) return;
+  playlist_->ReOrderWithoutUndo(rows_.new_rows());
+}
+
+void ReOrderItems::redo() {
+  if (evicted_) return;
+  playlist_->ReOrderWithoutUndo(rows_.old_rows());
+}
+
+SortItems::SortItems(Playlist* playlist, int column, Qt::SortOrder order, const QList<int> &old_rows)
+  : ReOrderItems(playlist, old_rows)
     //column_(column),
     //order_(order)
 {
@@ -127,8 +230,8 @@ SortItems::SortItems(Playlist* playlist, int column, Qt::SortOrder order, const
 }
 
 
-ShuffleItems::ShuffleItems(Playlist* playlist, const PlaylistItemList &new_items)
-  : ReOrderItems(playlist, new_items)
+ShuffleItems::ShuffleItems(Playlist* playlist, const QList<int> &old_rows)
+  : ReOrderItems(playlist, old_rows)
 {
   setText(tr("shuffle songs"));
 }
@@ -25,8 +25,10 @@
 
 #include <stdbool.h>
 
+#include <QtGlobal>
 #include <QCoreApplication>
 #include <QList>
+#include <QVector>
 #include <QUndoStack>
 
 #include "playlistitem.h"
@@ -45,8 +47,39 @@ namespace PlaylistUndoCommands {
    public:
     Base(Playlist *playlist);
 
+    // Roughly how many bytes the command keeps alive to be able to undo and redo
+    virtual int cost() const = 0;
+
+    // Frees the data of a command at the bottom of the stack to make room for newer ones.
+    // The command does nothing afterwards, so only the oldest commands that are done can be evicted.
+    void Evict();
+    bool evicted() const { return evicted_; }
+
    protected:
+    virtual void Release() = 0;
+
     Playlist *playlist_;
+    bool evicted_;
+  };
+
+  // A reordering of the playlist, as the old row of every new row.
+  // Sorted or reversed runs of rows are stored as a first row and a length, so reordering a mostly ordered playlist takes a few bytes.
+  // Otherwise the rows are stored as a plain array of ints.
+  class Permutation {
+   public:
+    Permutation() : runs_(false) {}
+    explicit Permutation(const QList<int> &old_rows);
+
+    QList<int> old_rows() const;
+    QList<int> new_rows() const;
+
+    int cost() const { return data_.count() * sizeof(int); }
+    void clear() { data_.clear(); }
+
+   private:
+    bool runs_;
+    // Either the rows, or pairs of first row and length, negative when the run is reversed
+    QVector<int> data_;
   };
 
   class InsertItems : public Base {
@@ -60,6 +93,11 @@ namespace PlaylistUndoCommands {
     // Return true if the was found (and updated), false otherwise
     bool UpdateItem(const PlaylistItemPtr &updated_item);
 
+    int cost() const;
+
+   protected:
+    void Release();
+
    private:
     PlaylistItemList items_;
     int pos_;
@@ -77,6 +115,11 @@ namespace PlaylistUndoCommands {
     void redo();
     bool mergeWith(const QUndoCommand *other);
 
+    int cost() const;
+
+   protected:
+    void Release();
+
    private:
     struct Range {
       Range(int pos, int count) : pos_(pos), count_(count) {}
@@ -95,6 +138,11 @@ namespace PlaylistUndoCommands {
     void undo();
     void redo();
 
+    int cost() const;
+
+   protected:
+    void Release();
+
    private:
     QList<int> source_rows_;
     int pos_;
@@ -102,19 +150,23 @@ namespace PlaylistUndoCommands {
 
   class ReOrderItems : public Base {
    public:
-    ReOrderItems(Playlist *playlist, const PlaylistItemList &new_items);
+    ReOrderItems(Playlist *playlist, const QList<int> &old_rows);
 
     void undo();
     void redo();
 
+    int cost() const { return rows_.cost(); }
+
+   protected:
+    void Release() { rows_.clear(); }
+
    private:
-    PlaylistItemList old_items_;
-    PlaylistItemList new_items_;
+    Permutation rows_;
   };
 
   class SortItems : public ReOrderItems {
    public:
-    SortItems(Playlist *playlist, int column, Qt::SortOrder order, const PlaylistItemList &new_items);
+    SortItems(Playlist *playlist, int column, Qt::SortOrder order, const QList<int> &old_rows);
 
    private:
     //int column_;
@@ -123,7 +175,7 @@ namespace PlaylistUndoCommands {
 
   class ShuffleItems : public ReOrderItems {
    public:
-    ShuffleItems(Playlist *playlist, const PlaylistItemList &new_items);
+    ShuffleItems(Playlist *playlist, const QList<int> &old_rows);
   };
 } //namespace
 
@@ -28,6 +28,7 @@
 #include <QBuffer>
 #include <QFlags>
 #include <QList>
+#include <QSet>
 #include <QVariant>
 #include <QString>
 #include <QStringList>
@@ -166,35 +167,48 @@ QVariant Queue::data(const QModelIndex &proxy_index, int role) const {
 
 void Queue::ToggleTracks(const QModelIndexList &source_indexes) {
 
+  QSet<int> queued_rows;
+  for (const QPersistentModelIndex &source_index : source_indexes_) {
+    queued_rows.insert(source_index.row());
+  }
+
+  QList<QPersistentModelIndex> enqueued;
   for (const QModelIndex &source_index : source_indexes) {
-    QModelIndex proxy_index = mapFromSource(source_index);
-    if (proxy_index.isValid()) {
+    if (queued_rows.contains(source_index.row())) {
       // Dequeue the track
-      const int row = proxy_index.row();
+      const int row = mapFromSource(source_index).row();
       beginRemoveRows(QModelIndex(), row, row);
       source_indexes_.removeAt(row);
       endRemoveRows();
+      queued_rows.remove(source_index.row());
     }
     else {
-      // Enqueue the track
-      const int row = source_indexes_.count();
-      beginInsertRows(QModelIndex(), row, row);
-      source_indexes_ << QPersistentModelIndex(source_index);
-      endInsertRows();
+      enqueued << QPersistentModelIndex(source_index);
     }
   }
 
+  // Enqueue the tracks all at once
+  if (!enqueued.isEmpty()) {
+    const int row = source_indexes_.count();
+    beginInsertRows(QModelIndex(), row, row + enqueued.count() - 1);
+    source_indexes_ << enqueued;
+    endInsertRows();
+  }
+
 }
 
 void Queue::InsertFirst(const QModelIndexList &source_indexes) {
 
+  QSet<int> rows_to_insert;
   for (const QModelIndex &source_index : source_indexes) {
-    QModelIndex proxy_index = mapFromSource(source_index);
-    if (proxy_index.isValid()) {
+    rows_to_insert.insert(source_index.row());
+  }
+
+  for (int i = source_indexes_.count() - 1; i >= 0; --i) {
+    if (rows_to_insert.contains(source_indexes_[i].row())) {
       // Already in the queue, so remove it to be reinserted later
-      const int row = proxy_index.row();
-      beginRemoveRows(QModelIndex(), row, row);
-      source_indexes_.removeAt(row);
+      beginRemoveRows(QModelIndex(), i, i);
+      source_indexes_.removeAt(i);
       endRemoveRows();
     }
   }
@@ -202,11 +216,13 @@ void Queue::InsertFirst(const QModelIndexList &source_indexes) {
   const int rows = source_indexes.count();
   // Enqueue the tracks at the beginning
   beginInsertRows(QModelIndex(), 0, rows - 1);
-  int offset = 0;
+  QList<QPersistentModelIndex> new_source_indexes;
+  new_source_indexes.reserve(rows + source_indexes_.count());
   for (const QModelIndex& source_index : source_indexes) {
-    source_indexes_.insert(offset, QPersistentModelIndex(source_index));
-    offset++;
+    new_source_indexes << QPersistentModelIndex(source_index);
   }
+  new_source_indexes << source_indexes_;
+  source_indexes_ = new_source_indexes;
   endInsertRows();
 
 }
@@ -29,6 +29,7 @@
 #include <QFileDialog>
 #include <QCheckBox>
 #include <QLineEdit>
+#include <QSpinBox>
 #include <QListView>
 #include <QPushButton>
 #include <QSettings>
@@ -109,8 +110,11 @@ void CollectionSettingsPage::Load() {
   ui_->auto_open->setChecked(s.value("auto_open", true).toBool());
   ui_->pretty_covers->setChecked(s.value("pretty_covers", true).toBool());
   ui_->show_dividers->setChecked(s.value("show_dividers", true).toBool());
+  ui_->in_memory_index->setChecked(s.value("in_memory_index", false).toBool());
+  ui_->compact_songs->setChecked(s.value("compact_songs", false).toBool());
   ui_->startup_scan->setChecked(s.value("startup_scan", true).toBool());
   ui_->monitor->setChecked(s.value("monitor", true).toBool());
+  ui_->spinbox_scan_threads->setValue(s.value("scan_threads", 1).toInt());
 
   QStringList filters = s.value("cover_art_patterns", QStringList() << "front" << "cover").toStringList();
   ui_->cover_art_patterns->setText(filters.join(","));
@@ -139,8 +143,11 @@ void CollectionSettingsPage::Save() {
   s.setValue("auto_open", ui_->auto_open->isChecked());
   s.setValue("pretty_covers", ui_->pretty_covers->isChecked());
   s.setValue("show_dividers", ui_->show_dividers->isChecked());
+  s.setValue("in_memory_index", ui_->in_memory_index->isChecked());
+  s.setValue("compact_songs", ui_->compact_songs->isChecked());
   s.setValue("startup_scan", ui_->startup_scan->isChecked());
   s.setValue("monitor", ui_->monitor->isChecked());
+  s.setValue("scan_threads", ui_->spinbox_scan_threads->value());
 
   QString filter_text = ui_->cover_art_patterns->text();
   QStringList filters = filter_text.split(',', QString::SkipEmptyParts);